@@ -0,0 +1,168 @@
+// bench_pipeline.cpp
+//
+// Microbenchmarks del camino por muestra con 1 a MAX_CELL_COUNT celdas:
+// Pack::update con celdas simuladas, ProtectionMonitor::evaluate (las
+// alertas) y firebase_serialize_snapshot (el JSON completo de la
+// resincronización). Es el mismo recorrido que la orden "benchmark" del
+// dispositivo, con más iteraciones y sin expropiaciones de otras tareas, nada
+// más que para comparar cambios: los tiempos del host no son los del C3.
+//
+// Falla si alguna etapa reserva heap o si el benchmark del dispositivo
+// (benchmark_run) no publica sus resultados en diagnostics/benchmark.
+//
+//   bench_pipeline [iteraciones]
+#include "Battery/battery_controller.h"
+#include "Battery/protection_monitor.h"
+#include "Battery/simulated_cell_source.h"
+#include "Firebase/firebase_controller.h"
+#include "Diagnostics/benchmark.h"
+#include "Boot/boot_profile.h"
+#include "Diagnostics/memory_budget.h"
+#include "Params/params_cache.h"
+#include "bi_params.hpp"
+#include "custom_config.h"
+#include "app_config.h"
+#include "host_heap.h"
+#include "mock_rtdb.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+extern BIParams biParams;
+
+// firebase_controller.cpp; en el dispositivo la llama firebase_task
+bool init_firebase(void);
+
+static constexpr uint32_t DEFAULT_ITERATIONS = 20000;
+static constexpr uint32_t ROUNDS = 5;   // Se publica la ronda más rápida de cada etapa
+
+static SimulatedCellSource s_source(BENCHMARK_SEED);
+static Pack s_pack;
+static ProtectionMonitor s_protection;
+static battery_snapshot_t s_snapshot;
+static char s_buffer[BENCHMARK_BUFFER_SIZE];
+
+typedef struct {
+    double updateNs;
+    double alertsNs;
+    double serializeNs;
+    size_t bytes;
+    uint64_t allocations;
+} stage_costs_t;
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Misma muestra que arma el benchmark del dispositivo
+static void fill_snapshot() {
+    const CellsView cells = s_pack.getCells();
+    s_snapshot.cell_count = static_cast<uint8_t>(cells.size());
+    s_snapshot.cells = cells.data();
+    s_snapshot.voltage = s_pack.getTotalVoltage();
+    s_snapshot.current = s_pack.getCurrent();
+    s_snapshot.power = s_pack.getPower();
+    s_snapshot.status = s_pack.getStatus();
+    s_snapshot.stats = s_pack.getStats();
+    s_snapshot.soc_permille = s_pack.getSocPermille();
+    s_snapshot.faults = s_protection.getActive();
+    s_snapshot.uptime = s_pack.getUptime();
+}
+
+static bool measure(uint8_t cells, uint32_t iterations, stage_costs_t* costs) {
+    const bool ok = s_pack.getCellCount() == 0 ? s_pack.init(cells) : s_pack.reconfigure(cells);
+    if (!ok) {
+        return false;
+    }
+
+    const DeviceParams& params = biParams.getParams();
+    *costs = {1e18, 1e18, 1e18, 0, 0};
+    const uint64_t allocationsBefore = host_heap_allocations();
+    for (uint32_t round = 0; round < ROUNDS; ++round) {
+        int64_t updateNs = 0;
+        int64_t alertsNs = 0;
+        int64_t serializeNs = 0;
+        for (uint32_t i = 0; i < iterations; ++i) {
+            int64_t start = now_ns();
+            s_pack.update();
+            updateNs += now_ns() - start;
+
+            start = now_ns();
+            s_protection.evaluate(s_pack, params);
+            alertsNs += now_ns() - start;
+
+            fill_snapshot();
+            start = now_ns();
+            costs->bytes = firebase_serialize_snapshot(&s_snapshot, s_buffer, sizeof(s_buffer));
+            serializeNs += now_ns() - start;
+        }
+        costs->updateNs = std::min(costs->updateNs, static_cast<double>(updateNs) / iterations);
+        costs->alertsNs = std::min(costs->alertsNs, static_cast<double>(alertsNs) / iterations);
+        costs->serializeNs = std::min(costs->serializeNs, static_cast<double>(serializeNs) / iterations);
+    }
+    costs->allocations = host_heap_allocations() - allocationsBefore;
+    return costs->bytes != 0;
+}
+
+// benchmark_run() contra la base de datos simulada: mide y publica en su propio PATCH
+static bool check_device_benchmark() {
+    mock_rtdb_set_account("bench-device");
+    biParams.getState().wifiConnected = true;
+    biParams.getState().firebaseConnected = true;
+    if (!init_firebase() || !benchmark_run()) {
+        return false;
+    }
+
+    char path[96];
+    double value = 0.0;
+    snprintf(path, sizeof(path), "/batteries/bench-device/diagnostics/benchmark/cells%d/payloadBytes", MAX_CELL_COUNT);
+    return mock_rtdb_get_number(path, &value) && value > 0 &&
+           mock_rtdb_get_number("/batteries/bench-device/diagnostics/benchmark/iterations", &value) &&
+           value == BENCHMARK_ITERATIONS;
+}
+
+int main(int argc, char** argv) {
+    const uint32_t iterations = argc > 1 ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : DEFAULT_ITERATIONS;
+    if (iterations == 0) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    boot_profile_init();
+    memory_budget_init();
+    biParams.init();
+    params_cache_init();
+    firebase_controller_init();
+    benchmark_init();
+
+    s_pack.setSource(&s_source);
+    s_pack.setNominalCapacity(appConfig.cellCapacityMah);
+    s_source.seed(BENCHMARK_SEED);
+
+    printf("cells  update ns  alerts ns  serialize ns  bytes  allocs   (%lu iterations, best of %lu rounds)\n",
+           static_cast<unsigned long>(iterations), static_cast<unsigned long>(ROUNDS));
+    bool ok = true;
+    for (uint8_t cells = MIN_CELL_COUNT; cells <= MAX_CELL_COUNT; ++cells) {
+        stage_costs_t costs;
+        if (!measure(cells, iterations, &costs)) {
+            fprintf(stderr, "measure failed with %u cells\n", cells);
+            return EXIT_FAILURE;
+        }
+        printf("%5u  %9.1f  %9.1f  %12.1f  %5zu  %6llu\n", cells, costs.updateNs, costs.alertsNs,
+               costs.serializeNs, costs.bytes, static_cast<unsigned long long>(costs.allocations));
+        ok = ok && costs.allocations == 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "FAIL: the per-sample path allocated heap\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!check_device_benchmark()) {
+        fprintf(stderr, "FAIL: benchmark_run() did not publish diagnostics/benchmark\n");
+        return EXIT_FAILURE;
+    }
+    printf("benchmark_run(): results published to diagnostics/benchmark\n");
+    return EXIT_SUCCESS;
+}
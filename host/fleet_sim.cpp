@@ -0,0 +1,247 @@
+// fleet_sim.cpp
+//
+// Flota de dispositivos virtuales contra la base de datos simulada, para
+// estimar la carga de muchos packs sobre la RTDB (peticiones por segundo,
+// bytes por petición, datos guardados por dispositivo) antes de desplegar.
+// Cada dispositivo ejecuta el firmware real de muestreo, política de subida y
+// serialización sobre un reloj virtual, con una fase de arranque aleatoria;
+// los dispositivos se simulan uno tras otro y la carga se suma por segundo
+// virtual.
+//
+// Al terminar cada dispositivo se sube una última muestra sin pérdidas y se
+// comprueba que el espejo de la base de datos coincide con ella. El programa
+// falla si no coincide o si el servidor rechazó algún cuerpo.
+//
+//   fleet_sim [dispositivos] [segundos] [tasa de pérdidas]
+#include "Battery/battery_controller.h"
+#include "Battery/protection_monitor.h"
+#include "Battery/report_policy.h"
+#include "Battery/sample_window.h"
+#include "Battery/simulated_cell_source.h"
+#include "Firebase/firebase_controller.h"
+#include "Boot/boot_profile.h"
+#include "Diagnostics/memory_budget.h"
+#include "Params/params_cache.h"
+#include "Storage/history_log.h"
+#include "bi_params.hpp"
+#include "custom_config.h"
+#include "app_config.h"
+#include "esp_random.h"
+#include "host_clock.h"
+#include "mock_rtdb.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+extern BIParams biParams;
+
+// firebase_controller.cpp; en el dispositivo la llama firebase_task
+bool init_firebase(void);
+
+static constexpr int64_t FLEET_EPOCH_US = 1000000;         // Inicio del reloj virtual
+static const uint8_t CELL_MIX[] = {4, 8, 12, 16, 18};      // Celdas de cada dispositivo, por turnos
+
+static SimulatedCellSource s_source;
+static Pack s_pack;
+static ProtectionMonitor s_protection;
+static SampleAccumulator s_samples;
+static ReportPolicy s_policy;
+static battery_snapshot_t s_snapshot;
+
+// Carga sumada de la flota por segundo virtual
+static std::vector<uint32_t> s_requestsPerSecond;
+static std::vector<uint64_t> s_bytesPerSecond;
+
+// Misma muestra que arma enqueue_snapshot() para un único pack sin balanceo
+static void fill_snapshot(bool live) {
+    const CellsView cells = s_pack.getCells();
+    s_snapshot.pack = 0;
+    s_snapshot.pack_count = 1;
+    s_snapshot.cell_count = static_cast<uint8_t>(cells.size());
+    s_snapshot.cells = cells.data();
+    s_snapshot.voltage = s_pack.getTotalVoltage();
+    s_snapshot.current = s_pack.getCurrent();
+    s_snapshot.power = s_pack.getPower();
+    s_snapshot.status = s_pack.getStatus();
+    s_snapshot.stats = s_pack.getStats();
+    s_snapshot.soc_permille = s_pack.getSocPermille();
+    s_snapshot.report_period_ms = s_policy.getPeriodMs();
+    s_snapshot.balance_state = BALANCE_STATE_IDLE;
+    s_snapshot.balance_mask = 0;
+    memset(s_snapshot.balance_seconds, 0, sizeof(s_snapshot.balance_seconds));
+    s_snapshot.faults = s_protection.getActive();
+    s_snapshot.uptime = s_pack.getUptime();
+    s_snapshot.timestamp_ms = history_epoch_ms();
+    if (live) {
+        s_samples.closeWindow(&s_snapshot.window);
+    } else {
+        s_snapshot.window.samples = 0;
+    }
+}
+
+// Sube la muestra y anota su carga en el segundo virtual en curso
+static bool upload(int64_t startUs) {
+    const mock_rtdb_stats_t before = *mock_rtdb_get_stats();
+    const int64_t second = (host_clock_now_us() - startUs) / 1000000;
+    const bool ok = update_battery_snapshot(&s_snapshot, true);
+    const mock_rtdb_stats_t* after = mock_rtdb_get_stats();
+    if (second >= 0 && static_cast<size_t>(second) < s_requestsPerSecond.size()) {
+        s_requestsPerSecond[second] += after->requests - before.requests;
+        s_bytesPerSecond[second] += after->bodyBytes - before.bodyBytes;
+    }
+    return ok;
+}
+
+// El espejo coincide con la última muestra: cada celda dentro de la banda muerta, el pack exacto
+static bool check_mirror(const char* uid) {
+    char path[96];
+    snprintf(path, sizeof(path), "/batteries/%s/cells", uid);
+    const size_t leaves = mock_rtdb_count_leaves(path);
+    if (leaves != s_snapshot.cell_count * 5u) {
+        fprintf(stderr, "%s: %zu cell leaves, expected %u\n", uid, leaves, s_snapshot.cell_count * 5u);
+        return false;
+    }
+
+    const float* voltages = s_snapshot.cells.voltage;
+    for (uint8_t i = 0; i < s_snapshot.cell_count; ++i) {
+        double stored = 0.0;
+        snprintf(path, sizeof(path), "/batteries/%s/cells/%u/voltage", uid, i);
+        if (!mock_rtdb_get_number(path, &stored) ||
+            std::fabs(stored - voltages[i]) * 1000.0 > appConfig.voltageDeadbandMv + 0.5) {
+            fprintf(stderr, "%s: cell %u stored %.3f V, last sample %.3f V\n", uid, i, stored, voltages[i]);
+            return false;
+        }
+    }
+
+    double stored = 0.0;
+    snprintf(path, sizeof(path), "/batteries/%s/pack/totalVoltage", uid);
+    if (!mock_rtdb_get_number(path, &stored) || std::fabs(stored - s_snapshot.voltage) > 0.0005 + 1e-6) {
+        fprintf(stderr, "%s: pack stored %.3f V, last sample %.3f V\n", uid, stored, s_snapshot.voltage);
+        return false;
+    }
+    return true;
+}
+
+static bool run_device(uint32_t index, uint32_t seconds, double lossRate) {
+    char uid[16];
+    snprintf(uid, sizeof(uid), "sim-%04lu", static_cast<unsigned long>(index));
+
+    const uint8_t cells = CELL_MIX[index % (sizeof(CELL_MIX) / sizeof(CELL_MIX[0]))];
+    s_source.seed(index + 1);
+    if (!(s_pack.getCellCount() == 0 ? s_pack.init(cells) : s_pack.reconfigure(cells))) {
+        fprintf(stderr, "%s: pack init failed\n", uid);
+        return false;
+    }
+    s_samples.reset(cells);
+    s_protection = ProtectionMonitor();
+
+    const DeviceParams& params = biParams.getParams();
+    PackLimits limits;
+    limits.highVoltage = params.alertHighVoltage;
+    limits.lowVoltage = params.alertLowVoltage;
+    limits.highTemperature = params.alertHighTemp;
+    limits.lowTemperature = params.alertLowTemp;
+    s_pack.setLimits(limits);
+    s_policy.configure(appConfig.reportAdaptive, params.sampleInterval * 1000,
+                       appConfig.reportMinPeriodMs, appConfig.reportMaxPeriodMs);
+
+    // Sesión nueva por dispositivo: autenticación y resincronización completa
+    const int64_t startUs = FLEET_EPOCH_US;
+    host_clock_set_virtual(startUs + static_cast<int64_t>(esp_random() % (params.sampleInterval * 1000)) * 1000);
+    mock_rtdb_set_failure_rate(0.0, 0);
+    mock_rtdb_set_account(uid);
+    biParams.getState().wifiConnected = true;
+    biParams.getState().firebaseConnected = true;
+    if (!init_firebase()) {
+        fprintf(stderr, "%s: init_firebase failed\n", uid);
+        return false;
+    }
+    mock_rtdb_set_failure_rate(lossRate, index + 1);
+
+    const int64_t endUs = startUs + static_cast<int64_t>(seconds) * 1000000;
+    int64_t nextLiveUs = host_clock_now_us();
+    while (host_clock_now_us() < endUs) {
+        const int64_t nowUs = host_clock_now_us();
+        s_pack.update();
+        s_samples.push(s_pack.getCells().voltages(), s_pack.getCurrent(), nowUs);
+        s_protection.evaluate(s_pack, params);
+        const uint32_t period = s_policy.update(s_pack, params, s_protection.getActive(), false, nowUs);
+        nextLiveUs = std::min<int64_t>(nextLiveUs, nowUs + static_cast<int64_t>(period) * 1000);
+
+        if (nowUs >= nextLiveUs) {
+            fill_snapshot(true);
+            upload(startUs);
+            s_policy.onReport();
+            nextLiveUs = host_clock_now_us() + static_cast<int64_t>(s_policy.getPeriodMs()) * 1000;
+        }
+        host_clock_advance_us(static_cast<int64_t>(appConfig.samplePeriodMs) * 1000);
+    }
+
+    // Última muestra sin pérdidas: el espejo tiene que converger a ella
+    mock_rtdb_set_failure_rate(0.0, 0);
+    fill_snapshot(true);
+    if (!upload(startUs)) {
+        fprintf(stderr, "%s: final upload failed\n", uid);
+        return false;
+    }
+    return check_mirror(uid);
+}
+
+int main(int argc, char** argv) {
+    const uint32_t devices = argc > 1 ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 16;
+    const uint32_t seconds = argc > 2 ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 3600;
+    const double lossRate = argc > 3 ? strtod(argv[3], nullptr) : 0.0;
+    if (devices == 0 || seconds == 0 || lossRate < 0.0 || lossRate >= 1.0) {
+        fprintf(stderr, "usage: %s [devices] [seconds] [lossRate 0..1)\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    boot_profile_init();
+    memory_budget_init();
+    biParams.init();
+    params_cache_init();
+    firebase_controller_init();
+    mock_rtdb_reset();
+
+    s_pack.setSource(&s_source);
+    s_pack.setNominalCapacity(appConfig.cellCapacityMah);
+    s_requestsPerSecond.assign(seconds + 1, 0);
+    s_bytesPerSecond.assign(seconds + 1, 0);
+
+    for (uint32_t i = 0; i < devices; ++i) {
+        if (!run_device(i, seconds, lossRate)) {
+            fprintf(stderr, "FAIL: device %lu\n", static_cast<unsigned long>(i));
+            return EXIT_FAILURE;
+        }
+    }
+
+    const mock_rtdb_stats_t* stats = mock_rtdb_get_stats();
+    if (stats->rejected != 0) {
+        fprintf(stderr, "FAIL: the server rejected %lu bodies\n", static_cast<unsigned long>(stats->rejected));
+        return EXIT_FAILURE;
+    }
+
+    uint32_t peakRequests = 0;
+    uint64_t peakBytes = 0;
+    for (size_t i = 0; i < s_requestsPerSecond.size(); ++i) {
+        peakRequests = std::max(peakRequests, s_requestsPerSecond[i]);
+        peakBytes = std::max(peakBytes, s_bytesPerSecond[i]);
+    }
+
+    printf("devices %lu, %lu s virtual, loss rate %.2f\n", static_cast<unsigned long>(devices),
+           static_cast<unsigned long>(seconds), lossRate);
+    printf("requests      %lu (%.2f/s mean, %lu/s peak)\n", static_cast<unsigned long>(stats->requests),
+           static_cast<double>(stats->requests) / seconds, static_cast<unsigned long>(peakRequests));
+    printf("body bytes    %llu (%.0f B/request, %.0f B/s mean, %llu B/s peak)\n",
+           static_cast<unsigned long long>(stats->bodyBytes),
+           stats->requests ? static_cast<double>(stats->bodyBytes) / stats->requests : 0.0,
+           static_cast<double>(stats->bodyBytes) / seconds, static_cast<unsigned long long>(peakBytes));
+    printf("stored        %.0f B/device\n", static_cast<double>(mock_rtdb_stored_bytes("/batteries")) / devices);
+    printf("sessions      %lu logins, %lu refreshes, %lu connections, %lu failed requests\n",
+           static_cast<unsigned long>(stats->logins), static_cast<unsigned long>(stats->refreshes),
+           static_cast<unsigned long>(stats->connections), static_cast<unsigned long>(stats->failed));
+    return EXIT_SUCCESS;
+}
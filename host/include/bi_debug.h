@@ -0,0 +1,35 @@
+// bi_debug.h (host)
+#ifndef HOST_BI_DEBUG_H
+#define HOST_BI_DEBUG_H
+
+#include <memory>
+
+/**
+ * Logs de bi_debug en el host
+ *
+ * Van a stderr con el nombre del logger. Sin la variable de entorno
+ * BIHAR_HOST_LOG no se imprime nada, para no medir la consola en los
+ * benchmarks; con BIHAR_HOST_LOG=<nivel> (0=VERBOSE .. 4=ERROR) se imprimen
+ * los de ese nivel o superior.
+ */
+enum LogLevel { VERBOSE, DEBUG, INFO, WARNING, ERROR };
+
+struct Logger {
+    const char* name;
+    LogLevel level;
+    bool enabled;
+};
+
+typedef std::shared_ptr<Logger> LoggerPtr;
+
+LoggerPtr createLogger(const char* name, LogLevel level, bool enabled);
+void bi_debug_log(const LoggerPtr& logger, LogLevel level, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#define BI_DEBUG_VERBOSE(logger, ...) bi_debug_log(logger, VERBOSE, __VA_ARGS__)
+#define BI_DEBUG_DEBUG(logger, ...)   bi_debug_log(logger, DEBUG, __VA_ARGS__)
+#define BI_DEBUG_INFO(logger, ...)    bi_debug_log(logger, INFO, __VA_ARGS__)
+#define BI_DEBUG_WARNING(logger, ...) bi_debug_log(logger, WARNING, __VA_ARGS__)
+#define BI_DEBUG_ERROR(logger, ...)   bi_debug_log(logger, ERROR, __VA_ARGS__)
+
+#endif // HOST_BI_DEBUG_H
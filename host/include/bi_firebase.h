@@ -0,0 +1,83 @@
+// bi_firebase.h (host)
+#ifndef HOST_BI_FIREBASE_H
+#define HOST_BI_FIREBASE_H
+
+#include <cstddef>
+#include <cstdint>
+#include "esp_http_client.h"
+
+/**
+ * API de bi_firebase que usa main/, servida por la base de datos en memoria
+ * de host/src/mock_rtdb.cpp (ver mock_rtdb.h para inspeccionarla)
+ */
+typedef enum {
+    FIREBASE_AUTH_NONE,
+    FIREBASE_AUTH_API_KEY,
+} firebase_auth_type_t;
+
+typedef struct {
+    firebase_auth_type_t auth_type;
+    const char* api_key;
+    const char* user_email;
+    const char* user_password;
+    const char* custom_token;
+    char* id_token;               // Reservadas con malloc; el manejador es su dueño
+    char* refresh_token;
+    int64_t token_expiry;
+    char* uid;
+} firebase_auth_t;
+
+typedef struct {
+    const char* database_url;
+    firebase_auth_t auth;
+    void* user_data;
+    int timeout_ms;
+    bool secure_connection;
+    esp_http_client_config_t http_config;
+} firebase_config_t;
+
+typedef struct {
+    firebase_auth_t auth;
+    esp_http_client_config_t http_config;
+    bool connected;               // Ya se generó HTTP_EVENT_ON_CONNECTED en este manejador
+} firebase_handle_t;
+
+typedef enum {
+    FIREBASE_DATA_TYPE_NULL,
+    FIREBASE_DATA_TYPE_INT,
+    FIREBASE_DATA_TYPE_FLOAT,
+    FIREBASE_DATA_TYPE_BOOL,
+    FIREBASE_DATA_TYPE_STRING,
+    FIREBASE_DATA_TYPE_JSON,
+} firebase_data_type_t;
+
+typedef struct {
+    firebase_data_type_t type;
+    union {
+        int int_val;
+        double float_val;
+        bool bool_val;
+        char* string_val;
+    } data;
+} firebase_data_value_t;
+
+typedef void (*firebase_listen_cb_t)(void* data, int event_id, firebase_data_value_t* value);
+
+firebase_handle_t* firebase_init(const firebase_config_t* config);
+void firebase_deinit(firebase_handle_t* handle);
+
+bool firebase_auth_with_password(firebase_handle_t* handle, const char* email, const char* password);
+bool firebase_is_authenticated(firebase_handle_t* handle);
+bool firebase_refresh_token(firebase_handle_t* handle);
+bool firebase_maintain_auth(firebase_handle_t* handle);
+
+bool firebase_set_json(firebase_data_value_t* value, const char* json);
+void firebase_free_value(firebase_data_value_t* value);
+
+bool firebase_update(firebase_handle_t* handle, const char* path, firebase_data_value_t* value);
+bool firebase_set(firebase_handle_t* handle, const char* path, firebase_data_value_t* value);
+bool firebase_push(firebase_handle_t* handle, const char* path, firebase_data_value_t* value, char* key,
+                   size_t keySize);
+bool firebase_listen(firebase_handle_t* handle, const char* path, firebase_listen_cb_t callback, void* data);
+
+#endif // HOST_BI_FIREBASE_H
@@ -0,0 +1,71 @@
+// bi_params.hpp (host)
+#ifndef HOST_BI_PARAMS_HPP
+#define HOST_BI_PARAMS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Parámetros del dispositivo (misma estructura que el componente bi_params)
+ */
+struct DeviceParams {
+    char deviceName[32];
+    char deviceModel[32];
+    char deviceKey[64];
+    uint8_t cellCount;
+    uint16_t sampleInterval;
+    bool deepSleepEnabled;
+    float shutdownVoltage;
+    float maxCurrent;
+    float alertHighTemp;
+    float alertLowTemp;
+    float alertHighVoltage;
+    float alertLowVoltage;
+    bool balancingEnabled;
+    float balancingThreshold;
+};
+
+struct DeviceState {
+    bool wifiConnected;
+    bool firebaseConnected;
+    char lastError[128];
+};
+
+struct DeviceCounters {
+    uint32_t bootCount;
+    uint32_t dataPoints;
+    uint32_t errorCount;
+    uint32_t wifiConnectCount;
+    uint32_t wifiFailCount;
+};
+
+/**
+ * @brief bi_params sin NVS: init() carga los valores por defecto y guardar
+ * no hace nada
+ */
+class BIParams {
+public:
+    bool init();
+    bool isInitialized();
+    DeviceParams& getParams();
+    DeviceState& getState();
+    DeviceCounters& getCounters();
+
+    bool incrementCounter(const char* name, uint32_t amount = 1, bool save = true);
+    bool updateStateValue(const char* name, const void* value, size_t size, bool save = true);
+    bool setCellCount(uint8_t count);
+    uint8_t getCellCount();
+
+    void printState();
+    void resetState();
+    bool saveParams();
+    bool saveState();
+
+private:
+    DeviceParams m_params = {};
+    DeviceState m_state = {};
+    DeviceCounters m_counters = {};
+    bool m_initialized = false;
+};
+
+#endif // HOST_BI_PARAMS_HPP
@@ -0,0 +1,10 @@
+// temperature_sensor.h (host)
+#ifndef HOST_DRIVER_TEMPERATURE_SENSOR_H
+#define HOST_DRIVER_TEMPERATURE_SENSOR_H
+
+#include "esp_err.h"
+
+// Solo los tipos que declara adc_cell_source.h: el host mide con SimulatedCellSource
+typedef struct temperature_sensor_obj_t* temperature_sensor_handle_t;
+
+#endif // HOST_DRIVER_TEMPERATURE_SENSOR_H
@@ -0,0 +1,9 @@
+// adc_cali_scheme.h (host)
+#ifndef HOST_ESP_ADC_CALI_SCHEME_H
+#define HOST_ESP_ADC_CALI_SCHEME_H
+
+#include "esp_adc/adc_continuous.h"
+
+typedef struct adc_cali_scheme_t* adc_cali_handle_t;
+
+#endif // HOST_ESP_ADC_CALI_SCHEME_H
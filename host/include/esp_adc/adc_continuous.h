@@ -0,0 +1,10 @@
+// adc_continuous.h (host)
+#ifndef HOST_ESP_ADC_CONTINUOUS_H
+#define HOST_ESP_ADC_CONTINUOUS_H
+
+#include "esp_err.h"
+
+// Solo los tipos que declara adc_cell_source.h: el host mide con SimulatedCellSource
+typedef struct adc_continuous_ctx_t* adc_continuous_handle_t;
+
+#endif // HOST_ESP_ADC_CONTINUOUS_H
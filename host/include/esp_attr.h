@@ -0,0 +1,11 @@
+// esp_attr.h (host)
+#ifndef HOST_ESP_ATTR_H
+#define HOST_ESP_ATTR_H
+
+// Sin secciones de memoria en el host
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+
+#endif // HOST_ESP_ATTR_H
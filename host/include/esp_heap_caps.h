@@ -0,0 +1,12 @@
+// esp_heap_caps.h (host)
+#ifndef HOST_ESP_HEAP_CAPS_H
+#define HOST_ESP_HEAP_CAPS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+
+#endif // HOST_ESP_HEAP_CAPS_H
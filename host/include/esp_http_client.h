@@ -0,0 +1,57 @@
+// esp_http_client.h (host)
+#ifndef HOST_ESP_HTTP_CLIENT_H
+#define HOST_ESP_HTTP_CLIENT_H
+
+#include "esp_err.h"
+
+// Solo los tipos de la configuración que firebase_controller pasa a bi_firebase
+typedef enum {
+    HTTP_TRANSPORT_UNKNOWN,
+    HTTP_TRANSPORT_OVER_TCP,
+    HTTP_TRANSPORT_OVER_SSL,
+} esp_http_client_transport_t;
+
+typedef enum {
+    HTTP_EVENT_ERROR,
+    HTTP_EVENT_ON_CONNECTED,
+    HTTP_EVENT_HEADERS_SENT,
+    HTTP_EVENT_ON_HEADER,
+    HTTP_EVENT_ON_DATA,
+    HTTP_EVENT_ON_FINISH,
+    HTTP_EVENT_DISCONNECTED,
+    HTTP_EVENT_REDIRECT,
+} esp_http_client_event_id_t;
+
+typedef struct esp_http_client* esp_http_client_handle_t;
+
+typedef struct esp_http_client_event {
+    esp_http_client_event_id_t event_id;
+    esp_http_client_handle_t client;
+    void* data;
+    int data_len;
+    void* user_data;
+    char* header_key;
+    char* header_value;
+} esp_http_client_event_t;
+
+typedef esp_err_t (*http_event_handle_cb)(esp_http_client_event_t* evt);
+
+typedef struct {
+    const char* url;
+    const char* cert_pem;
+    int timeout_ms;
+    esp_http_client_transport_t transport_type;
+    int buffer_size;
+    int buffer_size_tx;
+    bool is_async;
+    http_event_handle_cb event_handler;
+    void* user_data;
+    bool save_client_session;
+    bool keep_alive_enable;
+    int keep_alive_idle;
+    int keep_alive_interval;
+    int keep_alive_count;
+    esp_err_t (*crt_bundle_attach)(void* conf);
+} esp_http_client_config_t;
+
+#endif // HOST_ESP_HTTP_CLIENT_H
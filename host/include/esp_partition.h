@@ -0,0 +1,34 @@
+// esp_partition.h (host)
+#ifndef HOST_ESP_PARTITION_H
+#define HOST_ESP_PARTITION_H
+
+#include <cstddef>
+#include <cstdint>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0,
+    ESP_PARTITION_TYPE_DATA = 1,
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    uint32_t erase_size;
+    char label[17];
+} esp_partition_t;
+
+// Una sola partición de datos en RAM, "history", del tamaño de partition_table.csv
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label);
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size);
+
+#endif // HOST_ESP_PARTITION_H
@@ -0,0 +1,10 @@
+// esp_random.h (host)
+#ifndef HOST_ESP_RANDOM_H
+#define HOST_ESP_RANDOM_H
+
+#include <cstdint>
+
+// Secuencia fija (xorshift) para que las ejecuciones se puedan repetir
+uint32_t esp_random(void);
+
+#endif // HOST_ESP_RANDOM_H
@@ -0,0 +1,10 @@
+// esp_rom_crc.h (host)
+#ifndef HOST_ESP_ROM_CRC_H
+#define HOST_ESP_ROM_CRC_H
+
+#include <cstdint>
+
+// Mismo CRC-16 (CCITT, reflejado) que la ROM
+uint16_t esp_rom_crc16_le(uint16_t crc, const uint8_t* buf, uint32_t len);
+
+#endif // HOST_ESP_ROM_CRC_H
@@ -0,0 +1,13 @@
+// esp_sleep.h (host)
+#ifndef HOST_ESP_SLEEP_H
+#define HOST_ESP_SLEEP_H
+
+#include <cstdint>
+#include "esp_err.h"
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t timeoutUs);
+
+// Termina el proceso: en el dispositivo no vuelve
+[[noreturn]] void esp_deep_sleep_start(void);
+
+#endif // HOST_ESP_SLEEP_H
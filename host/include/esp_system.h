@@ -0,0 +1,23 @@
+// esp_system.h (host)
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+#include <cstdint>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_RST_UNKNOWN,
+    ESP_RST_POWERON,
+} esp_reset_reason_t;
+
+typedef void (*shutdown_handler_t)(void);
+
+void esp_restart(void);
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler);
+esp_reset_reason_t esp_reset_reason(void);
+
+// Heap simulado de HOST_HEAP_SIZE bytes menos lo reservado con malloc (ver host_heap.h)
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+#endif // HOST_ESP_SYSTEM_H
@@ -0,0 +1,34 @@
+// esp_timer.h (host)
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <cstdint>
+#include "esp_err.h"
+
+/**
+ * @brief Microsegundos del reloj del host (ver host_clock.h)
+ */
+int64_t esp_timer_get_time(void);
+
+typedef struct esp_timer* esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum {
+    ESP_TIMER_TASK,
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+// Los temporizadores vencen en host_clock_advance_us()
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+
+#endif // HOST_ESP_TIMER_H
@@ -0,0 +1,45 @@
+// FreeRTOS.h (host)
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <cstddef>
+#include <cstdint>
+#include "sdkconfig.h"
+
+/**
+ * FreeRTOS mínimo para compilar main/ en el host
+ *
+ * No hay planificador: las tareas se registran pero no se ejecutan y los
+ * programas del host llaman directamente a las funciones que quieren medir.
+ * Las colas y los mutex funcionan de verdad en un solo hilo, así que un
+ * xSemaphoreTake() que en el dispositivo bloquearía aquí devuelve pdFALSE.
+ */
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint8_t StackType_t;     // En ESP-IDF la pila se cuenta en bytes
+
+#define configTICK_RATE_HZ      CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+
+#define pdTRUE  ((BaseType_t)1)
+#define pdFALSE ((BaseType_t)0)
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+
+// Memoria de los objetos estáticos: el host guarda el estado aparte
+typedef struct { void* impl; } StaticTask_t;
+typedef struct { void* impl; } StaticQueue_t;
+typedef StaticQueue_t StaticSemaphore_t;
+
+// Secciones críticas: sin concurrencia no hay nada que excluir
+typedef struct { int owner; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux)     ((void)(mux))
+#define portEXIT_CRITICAL(mux)      ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux)  ((void)(mux))
+
+#endif // HOST_FREERTOS_H
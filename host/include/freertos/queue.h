@@ -0,0 +1,16 @@
+// queue.h (host)
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct QueueDefinition* QueueHandle_t;
+
+// Cola FIFO copiando elementos, como en FreeRTOS; llena o vacía no espera
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t itemSize, uint8_t* storage, StaticQueue_t* buffer);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+#endif // HOST_FREERTOS_QUEUE_H
@@ -0,0 +1,17 @@
+// semphr.h (host)
+#ifndef HOST_FREERTOS_SEMPHR_H
+#define HOST_FREERTOS_SEMPHR_H
+
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+// Mutex de un solo hilo: tomar uno ya tomado falla en lugar de bloquear
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t* buffer);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex);
+
+#endif // HOST_FREERTOS_SEMPHR_H
@@ -0,0 +1,39 @@
+// task.h (host)
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct tskTaskControlBlock* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* param);
+
+typedef enum {
+    eNoAction,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite,
+} eNotifyAction;
+
+// Registran la tarea sin ejecutarla (ver FreeRTOS.h)
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth, void* param,
+                       UBaseType_t priority, TaskHandle_t* created);
+TaskHandle_t xTaskCreateStatic(TaskFunction_t function, const char* name, uint32_t stackDepth, void* param,
+                               UBaseType_t priority, StackType_t* stack, StaticTask_t* tcb);
+void vTaskDelete(TaskHandle_t task);
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+const char* pcTaskGetName(TaskHandle_t task);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+// El tiempo sale del reloj del host; vTaskDelay() lo avanza
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t ticks);
+
+// Las notificaciones se acumulan en la tarea destino y se recogen sin esperar
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t* value, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+
+#endif // HOST_FREERTOS_TASK_H
@@ -0,0 +1,34 @@
+// host_clock.h
+#ifndef HOST_CLOCK_H
+#define HOST_CLOCK_H
+
+#include <cstdint>
+
+/**
+ * Reloj de esp_timer_get_time() en el host
+ *
+ * Por defecto es el reloj monótono del sistema desde el arranque del proceso,
+ * que es lo que miden los benchmarks. host_clock_set_virtual() lo congela en
+ * un instante dado y a partir de ahí solo avanza con host_clock_advance_us():
+ * así el simulador recorre horas de funcionamiento en segundos y sus
+ * resultados no dependen de la máquina.
+ */
+
+/**
+ * @brief Pasa al reloj virtual, fijándolo en nowUs
+ */
+void host_clock_set_virtual(int64_t nowUs);
+
+/**
+ * @brief Avanza el reloj y ejecuta los esp_timer que vencen por el camino
+ *
+ * Con el reloj real solo suma un desfase, como si se hubiera dormido.
+ */
+void host_clock_advance_us(int64_t us);
+
+/**
+ * @brief Instante actual en microsegundos
+ */
+int64_t host_clock_now_us(void);
+
+#endif // HOST_CLOCK_H
@@ -0,0 +1,28 @@
+// host_heap.h
+#ifndef HOST_HEAP_H
+#define HOST_HEAP_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Contabilidad del heap del proceso
+ *
+ * host_heap.cpp interpone malloc/calloc/realloc/free (y con ellos new/delete)
+ * para contar reservas y bytes vivos. esp_get_free_heap_size() devuelve
+ * HOST_HEAP_SIZE menos esos bytes, así que el heapDelta del benchmark del
+ * dispositivo también tiene sentido aquí.
+ */
+#define HOST_HEAP_SIZE (256 * 1024)
+
+/**
+ * @brief Reservas hechas desde el arranque del proceso
+ */
+uint64_t host_heap_allocations(void);
+
+/**
+ * @brief Bytes reservados y aún no liberados
+ */
+size_t host_heap_live_bytes(void);
+
+#endif // HOST_HEAP_H
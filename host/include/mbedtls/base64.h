@@ -0,0 +1,12 @@
+// base64.h (host)
+#ifndef HOST_MBEDTLS_BASE64_H
+#define HOST_MBEDTLS_BASE64_H
+
+#include <cstddef>
+
+#define MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL -0x002A
+
+// Mismo contrato que mbedtls: *olen es la longitud sin el '\0' final
+int mbedtls_base64_encode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen);
+
+#endif // HOST_MBEDTLS_BASE64_H
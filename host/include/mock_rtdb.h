@@ -0,0 +1,72 @@
+// mock_rtdb.h
+#ifndef MOCK_RTDB_H
+#define MOCK_RTDB_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Realtime Database en memoria detrás de bi_firebase.h
+ *
+ * Guarda cada hoja por su ruta completa ("batteries/<uid>/cells/0/voltage")
+ * y aplica las peticiones con la semántica de la API REST: PATCH sustituye
+ * cada ruta hija indicada, PUT sustituye la ruta entera y POST crea una clave
+ * nueva. Un cuerpo que no es JSON válido se rechaza como haría el servidor
+ * (400) y cuenta en rejected. {".sv": "timestamp"} guarda el reloj del host
+ * en ms.
+ *
+ * Hay una sola cuenta a la vez (mock_rtdb_set_account): los refresh tokens de
+ * otra cuenta no se aceptan, así que al cambiar de dispositivo virtual el
+ * firmware abre una sesión nueva con contraseña.
+ */
+typedef struct {
+    uint32_t requests;          // Peticiones de escritura recibidas
+    uint32_t failed;            // Fallos inyectados (el firmware reintenta)
+    uint32_t rejected;          // Cuerpos que no son JSON válido
+    uint32_t connections;       // HTTP_EVENT_ON_CONNECTED enviados
+    uint32_t logins;            // Autenticaciones con contraseña
+    uint32_t refreshes;         // Renovaciones de token aceptadas
+    uint64_t bodyBytes;         // Bytes de los cuerpos recibidos
+} mock_rtdb_stats_t;
+
+/**
+ * @brief Vacía la base de datos y las estadísticas
+ */
+void mock_rtdb_reset(void);
+
+/**
+ * @brief Cuenta que obtiene el siguiente inicio de sesión con contraseña
+ */
+void mock_rtdb_set_account(const char* uid);
+
+/**
+ * @brief Hace fallar cada petición de escritura con probabilidad rate
+ *
+ * Un fallo también cierra la conexión: la siguiente petición vuelve a
+ * generar HTTP_EVENT_ON_CONNECTED.
+ */
+void mock_rtdb_set_failure_rate(double rate, uint32_t seed);
+
+/**
+ * @brief Estadísticas desde el último mock_rtdb_reset()
+ */
+const mock_rtdb_stats_t* mock_rtdb_get_stats(void);
+
+/**
+ * @brief Lee una hoja numérica
+ * @param path Ruta con o sin '/' inicial
+ * @return false si no existe o no es un número
+ */
+bool mock_rtdb_get_number(const char* path, double* value);
+
+/**
+ * @brief Número de hojas guardadas bajo una ruta
+ */
+size_t mock_rtdb_count_leaves(const char* path);
+
+/**
+ * @brief Bytes guardados bajo una ruta (rutas relativas y valores JSON)
+ */
+size_t mock_rtdb_stored_bytes(const char* path);
+
+#endif // MOCK_RTDB_H
@@ -0,0 +1,22 @@
+// sdkconfig.h (host)
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+// Valores del sdkconfig del proyecto que usa main/. El perfil de release se
+// elige en host/CMakeLists.txt (BIHAR_HOST_RELEASE), como en menuconfig.
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_ESP_MAIN_TASK_STACK_SIZE 3584
+
+#ifndef CONFIG_BIHAR_PACK_MAX_COUNT
+    #define CONFIG_BIHAR_PACK_MAX_COUNT 1
+#endif
+
+#ifndef CONFIG_BIHAR_LOG_MIN_LEVEL
+    #if CONFIG_BIHAR_RELEASE_BUILD
+        #define CONFIG_BIHAR_LOG_MIN_LEVEL 3
+    #else
+        #define CONFIG_BIHAR_LOG_MIN_LEVEL 0
+    #endif
+#endif
+
+#endif // HOST_SDKCONFIG_H
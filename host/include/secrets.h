@@ -0,0 +1,11 @@
+// secrets.h (host)
+#ifndef HOST_SECRETS_H
+#define HOST_SECRETS_H
+
+// Credenciales de mentira: mock_rtdb acepta cualquier contraseña
+#define FIREBASE_DATABASE_URL "https://host-mock.firebaseio.test"
+#define FIREBASE_API_KEY "host-api-key"
+#define FIREBASE_EMAIL "host@bihar.test"
+#define FIREBASE_PASSWORD "host-password"
+
+#endif // HOST_SECRETS_H
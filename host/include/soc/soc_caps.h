@@ -0,0 +1,11 @@
+// soc_caps.h (host)
+#ifndef HOST_SOC_CAPS_H
+#define HOST_SOC_CAPS_H
+
+// Capacidades del ADC del ESP32-C3, para el tamaño de AdcCellSource
+#define SOC_ADC_DIGI_MAX_BITWIDTH   12
+#define SOC_ADC_DIGI_RESULT_BYTES   4
+#define SOC_ADC_PATT_LEN_MAX        8
+#define SOC_ADC_CHANNEL_NUM(unit)   5
+
+#endif // HOST_SOC_CAPS_H
@@ -0,0 +1,121 @@
+// bi_host.cpp
+#include "bi_params.hpp"
+#include "bi_debug.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Valores por defecto de bi_params para un pack de 8 celdas Li-ion
+static const DeviceParams DEFAULT_PARAMS = {
+    "Bihar host", "BIHAR-HOST", "", 8, 5,
+    false, 2.8f, 50.0f, 55.0f, 0.0f, 4.2f, 3.0f, false, 0.01f,
+};
+
+bool BIParams::init() {
+    m_params = DEFAULT_PARAMS;
+    m_state = {};
+    m_counters = {};
+    m_initialized = true;
+    return true;
+}
+
+bool BIParams::isInitialized() {
+    return m_initialized;
+}
+
+DeviceParams& BIParams::getParams() {
+    return m_params;
+}
+
+DeviceState& BIParams::getState() {
+    return m_state;
+}
+
+DeviceCounters& BIParams::getCounters() {
+    return m_counters;
+}
+
+bool BIParams::incrementCounter(const char* name, uint32_t amount, bool save) {
+    static const struct {
+        const char* name;
+        uint32_t DeviceCounters::* field;
+    } COUNTERS[] = {
+        {"bootCount", &DeviceCounters::bootCount},
+        {"dataPoints", &DeviceCounters::dataPoints},
+        {"errorCount", &DeviceCounters::errorCount},
+        {"wifiConnectCount", &DeviceCounters::wifiConnectCount},
+        {"wifiFailCount", &DeviceCounters::wifiFailCount},
+    };
+    for (const auto& counter : COUNTERS) {
+        if (strcmp(counter.name, name) == 0) {
+            m_counters.*counter.field += amount;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BIParams::updateStateValue(const char* name, const void* value, size_t size, bool save) {
+    if (strcmp(name, "wifiConnected") == 0 && size == sizeof(bool)) {
+        memcpy(&m_state.wifiConnected, value, size);
+    } else if (strcmp(name, "firebaseConnected") == 0 && size == sizeof(bool)) {
+        memcpy(&m_state.firebaseConnected, value, size);
+    } else if (strcmp(name, "lastError") == 0 && size <= sizeof(m_state.lastError)) {
+        memcpy(m_state.lastError, value, size);
+        m_state.lastError[sizeof(m_state.lastError) - 1] = '\0';
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool BIParams::setCellCount(uint8_t count) {
+    m_params.cellCount = count;
+    return true;
+}
+
+uint8_t BIParams::getCellCount() {
+    return m_params.cellCount;
+}
+
+void BIParams::printState() {
+}
+
+void BIParams::resetState() {
+    m_state = {};
+}
+
+bool BIParams::saveParams() {
+    return true;
+}
+
+bool BIParams::saveState() {
+    return true;
+}
+
+// Nivel mínimo impreso según BIHAR_HOST_LOG (ver bi_debug.h); -1 = nada
+static int host_log_level() {
+    static const int level = [] {
+        const char* env = getenv("BIHAR_HOST_LOG");
+        return env ? atoi(env) : -1;
+    }();
+    return level;
+}
+
+LoggerPtr createLogger(const char* name, LogLevel level, bool enabled) {
+    return std::make_shared<Logger>(Logger{name, level, enabled});
+}
+
+void bi_debug_log(const LoggerPtr& logger, LogLevel level, const char* format, ...) {
+    const int minLevel = host_log_level();
+    if (minLevel < 0 || level < minLevel || !logger || !logger->enabled || level < logger->level) {
+        return;
+    }
+    fprintf(stderr, "[%s] ", logger->name);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
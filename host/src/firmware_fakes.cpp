@@ -0,0 +1,66 @@
+// firmware_fakes.cpp
+//
+// Módulos de main/ que no se compilan en el host porque dependen de
+// componentes sin equivalente aquí: la radio (esp_wifi), la OTA
+// (esp_https_ota) y el análisis de /config y /commands (cJSON; el mock no
+// genera eventos de los listeners). Lo demás de main/ es el código real.
+#include "bi_params.hpp"
+#include "app_config.h"
+#include "WiFi/wifi_power.h"
+#include "Ota/ota_controller.h"
+#include "Firebase/remote_config.h"
+#include "Firebase/command_queue.h"
+#include <cstdio>
+
+// En el dispositivo los define main.cpp
+BIParams biParams;
+AppConfig appConfig;
+
+void wifi_power_init(void) {
+}
+
+uint32_t wifi_power_step(void) {
+    return 1000;
+}
+
+void wifi_power_on_connected(void) {
+}
+
+void wifi_power_on_error(void) {
+}
+
+bool wifi_power_is_duty_cycled(void) {
+    return appConfig.wifiPowerMode == WIFI_POWER_DUTY_CYCLE;
+}
+
+void wifi_power_prepare_deep_sleep(void) {
+}
+
+wifi_power_stats_t wifi_power_get_stats(void) {
+    return {};
+}
+
+void ota_controller_init(void) {
+}
+
+bool ota_controller_start(const char* version, char* result, size_t size) {
+    snprintf(result, size, "OTA not available on host");
+    return false;
+}
+
+void ota_controller_confirm_image(void) {
+}
+
+void remote_config_init(void) {
+}
+
+bool remote_config_handle_event(const char* json) {
+    return false;
+}
+
+void command_queue_init(void) {
+}
+
+int command_queue_handle_event(const char* json) {
+    return 0;
+}
@@ -0,0 +1,246 @@
+// host_esp.cpp
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_random.h"
+#include "esp_sleep.h"
+#include "esp_rom_crc.h"
+#include "esp_partition.h"
+#include "driver/gpio.h"
+#include "mbedtls/base64.h"
+#include "host_clock.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Reloj: real desde el arranque del proceso más un desfase, o virtual
+static const std::chrono::steady_clock::time_point s_processStart = std::chrono::steady_clock::now();
+static bool s_virtual = false;
+static int64_t s_offsetUs = 0;
+
+// Temporizador de esp_timer, vence dentro de host_clock_advance_us()
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    int64_t dueUs;        // 0 = parado
+    int64_t periodUs;     // 0 = de un disparo
+};
+
+static std::vector<esp_timer*> s_timers;
+
+void host_clock_set_virtual(int64_t nowUs) {
+    s_virtual = true;
+    s_offsetUs = nowUs;
+}
+
+int64_t host_clock_now_us(void) {
+    if (s_virtual) {
+        return s_offsetUs;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - s_processStart;
+    return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() + s_offsetUs;
+}
+
+void host_clock_advance_us(int64_t us) {
+    const int64_t target = host_clock_now_us() + us;
+
+    // Los temporizadores vencen en orden y ven el reloj en su instante
+    while (true) {
+        esp_timer* next = nullptr;
+        for (esp_timer* timer : s_timers) {
+            if (timer->dueUs != 0 && timer->dueUs <= target && (!next || timer->dueUs < next->dueUs)) {
+                next = timer;
+            }
+        }
+        if (!next) {
+            break;
+        }
+        if (next->dueUs > host_clock_now_us()) {
+            s_offsetUs += next->dueUs - host_clock_now_us();
+        }
+        next->dueUs = next->periodUs != 0 ? next->dueUs + next->periodUs : 0;
+        next->callback(next->arg);
+    }
+    if (target > host_clock_now_us()) {
+        s_offsetUs += target - host_clock_now_us();
+    }
+}
+
+int64_t esp_timer_get_time(void) {
+    return host_clock_now_us();
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out) {
+    if (!args || !args->callback || !out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out = new esp_timer{args->callback, args->arg, 0, 0};
+    s_timers.push_back(*out);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->dueUs != 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Un plazo de 0 vence en el siguiente avance del reloj
+    timer->dueUs = host_clock_now_us() + static_cast<int64_t>(timeoutUs) + 1;
+    timer->periodUs = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+    if (!timer || periodUs == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->dueUs != 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->dueUs = host_clock_now_us() + static_cast<int64_t>(periodUs);
+    timer->periodUs = static_cast<int64_t>(periodUs);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer || timer->dueUs == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->dueUs = 0;
+    return ESP_OK;
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK:                return "ESP_OK";
+        case ESP_FAIL:              return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:  return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:       return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_CRC:   return "ESP_ERR_INVALID_CRC";
+        default:                    return "UNKNOWN ERROR";
+    }
+}
+
+void esp_restart(void) {
+    fprintf(stderr, "esp_restart() en el host: fin del programa\n");
+    exit(EXIT_FAILURE);
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler) {
+    return ESP_OK;
+}
+
+esp_reset_reason_t esp_reset_reason(void) {
+    return ESP_RST_POWERON;
+}
+
+uint32_t esp_random(void) {
+    static uint32_t state = 0x2545F491;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t timeoutUs) {
+    return ESP_OK;
+}
+
+void esp_deep_sleep_start(void) {
+    fprintf(stderr, "esp_deep_sleep_start() en el host: fin del programa\n");
+    exit(EXIT_FAILURE);
+}
+
+uint16_t esp_rom_crc16_le(uint16_t crc, const uint8_t* buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; ++i) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+// Partición "history" de partition_table.csv, en RAM y con la semántica de la
+// flash: borrar deja 0xFF y escribir solo puede pasar bits de 1 a 0
+static const esp_partition_t s_historyPartition = {
+    ESP_PARTITION_TYPE_DATA, static_cast<esp_partition_subtype_t>(0x40), 0x1E0000, 0x20000, 4096, "history"};
+static std::vector<uint8_t> s_historyFlash(s_historyPartition.size, 0xFF);
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label) {
+    const bool subtypeMatch = subtype == ESP_PARTITION_SUBTYPE_ANY || subtype == s_historyPartition.subtype;
+    const bool labelMatch = !label || strcmp(label, s_historyPartition.label) == 0;
+    return type == s_historyPartition.type && subtypeMatch && labelMatch ? &s_historyPartition : nullptr;
+}
+
+static bool in_partition(const esp_partition_t* partition, size_t offset, size_t size) {
+    return partition == &s_historyPartition && offset <= partition->size && size <= partition->size - offset;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* dst, size_t size) {
+    if (!in_partition(partition, offset, size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(dst, &s_historyFlash[offset], size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* src, size_t size) {
+    if (!in_partition(partition, offset, size)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(src);
+    for (size_t i = 0; i < size; ++i) {
+        s_historyFlash[offset + i] &= bytes[i];
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    if (!in_partition(partition, offset, size) || offset % partition->erase_size != 0 ||
+        size % partition->erase_size != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(&s_historyFlash[offset], 0xFF, size);
+    return ESP_OK;
+}
+
+esp_err_t gpio_config(const gpio_config_t* config) {
+    return config ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level) {
+    return ESP_OK;
+}
+
+int mbedtls_base64_encode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen) {
+    static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const size_t needed = (slen + 2) / 3 * 4;
+    if (dlen < needed + 1) {
+        *olen = needed + 1;
+        return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+    }
+
+    size_t out = 0;
+    for (size_t i = 0; i < slen; i += 3) {
+        const uint32_t chunk = (src[i] << 16) | (i + 1 < slen ? src[i + 1] << 8 : 0) | (i + 2 < slen ? src[i + 2] : 0);
+        dst[out++] = ALPHABET[(chunk >> 18) & 0x3F];
+        dst[out++] = ALPHABET[(chunk >> 12) & 0x3F];
+        dst[out++] = i + 1 < slen ? ALPHABET[(chunk >> 6) & 0x3F] : '=';
+        dst[out++] = i + 2 < slen ? ALPHABET[chunk & 0x3F] : '=';
+    }
+    dst[out] = '\0';
+    *olen = out;
+    return 0;
+}
@@ -0,0 +1,204 @@
+// host_freertos.cpp
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "host_clock.h"
+#include <cstring>
+#include <vector>
+
+// Tarea registrada: nunca se ejecuta, solo guarda lo que se le notifica
+struct tskTaskControlBlock {
+    const char* name;
+    uint32_t stackDepth;
+    uint32_t notifyValue;
+    bool notified;
+};
+
+// Cola de elementos de tamaño fijo, o mutex si itemSize es 0
+struct QueueDefinition {
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    std::vector<uint8_t> storage;
+    UBaseType_t head;
+    UBaseType_t count;
+    bool recursive;
+    UBaseType_t holdCount;
+};
+
+// El hilo del programa hace de tarea actual (la de app_main en el dispositivo)
+static tskTaskControlBlock s_mainTask = {"main", CONFIG_ESP_MAIN_TASK_STACK_SIZE, 0, false};
+
+static TaskHandle_t register_task(const char* name, uint32_t stackDepth) {
+    return new tskTaskControlBlock{name, stackDepth, 0, false};
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth, void* param,
+                       UBaseType_t priority, TaskHandle_t* created) {
+    TaskHandle_t task = register_task(name, stackDepth);
+    if (created) {
+        *created = task;
+    }
+    return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStatic(TaskFunction_t function, const char* name, uint32_t stackDepth, void* param,
+                               UBaseType_t priority, StackType_t* stack, StaticTask_t* tcb) {
+    return register_task(name, stackDepth);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task && task != &s_mainTask) {
+        delete task;
+    }
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return &s_mainTask;
+}
+
+const char* pcTaskGetName(TaskHandle_t task) {
+    return (task ? task : &s_mainTask)->name;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    // Sin medida en el host: la pila se da por entera libre
+    return (task ? task : &s_mainTask)->stackDepth;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return static_cast<TickType_t>(host_clock_now_us() / 1000 / portTICK_PERIOD_MS);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    host_clock_advance_us(static_cast<int64_t>(ticks) * portTICK_PERIOD_MS * 1000);
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    if (!task) {
+        return pdFAIL;
+    }
+    switch (action) {
+        case eSetBits:                  task->notifyValue |= value; break;
+        case eIncrement:                task->notifyValue++; break;
+        case eSetValueWithOverwrite:    task->notifyValue = value; break;
+        case eSetValueWithoutOverwrite:
+            if (task->notified) {
+                return pdFAIL;
+            }
+            task->notifyValue = value;
+            break;
+        case eNoAction:                 break;
+    }
+    task->notified = true;
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t* value, TickType_t ticks) {
+    tskTaskControlBlock& task = s_mainTask;
+    if (!task.notified) {
+        task.notifyValue &= ~clearOnEntry;
+    }
+    if (value) {
+        *value = task.notifyValue;
+    }
+    const bool notified = task.notified;
+    if (notified) {
+        task.notifyValue &= ~clearOnExit;
+        task.notified = false;
+    }
+    return notified ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    tskTaskControlBlock& task = s_mainTask;
+    const uint32_t value = task.notifyValue;
+    if (value != 0) {
+        task.notifyValue = clearOnExit ? 0 : value - 1;
+    }
+    task.notified = false;
+    return value;
+}
+
+static QueueHandle_t create_queue(UBaseType_t length, UBaseType_t itemSize, bool recursive) {
+    QueueHandle_t queue = new QueueDefinition{length, itemSize, {}, 0, 0, recursive, 0};
+    queue->storage.resize(static_cast<size_t>(length) * itemSize);
+    return queue;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    return create_queue(length, itemSize, false);
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t itemSize, uint8_t* storage, StaticQueue_t* buffer) {
+    return create_queue(length, itemSize, false);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks) {
+    if (!queue || queue->count >= queue->length) {
+        return pdFAIL;
+    }
+    const UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    memcpy(&queue->storage[static_cast<size_t>(tail) * queue->itemSize], item, queue->itemSize);
+    queue->count++;
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks) {
+    if (!queue || queue->count == 0) {
+        return pdFAIL;
+    }
+    memcpy(item, &queue->storage[static_cast<size_t>(queue->head) * queue->itemSize], queue->itemSize);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    return queue ? queue->count : 0;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return create_queue(1, 0, false);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t* buffer) {
+    return create_queue(1, 0, true);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks) {
+    // Con un solo hilo, un mutex tomado no se va a liberar esperando
+    if (!mutex || mutex->holdCount != 0) {
+        return pdFALSE;
+    }
+    mutex->holdCount = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+    if (!mutex || mutex->holdCount == 0) {
+        return pdFALSE;
+    }
+    mutex->holdCount = 0;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks) {
+    if (!mutex || !mutex->recursive) {
+        return pdFALSE;
+    }
+    mutex->holdCount++;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex) {
+    if (!mutex || !mutex->recursive || mutex->holdCount == 0) {
+        return pdFALSE;
+    }
+    mutex->holdCount--;
+    return pdTRUE;
+}
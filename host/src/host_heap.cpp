@@ -0,0 +1,99 @@
+// host_heap.cpp
+#include "host_heap.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include <cerrno>
+#include <malloc.h>
+
+// Interposición de la reserva de glibc: el enlazador resuelve malloc y
+// compañía a estas definiciones antes que a las de la biblioteca, y new/delete
+// de libstdc++ pasan por ellas
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+
+static uint64_t s_allocations = 0;
+static size_t s_liveBytes = 0;
+static size_t s_peakBytes = 0;
+
+static void* track(void* ptr) {
+    if (ptr) {
+        s_allocations++;
+        s_liveBytes += malloc_usable_size(ptr);
+        if (s_liveBytes > s_peakBytes) {
+            s_peakBytes = s_liveBytes;
+        }
+    }
+    return ptr;
+}
+
+static void untrack(void* ptr) {
+    if (ptr) {
+        s_liveBytes -= malloc_usable_size(ptr);
+    }
+}
+
+extern "C" void* malloc(size_t size) noexcept {
+    return track(__libc_malloc(size));
+}
+
+extern "C" void* calloc(size_t count, size_t size) noexcept {
+    return track(__libc_calloc(count, size));
+}
+
+extern "C" void* realloc(void* ptr, size_t size) noexcept {
+    untrack(ptr);
+    void* moved = __libc_realloc(ptr, size);
+    if (!moved && size != 0) {
+        // El bloque original sigue reservado
+        s_liveBytes += ptr ? malloc_usable_size(ptr) : 0;
+        return nullptr;
+    }
+    return track(moved);
+}
+
+extern "C" void* memalign(size_t alignment, size_t size) noexcept {
+    return track(__libc_memalign(alignment, size));
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    return track(__libc_memalign(alignment, size));
+}
+
+extern "C" int posix_memalign(void** out, size_t alignment, size_t size) noexcept {
+    void* ptr = track(__libc_memalign(alignment, size));
+    if (!ptr) {
+        return ENOMEM;
+    }
+    *out = ptr;
+    return 0;
+}
+
+extern "C" void free(void* ptr) noexcept {
+    untrack(ptr);
+    __libc_free(ptr);
+}
+
+uint64_t host_heap_allocations(void) {
+    return s_allocations;
+}
+
+size_t host_heap_live_bytes(void) {
+    return s_liveBytes;
+}
+
+uint32_t esp_get_free_heap_size(void) {
+    return s_liveBytes < HOST_HEAP_SIZE ? static_cast<uint32_t>(HOST_HEAP_SIZE - s_liveBytes) : 0;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void) {
+    return s_peakBytes < HOST_HEAP_SIZE ? static_cast<uint32_t>(HOST_HEAP_SIZE - s_peakBytes) : 0;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+    return esp_get_free_heap_size();
+}
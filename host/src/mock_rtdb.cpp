@@ -0,0 +1,602 @@
+// mock_rtdb.cpp
+#include "mock_rtdb.h"
+#include "bi_firebase.h"
+#include "host_clock.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Vigencia de los id tokens, como la de Firebase Auth
+static constexpr int64_t TOKEN_LIFETIME_US = 3600LL * 1000000;
+static constexpr int64_t TOKEN_REFRESH_MARGIN_US = 300LL * 1000000;
+
+// Hojas por ruta completa, sin '/' inicial; el valor es el texto JSON
+typedef std::map<std::string, std::string> Tree;
+typedef std::vector<std::pair<std::string, std::string>> Leaves;
+
+static Tree s_tree;
+static mock_rtdb_stats_t s_stats = {};
+static std::string s_accountUid = "host-device";
+static double s_failureRate = 0.0;
+static uint32_t s_failureState = 1;
+static uint32_t s_tokenSerial = 0;
+static uint32_t s_pushSerial = 0;
+
+static std::string normalize(const char* path) {
+    std::string result;
+    for (const char* c = path ? path : ""; *c; ++c) {
+        if (*c == '/' && (result.empty() || result.back() == '/')) {
+            continue;
+        }
+        result += *c;
+    }
+    if (!result.empty() && result.back() == '/') {
+        result.pop_back();
+    }
+    return result;
+}
+
+static std::string join(const std::string& base, const std::string& key) {
+    return base.empty() ? key : base + "/" + key;
+}
+
+static bool in_subtree(const std::string& path, const std::string& root) {
+    return root.empty() ||
+           (path.compare(0, root.size(), root) == 0 && (path.size() == root.size() || path[root.size()] == '/'));
+}
+
+// Recorre la hoja de root y las de su subárbol, que van seguidas en el mapa a
+// partir de "root/". El visitante devuelve el iterador siguiente.
+template <typename Visitor>
+static void visit_subtree(const std::string& root, Visitor visit) {
+    if (root.empty()) {
+        for (auto it = s_tree.begin(); it != s_tree.end();) {
+            it = visit(it);
+        }
+        return;
+    }
+    const auto leaf = s_tree.find(root);
+    if (leaf != s_tree.end()) {
+        visit(leaf);
+    }
+    const std::string prefix = root + "/";
+    for (auto it = s_tree.lower_bound(prefix); it != s_tree.end() && it->first.compare(0, prefix.size(), prefix) == 0;) {
+        it = visit(it);
+    }
+}
+
+static void erase_subtree(const std::string& root) {
+    visit_subtree(root, [](Tree::iterator it) { return s_tree.erase(it); });
+}
+
+// Caracteres que la base de datos no admite en una clave
+static bool valid_key(const std::string& key, bool allowSlash) {
+    if (key.empty()) {
+        return false;
+    }
+    for (char c : key) {
+        if (strchr(".$#[]", c) || static_cast<unsigned char>(c) < 0x20 || (!allowSlash && c == '/')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Analizador JSON que aplana el documento en hojas por ruta
+ *
+ * Los arrays se guardan como objetos con claves numéricas y null o un objeto
+ * vacío no dejan hoja, como en la base de datos real.
+ */
+class Flattener {
+public:
+    explicit Flattener(const char* json) : m_p(json) {}
+
+    bool parse(const std::string& path, Leaves* leaves) {
+        skip_space();
+        return parse_value(path, leaves) && (skip_space(), *m_p == '\0');
+    }
+
+    /**
+     * @brief Primer nivel de un PATCH: cada clave es una ruta relativa
+     */
+    bool parse_update(std::vector<std::pair<std::string, Leaves>>* children) {
+        skip_space();
+        if (*m_p++ != '{') {
+            return false;
+        }
+        skip_space();
+        if (*m_p == '}') {
+            ++m_p;
+            return skip_space(), *m_p == '\0';
+        }
+        while (true) {
+            std::string key;
+            if (!parse_key(&key) || !valid_key(normalize(key.c_str()), true)) {
+                return false;
+            }
+            Leaves leaves;
+            const std::string child = normalize(key.c_str());
+            if (!parse_value(child, &leaves)) {
+                return false;
+            }
+            children->emplace_back(child, std::move(leaves));
+            skip_space();
+            if (*m_p == ',') {
+                ++m_p;
+                skip_space();
+            } else if (*m_p == '}') {
+                ++m_p;
+                return skip_space(), *m_p == '\0';
+            } else {
+                return false;
+            }
+        }
+    }
+
+private:
+    const char* m_p;
+
+    void skip_space() {
+        while (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r') {
+            ++m_p;
+        }
+    }
+
+    bool parse_string(std::string* raw) {
+        const char* start = m_p;
+        if (*m_p++ != '"') {
+            return false;
+        }
+        while (*m_p != '"') {
+            if (*m_p == '\0' || static_cast<unsigned char>(*m_p) < 0x20) {
+                return false;
+            }
+            if (*m_p == '\\') {
+                ++m_p;
+                if (*m_p == 'u') {
+                    for (int i = 1; i <= 4; ++i) {
+                        if (!isxdigit(static_cast<unsigned char>(m_p[i]))) {
+                            return false;
+                        }
+                    }
+                    m_p += 4;
+                } else if (!strchr("\"\\/bfnrt", *m_p)) {
+                    return false;
+                }
+            }
+            ++m_p;
+        }
+        ++m_p;
+        raw->assign(start, m_p - start);
+        return true;
+    }
+
+    bool parse_key(std::string* key) {
+        std::string raw;
+        if (!parse_string(&raw)) {
+            return false;
+        }
+        skip_space();
+        if (*m_p++ != ':') {
+            return false;
+        }
+        skip_space();
+        key->assign(raw, 1, raw.size() - 2);
+        return true;
+    }
+
+    bool parse_number(std::string* raw) {
+        const char* start = m_p;
+        char* end = nullptr;
+        strtod(m_p, &end);
+        // strtod acepta formas que JSON no (inf, nan, hexadecimales, '+')
+        if (end == m_p || *m_p == '+' || !strchr("-0123456789", *m_p) ||
+            std::string(m_p, static_cast<size_t>(end - m_p)).find_first_not_of("-+.0123456789eE") != std::string::npos) {
+            return false;
+        }
+        m_p = end;
+        raw->assign(start, end - start);
+        return true;
+    }
+
+    bool parse_literal(const char* literal) {
+        const size_t length = strlen(literal);
+        if (strncmp(m_p, literal, length) != 0) {
+            return false;
+        }
+        m_p += length;
+        return true;
+    }
+
+    bool parse_object(const std::string& path, Leaves* leaves) {
+        ++m_p;
+        skip_space();
+        Leaves children;
+        bool serverValue = false;
+        if (*m_p == '}') {
+            ++m_p;
+            return true;
+        }
+        while (true) {
+            std::string key;
+            if (!parse_key(&key)) {
+                return false;
+            }
+            if (key == ".sv") {
+                std::string value;
+                if (!parse_string(&value) || value != "\"timestamp\"") {
+                    return false;
+                }
+                serverValue = true;
+            } else if (!valid_key(key, false) || !parse_value(join(path, key), &children)) {
+                return false;
+            }
+            skip_space();
+            if (*m_p == ',') {
+                ++m_p;
+                skip_space();
+            } else if (*m_p == '}') {
+                ++m_p;
+                break;
+            } else {
+                return false;
+            }
+        }
+
+        if (serverValue) {
+            leaves->emplace_back(path, std::to_string(host_clock_now_us() / 1000));
+        } else {
+            leaves->insert(leaves->end(), children.begin(), children.end());
+        }
+        return true;
+    }
+
+    bool parse_array(const std::string& path, Leaves* leaves) {
+        ++m_p;
+        skip_space();
+        if (*m_p == ']') {
+            ++m_p;
+            return true;
+        }
+        for (unsigned index = 0;; ++index) {
+            if (!parse_value(join(path, std::to_string(index)), leaves)) {
+                return false;
+            }
+            skip_space();
+            if (*m_p == ',') {
+                ++m_p;
+                skip_space();
+            } else if (*m_p == ']') {
+                ++m_p;
+                return true;
+            } else {
+                return false;
+            }
+        }
+    }
+
+    bool parse_value(const std::string& path, Leaves* leaves) {
+        std::string raw;
+        switch (*m_p) {
+            case '{':
+                return parse_object(path, leaves);
+            case '[':
+                return parse_array(path, leaves);
+            case '"':
+                if (!parse_string(&raw)) {
+                    return false;
+                }
+                break;
+            case 't':
+                if (!parse_literal("true")) {
+                    return false;
+                }
+                raw = "true";
+                break;
+            case 'f':
+                if (!parse_literal("false")) {
+                    return false;
+                }
+                raw = "false";
+                break;
+            case 'n':
+                return parse_literal("null");
+            default:
+                if (!parse_number(&raw)) {
+                    return false;
+                }
+                break;
+        }
+        leaves->emplace_back(path, raw);
+        return true;
+    }
+};
+
+/**
+ * @brief Contabiliza una escritura y decide si falla la red
+ * @return false si la petición no llega al servidor
+ */
+static bool begin_request(firebase_handle_t* handle, const firebase_data_value_t* value) {
+    s_stats.requests++;
+    if (value && (value->type == FIREBASE_DATA_TYPE_JSON || value->type == FIREBASE_DATA_TYPE_STRING) &&
+        value->data.string_val) {
+        s_stats.bodyBytes += strlen(value->data.string_val);
+    }
+
+    if (!handle->connected) {
+        handle->connected = true;
+        s_stats.connections++;
+        if (handle->http_config.event_handler) {
+            esp_http_client_event_t event = {};
+            event.event_id = HTTP_EVENT_ON_CONNECTED;
+            event.user_data = handle->http_config.user_data;
+            handle->http_config.event_handler(&event);
+        }
+    }
+
+    if (s_failureRate > 0.0) {
+        s_failureState ^= s_failureState << 13;
+        s_failureState ^= s_failureState >> 17;
+        s_failureState ^= s_failureState << 5;
+        if (s_failureState / 4294967296.0 < s_failureRate) {
+            s_stats.failed++;
+            handle->connected = false;
+            return false;
+        }
+    }
+    return firebase_is_authenticated(handle);
+}
+
+// Texto JSON de un valor de bi_firebase
+static bool value_to_json(const firebase_data_value_t* value, std::string* json) {
+    char number[32];
+    switch (value->type) {
+        case FIREBASE_DATA_TYPE_NULL:
+            *json = "null";
+            return true;
+        case FIREBASE_DATA_TYPE_INT:
+            snprintf(number, sizeof(number), "%d", value->data.int_val);
+            *json = number;
+            return true;
+        case FIREBASE_DATA_TYPE_FLOAT:
+            snprintf(number, sizeof(number), "%.17g", value->data.float_val);
+            *json = number;
+            return true;
+        case FIREBASE_DATA_TYPE_BOOL:
+            *json = value->data.bool_val ? "true" : "false";
+            return true;
+        case FIREBASE_DATA_TYPE_STRING:
+            if (!value->data.string_val) {
+                return false;
+            }
+            *json = std::string("\"") + value->data.string_val + "\"";
+            return true;
+        case FIREBASE_DATA_TYPE_JSON:
+            if (!value->data.string_val) {
+                return false;
+            }
+            *json = value->data.string_val;
+            return true;
+    }
+    return false;
+}
+
+// PUT: sustituye la ruta entera
+static bool put(const std::string& path, const std::string& json) {
+    Leaves leaves;
+    if (!Flattener(json.c_str()).parse(path, &leaves)) {
+        s_stats.rejected++;
+        return false;
+    }
+    erase_subtree(path);
+    s_tree.insert(leaves.begin(), leaves.end());
+    return true;
+}
+
+static void issue_tokens(firebase_handle_t* handle) {
+    char token[96];
+    free(handle->auth.id_token);
+    snprintf(token, sizeof(token), "id-%s-%lu", handle->auth.uid, static_cast<unsigned long>(++s_tokenSerial));
+    handle->auth.id_token = strdup(token);
+    handle->auth.token_expiry = host_clock_now_us() + TOKEN_LIFETIME_US;
+}
+
+firebase_handle_t* firebase_init(const firebase_config_t* config) {
+    if (!config || !config->database_url) {
+        return nullptr;
+    }
+    firebase_handle_t* handle = static_cast<firebase_handle_t*>(calloc(1, sizeof(firebase_handle_t)));
+    if (handle) {
+        handle->auth.auth_type = config->auth.auth_type;
+        handle->http_config = config->http_config;
+    }
+    return handle;
+}
+
+void firebase_deinit(firebase_handle_t* handle) {
+    if (!handle) {
+        return;
+    }
+    free(handle->auth.id_token);
+    free(handle->auth.refresh_token);
+    free(handle->auth.uid);
+    free(handle);
+}
+
+bool firebase_auth_with_password(firebase_handle_t* handle, const char* email, const char* password) {
+    if (!handle || !email || !password) {
+        return false;
+    }
+    s_stats.logins++;
+    free(handle->auth.uid);
+    free(handle->auth.refresh_token);
+    handle->auth.uid = strdup(s_accountUid.c_str());
+    handle->auth.refresh_token = strdup(("refresh-" + s_accountUid).c_str());
+    issue_tokens(handle);
+    return true;
+}
+
+bool firebase_is_authenticated(firebase_handle_t* handle) {
+    return handle && handle->auth.id_token && host_clock_now_us() < handle->auth.token_expiry;
+}
+
+bool firebase_refresh_token(firebase_handle_t* handle) {
+    // Solo vale el refresh token de la cuenta actual
+    if (!handle || !handle->auth.refresh_token || !handle->auth.uid ||
+        ("refresh-" + s_accountUid) != handle->auth.refresh_token || s_accountUid != handle->auth.uid) {
+        return false;
+    }
+    s_stats.refreshes++;
+    issue_tokens(handle);
+    return true;
+}
+
+bool firebase_maintain_auth(firebase_handle_t* handle) {
+    if (!handle) {
+        return false;
+    }
+    if (handle->auth.id_token && host_clock_now_us() + TOKEN_REFRESH_MARGIN_US < handle->auth.token_expiry) {
+        return true;
+    }
+    return firebase_refresh_token(handle);
+}
+
+bool firebase_set_json(firebase_data_value_t* value, const char* json) {
+    if (!value || !json) {
+        return false;
+    }
+    value->type = FIREBASE_DATA_TYPE_JSON;
+    value->data.string_val = strdup(json);
+    return value->data.string_val != nullptr;
+}
+
+void firebase_free_value(firebase_data_value_t* value) {
+    if (value && (value->type == FIREBASE_DATA_TYPE_JSON || value->type == FIREBASE_DATA_TYPE_STRING)) {
+        free(value->data.string_val);
+        value->data.string_val = nullptr;
+    }
+}
+
+bool firebase_update(firebase_handle_t* handle, const char* path, firebase_data_value_t* value) {
+    if (!handle || !value || !begin_request(handle, value)) {
+        return false;
+    }
+
+    // El cuerpo de un PATCH es un objeto; ninguna ruta puede contener a otra
+    std::vector<std::pair<std::string, Leaves>> children;
+    if (value->type != FIREBASE_DATA_TYPE_JSON || !value->data.string_val ||
+        !Flattener(value->data.string_val).parse_update(&children)) {
+        s_stats.rejected++;
+        return false;
+    }
+    for (size_t i = 0; i < children.size(); ++i) {
+        for (size_t j = 0; j < children.size(); ++j) {
+            if (i != j && in_subtree(children[j].first, children[i].first)) {
+                s_stats.rejected++;
+                return false;
+            }
+        }
+    }
+
+    const std::string base = normalize(path);
+    for (const auto& child : children) {
+        const std::string root = join(base, child.first);
+        erase_subtree(root);
+        for (const auto& leaf : child.second) {
+            s_tree[join(base, leaf.first)] = leaf.second;
+        }
+    }
+    return true;
+}
+
+bool firebase_set(firebase_handle_t* handle, const char* path, firebase_data_value_t* value) {
+    std::string json;
+    if (!handle || !value || !begin_request(handle, value)) {
+        return false;
+    }
+    if (!value_to_json(value, &json)) {
+        s_stats.rejected++;
+        return false;
+    }
+    return put(normalize(path), json);
+}
+
+bool firebase_push(firebase_handle_t* handle, const char* path, firebase_data_value_t* value, char* key,
+                   size_t keySize) {
+    std::string json;
+    if (!handle || !value || !begin_request(handle, value)) {
+        return false;
+    }
+    if (!value_to_json(value, &json)) {
+        s_stats.rejected++;
+        return false;
+    }
+
+    char name[24];
+    snprintf(name, sizeof(name), "-Mock%08lu", static_cast<unsigned long>(++s_pushSerial));
+    if (!put(join(normalize(path), name), json)) {
+        return false;
+    }
+    if (key && keySize > 0) {
+        snprintf(key, keySize, "%s", name);
+    }
+    return true;
+}
+
+bool firebase_listen(firebase_handle_t* handle, const char* path, firebase_listen_cb_t callback, void* data) {
+    // Los listeners se aceptan pero no reciben eventos
+    return handle && path && callback;
+}
+
+void mock_rtdb_reset(void) {
+    s_tree.clear();
+    s_stats = {};
+}
+
+void mock_rtdb_set_account(const char* uid) {
+    s_accountUid = uid;
+}
+
+void mock_rtdb_set_failure_rate(double rate, uint32_t seed) {
+    s_failureRate = rate;
+    s_failureState = seed != 0 ? seed : 1;
+}
+
+const mock_rtdb_stats_t* mock_rtdb_get_stats(void) {
+    return &s_stats;
+}
+
+bool mock_rtdb_get_number(const char* path, double* value) {
+    const auto it = s_tree.find(normalize(path));
+    if (it == s_tree.end() || it->second.empty() || !strchr("-0123456789", it->second[0])) {
+        return false;
+    }
+    *value = strtod(it->second.c_str(), nullptr);
+    return true;
+}
+
+size_t mock_rtdb_count_leaves(const char* path) {
+    size_t count = 0;
+    visit_subtree(normalize(path), [&count](Tree::iterator it) {
+        count++;
+        return std::next(it);
+    });
+    return count;
+}
+
+size_t mock_rtdb_stored_bytes(const char* path) {
+    const std::string root = normalize(path);
+    size_t bytes = 0;
+    visit_subtree(root, [&bytes, &root](Tree::iterator it) {
+        bytes += it->first.size() - root.size() + it->second.size();
+        return std::next(it);
+    });
+    return bytes;
+}
@@ -0,0 +1,188 @@
+// adc_cell_source.cpp
+#include "adc_cell_source.h"
+#include "../app_log.h"
+#include <cstring>
+
+// Logger para la adquisición por ADC
+static LoggerPtr g_AdcLogger;
+
+// Canal ADC1 de cada toma del stack, de la celda 1 en adelante
+static const uint8_t CELL_CHANNELS[] = ADC_CELL_CHANNELS;
+static constexpr uint8_t CELL_CHANNEL_COUNT = sizeof(CELL_CHANNELS) / sizeof(CELL_CHANNELS[0]);
+static constexpr uint8_t NO_SLOT = 0xFF;
+
+// La toma más alta ve la suma de todas las celdas: con ella se dimensiona el divisor
+static_assert(CELL_CHANNEL_COUNT * ADC_CELL_MAX_VOLTAGE * 1000.0f / ADC_CELL_DIVIDER <= ADC_INPUT_MAX_MV,
+              "ADC_CELL_DIVIDER too small for the top tap of the stack");
+
+AdcCellSource::AdcCellSource()
+    : m_handle(NULL), m_cali(NULL), m_tempSensor(NULL), m_started(false),
+      m_cellCount(0), m_slotCount(0) {
+    memset(m_slotOfChannel, NO_SLOT, sizeof(m_slotOfChannel));
+    memset(m_sum, 0, sizeof(m_sum));
+    memset(m_count, 0, sizeof(m_count));
+}
+
+bool AdcCellSource::start() {
+    // Patrón: una toma por celda y, al final, la corriente
+    adc_digi_pattern_config_t pattern[SOC_ADC_PATT_LEN_MAX] = {};
+    for (uint8_t slot = 0; slot < CELL_CHANNEL_COUNT; ++slot) {
+        pattern[slot].atten = ADC_ATTEN_DB_12;
+        pattern[slot].channel = CELL_CHANNELS[slot];
+        pattern[slot].unit = ADC_UNIT_1;
+        pattern[slot].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+        m_slotOfChannel[CELL_CHANNELS[slot]] = slot;
+    }
+    m_slotCount = CELL_CHANNEL_COUNT;
+    
+#if ADC_CURRENT_CHANNEL >= 0
+    pattern[m_slotCount].atten = ADC_ATTEN_DB_12;
+    pattern[m_slotCount].channel = ADC_CURRENT_CHANNEL;
+    pattern[m_slotCount].unit = ADC_UNIT_1;
+    pattern[m_slotCount].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    m_slotOfChannel[ADC_CURRENT_CHANNEL] = m_slotCount;
+    m_slotCount++;
+#endif
+    
+    // El pool se llena en unos ms y read() lo vacía una vez por periodo de
+    // muestreo: con flush_pool el driver descarta lo antiguo y conserva lo último
+    adc_continuous_handle_cfg_t handleConfig = {};
+    handleConfig.max_store_buf_size = ADC_CONV_FRAME_SIZE * ADC_POOL_FRAMES;
+    handleConfig.conv_frame_size = ADC_CONV_FRAME_SIZE;
+    handleConfig.flags.flush_pool = true;
+    esp_err_t err = adc_continuous_new_handle(&handleConfig, &m_handle);
+    if (err != ESP_OK) {
+        BI_DEBUG_ERROR(g_AdcLogger, "Failed to create continuous ADC handle: %s", esp_err_to_name(err));
+        return false;
+    }
+    
+    adc_continuous_config_t config = {};
+    config.pattern_num = m_slotCount;
+    config.adc_pattern = pattern;
+    config.sample_freq_hz = ADC_SAMPLE_FREQ_HZ;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+    err = adc_continuous_config(m_handle, &config);
+    
+    // Calibración de fábrica (eFuse) común a todos los canales del ADC1
+    adc_cali_curve_fitting_config_t caliConfig = {};
+    caliConfig.unit_id = ADC_UNIT_1;
+    caliConfig.chan = static_cast<adc_channel_t>(CELL_CHANNELS[0]);
+    caliConfig.atten = ADC_ATTEN_DB_12;
+    caliConfig.bitwidth = ADC_BITWIDTH_12;
+    if (err == ESP_OK) {
+        err = adc_cali_create_scheme_curve_fitting(&caliConfig, &m_cali);
+    }
+    
+    // Sensor de temperatura interno, usado como temperatura de placa
+    temperature_sensor_config_t tempConfig = TEMPERATURE_SENSOR_CONFIG_DEFAULT(-10, 80);
+    if (err == ESP_OK) {
+        err = temperature_sensor_install(&tempConfig, &m_tempSensor);
+    }
+    if (err == ESP_OK) {
+        err = temperature_sensor_enable(m_tempSensor);
+    }
+    if (err == ESP_OK) {
+        err = adc_continuous_start(m_handle);
+    }
+    
+    if (err != ESP_OK) {
+        BI_DEBUG_ERROR(g_AdcLogger, "Failed to start continuous ADC: %s", esp_err_to_name(err));
+        // Liberar lo que se llegó a crear para que un reintento empiece de cero
+        if (m_tempSensor) {
+            temperature_sensor_disable(m_tempSensor);
+            temperature_sensor_uninstall(m_tempSensor);
+            m_tempSensor = NULL;
+        }
+        if (m_cali) {
+            adc_cali_delete_scheme_curve_fitting(m_cali);
+            m_cali = NULL;
+        }
+        adc_continuous_deinit(m_handle);
+        m_handle = NULL;
+        memset(m_slotOfChannel, NO_SLOT, sizeof(m_slotOfChannel));
+        return false;
+    }
+    
+    m_started = true;
+    BI_DEBUG_INFO(g_AdcLogger, "Continuous ADC started: %d channels at %d Hz",
+                 m_slotCount, ADC_SAMPLE_FREQ_HZ);
+    return true;
+}
+
+bool AdcCellSource::begin(uint16_t cellCount) {
+    if (!g_AdcLogger) {
+        g_AdcLogger = createLogger("CELL_ADC", INFO, DEBUG_BATTERY);
+    }
+    
+    if (cellCount == 0 || cellCount > CELL_CHANNEL_COUNT) {
+        BI_DEBUG_ERROR(g_AdcLogger, "ADC source measures up to %d cells, %d requested",
+                      CELL_CHANNEL_COUNT, cellCount);
+        return false;
+    }
+    
+    if (!m_started && !start()) {
+        return false;
+    }
+    
+    m_cellCount = cellCount;
+    return true;
+}
+
+bool AdcCellSource::read(float* voltage, float* temperature, float* current) {
+    if (!m_started) {
+        return false;
+    }
+    
+    // Vaciar sin esperar todo lo que el DMA ha dejado desde la última lectura
+    uint32_t length = 0;
+    while (adc_continuous_read(m_handle, m_buffer, sizeof(m_buffer), &length, 0) == ESP_OK) {
+        for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+            const adc_digi_output_data_t* result = reinterpret_cast<const adc_digi_output_data_t*>(&m_buffer[i]);
+            const uint32_t channel = result->type2.channel;
+            if (result->type2.unit != 0 || channel >= sizeof(m_slotOfChannel) || m_slotOfChannel[channel] == NO_SLOT) {
+                continue;
+            }
+            const uint8_t slot = m_slotOfChannel[channel];
+            m_sum[slot] += result->type2.data;
+            m_count[slot]++;
+        }
+    }
+    
+    // Un marco solo es completo si todos los canales tienen al menos una conversión
+    for (uint8_t slot = 0; slot < m_slotCount; ++slot) {
+        if (m_count[slot] == 0) {
+            return false;
+        }
+    }
+    
+    float tapMv[SOC_ADC_PATT_LEN_MAX];
+    for (uint8_t slot = 0; slot < m_slotCount; ++slot) {
+        int mv = 0;
+        adc_cali_raw_to_voltage(m_cali, static_cast<int>(m_sum[slot] / m_count[slot]), &mv);
+        tapMv[slot] = static_cast<float>(mv);
+        m_sum[slot] = 0;
+        m_count[slot] = 0;
+    }
+    
+    // Tensión de celda = diferencia entre tomas consecutivas del stack
+    float previousTap = 0.0f;
+    for (uint16_t i = 0; i < m_cellCount; ++i) {
+        const float tap = tapMv[i] * ADC_CELL_DIVIDER / 1000.0f;
+        voltage[i] = tap - previousTap;
+        previousTap = tap;
+    }
+    
+    float boardTemperature = 0.0f;
+    temperature_sensor_get_celsius(m_tempSensor, &boardTemperature);
+    for (uint16_t i = 0; i < m_cellCount; ++i) {
+        temperature[i] = boardTemperature;
+    }
+    
+#if ADC_CURRENT_CHANNEL >= 0
+    *current = (tapMv[CELL_CHANNEL_COUNT] - ADC_CURRENT_ZERO_MV) / ADC_CURRENT_MV_PER_A;
+#else
+    *current = 0.0f;
+#endif
+    return true;
+}
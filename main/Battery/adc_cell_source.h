@@ -0,0 +1,57 @@
+#ifndef ADC_CELL_SOURCE_H
+#define ADC_CELL_SOURCE_H
+
+#include "battery_controller.h"
+#include "cell_data_source.h"
+#include "esp_adc/adc_continuous.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "driver/temperature_sensor.h"
+#include "soc/soc_caps.h"
+
+/**
+ * @brief Adquisición de celdas con el ADC en modo continuo (DMA)
+ *
+ * El ADC1 recorre en bucle el patrón de canales de ADC_CELL_CHANNELS (y el de
+ * corriente, si hay) y el DMA deja los resultados en el buffer del driver sin
+ * intervención de la CPU. read() vacía lo acumulado y devuelve la media por
+ * canal como un marco completo. El pool del driver guarda solo los últimos
+ * ADC_POOL_FRAMES marcos (flush_pool descarta los antiguos al llenarse), así
+ * que la media cubre las últimas ADC_POOL_FRAMES * ADC_CONV_FRAME_SIZE /
+ * SOC_ADC_DIGI_RESULT_BYTES conversiones, unos 13 ms a ADC_SAMPLE_FREQ_HZ,
+ * y no el periodo de muestreo entero: la lectura es de justo antes de read().
+ *
+ * Cada canal mide, a través de un divisor ADC_CELL_DIVIDER, la toma acumulada
+ * del stack (toma k = suma de las celdas 1..k); la tensión de cada celda es la
+ * diferencia entre tomas consecutivas. Como la toma más alta lleva el stack
+ * completo, el divisor se dimensiona con ella (se comprueba al compilar frente
+ * a ADC_INPUT_MAX_MV). La temperatura de todas las celdas es
+ * la del sensor interno del chip, a falta de NTC por celda.
+ *
+ * En el ESP32-C3 solo el ADC1 (GPIO0-4) funciona en modo continuo, lo que
+ * limita el número de celdas a los canales libres. Para los 18 canales hace
+ * falta un AFE externo implementado como otro CellDataSource.
+ */
+class AdcCellSource : public CellDataSource {
+public:
+    AdcCellSource();
+
+    bool begin(uint16_t cellCount) override;
+    bool read(float* voltage, float* temperature, float* current) override;
+    const char* name() const override { return "adc"; }
+
+private:
+    bool start();
+
+    adc_continuous_handle_t m_handle;
+    adc_cali_handle_t m_cali;
+    temperature_sensor_handle_t m_tempSensor;
+    bool m_started;
+    uint16_t m_cellCount;
+    uint8_t m_slotOfChannel[SOC_ADC_CHANNEL_NUM(0)];   // Canal ADC -> posición en el marco (0xFF = no usado)
+    uint8_t m_slotCount;
+    uint32_t m_sum[SOC_ADC_PATT_LEN_MAX];
+    uint32_t m_count[SOC_ADC_PATT_LEN_MAX];
+    uint8_t m_buffer[ADC_CONV_FRAME_SIZE];
+};
+
+#endif // ADC_CELL_SOURCE_H
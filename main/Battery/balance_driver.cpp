@@ -0,0 +1,39 @@
+// balance_driver.cpp
+#include "balance_driver.h"
+#include "driver/gpio.h"
+#include <algorithm>
+
+// GPIO de descarga de cada celda, de la celda 1 en adelante
+static const uint8_t BALANCE_PINS[] = BALANCE_GPIOS;
+static constexpr uint16_t BALANCE_PIN_COUNT = sizeof(BALANCE_PINS) / sizeof(BALANCE_PINS[0]);
+
+uint16_t GpioBalanceDriver::begin(uint16_t cellCount) {
+    if (!m_configured) {
+        uint64_t pinMask = 0;
+        for (uint16_t i = 0; i < BALANCE_PIN_COUNT; ++i) {
+            pinMask |= 1ULL << BALANCE_PINS[i];
+        }
+        
+        gpio_config_t config = {};
+        config.pin_bit_mask = pinMask;
+        config.mode = GPIO_MODE_OUTPUT;
+        config.pull_up_en = GPIO_PULLUP_DISABLE;
+        config.pull_down_en = GPIO_PULLDOWN_DISABLE;
+        config.intr_type = GPIO_INTR_DISABLE;
+        m_configured = gpio_config(&config) == ESP_OK;
+    }
+    
+    m_count = m_configured ? std::min(cellCount, BALANCE_PIN_COUNT) : 0;
+    apply(0);
+    return m_count;
+}
+
+void GpioBalanceDriver::apply(uint32_t mask) {
+    if (!m_configured) {
+        return;
+    }
+    // Las salidas sin celda asignada quedan siempre apagadas
+    for (uint16_t i = 0; i < BALANCE_PIN_COUNT; ++i) {
+        gpio_set_level(static_cast<gpio_num_t>(BALANCE_PINS[i]), (i < m_count && (mask & (1u << i))) ? 1 : 0);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef BALANCE_DRIVER_H
+#define BALANCE_DRIVER_H
+
+#include <cstdint>
+#include "../custom_config.h"
+
+/**
+ * @brief Salidas de descarga (bleed) de las celdas
+ *
+ * Abstrae cómo se activan las resistencias de balanceo: GPIO directos, un AFE
+ * por SPI/I2C, etc. BalancingController decide qué celdas descargar y el
+ * driver solo aplica la máscara.
+ */
+class BalanceDriver {
+public:
+    virtual ~BalanceDriver() = default;
+
+    /**
+     * @brief Prepara las salidas para un número de celdas, todas apagadas
+     * @param cellCount Número de celdas
+     * @return Número de celdas con salida de balanceo (puede ser menor)
+     */
+    virtual uint16_t begin(uint16_t cellCount) = 0;
+
+    /**
+     * @brief Activa la descarga de las celdas cuyo bit está a 1 y apaga el resto
+     * @param mask Bit i = celda i (base 0)
+     */
+    virtual void apply(uint32_t mask) = 0;
+
+    virtual const char* name() const = 0;
+};
+
+/**
+ * @brief Driver sin hardware: registra la máscara pero no actúa sobre nada
+ *
+ * Para el simulador y placas sin resistencias de balanceo; el tiempo de
+ * balanceo se sigue contando y publicando.
+ */
+class NullBalanceDriver : public BalanceDriver {
+public:
+    uint16_t begin(uint16_t cellCount) override { return cellCount; }
+    void apply(uint32_t mask) override { (void)mask; }
+    const char* name() const override { return "none"; }
+};
+
+/**
+ * @brief Un GPIO por celda (BALANCE_GPIOS) que activa su transistor de descarga
+ */
+class GpioBalanceDriver : public BalanceDriver {
+public:
+    GpioBalanceDriver() : m_count(0), m_configured(false) {}
+
+    uint16_t begin(uint16_t cellCount) override;
+    void apply(uint32_t mask) override;
+    const char* name() const override { return "gpio"; }
+
+private:
+    uint16_t m_count;
+    bool m_configured;
+};
+
+#endif // BALANCE_DRIVER_H
@@ -0,0 +1,178 @@
+// balancing_controller.cpp
+#include "battery_controller.h"
+#include "../app_log.h"
+#include <algorithm>
+#include <cstring>
+
+// Logger para el balanceo
+static LoggerPtr g_BalanceLogger;
+
+BalancingController::BalancingController()
+    : m_driver(nullptr), m_cellCount(0), m_outputs(0), m_state(BALANCE_STATE_IDLE),
+      m_manual(false), m_cancelled(false), m_hot(false), m_bleeding(false),
+      m_phaseStartUs(0), m_mask(0), m_maskSinceUs(0) {
+    memset(m_cellUs, 0, sizeof(m_cellUs));
+}
+
+void BalancingController::reset(uint16_t cellCount) {
+    if (!g_BalanceLogger) {
+        g_BalanceLogger = createLogger("BALANCE", INFO, DEBUG_BATTERY);
+    }
+    
+    m_cellCount = std::min<uint16_t>(cellCount, MAX_CELL_COUNT);
+    m_outputs = m_driver ? m_driver->begin(m_cellCount) : 0;
+    m_state = BALANCE_STATE_IDLE;
+    m_manual = false;
+    m_bleeding = false;
+    m_mask = 0;
+    memset(m_cellUs, 0, sizeof(m_cellUs));
+    
+    BI_DEBUG_INFO(g_BalanceLogger, "Balancing ready: %d of %d cells with output (driver: %s)",
+                 m_outputs, m_cellCount, m_driver ? m_driver->name() : "none");
+}
+
+void BalancingController::setMask(uint32_t mask, int64_t nowUs) {
+    // Acumular el tiempo de descarga de las celdas que estaban activas
+    const int64_t elapsed = nowUs - m_maskSinceUs;
+    for (uint32_t bits = m_mask; bits; bits &= bits - 1) {
+        m_cellUs[__builtin_ctz(bits)] += elapsed;
+    }
+    m_maskSinceUs = nowUs;
+    
+    if (mask != m_mask) {
+        m_mask = mask;
+        if (m_driver) {
+            m_driver->apply(mask);
+        }
+    }
+}
+
+void BalancingController::stop(balance_state_t reason, int64_t nowUs) {
+    setMask(0, nowUs);
+    m_bleeding = false;
+    if (m_state != reason) {
+        BI_DEBUG_INFO(g_BalanceLogger, "Balancing %s", stateToString(reason));
+    }
+    m_state = reason;
+}
+
+void BalancingController::requestStart() {
+    m_manual = true;
+    m_cancelled = false;
+}
+
+void BalancingController::requestStop(int64_t nowUs) {
+    m_manual = false;
+    m_cancelled = true;
+    stop(BALANCE_STATE_STOPPED, nowUs);
+}
+
+void BalancingController::update(const Pack& pack, const DeviceParams& params, bool startDue,
+                                 bool protectionFault, int64_t nowUs) {
+    const PackStats& stats = pack.getStats();
+    
+    // La pasada cancelada no rearranca sola hasta que cese la condición de inicio
+    if (m_cancelled && !startDue) {
+        m_cancelled = false;
+    }
+    
+    // Temperatura con histéresis para no arrancar y parar en cada ciclo
+    if (stats.maxTemperature >= BALANCE_MAX_TEMPERATURE) {
+        m_hot = true;
+    } else if (stats.maxTemperature < BALANCE_MAX_TEMPERATURE - BALANCE_TEMPERATURE_HYSTERESIS) {
+        m_hot = false;
+    }
+    
+    if (protectionFault) {
+        stop(BALANCE_STATE_PROTECTION, nowUs);
+        return;
+    }
+    if (m_hot) {
+        stop(BALANCE_STATE_TEMPERATURE, nowUs);
+        return;
+    }
+    if (m_outputs == 0 || m_cellCount < 2 || !(params.balancingEnabled || m_manual)) {
+        stop(BALANCE_STATE_IDLE, nowUs);
+        return;
+    }
+    
+    if (!isActive()) {
+        if (m_cancelled) {
+            stop(BALANCE_STATE_STOPPED, nowUs);
+            return;
+        }
+        if (!startDue && !m_manual) {
+            // Sin orden ni dispersión suficiente: mantener el último motivo de parada
+            if (m_state != BALANCE_STATE_CONVERGED) {
+                m_state = BALANCE_STATE_IDLE;
+            }
+            return;
+        }
+        BI_DEBUG_INFO(g_BalanceLogger, "Balancing started: spread %.3fV (threshold %.3fV)",
+                     stats.voltageSpread, params.balancingThreshold);
+        m_state = BALANCE_STATE_ACTIVE;
+        m_bleeding = false;
+        // Empezar como si acabara una fase de medida: las tensiones actuales son sin descarga
+        m_phaseStartUs = nowUs - static_cast<int64_t>(BALANCE_OFF_MS) * 1000;
+    }
+    
+    const int64_t phaseUs = nowUs - m_phaseStartUs;
+    if (m_bleeding) {
+        if (phaseUs >= static_cast<int64_t>(BALANCE_ON_MS) * 1000) {
+            // Fase de medida: sin descarga para que las tensiones se estabilicen
+            setMask(0, nowUs);
+            m_bleeding = false;
+            m_phaseStartUs = nowUs;
+        } else {
+            setMask(m_mask, nowUs);
+        }
+        return;
+    }
+    
+    if (phaseUs < static_cast<int64_t>(BALANCE_OFF_MS) * 1000) {
+        return;
+    }
+    
+    // Fin de la fase de medida: decidir con tensiones sin descarga
+    const float stopLevel = params.balancingThreshold * BALANCE_STOP_RATIO_PERCENT / 100.0f;
+    if (stats.voltageSpread <= stopLevel) {
+        m_manual = false;
+        stop(BALANCE_STATE_CONVERGED, nowUs);
+        return;
+    }
+    
+    // Descargar las celdas que superan a la mínima en más del nivel de parada
+    const float* voltages = pack.getCells().voltages();
+    const float target = stats.minVoltage + stopLevel;
+    uint32_t mask = 0;
+    for (uint16_t i = 0; i < m_outputs; ++i) {
+        if (voltages[i] > target && voltages[i] > BALANCE_MIN_CELL_VOLTAGE) {
+            mask |= 1u << i;
+        }
+    }
+    
+    setMask(mask, nowUs);
+    m_bleeding = true;
+    m_phaseStartUs = nowUs;
+    BI_DEBUG_VERBOSE(g_BalanceLogger, "Bleeding cells 0x%05lx, spread %.3fV", mask, stats.voltageSpread);
+}
+
+void BalancingController::getCellSeconds(uint32_t* seconds, int64_t nowUs) const {
+    const int64_t ongoing = nowUs - m_maskSinceUs;
+    for (uint16_t i = 0; i < m_cellCount; ++i) {
+        const uint64_t total = m_cellUs[i] + ((m_mask & (1u << i)) ? ongoing : 0);
+        seconds[i] = static_cast<uint32_t>(total / 1000000);
+    }
+}
+
+const char* BalancingController::stateToString(balance_state_t state) {
+    switch (state) {
+        case BALANCE_STATE_IDLE: return "idle";
+        case BALANCE_STATE_ACTIVE: return "active";
+        case BALANCE_STATE_CONVERGED: return "converged";
+        case BALANCE_STATE_TEMPERATURE: return "temperature";
+        case BALANCE_STATE_PROTECTION: return "protection";
+        case BALANCE_STATE_STOPPED: return "stopped";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef BALANCING_CONTROLLER_H
+#define BALANCING_CONTROLLER_H
+
+#include <cstdint>
+#include "bi_params.hpp"
+#include "balance_driver.h"
+
+// Usa MAX_CELL_COUNT: se incluye desde battery_controller.h tras definirlo
+
+class Pack;
+
+/**
+ * @brief Estado del balanceo, con el motivo de la última parada
+ */
+typedef enum {
+    BALANCE_STATE_IDLE = 0,      // Sin balancear, dispersión por debajo del umbral
+    BALANCE_STATE_ACTIVE,        // Balanceando (fase de descarga o de medida)
+    BALANCE_STATE_CONVERGED,     // Parado al bajar la dispersión del nivel de parada
+    BALANCE_STATE_TEMPERATURE,   // Parado por temperatura
+    BALANCE_STATE_PROTECTION,    // Parado por un fallo de protección
+    BALANCE_STATE_STOPPED,       // Pasada cancelada por orden, hasta que cese su condición de inicio
+} balance_state_t;
+
+/**
+ * @brief Balanceo pasivo en lazo cerrado
+ *
+ * Arranca cuando BatteryController::shouldStartBalancing() lo indica (o por
+ * orden) y alterna fases de descarga de BALANCE_ON_MS con fases de medida de
+ * BALANCE_OFF_MS sin descarga, para no medir las tensiones con las
+ * resistencias activas. Al final de cada fase de medida se eligen las celdas
+ * que superan a la mínima en más del nivel de parada
+ * (balancingThreshold * BALANCE_STOP_RATIO_PERCENT / 100) y se para cuando la
+ * dispersión queda por debajo de ese nivel. También se para por temperatura,
+ * con histéresis, y ante cualquier fallo de protección.
+ */
+class BalancingController {
+public:
+    BalancingController();
+
+    /**
+     * @brief Establece el driver de salidas; debe llamarse antes de reset()
+     */
+    void setDriver(BalanceDriver* driver) { m_driver = driver; }
+
+    /**
+     * @brief Apaga las salidas y prepara el balanceo para un número de celdas
+     * @param cellCount Número de celdas del pack
+     */
+    void reset(uint16_t cellCount);
+
+    /**
+     * @brief Orden de inicio: balancea aunque balancingEnabled esté desactivado
+     */
+    void requestStart();
+
+    /**
+     * @brief Orden de parada: cancela la pasada en curso y la orden de inicio pendiente
+     *
+     * El balanceo automático no se desactiva: vuelve a arrancar cuando
+     * shouldStartBalancing() deja de cumplirse y se cumple de nuevo, o con la
+     * siguiente orden de inicio. La histéresis de temperatura sigue al día.
+     */
+    void requestStop(int64_t nowUs);
+
+    /**
+     * @brief Avanza el ciclo de balanceo
+     * @param pack Pack con las estadísticas de la última muestra
+     * @param params Umbrales configurados
+     * @param startDue Resultado de shouldStartBalancing()
+     * @param protectionFault true si hay fallos de protección activos
+     * @param nowUs Instante actual (esp_timer_get_time)
+     */
+    void update(const Pack& pack, const DeviceParams& params, bool startDue, bool protectionFault, int64_t nowUs);
+
+    bool isActive() const { return m_state == BALANCE_STATE_ACTIVE; }
+    balance_state_t getState() const { return m_state; }
+    uint32_t getMask() const { return m_mask; }
+
+    /**
+     * @brief Tiempo total de descarga de cada celda
+     * @param seconds Destino, cellCount valores
+     * @param nowUs Instante actual, para incluir la fase en curso
+     */
+    void getCellSeconds(uint32_t* seconds, int64_t nowUs) const;
+
+    static const char* stateToString(balance_state_t state);
+
+private:
+    void setMask(uint32_t mask, int64_t nowUs);
+    void stop(balance_state_t reason, int64_t nowUs);
+
+    BalanceDriver* m_driver;
+    uint16_t m_cellCount;
+    uint16_t m_outputs;          // Celdas con salida de balanceo
+    balance_state_t m_state;
+    bool m_manual;               // Orden de inicio pendiente de converger
+    bool m_cancelled;            // Orden de parada mientras dure la condición de inicio
+    bool m_hot;                  // Parada por temperatura (con histéresis)
+    bool m_bleeding;             // Fase de descarga (false = fase de medida)
+    int64_t m_phaseStartUs;
+    uint32_t m_mask;
+    int64_t m_maskSinceUs;
+    uint64_t m_cellUs[MAX_CELL_COUNT];
+};
+
+#endif // BALANCING_CONTROLLER_H
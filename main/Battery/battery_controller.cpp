@@ -1,14 +1,27 @@
 /// battery_controller.cpp
 #include "battery_controller.h"
-#include "bi_debug.h"
+#include "../app_log.h"
 #include "../Firebase/firebase_controller.h"
-#include <cstdlib>
-#include <ctime>
+#include "../Uplink/uplink_controller.h"
 #include <cmath>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_timer.h"
+#include "esp_sleep.h"
+#include <cstring>
+#include <algorithm>
 #include "../custom_config.h"
+#include "../app_config.h"
+#include "../Storage/history_log.h"
+#include "../Params/params_cache.h"
+#include "simulated_cell_source.h"
+#include "adc_cell_source.h"
+#include "report_policy.h"
+#include "../WiFi/wifi_power.h"
+#include "../Ota/ota_controller.h"
+#include "../Boot/boot_profile.h"
+#include "../Diagnostics/memory_budget.h"
+#include "../Diagnostics/latency_probe.h"
 #include "bi_params.hpp"
 
 extern BIParams biParams;
@@ -18,131 +31,178 @@ static LoggerPtr g_BatteryLogger;
 // Instancia global del controlador
 static BatteryController g_batteryController;
 
-// Constantes de simulación
-constexpr float MIN_CELL_VOLTAGE = 3.0f;
-constexpr float MAX_CELL_VOLTAGE = 4.2f;
-constexpr float NOMINAL_CELL_VOLTAGE = 3.7f;
-constexpr float MIN_TEMPERATURE = 10.0f;
-constexpr float MAX_TEMPERATURE = 45.0f;
-constexpr float MIN_CURRENT = -10.0f;  // Descarga máxima
-constexpr float MAX_CURRENT = 5.0f;    // Carga máxima
-
-// Genera un número aleatorio entre min y max
-float randomFloat(float min, float max) {
-    return min + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (max - min)));
-}
+// Tarea de batería, destino de las notificaciones de configuración
+static TaskHandle_t s_batteryTaskHandle = NULL;
+static StaticTask<BATTERY_TASK_STACK_SIZE> s_batteryTask;
+
+// Origen de las medidas de celdas, elegido en compilación. El ADC de la placa
+// solo mide el pack 0: los demás packs necesitan su propio front-end
+#if CELL_DATA_SOURCE == CELL_DATA_SOURCE_ADC
+static AdcCellSource s_cellSource;
+#else
+static SimulatedCellSource s_cellSources[PACK_MAX_COUNT];
+#endif
+
+// Salidas de balanceo, elegidas en compilación
+#if BALANCE_DRIVER == BALANCE_DRIVER_GPIO
+static GpioBalanceDriver s_balanceDriver;
+#else
+static NullBalanceDriver s_balanceDriver;
+#endif
+
+// Trabajos periódicos de la tarea de batería
+enum {
+    BATTERY_JOB_SAMPLE = 0,
+    BATTERY_JOB_LIVE,
+    BATTERY_JOB_HISTORY,
+    BATTERY_JOB_ALERTS,
+    BATTERY_JOB_BALANCE,
+    BATTERY_JOB_COUNT
+};
+static JobScheduler s_scheduler;
+static int s_jobIds[BATTERY_JOB_COUNT];
+
+// Periodo de la subida en tiempo real según la actividad de cada pack
+static ReportPolicy s_reportPolicies[PACK_MAX_COUNT];
+
+// Las lecturas de los packs se reparten en s_sampleSlots ejecuciones del
+// trabajo de muestreo por periodo, en lugar de leerlos todos de golpe
+static uint8_t s_sampleSlots = 1;
+static uint8_t s_sampleSlot = 0;     // Ejecución actual dentro del periodo
+
+// Subidas pedidas por los trabajos en la pasada actual (uplink_flags_t)
+static uint8_t s_uplinkFlags = 0;
 
-// Constructor de Cell
-Cell::Cell(uint16_t id) : m_id(id) {
-    // Inicializar con valores aleatorios pero coherentes
-    m_voltage = randomFloat(NOMINAL_CELL_VOLTAGE - 0.2f, NOMINAL_CELL_VOLTAGE + 0.2f);
-    m_temperature = randomFloat(20.0f, 30.0f);
-    m_soc = static_cast<uint8_t>(randomFloat(70.0f, 90.0f));
-    m_soh = static_cast<uint8_t>(randomFloat(90.0f, 100.0f));
+// Muestras seguidas del pack 0 leídas bien; al llegar a OTA_HEALTHY_SAMPLES se
+// confirma la imagen y deja de contar
+static uint16_t s_healthySamples = 0;
+
+void Pack::initCell(uint16_t index) {
+    // Valores neutros hasta el primer marco del origen de datos
+    m_cells.voltage[index] = 0.0f;
+    m_cells.temperature[index] = 0.0f;
+    m_cells.soc[index] = 0;
+    m_cells.soh[index] = 100;
 }
 
-void Cell::update() {
-    // Simular ligeras variaciones en voltaje (±0.05V)
-    m_voltage += randomFloat(-0.05f, 0.05f);
-    // Asegurar que el voltaje esté dentro de límites
-    if (m_voltage < MIN_CELL_VOLTAGE) m_voltage = MIN_CELL_VOLTAGE;
-    if (m_voltage > MAX_CELL_VOLTAGE) m_voltage = MAX_CELL_VOLTAGE;
+void HOT_PATH_ATTR Pack::updateCells() {
+    if (!m_source || !m_source->read(m_cells.voltage, m_cells.temperature, &m_current)) {
+        // Se conservan las últimas medidas; tras varios fallos seguidos el pack pasa a error
+        if (m_missedReads < UINT16_MAX) {
+            m_missedReads++;
+        }
+        if (m_missedReads >= PACK_SOURCE_MAX_MISSED_READS) {
+            m_status = PackStatus::ERROR;
+        }
+        return;
+    }
+    m_missedReads = 0;
+    
+    // Conteo de carga sobre el intervalo real entre muestras, corregido por OCV en reposo
+    m_socEstimator.update(m_cells.voltage, m_current, esp_timer_get_time(), m_cellCount,
+                          m_cells.soc, m_cells.soh);
     
-    // Simular variaciones en temperatura (±0.5°C)
-    m_temperature += randomFloat(-0.5f, 0.5f);
-    // Asegurar que la temperatura esté dentro de límites
-    if (m_temperature < MIN_TEMPERATURE) m_temperature = MIN_TEMPERATURE;
-    if (m_temperature > MAX_TEMPERATURE) m_temperature = MAX_TEMPERATURE;
+    // Estado según el sentido de la corriente medida
+    if (m_current > PACK_IDLE_CURRENT_A) {
+        m_status = PackStatus::CHARGING;
+    } else if (m_current < -PACK_IDLE_CURRENT_A) {
+        m_status = PackStatus::DISCHARGING;
+    } else {
+        m_status = PackStatus::IDLE;
+    }
+}
+
+void HOT_PATH_ATTR Pack::computeStats() {
+    const float* voltage = m_cells.voltage;
+    const float* temperature = m_cells.temperature;
+    PackStats stats = {};
+    float sumTemperature = 0.0f;
+    
+    if (m_cellCount > 0) {
+        stats.minVoltage = stats.maxVoltage = voltage[0];
+        stats.minTemperature = stats.maxTemperature = temperature[0];
+    }
     
-    // Calcular el SOC basado en el voltaje (simplificado)
-    // Mapeo lineal entre MIN_VOLTAGE (0% SOC) y MAX_VOLTAGE (100% SOC)
-    float socPercentage = (m_voltage - MIN_CELL_VOLTAGE) / (MAX_CELL_VOLTAGE - MIN_CELL_VOLTAGE) * 100.0f;
-    m_soc = static_cast<uint8_t>(std::max(0.0f, std::min(100.0f, socPercentage)));
+    for (uint16_t i = 0; i < m_cellCount; ++i) {
+        const float v = voltage[i];
+        const float t = temperature[i];
+        const uint32_t bit = 1u << i;
+        
+        stats.sumVoltage += v;
+        sumTemperature += t;
+        
+        if (v < stats.minVoltage) { stats.minVoltage = v; stats.minVoltageCell = i; }
+        if (v > stats.maxVoltage) { stats.maxVoltage = v; stats.maxVoltageCell = i; }
+        if (t < stats.minTemperature) { stats.minTemperature = t; stats.minTemperatureCell = i; }
+        if (t > stats.maxTemperature) { stats.maxTemperature = t; stats.maxTemperatureCell = i; }
+        
+        // Sin ramas: cada comparación aporta su bit a la máscara
+        stats.highVoltageMask |= bit & -static_cast<uint32_t>(v > m_limits.highVoltage);
+        stats.lowVoltageMask |= bit & -static_cast<uint32_t>(v < m_limits.lowVoltage);
+        stats.highTemperatureMask |= bit & -static_cast<uint32_t>(t > m_limits.highTemperature);
+        stats.lowTemperatureMask |= bit & -static_cast<uint32_t>(t < m_limits.lowTemperature);
+    }
     
-    // El SOH disminuye muy lentamente con el tiempo (simulación)
-    if (rand() % 1000 == 0 && m_soh > 80) {
-        m_soh -= 1;
+    if (m_cellCount > 0) {
+        stats.meanVoltage = stats.sumVoltage / m_cellCount;
+        stats.meanTemperature = sumTemperature / m_cellCount;
+        stats.voltageSpread = stats.maxVoltage - stats.minVoltage;
     }
+    
+    m_stats = stats;
+    m_totalVoltage = stats.sumVoltage;
 }
 
 // Constructor de Pack - Actualizado para usar configuración
-Pack::Pack() : m_uptime(0), m_cellCount(0) {
+Pack::Pack() : m_current(0.0f), m_uptime(0), m_startUs(0), m_cellCount(0),
+               m_source(nullptr), m_missedReads(0) {
     // Constructor vacío - se inicializará con init()
 }
 
 bool Pack::init(uint16_t cellCount) {
-    if (cellCount == 0) {
+    if (cellCount == 0 || cellCount > MAX_CELL_COUNT) {
         BI_DEBUG_ERROR(g_BatteryLogger, "Invalid cell count: %d", cellCount);
         return false;
     }
     
-    // Limpiar celdas existentes si las hay
-    m_cells.clear();
+    if (!m_source || !m_source->begin(cellCount)) {
+        BI_DEBUG_ERROR(g_BatteryLogger, "Cell data source cannot measure %d cells", cellCount);
+        return false;
+    }
     
     m_cellCount = cellCount;
     
-    // Crear las celdas - CORREGIDO: usar push_back con constructor
-    m_cells.reserve(cellCount);
+    // Inicializar las celdas en los arrays de capacidad fija
     for (uint16_t i = 0; i < cellCount; ++i) {
-        m_cells.push_back(Cell(i + 1));  // Crear Cell con ID específico
+        initCell(i);
     }
     
     // Inicializar otros valores
     m_status = PackStatus::IDLE;
     m_uptime = 0;
+    m_startUs = esp_timer_get_time();
     update();  // Esto actualizará los valores derivados
     
-    BI_DEBUG_INFO(g_BatteryLogger, "Pack initialized with %d cells", cellCount);
+    BI_DEBUG_INFO(g_BatteryLogger, "Pack initialized with %d cells (source: %s)", cellCount, m_source->name());
     return true;
 }
 
-void Pack::update() {
-    // Actualizar todas las celdas
-    for (auto& cell : m_cells) {
-        cell.update();
-    }
+void HOT_PATH_ATTR Pack::update() {
+    // Leer las celdas y la corriente del origen de datos
+    updateCells();
     
-    // Calcular el voltaje total sumando todas las celdas
-    m_totalVoltage = 0.0f;
-    for (const auto& cell : m_cells) {
-        m_totalVoltage += cell.getVoltage();
-    }
-    
-    // Simular corriente basada en el estado
-    // 5% de probabilidad de cambiar de estado (menos frecuente)
-    if (rand() % 20 == 0) {
-        int newState = rand() % 5;
-        m_status = static_cast<PackStatus>(newState);
-    }
-    
-    // Ajustar corriente según el estado
-    switch (m_status) {
-        case PackStatus::IDLE:
-            m_current = randomFloat(-0.1f, 0.1f);
-            break;
-        case PackStatus::CHARGING:
-            m_current = randomFloat(1.0f, MAX_CURRENT);
-            break;
-        case PackStatus::DISCHARGING:
-            m_current = randomFloat(MIN_CURRENT, -1.0f);
-            break;
-        case PackStatus::ERROR:
-            m_current = 0.0f;
-            break;
-        case PackStatus::BALANCING:
-            m_current = randomFloat(-0.5f, 0.5f);
-            break;
-    }
+    // Estadísticas y voltaje total en una sola pasada
+    computeStats();
     
     // Calcular potencia (P = V * I)
     m_power = m_totalVoltage * m_current;
     
-    // Incrementar el tiempo de funcionamiento
-    m_uptime += 1;
+    // Tiempo de funcionamiento real, independiente del periodo de muestreo
+    m_uptime = static_cast<uint32_t>((esp_timer_get_time() - m_startUs) / 1000000);
 }
 
 bool Pack::reconfigure(uint16_t newCellCount) {
-    if (newCellCount == 0) {
+    if (newCellCount == 0 || newCellCount > MAX_CELL_COUNT) {
         BI_DEBUG_ERROR(g_BatteryLogger, "Invalid new cell count: %d", newCellCount);
         return false;
     }
@@ -154,15 +214,14 @@ bool Pack::reconfigure(uint16_t newCellCount) {
     
     BI_DEBUG_INFO(g_BatteryLogger, "Reconfiguring pack from %d to %d cells", m_cellCount, newCellCount);
     
-    if (newCellCount > m_cellCount) {
-        // Añadir nuevas celdas
-        m_cells.reserve(newCellCount);
-        for (uint16_t i = m_cellCount; i < newCellCount; ++i) {
-            m_cells.push_back(Cell(i + 1));
-        }
-    } else if (newCellCount < m_cellCount) {
-        // Remover celdas excedentes
-        m_cells.erase(m_cells.begin() + newCellCount, m_cells.end());
+    if (!m_source || !m_source->begin(newCellCount)) {
+        BI_DEBUG_ERROR(g_BatteryLogger, "Cell data source cannot measure %d cells", newCellCount);
+        return false;
+    }
+    
+    // Inicializar las celdas nuevas; las sobrantes simplemente dejan de contarse
+    for (uint16_t i = m_cellCount; i < newCellCount; ++i) {
+        initCell(i);
     }
     
     m_cellCount = newCellCount;
@@ -174,8 +233,8 @@ bool Pack::reconfigure(uint16_t newCellCount) {
     return true;
 }
 
-const char* Pack::getStatusString() const {
-    switch (m_status) {
+const char* Pack::statusToString(PackStatus status) {
+    switch (status) {
         case PackStatus::IDLE: return "Idle";
         case PackStatus::CHARGING: return "Charging";
         case PackStatus::DISCHARGING: return "Discharging";
@@ -186,37 +245,138 @@ const char* Pack::getStatusString() const {
 }
 
 // Implementación de BatteryController
-BatteryController::BatteryController() : m_initialized(false) {}
+// Último paso del apagado por tensión crítica, ya con NVS volcado (tarea de esp_timer)
+static void enter_protection_sleep() {
+    wifi_power_prepare_deep_sleep();
+    // Despertar periódicamente: si la tensión se ha recuperado el equipo vuelve
+    // a funcionar, y si no la protección lo apaga de nuevo al confirmar el fallo
+    esp_sleep_enable_timer_wakeup(static_cast<uint64_t>(PROTECTION_SHUTDOWN_WAKE_S) * 1000000ULL);
+    esp_deep_sleep_start();
+}
+
+// Acción de protección: se ejecuta en el mismo ciclo en que se confirma el fallo
+static void protection_action(uint32_t raised, uint32_t cleared, uint32_t active) {
+    BI_DEBUG_VERBOSE(g_BatteryLogger, "Protection faults: raised 0x%02lx, cleared 0x%02lx, active 0x%02lx",
+                    raised, cleared, active);
+    
+    // Apagado por voltaje crítico del pack
+    static bool shutdownRequested = false;
+    if ((raised & PROTECTION_FAULT_PACK_UNDER_VOLTAGE) && !shutdownRequested &&
+        biParams.isInitialized() && biParams.getParams().deepSleepEnabled) {
+        BI_DEBUG_ERROR(g_BatteryLogger, "Initiating auto-shutdown for critical voltage (wake in %d s)",
+                      PROTECTION_SHUTDOWN_WAKE_S);
+        shutdownRequested = true;
+        // El volcado a NVS y el apagado siguen en la tarea de esp_timer para no
+        // bloquear la tarea de batería mientras tanto
+        char alertMessage[] = "Auto-shutdown: critical pack voltage";
+        params_cache_set_state("lastError", alertMessage, strlen(alertMessage));
+        params_cache_flush_async(enter_protection_sleep);
+    }
+}
+
+// Origen de datos de un pack, o nullptr si esta compilación no puede medirlo
+static CellDataSource* pack_source(uint8_t index) {
+#if CELL_DATA_SOURCE == CELL_DATA_SOURCE_ADC
+    return index == 0 ? &s_cellSource : nullptr;
+#else
+    return &s_cellSources[index];
+#endif
+}
+
+// Celdas de un pack: las de /config/packs/cellCounts o, si no tiene, cellCount
+static uint16_t pack_cell_count(uint8_t index) {
+    if (appConfig.packCellCounts[index] != 0) {
+        return appConfig.packCellCounts[index];
+    }
+    return biParams.isInitialized() ? biParams.getCellCount() : DEFAULT_CELL_COUNT;
+}
+
+BatteryController::BatteryController() : m_packCount(0), m_initialized(false) {
+    for (PackChannel& channel : m_packs) {
+        channel.active = false;
+    }
+    // El apagado protege la batería que alimenta la placa, la del pack 0
+    m_packs[0].protection.setAction(protection_action);
+}
+
+bool BatteryController::setupPack(uint8_t index) {
+    PackChannel& channel = m_packs[index];
+    const uint16_t cellCount = pack_cell_count(index);
+    
+    if (channel.active) {
+        return channel.pack.getCellCount() == cellCount || reconfigureCells(index, cellCount);
+    }
+    
+    CellDataSource* source = pack_source(index);
+    if (!source) {
+        BI_DEBUG_ERROR(g_BatteryLogger, "No cell data source for pack %d in this build", index);
+        return false;
+    }
+    
+    channel.pack.setSource(source);
+    channel.pack.setNominalCapacity(appConfig.cellCapacityMah);
+    if (!channel.pack.init(cellCount)) {
+        BI_DEBUG_ERROR(g_BatteryLogger, "Failed to initialize pack %d with %d cells", index, cellCount);
+        return false;
+    }
+    
+    channel.samples.reset(cellCount);
+    if (index == 0) {
+        m_balancing.reset(cellCount);
+    }
+    s_reportPolicies[index].reset();
+    channel.active = true;
+    return true;
+}
 
 bool BatteryController::init() {
     if (m_initialized) {
         return true;  // Ya inicializado
     }
     
-    // Sembrar el generador de números aleatorios
-    srand(static_cast<unsigned int>(time(nullptr)));
-    
-    // Obtener número de celdas desde configuración
-    uint16_t cellCount = DEFAULT_CELL_COUNT;
-    if (biParams.isInitialized()) {
-        cellCount = biParams.getCellCount();
+#if CELL_DATA_SOURCE != CELL_DATA_SOURCE_ADC
+    // Una semilla distinta por pack para que no simulen todos lo mismo
+    for (uint8_t i = 0; i < PACK_MAX_COUNT; ++i) {
+        s_cellSources[i].seed(CELL_SIM_SEED != 0 ? CELL_SIM_SEED + i : 0);
     }
+#endif
+    m_balancing.setDriver(&s_balanceDriver);
     
-    // Inicializar el pack con el número de celdas especificado
-    if (!m_pack.init(cellCount)) {
-        BI_DEBUG_ERROR(g_BatteryLogger, "Failed to initialize pack with %d cells", cellCount);
+    // Sin el pack 0 no hay controlador; el resto se reintenta con cada cambio de /config
+    applyPackLayout();
+    if (!m_packs[0].active) {
         return false;
     }
-    
     m_initialized = true;
     
-    BI_DEBUG_INFO(g_BatteryLogger, "Battery controller initialized with %d cells", cellCount);
+    BI_DEBUG_INFO(g_BatteryLogger, "Battery controller initialized with %d pack(s), %d cells in pack 0",
+                 m_packCount, m_packs[0].pack.getCellCount());
     return true;
 }
 
-bool BatteryController::reconfigureCells(uint16_t newCellCount) {
-    if (!m_initialized) {
-        BI_DEBUG_ERROR(g_BatteryLogger, "Cannot reconfigure: controller not initialized");
+bool BatteryController::applyPackLayout() {
+    const uint8_t packCount = std::min<uint8_t>(std::max<uint8_t>(appConfig.packCount, 1), PACK_MAX_COUNT);
+    bool ok = true;
+    
+    for (uint8_t i = 0; i < PACK_MAX_COUNT; ++i) {
+        if (i < packCount) {
+            ok = setupPack(i) && ok;
+        } else {
+            // Al volver a añadirlo se inicializa desde cero
+            m_packs[i].active = false;
+        }
+    }
+    
+    if (packCount != m_packCount) {
+        BI_DEBUG_INFO(g_BatteryLogger, "Pack count changed from %d to %d", m_packCount, packCount);
+        m_packCount = packCount;
+    }
+    return ok;
+}
+
+bool BatteryController::reconfigureCells(uint8_t index, uint16_t newCellCount) {
+    if (!m_packs[index].active) {
+        BI_DEBUG_ERROR(g_BatteryLogger, "Cannot reconfigure: pack %d not initialized", index);
         return false;
     }
     
@@ -226,243 +386,475 @@ bool BatteryController::reconfigureCells(uint16_t newCellCount) {
         return false;
     }
     
-    return m_pack.reconfigure(newCellCount);
+    PackChannel& channel = m_packs[index];
+    if (!channel.pack.reconfigure(newCellCount)) {
+        return false;
+    }
+    
+    // Las muestras guardadas tienen el número de celdas anterior
+    channel.samples.reset(newCellCount);
+    if (index == 0) {
+        m_balancing.reset(newCellCount);
+    }
+    s_reportPolicies[index].reset();
+    return true;
+}
+
+void BatteryController::setNominalCapacity(uint32_t capacityMah) {
+    for (PackChannel& channel : m_packs) {
+        channel.pack.setNominalCapacity(capacityMah);
+    }
 }
 
-void BatteryController::update() {
-    if (!m_initialized) {
+void BatteryController::update(uint8_t index) {
+    if (!m_initialized || !isPackActive(index)) {
         return;
     }
+    PackChannel& channel = m_packs[index];
+    
+    // Umbrales de alerta para las máscaras de PackStats
+    if (biParams.isInitialized()) {
+        const DeviceParams& params = biParams.getParams();
+        PackLimits limits;
+        limits.highVoltage = params.alertHighVoltage;
+        limits.lowVoltage = params.alertLowVoltage;
+        limits.highTemperature = params.alertHighTemp;
+        limits.lowTemperature = params.alertLowTemp;
+        channel.pack.setLimits(limits);
+    }
     
     // Actualizar el pack
-    m_pack.update();
+    {
+        LATENCY_PROBE(LATENCY_STAGE_PACK_UPDATE);
+        channel.pack.update();
+    }
+    channel.samples.push(channel.pack.getCells().voltages(), channel.pack.getCurrent(), esp_timer_get_time());
+    
+    // Protección en cada muestra, sin esperar al informe de alertas
+    if (biParams.isInitialized()) {
+        LATENCY_PROBE(LATENCY_STAGE_ALERTS);
+        channel.protection.evaluate(channel.pack, biParams.getParams());
+    }
     
     // Log de algunos valores (solo cada 10 actualizaciones para reducir spam)
     static int update_counter = 0;
     if (++update_counter >= 10) {
-        BI_DEBUG_VERBOSE(g_BatteryLogger, "Battery status: %s, Voltage: %.2fV, Current: %.2fA, Power: %.2fW, Cells: %d",
-                        m_pack.getStatusString(), m_pack.getTotalVoltage(), m_pack.getCurrent(), 
-                        m_pack.getPower(), m_pack.getCellCount());
+        BI_DEBUG_VERBOSE(g_BatteryLogger, "Pack %d status: %s, Voltage: %.2fV, Current: %.2fA, Power: %.2fW, Cells: %d",
+                        index, channel.pack.getStatusString(), channel.pack.getTotalVoltage(),
+                        channel.pack.getCurrent(), channel.pack.getPower(), channel.pack.getCellCount());
         update_counter = 0;
     }
 }
 
-void BatteryController::batteryTask(void* pvParameters) {
-    TickType_t lastWakeTime = xTaskGetTickCount();
-    const TickType_t updateInterval = pdMS_TO_TICKS(1000);  // Actualizar controlador cada 1 segundo
+// Periodo de subida en tiempo real: el del pack que más lo necesita
+static uint32_t live_period() {
+    uint32_t period = UINT32_MAX;
+    for (uint8_t i = 0; i < g_batteryController.getPackCount(); ++i) {
+        if (g_batteryController.isPackActive(i)) {
+            period = std::min(period, s_reportPolicies[i].getPeriodMs());
+        }
+    }
+    return period != UINT32_MAX ? period : s_reportPolicies[0].getPeriodMs();
+}
+
+// Aplica a los trabajos los periodos configurados (en ms), con sus mínimos
+static void apply_job_periods() {
+    uint32_t activeInterval = 5000;  // Por defecto 5 segundos
+    if (biParams.isInitialized()) {
+        // Convertir de segundos a milisegundos
+        activeInterval = biParams.getParams().sampleInterval * 1000;
+    }
     
-    static uint32_t lastStoreTime = 0;
-    static uint32_t lastHistoryTime = 0;
-    static uint32_t lastConfigCheck = 0;
-    static uint8_t lastCellCount = 0;
+    // Validar intervalos mínimos para evitar sobrecarga
+    const uint32_t samplePeriod = std::max<uint32_t>(appConfig.samplePeriodMs, BATTERY_MIN_SAMPLE_PERIOD_MS);
+    const uint32_t historyInterval = std::max<uint32_t>(appConfig.historyIntervalMs, HISTORY_MIN_INTERVAL_MS);
     
-    // Variables para intervalos configurables (en ms)
-    static uint32_t currentStoreInterval = 5000;    // Por defecto 5 segundos
-    static uint32_t currentHistoryInterval = 3600000; // Por defecto 1 hora
+    // El intervalo configurado es el periodo de subida con el pack en actividad
+    for (ReportPolicy& policy : s_reportPolicies) {
+        policy.configure(appConfig.reportAdaptive, activeInterval,
+                         appConfig.reportMinPeriodMs, appConfig.reportMaxPeriodMs);
+    }
+    const uint32_t liveInterval = live_period();
     
-    while (true) {
-        uint32_t currentTime = xTaskGetTickCount();
-        
-        // Actualizar el controlador cada segundo
-        g_batteryController.update();
-        
-        // Verificar configuración cada 10 segundos para actualizaciones dinámicas
-        if ((currentTime - lastConfigCheck) >= pdMS_TO_TICKS(10000)) {
+    // Cada pack se lee una vez por periodo, en ranuras separadas al menos un tick
+    const uint32_t packCount = g_batteryController.getPackCount();
+    s_sampleSlots = static_cast<uint8_t>(std::max<uint32_t>(1, std::min<uint32_t>(packCount, samplePeriod / PACK_SAMPLE_SLOT_MIN_MS)));
+    s_sampleSlot = 0;
+    
+    s_scheduler.setPeriod(s_jobIds[BATTERY_JOB_SAMPLE], samplePeriod / s_sampleSlots);
+    s_scheduler.setPeriod(s_jobIds[BATTERY_JOB_LIVE], liveInterval);
+    s_scheduler.setPeriod(s_jobIds[BATTERY_JOB_HISTORY], historyInterval);
+    
+    BI_DEBUG_INFO(g_BatteryLogger, "Job periods: Sample=%lums (%lu packs in %d slots), Live=%lums (%s, %lu-%lums), History=%lums",
+                 samplePeriod, packCount, s_sampleSlots, liveInterval, appConfig.reportAdaptive ? "adaptive" : "fixed",
+                 appConfig.reportMinPeriodMs, appConfig.reportMaxPeriodMs, historyInterval);
+}
+
+// Prepara la muestra completa (celdas + pack) de un pack y la encola para uplink_task
+static void enqueue_snapshot(uint8_t index, uint8_t flags) {
+    const Pack& pack = g_batteryController.getPack(index);
+    const CellsView cells = pack.getCells();
+    
+    if (cells.empty()) {
+        return;
+    }
+    
+    // Registro de tamaño fijo. Las celdas ya están en el mismo formato SoA:
+    // una única copia de los arrays.
+    static uplink_record_t record;
+    battery_snapshot_t& snapshot = record.snapshot;
+    snapshot.pack = index;
+    snapshot.pack_count = g_batteryController.getPackCount();
+    snapshot.cell_count = static_cast<uint8_t>(cells.size());
+    snapshot.cells = cells.data();
+    
+    snapshot.voltage = pack.getTotalVoltage();
+    snapshot.current = pack.getCurrent();
+    snapshot.power = pack.getPower();
+    snapshot.status = pack.getStatus();
+    snapshot.stats = pack.getStats();
+    snapshot.soc_permille = pack.getSocPermille();
+    snapshot.report_period_ms = s_scheduler.getJobs()[s_jobIds[BATTERY_JOB_LIVE]].periodMs;
+    
+    // Solo el pack 0 tiene salidas de balanceo
+    if (index == 0) {
+        const BalancingController& balancing = g_batteryController.getBalancing();
+        snapshot.balance_state = balancing.getState();
+        snapshot.balance_mask = balancing.getMask();
+        balancing.getCellSeconds(snapshot.balance_seconds, esp_timer_get_time());
+        if (balancing.isActive() && snapshot.status == PackStatus::IDLE) {
+            snapshot.status = PackStatus::BALANCING;
+        }
+    } else {
+        snapshot.balance_state = BALANCE_STATE_IDLE;
+        snapshot.balance_mask = 0;
+        memset(snapshot.balance_seconds, 0, sizeof(snapshot.balance_seconds));
+    }
+    snapshot.faults = g_batteryController.getProtection(index).getActive();
+    snapshot.uptime = pack.getUptime();
+    snapshot.timestamp_ms = history_epoch_ms();
+    record.flags = flags;
+    
+    // La subida en tiempo real cierra la ventana de muestras
+    if (flags & UPLINK_FLAG_LIVE) {
+        g_batteryController.closeSampleWindow(index, &snapshot.window);
+    } else {
+        snapshot.window.samples = 0;
+    }
+    
+    // Encolar sin bloquear; la tarea de subida junta los packs en un único PATCH
+    if (!uplink_enqueue(&record)) {
+        BI_DEBUG_WARNING(g_BatteryLogger, "Failed to enqueue snapshot of pack %d for uplink", index);
+    }
+    
+    // Incrementar contador de puntos de datos
+    if (flags & UPLINK_FLAG_LIVE) {
+        params_cache_increment(PARAMS_COUNTER_DATA_POINTS);
+    }
+}
+
+// Encola la muestra de todos los packs activos; la del último cierra la pasada
+static void enqueue_snapshots(uint8_t flags) {
+    int last = -1;
+    for (uint8_t i = 0; i < g_batteryController.getPackCount(); ++i) {
+        if (g_batteryController.isPackActive(i)) {
+            last = i;
+        }
+    }
+    
+    for (int i = 0; i <= last; ++i) {
+        if (g_batteryController.isPackActive(i)) {
+            enqueue_snapshot(i, flags | (i == last ? UPLINK_FLAG_BATCH_END : UPLINK_FLAG_NONE));
+        }
+    }
+}
+
+void battery_controller_notify_config(uint32_t events) {
+    if (s_batteryTaskHandle && events != BATTERY_CONFIG_NONE) {
+        xTaskNotify(s_batteryTaskHandle, events, eSetBits);
+    }
+}
+
+bool battery_controller_request_balancing(bool start) {
+    if (!s_batteryTaskHandle) {
+        return false;
+    }
+    return xTaskNotify(s_batteryTaskHandle,
+                       start ? BATTERY_COMMAND_BALANCE_START : BATTERY_COMMAND_BALANCE_STOP,
+                       eSetBits) == pdPASS;
+}
+
+const ScheduledJob* battery_controller_get_jobs(uint8_t* count) {
+    *count = s_batteryTaskHandle ? s_scheduler.getJobCount() : 0;
+    return *count ? s_scheduler.getJobs() : nullptr;
+}
+
+void BatteryController::batteryTask(void* pvParameters) {
+    // Trabajos en orden de ejecución cuando vencen a la vez: la muestra va
+    // primero para que las subidas y las alertas usen datos del mismo ciclo
+    s_jobIds[BATTERY_JOB_SAMPLE] = s_scheduler.add("sample", [](void*) {
+        // Esta ejecución lee los packs de su ranura; el pack 0 siempre va en la primera
+        const uint8_t packCount = g_batteryController.m_packCount;
+        for (uint8_t i = 0; i < packCount; ++i) {
+            if (i * s_sampleSlots / packCount != s_sampleSlot || !g_batteryController.isPackActive(i)) {
+                continue;
+            }
+            g_batteryController.update(i);
+            
+            // Un evento acorta el periodo de subida en el acto; alargarlo se deja
+            // para la propia subida, así no se pierde resolución a mitad de evento
             if (biParams.isInitialized()) {
-                DeviceParams& params = biParams.getParams();
-                
-                // Verificar si cambió el número de celdas
-                if (lastCellCount == 0) {
-                    // Primera inicialización
-                    lastCellCount = params.cellCount;
-                } else if (lastCellCount != params.cellCount) {
-                    BI_DEBUG_INFO(g_BatteryLogger, "Cell count configuration changed from %d to %d", 
-                                 lastCellCount, params.cellCount);
-                    
-                    if (g_batteryController.reconfigureCells(params.cellCount)) {
-                        lastCellCount = params.cellCount;
-                        BI_DEBUG_INFO(g_BatteryLogger, "Successfully reconfigured to %d cells", params.cellCount);
-                    } else {
-                        BI_DEBUG_ERROR(g_BatteryLogger, "Failed to reconfigure cells, reverting to %d", lastCellCount);
-                        // Revertir parámetro si falla la reconfiguración
-                        biParams.setCellCount(lastCellCount);
-                    }
+                const PackChannel& channel = g_batteryController.m_packs[i];
+                const uint32_t period = s_reportPolicies[i].update(channel.pack, biParams.getParams(),
+                                                                   channel.protection.getActive(),
+                                                                   i == 0 && g_batteryController.m_balancing.isActive(),
+                                                                   esp_timer_get_time());
+                if (period < s_scheduler.getJobs()[s_jobIds[BATTERY_JOB_LIVE]].periodMs) {
+                    s_scheduler.setPeriod(s_jobIds[BATTERY_JOB_LIVE], period);
                 }
-                
-                // Convertir de segundos a milisegundos
-                currentStoreInterval = params.sampleInterval * 1000;
-                
-                // El intervalo de históricos puede ser configurable o fijo
-                // Por ahora mantenemos 1 hora, pero se podría añadir otro parámetro
-                currentHistoryInterval = 3600000; // 1 hora fija
-                
-                // Validar intervalos mínimos para evitar sobrecarga
-                if (currentStoreInterval < 1000) {
-                    currentStoreInterval = 1000; // Mínimo 1 segundo
-                }
-                
-                BI_DEBUG_VERBOSE(g_BatteryLogger, "Config: Cells=%d, Store=%lums, History=%lums", 
-                                params.cellCount, currentStoreInterval, currentHistoryInterval);
             }
-            lastConfigCheck = currentTime;
         }
         
-        // Almacenar datos en tiempo real según configuración
-        if ((currentTime - lastStoreTime) >= pdMS_TO_TICKS(currentStoreInterval) && 
-            check_firebase_connectivity()) {
-            
-            // Preparar datos para Firebase
-            const Pack& pack = g_batteryController.getPack();
-            const std::vector<Cell>& cells = pack.getCells();
-            
-            if (!cells.empty()) {
-                // Crear un array con los datos de las celdas
-                battery_cell_t* cellData = new battery_cell_t[cells.size()];
-                
-                for (size_t i = 0; i < cells.size(); ++i) {
-                    cellData[i].voltage = cells[i].getVoltage();
-                    cellData[i].temperature = cells[i].getTemperature();
-                    cellData[i].soc = cells[i].getSOC();
-                    cellData[i].soh = cells[i].getSOH();
-                }
-                
-                // Actualizar Firebase con los datos de las celdas
-                if (update_battery_cells(cellData, cells.size())) {
-                    BI_DEBUG_VERBOSE(g_BatteryLogger, "Cell data updated in Firebase (%zu cells)", cells.size());
+        // Salud local de una imagen recién actualizada: la tarea planifica el
+        // muestreo y el pack 0 (siempre en la primera ranura) se lee bien
+        if (s_sampleSlot == 0 && s_healthySamples < OTA_HEALTHY_SAMPLES) {
+            if (g_batteryController.getPack(0).getMissedReads() == 0) {
+                if (++s_healthySamples == OTA_HEALTHY_SAMPLES) {
+                    ota_controller_confirm_image();
                 }
-                
-                // Actualizar también los datos del pack
-                if (update_battery_pack(pack.getTotalVoltage(), pack.getCurrent(), 
-                                      pack.getPower(), pack.getStatusString(), pack.getUptime())) {
-                    BI_DEBUG_VERBOSE(g_BatteryLogger, "Pack data updated in Firebase");
+            } else {
+                s_healthySamples = 0;
+            }
+        }
+        s_sampleSlot = (s_sampleSlot + 1) % s_sampleSlots;
+        boot_profile_mark(BOOT_PHASE_FIRST_SAMPLE);
+    }, BATTERY_SAMPLE_PERIOD_MS);
+    
+    // Solo se consultan los flags de estado: la subida la hace uplink_task,
+    // así que esta tarea nunca espera por la red
+    s_jobIds[BATTERY_JOB_LIVE] = s_scheduler.add("live", [](void*) {
+        const DeviceState& state = biParams.getState();
+        // Con la radio apagada entre ráfagas la subida retiene la última muestra
+        if ((state.wifiConnected && state.firebaseConnected) || wifi_power_is_duty_cycled()) {
+            s_uplinkFlags |= UPLINK_FLAG_LIVE;
+        } else {
+            // Sin conexión las ventanas siguen alineadas con la cadencia de subida
+            for (uint8_t i = 0; i < g_batteryController.getPackCount(); ++i) {
+                if (g_batteryController.isPackActive(i)) {
+                    g_batteryController.closeSampleWindow(i, nullptr);
                 }
-                
-                // Verificar si es momento de almacenar histórico
-                if ((currentTime - lastHistoryTime) >= pdMS_TO_TICKS(currentHistoryInterval)) {
-                    if (store_battery_history(cellData, cells.size(), pack.getTotalVoltage(), 
-                                            pack.getCurrent(), pack.getPower(), pack.getStatusString())) {
-                        BI_DEBUG_INFO(g_BatteryLogger, "Historical record stored (%zu cells)", cells.size());
-                        lastHistoryTime = currentTime;
-                    } else {
-                        BI_DEBUG_WARNING(g_BatteryLogger, "Failed to store historical record");
-                    }
+            }
+        }
+        s_scheduler.setPeriod(s_jobIds[BATTERY_JOB_LIVE], live_period());
+        for (ReportPolicy& policy : s_reportPolicies) {
+            policy.onReport();
+        }
+    }, LIVE_MIN_INTERVAL_MS);
+    
+    // Los históricos se generan también sin conexión y quedan en flash hasta
+    // que vuelve el enlace
+    s_jobIds[BATTERY_JOB_HISTORY] = s_scheduler.add("history", [](void*) {
+        s_uplinkFlags |= UPLINK_FLAG_HISTORY;
+    }, HISTORY_DEFAULT_INTERVAL_MS);
+    
+    // Informe de alertas; la protección ya se evalúa en cada muestra
+    s_jobIds[BATTERY_JOB_ALERTS] = s_scheduler.add("alerts", [](void*) {
+        if (biParams.isInitialized()) {
+            for (uint8_t i = 0; i < g_batteryController.getPackCount(); ++i) {
+                if (g_batteryController.isPackActive(i)) {
+                    checkBatteryAlerts(i);
                 }
-                
-                // Liberar memoria
-                delete[] cellData;
-                
-                // Incrementar contador de puntos de datos
-                biParams.incrementCounter("dataPoints", 1, false);
             }
-            
-            // Actualizar la marca de tiempo
-            lastStoreTime = currentTime;
         }
-        
-        // Verificar alertas de temperatura y voltaje
+    }, ALERT_CHECK_PERIOD_MS);
+    
+    // Balanceo en lazo cerrado con las estadísticas de la última muestra del pack 0
+    s_jobIds[BATTERY_JOB_BALANCE] = s_scheduler.add("balance", [](void*) {
         if (biParams.isInitialized()) {
-            checkBatteryAlerts();
+            const PackChannel& channel = g_batteryController.m_packs[0];
+            g_batteryController.m_balancing.update(channel.pack, biParams.getParams(),
+                                                   shouldStartBalancing(),
+                                                   channel.protection.getActive() != 0,
+                                                   esp_timer_get_time());
         }
+    }, BALANCE_PERIOD_MS);
+    
+    apply_job_periods();
+    
+    uint32_t lastOverruns[JobScheduler::MAX_JOBS] = {};
+    
+    while (true) {
+        const uint32_t waitMs = s_scheduler.runDue();
         
-        // Esperar hasta el próximo intervalo de actualización
-        vTaskDelayUntil(&lastWakeTime, updateInterval);
+        // Una única muestra aunque venzan a la vez la subida en vivo y el histórico
+        if (s_uplinkFlags != UPLINK_FLAG_NONE) {
+            enqueue_snapshots(s_uplinkFlags);
+            s_uplinkFlags = UPLINK_FLAG_NONE;
+        }
+        
+        // Avisar de los trabajos que se han retrasado más de un periodo
+        const ScheduledJob* jobs = s_scheduler.getJobs();
+        for (uint8_t i = 0; i < s_scheduler.getJobCount(); ++i) {
+            if (jobs[i].overruns != lastOverruns[i]) {
+                BI_DEBUG_WARNING(g_BatteryLogger, "Job '%s' overran (%lu missed periods so far, max lateness %lums)",
+                               jobs[i].name, jobs[i].overruns, jobs[i].maxLatenessUs / 1000);
+                lastOverruns[i] = jobs[i].overruns;
+            }
+        }
+        
+        // Dormir hasta el próximo plazo, o hasta que llegue un cambio de
+        // configuración. El listener escribe los parámetros antes de notificar,
+        // así que aquí ya se leen los valores nuevos. Redondeo hacia arriba para
+        // no despertar antes del plazo con el tick de 10 ms.
+        const TickType_t wait = (waitMs == UINT32_MAX) ? portMAX_DELAY :
+                                (waitMs + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+        uint32_t configEvents = BATTERY_CONFIG_NONE;
+        if (xTaskNotifyWait(0, UINT32_MAX, &configEvents, wait) == pdTRUE) {
+            if (configEvents & (BATTERY_CONFIG_CELL_COUNT | BATTERY_CONFIG_PACKS)) {
+                const uint16_t lastCellCount = g_batteryController.getPack(0).getCellCount();
+                
+                // Solo se reconfiguran los packs cuyo número de celdas cambió
+                if (g_batteryController.applyPackLayout()) {
+                    BI_DEBUG_INFO(g_BatteryLogger, "Pack layout applied: %d pack(s), %d cells in pack 0",
+                                 g_batteryController.getPackCount(), g_batteryController.getPack(0).getCellCount());
+                } else if (g_batteryController.getPack(0).getCellCount() != pack_cell_count(0) &&
+                           appConfig.packCellCounts[0] == 0) {
+                    BI_DEBUG_ERROR(g_BatteryLogger, "Failed to reconfigure cells, reverting to %d", lastCellCount);
+                    // Revertir parámetro si falla la reconfiguración del pack que lo usa
+                    biParams.setCellCount(lastCellCount);
+                } else {
+                    BI_DEBUG_ERROR(g_BatteryLogger, "Failed to set up some packs, they will not be sampled");
+                }
+            }
+            
+            // El reparto del muestreo depende del número de packs
+            if (configEvents & (BATTERY_CONFIG_INTERVALS | BATTERY_CONFIG_PACKS)) {
+                apply_job_periods();
+            }
+            
+            if (configEvents & BATTERY_COMMAND_BALANCE_STOP) {
+                g_batteryController.m_balancing.requestStop(esp_timer_get_time());
+            }
+            if (configEvents & BATTERY_COMMAND_BALANCE_START) {
+                g_batteryController.m_balancing.requestStart();
+            }
+            
+            if (configEvents & BATTERY_CONFIG_CAPACITY) {
+                g_batteryController.setNominalCapacity(appConfig.cellCapacityMah);
+                BI_DEBUG_INFO(g_BatteryLogger, "Nominal cell capacity set to %lu mAh, SOC re-estimated",
+                             appConfig.cellCapacityMah);
+            }
+        }
     }
 }
 
-// Nueva función para verificar alertas
-void BatteryController::checkBatteryAlerts() {
+// Informe de los fallos de protección de un pack, limitado en frecuencia
+void BatteryController::checkBatteryAlerts(uint8_t index) {
     if (!biParams.isInitialized()) return;
     
-    DeviceParams& params = biParams.getParams();
-    const Pack& pack = g_batteryController.getPack();
-    const std::vector<Cell>& cells = pack.getCells();
+    ProtectionMonitor& protection = g_batteryController.m_packs[index].protection;
+    if (protection.getActive() == 0 && protection.getRaised() == 0) return;
     
-    static uint32_t lastAlertTime = 0;
+    static uint32_t lastAlertTime[PACK_MAX_COUNT] = {};
+    static bool alerted[PACK_MAX_COUNT] = {};
     uint32_t currentTime = xTaskGetTickCount();
     
-    // Verificar alertas solo cada 30 segundos para evitar spam
-    if ((currentTime - lastAlertTime) < pdMS_TO_TICKS(30000)) {
+    // Informar como mucho cada ALERT_REPORT_INTERVAL_MS para evitar spam;
+    // los fallos activados mientras tanto quedan pendientes en el monitor
+    if (alerted[index] && (currentTime - lastAlertTime[index]) < pdMS_TO_TICKS(ALERT_REPORT_INTERVAL_MS)) {
         return;
     }
     
-    bool alertTriggered = false;
+    // Activos ahora o activados (aunque ya desactivados) desde el último informe
+    const uint32_t faults = protection.getActive() | protection.takeRaised();
+    
+    // Con varios packs cada mensaje indica de cuál es
+    char source[12] = "";
+    if (g_batteryController.getPackCount() > 1) {
+        snprintf(source, sizeof(source), "Pack %u: ", index);
+    }
+    
+    const DeviceParams& params = biParams.getParams();
+    const Pack& pack = g_batteryController.getPack(index);
+    const PackStats& stats = pack.getStats();
+    const CellsView cells = pack.getCells();
+    const float* voltages = cells.voltages();
+    const float* temperatures = cells.temperatures();
     char alertMessage[128];
+    uint32_t mask;
     
-    // Verificar alertas por celda
-    for (size_t i = 0; i < cells.size(); ++i) {
-        const Cell& cell = cells[i];
-        
-        // Alerta de temperatura alta
-        if (cell.getTemperature() > params.alertHighTemp) {
+    // En las alertas por celda se listan las celdas fuera de límite en esta
+    // muestra; si ya han vuelto al rango se informa de la celda extrema
+    
+    // Alerta de temperatura alta
+    if (faults & PROTECTION_FAULT_OVER_TEMPERATURE) {
+        mask = stats.highTemperatureMask ? stats.highTemperatureMask : (1u << stats.maxTemperatureCell);
+        for (; mask; mask &= mask - 1) {
+            const int i = __builtin_ctz(mask);
             snprintf(alertMessage, sizeof(alertMessage), 
-                    "High temp cell %d: %.1f°C (limit: %.1f°C)", 
-                    (int)(i + 1), cell.getTemperature(), params.alertHighTemp);
+                    "%sHigh temp cell %d: %.1f°C (limit: %.1f°C)", 
+                    source, i + 1, temperatures[i], params.alertHighTemp);
             BI_DEBUG_WARNING(g_BatteryLogger, "%s", alertMessage);
-            biParams.updateStateValue("lastError", alertMessage, strlen(alertMessage), true);
-            alertTriggered = true;
         }
-        
-        // Alerta de temperatura baja
-        if (cell.getTemperature() < params.alertLowTemp) {
+    }
+    
+    // Alerta de temperatura baja
+    if (faults & PROTECTION_FAULT_UNDER_TEMPERATURE) {
+        mask = stats.lowTemperatureMask ? stats.lowTemperatureMask : (1u << stats.minTemperatureCell);
+        for (; mask; mask &= mask - 1) {
+            const int i = __builtin_ctz(mask);
             snprintf(alertMessage, sizeof(alertMessage), 
-                    "Low temp cell %d: %.1f°C (limit: %.1f°C)", 
-                    (int)(i + 1), cell.getTemperature(), params.alertLowTemp);
+                    "%sLow temp cell %d: %.1f°C (limit: %.1f°C)", 
+                    source, i + 1, temperatures[i], params.alertLowTemp);
             BI_DEBUG_WARNING(g_BatteryLogger, "%s", alertMessage);
-            biParams.updateStateValue("lastError", alertMessage, strlen(alertMessage), true);
-            alertTriggered = true;
         }
-        
-        // Alerta de voltaje alto
-        if (cell.getVoltage() > params.alertHighVoltage) {
+    }
+    
+    // Alerta de voltaje alto
+    if (faults & PROTECTION_FAULT_CELL_OVER_VOLTAGE) {
+        mask = stats.highVoltageMask ? stats.highVoltageMask : (1u << stats.maxVoltageCell);
+        for (; mask; mask &= mask - 1) {
+            const int i = __builtin_ctz(mask);
             snprintf(alertMessage, sizeof(alertMessage), 
-                    "High voltage cell %d: %.2fV (limit: %.2fV)", 
-                    (int)(i + 1), cell.getVoltage(), params.alertHighVoltage);
+                    "%sHigh voltage cell %d: %.2fV (limit: %.2fV)", 
+                    source, i + 1, voltages[i], params.alertHighVoltage);
             BI_DEBUG_WARNING(g_BatteryLogger, "%s", alertMessage);
-            biParams.updateStateValue("lastError", alertMessage, strlen(alertMessage), true);
-            alertTriggered = true;
         }
-        
-        // Alerta de voltaje bajo
-        if (cell.getVoltage() < params.alertLowVoltage) {
+    }
+    
+    // Alerta de voltaje bajo
+    if (faults & PROTECTION_FAULT_CELL_UNDER_VOLTAGE) {
+        mask = stats.lowVoltageMask ? stats.lowVoltageMask : (1u << stats.minVoltageCell);
+        for (; mask; mask &= mask - 1) {
+            const int i = __builtin_ctz(mask);
             snprintf(alertMessage, sizeof(alertMessage), 
-                    "Low voltage cell %d: %.2fV (limit: %.2fV)", 
-                    (int)(i + 1), cell.getVoltage(), params.alertLowVoltage);
+                    "%sLow voltage cell %d: %.2fV (limit: %.2fV)", 
+                    source, i + 1, voltages[i], params.alertLowVoltage);
             BI_DEBUG_WARNING(g_BatteryLogger, "%s", alertMessage);
-            biParams.updateStateValue("lastError", alertMessage, strlen(alertMessage), true);
-            alertTriggered = true;
         }
     }
     
     // Verificar límite de corriente
-    if (fabs(pack.getCurrent()) > params.maxCurrent) {
+    if (faults & PROTECTION_FAULT_OVER_CURRENT) {
         snprintf(alertMessage, sizeof(alertMessage), 
-                "Excessive current: %.2fA (limit: %.2fA)", 
-                pack.getCurrent(), params.maxCurrent);
+                "%sExcessive current: %.2fA (limit: %.2fA)", 
+                source, pack.getCurrent(), params.maxCurrent);
         BI_DEBUG_WARNING(g_BatteryLogger, "%s", alertMessage);
-        biParams.updateStateValue("lastError", alertMessage, strlen(alertMessage), true);
-        alertTriggered = true;
     }
     
     // Verificar voltaje de apagado
-    if (pack.getTotalVoltage() < (params.shutdownVoltage * cells.size())) {
+    if (faults & PROTECTION_FAULT_PACK_UNDER_VOLTAGE) {
         snprintf(alertMessage, sizeof(alertMessage), 
-                "Critical pack voltage: %.2fV (limit: %.2fV)", 
-                pack.getTotalVoltage(), params.shutdownVoltage * cells.size());
+                "%sCritical pack voltage: %.2fV (limit: %.2fV)", 
+                source, pack.getTotalVoltage(), params.shutdownVoltage * cells.size());
         BI_DEBUG_ERROR(g_BatteryLogger, "%s", alertMessage);
-        biParams.updateStateValue("lastError", alertMessage, strlen(alertMessage), true);
-        alertTriggered = true;
-        
-        // Si está habilitado el auto-shutdown, apagar el sistema
-        if (params.deepSleepEnabled) {
-            BI_DEBUG_ERROR(g_BatteryLogger, "Initiating auto-shutdown for critical voltage");
-            // Aquí se podría implementar el apagado real del sistema
-        }
     }
     
-    if (alertTriggered) {
-        biParams.incrementCounter("errorCount", 1, true);
-        lastAlertTime = currentTime;
-    }
+    // El último mensaje (el más grave, por orden) queda como lastError
+    params_cache_set_state("lastError", alertMessage, strlen(alertMessage));
+    params_cache_increment(PARAMS_COUNTER_ERROR_COUNT);
+    lastAlertTime[index] = currentTime;
+    alerted[index] = true;
 }
 
 // Función para verificar necesidad de balanceo
@@ -472,25 +864,11 @@ bool BatteryController::shouldStartBalancing() {
     DeviceParams& params = biParams.getParams();
     if (!params.balancingEnabled) return false;
     
-    const Pack& pack = g_batteryController.getPack();
-    const std::vector<Cell>& cells = pack.getCells();
-    
-    if (cells.size() < 2) return false;
-    
-    // Encontrar voltajes mínimo y máximo
-    float minVoltage = cells[0].getVoltage();
-    float maxVoltage = cells[0].getVoltage();
-    
-    for (const auto& cell : cells) {
-        if (cell.getVoltage() < minVoltage) {
-            minVoltage = cell.getVoltage();
-        }
-        if (cell.getVoltage() > maxVoltage) {
-            maxVoltage = cell.getVoltage();
-        }
-    }
+    const Pack& pack = g_batteryController.getPack(0);
+    if (pack.getCellCount() < 2) return false;
     
-    float voltageDifference = maxVoltage - minVoltage;
+    // Diferencia entre la celda más alta y la más baja, ya calculada en update()
+    float voltageDifference = pack.getStats().voltageSpread;
     
     BI_DEBUG_VERBOSE(g_BatteryLogger, "Voltage difference: %.3fV (threshold: %.3fV)", 
                     voltageDifference, params.balancingThreshold);
@@ -508,7 +886,8 @@ void battery_controller_init() {
     // Inicializar el controlador
     if (g_batteryController.init()) {
         // Crear la tarea de actualización de batería
-        xTaskCreate(BatteryController::batteryTask, "battery_task", 4096 * 2, NULL, 5, NULL);
+        s_batteryTaskHandle = s_batteryTask.start(BatteryController::batteryTask, "battery_task", NULL,
+                                                  BATTERY_TASK_PRIORITY);
         BI_DEBUG_INFO(g_BatteryLogger, "Battery controller task created");
     } else {
         BI_DEBUG_ERROR(g_BatteryLogger, "Failed to initialize battery controller");
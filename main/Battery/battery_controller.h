@@ -2,68 +2,101 @@
 #ifndef BATTERY_CONTROLLER_H
 #define BATTERY_CONTROLLER_H
 
-#include <vector>
 #include <cstdint>
+#include <cmath>
+#include "../custom_config.h"
+#include "protection_monitor.h"
+#include "job_scheduler.h"
 
 // Constantes para número de celdas (importadas desde bi_params.hpp)
 #define MIN_CELL_COUNT 1
 #define DEFAULT_CELL_COUNT 8
 #define MAX_CELL_COUNT 18
 
+#include "sample_window.h"
+#include "soc_estimator.h"
+#include "balancing_controller.h"
+
+class CellDataSource;
+
 /**
- * @brief Clase que representa una celda individual de la batería
+ * @brief Datos de las celdas del pack como estructura de arrays (SoA)
+ *
+ * Capacidad fija de MAX_CELL_COUNT: no hay reservas dinámicas al reconfigurar
+ * y los recorridos (suma, mínimos/máximos, alertas) son bucles sobre arrays
+ * contiguos. Solo las primeras getCellCount() posiciones son válidas.
  */
-class Cell {
+struct CellArrays {
+    float voltage[MAX_CELL_COUNT];       // Voltaje en V
+    float temperature[MAX_CELL_COUNT];   // Temperatura en °C
+    uint8_t soc[MAX_CELL_COUNT];         // Estado de carga (0-100%)
+    uint8_t soh[MAX_CELL_COUNT];         // Estado de salud (0-100%)
+};
+
+/**
+ * @brief Vista de solo lectura de las celdas válidas de un pack
+ *
+ * No copia los datos: apunta a los arrays del pack, así que solo es válida
+ * mientras no se reconfigure.
+ */
+class CellsView {
 private:
-    uint16_t m_id;
-    float m_voltage;         // Voltaje en V
-    float m_temperature;     // Temperatura en °C
-    uint8_t m_soc;           // Estado de carga (0-100%)
-    uint8_t m_soh;           // Estado de salud (0-100%)
+    const CellArrays* m_data;
+    uint16_t m_count;
 
 public:
-    /**
-     * @brief Constructor de la celda
-     * @param id Identificador único de la celda
-     */
-    Cell(uint16_t id);
-
-    /**
-     * @brief Actualiza los valores de la celda con datos simulados
-     */
-    void update();
+    CellsView(const CellArrays& data, uint16_t count) : m_data(&data), m_count(count) {}
 
-    /**
-     * @brief Obtiene el identificador de la celda
-     * @return Identificador de la celda
-     */
-    uint16_t getId() const { return m_id; }
+    uint16_t size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
 
-    /**
-     * @brief Obtiene el voltaje actual de la celda
-     * @return Voltaje en V
-     */
-    float getVoltage() const { return m_voltage; }
+    const float* voltages() const { return m_data->voltage; }
+    const float* temperatures() const { return m_data->temperature; }
+    const uint8_t* socs() const { return m_data->soc; }
+    const uint8_t* sohs() const { return m_data->soh; }
 
     /**
-     * @brief Obtiene la temperatura actual de la celda
-     * @return Temperatura en °C
+     * @brief Arrays completos, p. ej. para copiarlos a una muestra
      */
-    float getTemperature() const { return m_temperature; }
+    const CellArrays& data() const { return *m_data; }
+};
 
-    /**
-     * @brief Obtiene el estado de carga de la celda
-     * @return SOC (0-100%)
-     */
-    uint8_t getSOC() const { return m_soc; }
+/**
+ * @brief Umbrales por celda evaluados en el cálculo de estadísticas
+ */
+struct PackLimits {
+    float highVoltage = INFINITY;        // V
+    float lowVoltage = -INFINITY;        // V
+    float highTemperature = INFINITY;    // °C
+    float lowTemperature = -INFINITY;    // °C
+};
 
-    /**
-     * @brief Obtiene el estado de salud de la celda
-     * @return SOH (0-100%)
-     */
-    uint8_t getSOH() const { return m_soh; }
+/**
+ * @brief Estadísticas del pack calculadas en una única pasada por ciclo
+ *
+ * Las máscaras tienen el bit i activo si la celda i (base 0) incumple el umbral.
+ */
+struct PackStats {
+    float sumVoltage;            // Suma de voltajes de celda en V
+    float meanVoltage;           // Voltaje medio de celda en V
+    float minVoltage;            // Voltaje de celda mínimo en V
+    float maxVoltage;            // Voltaje de celda máximo en V
+    float voltageSpread;         // maxVoltage - minVoltage en V
+    uint8_t minVoltageCell;      // Índice (base 0) de la celda con minVoltage
+    uint8_t maxVoltageCell;      // Índice (base 0) de la celda con maxVoltage
+    float minTemperature;        // °C
+    float maxTemperature;        // °C
+    float meanTemperature;       // °C
+    uint8_t minTemperatureCell;
+    uint8_t maxTemperatureCell;
+    uint32_t highVoltageMask;
+    uint32_t lowVoltageMask;
+    uint32_t highTemperatureMask;
+    uint32_t lowTemperatureMask;
 };
 
+static_assert(MAX_CELL_COUNT <= 32, "PackStats masks hold one bit per cell");
+
 /**
  * @brief Enumera los posibles estados del pack de baterías
  */
@@ -80,16 +113,40 @@ enum class PackStatus {
  */
 class Pack {
 private:
-    std::vector<Cell> m_cells;
+    CellArrays m_cells;      // Celdas en SoA, capacidad fija
     float m_totalVoltage;    // Voltaje total del pack en V
     float m_current;         // Corriente en A (positivo = carga, negativo = descarga)
     float m_power;           // Potencia en W
     PackStatus m_status;     // Estado del pack
     uint32_t m_uptime;       // Tiempo de funcionamiento en segundos
+    int64_t m_startUs;       // esp_timer_get_time() en init(), base de m_uptime
 
     // Número de celdas en el pack
     uint16_t m_cellCount;
 
+    PackLimits m_limits;     // Umbrales para las máscaras de m_stats
+    PackStats m_stats;       // Estadísticas del último update()
+
+    /**
+     * @brief Calcula m_stats y el voltaje total recorriendo las celdas una sola vez
+     */
+    void computeStats();
+
+    SocEstimator m_socEstimator; // SOC/SOH por conteo de carga y OCV
+    CellDataSource* m_source;    // Origen de las medidas (no es propiedad del pack)
+    uint16_t m_missedReads;      // Lecturas seguidas sin marco completo
+
+    /**
+     * @brief Inicializa los valores de una celda que aún no tiene medidas
+     * @param index Posición de la celda (0..MAX_CELL_COUNT-1)
+     */
+    void initCell(uint16_t index);
+
+    /**
+     * @brief Lee un marco del origen de datos y actualiza SOC, SOH y estado
+     */
+    void updateCells();
+
 public:
     /**
      * @brief Constructor del pack de baterías
@@ -110,16 +167,46 @@ public:
      */
     bool reconfigure(uint16_t newCellCount);
 
+    /**
+     * @brief Establece el origen de las medidas; debe llamarse antes de init()
+     * @param source Origen de datos, que debe vivir tanto como el pack
+     */
+    void setSource(CellDataSource* source) { m_source = source; }
+
     /**
      * @brief Actualiza el estado del pack y todas sus celdas
      */
     void update();
 
     /**
-     * @brief Obtiene el vector de celdas
-     * @return Vector de celdas
+     * @brief Establece los umbrales usados en las máscaras de PackStats
+     * @param limits Umbrales por celda
      */
-    const std::vector<Cell>& getCells() const { return m_cells; }
+    void setLimits(const PackLimits& limits) { m_limits = limits; }
+
+    /**
+     * @brief Cambia la capacidad nominal de las celdas y reinicia la estimación de SOC
+     * @param capacityMah Capacidad nominal de cada celda en mAh
+     */
+    void setNominalCapacity(uint32_t capacityMah) { m_socEstimator.reset(capacityMah); }
+
+    /**
+     * @brief Obtiene el SOC del pack (el de la celda más descargada)
+     * @return SOC en tanto por mil
+     */
+    uint16_t getSocPermille() const { return m_socEstimator.getPackSocPermille(); }
+
+    /**
+     * @brief Obtiene las estadísticas calculadas en el último update()
+     * @return Estadísticas del pack
+     */
+    const PackStats& getStats() const { return m_stats; }
+
+    /**
+     * @brief Obtiene una vista de las celdas configuradas
+     * @return Vista de solo lectura sobre los arrays del pack
+     */
+    CellsView getCells() const { return CellsView(m_cells, m_cellCount); }
 
     /**
      * @brief Obtiene el número de celdas configuradas
@@ -151,6 +238,12 @@ public:
      */
     PackStatus getStatus() const { return m_status; }
 
+    /**
+     * @brief Obtiene las lecturas seguidas sin marco completo del origen
+     * @return 0 si la última lectura fue buena
+     */
+    uint16_t getMissedReads() const { return m_missedReads; }
+
     /**
      * @brief Obtiene el tiempo de funcionamiento
      * @return Tiempo en segundos
@@ -161,21 +254,51 @@ public:
      * @brief Convierte el estado del pack a string
      * @return String con el estado
      */
-    const char* getStatusString() const;
+    const char* getStatusString() const { return statusToString(m_status); }
+
+    /**
+     * @brief Convierte un estado de pack a string
+     * @param status Estado a convertir
+     * @return String con el estado
+     */
+    static const char* statusToString(PackStatus status);
+};
+
+/**
+ * @brief Un pack gestionado por el controlador y lo que se evalúa por pack
+ */
+struct PackChannel {
+    Pack pack;
+    ProtectionMonitor protection;
+    SampleAccumulator samples;  // Agregados desde la última subida en tiempo real
+    bool active;                // Inicializado con un origen de datos válido
 };
 
 /**
  * @brief Controlador principal de la batería
+ *
+ * Gestiona hasta PACK_MAX_COUNT packs, cada uno con su número de celdas. Con
+ * un solo pack se comporta como el controlador de un pack de siempre; el
+ * balanceo y el apagado por tensión crítica solo actúan sobre el pack 0, que
+ * es el conectado a las salidas de la placa y la alimenta.
  */
 class BatteryController {
 private:
-    Pack m_pack;
+    PackChannel m_packs[PACK_MAX_COUNT];
+    uint8_t m_packCount;        // Packs configurados (los primeros m_packCount de m_packs)
+    BalancingController m_balancing;
     bool m_initialized;
 
     /**
-     * @brief Verifica alertas de temperatura y voltaje según configuración
+     * @brief Informa de los fallos de protección de un pack (logs, lastError, errorCount)
+     *
+     * Va limitada a un informe por pack cada ALERT_REPORT_INTERVAL_MS; la
+     * detección la hace la protección del pack en cada muestra y no depende
+     * de este límite.
+     *
+     * @param index Índice del pack
      */
-    static void checkBatteryAlerts();
+    static void checkBatteryAlerts(uint8_t index);
     
     /**
      * @brief Determina si es necesario iniciar balanceo de celdas
@@ -183,6 +306,13 @@ private:
      */
     static bool shouldStartBalancing();
 
+    /**
+     * @brief Inicializa o reconfigura un pack con el número de celdas que le corresponde
+     * @param index Índice del pack
+     * @return true si el pack quedó activo
+     */
+    bool setupPack(uint8_t index);
+
 public:
     /**
      * @brief Constructor del controlador
@@ -191,28 +321,78 @@ public:
 
     /**
      * @brief Inicializa el controlador de batería
-     * Obtiene el número de celdas desde la configuración de parámetros
-     * @return true si la inicialización fue exitosa
+     * Obtiene el número de packs y de celdas desde la configuración
+     * @return true si al menos el pack 0 se inicializó
      */
     bool init();
 
     /**
-     * @brief Reconfigura el número de celdas en tiempo de ejecución
+     * @brief Reconfigura el número de celdas de un pack en tiempo de ejecución
+     * @param index Índice del pack
      * @param newCellCount Nuevo número de celdas (1-18)
      * @return true si la reconfiguración fue exitosa
      */
-    bool reconfigureCells(uint16_t newCellCount);
+    bool reconfigureCells(uint8_t index, uint16_t newCellCount);
 
     /**
-     * @brief Actualiza el estado de la batería
+     * @brief Aplica appConfig.packCount y las celdas de cada pack
+     *
+     * Los packs nuevos se inicializan y los que sobran dejan de muestrearse.
+     *
+     * @return true si todos los packs configurados quedaron activos
      */
-    void update();
+    bool applyPackLayout();
+
+    /**
+     * @brief Actualiza el estado de un pack
+     * @param index Índice del pack
+     */
+    void update(uint8_t index);
+
+    /**
+     * @brief Obtiene el número de packs configurados
+     * @return Número de packs
+     */
+    uint8_t getPackCount() const { return m_packCount; }
+
+    /**
+     * @brief Indica si un pack configurado se está muestreando
+     * @param index Índice del pack
+     */
+    bool isPackActive(uint8_t index) const { return index < m_packCount && m_packs[index].active; }
 
     /**
-     * @brief Obtiene el pack de baterías
+     * @brief Obtiene un pack de baterías
+     * @param index Índice del pack (0 = pack de la placa)
      * @return Referencia al pack
      */
-    const Pack& getPack() const { return m_pack; }
+    const Pack& getPack(uint8_t index = 0) const { return m_packs[index].pack; }
+
+    /**
+     * @brief Agrega las muestras de un pack desde la última llamada y empieza otra ventana
+     * @param index Índice del pack
+     * @param window Destino de los agregados, o nullptr para descartarlos
+     */
+    void closeSampleWindow(uint8_t index, SampleWindow* window) { m_packs[index].samples.closeWindow(window); }
+
+    /**
+     * @brief Obtiene el controlador de balanceo (del pack 0)
+     * @return Referencia al controlador
+     */
+    const BalancingController& getBalancing() const { return m_balancing; }
+
+    /**
+     * @brief Obtiene el monitor de protección de un pack
+     * @param index Índice del pack
+     * @return Referencia al monitor
+     */
+    const ProtectionMonitor& getProtection(uint8_t index = 0) const { return m_packs[index].protection; }
+
+    /**
+     * @brief Cambia la capacidad nominal de las celdas de todos los packs
+     * @param capacityMah Capacidad nominal de cada celda en mAh
+     */
+    void setNominalCapacity(uint32_t capacityMah);
 
     /**
      * @brief Verifica si el controlador está inicializado
@@ -227,7 +407,53 @@ public:
     static void batteryTask(void* pvParameters);
 };
 
+/**
+ * @brief Cambios de configuración que afectan a la tarea de batería (bits combinables)
+ */
+typedef enum {
+    BATTERY_CONFIG_NONE       = 0,
+    BATTERY_CONFIG_CELL_COUNT = 1 << 0,   // Cambió DeviceParams::cellCount
+    BATTERY_CONFIG_INTERVALS  = 1 << 1,   // Cambió sampleInterval o el intervalo de históricos
+    BATTERY_CONFIG_CAPACITY   = 1 << 2,   // Cambió la capacidad nominal de las celdas
+    BATTERY_CONFIG_PACKS      = 1 << 3,   // Cambió el número de packs o las celdas de alguno
+    
+    // Órdenes, en la misma notificación
+    BATTERY_COMMAND_BALANCE_START = 1 << 8,
+    BATTERY_COMMAND_BALANCE_STOP  = 1 << 9,
+} battery_config_event_t;
+
 // Función de inicialización global para el controlador
 void battery_controller_init();
 
+/**
+ * @brief Notifica a la tarea de batería un cambio de configuración
+ *
+ * Los parámetros deben estar ya actualizados: la tarea los relee en su
+ * siguiente ciclo (como máximo 1 segundo después).
+ *
+ * @param events Combinación de battery_config_event_t
+ */
+void battery_controller_notify_config(uint32_t events);
+
+/**
+ * @brief Trabajos periódicos de la tarea de batería, para diagnóstico
+ *
+ * Los contadores los escribe la tarea de batería; leerlos desde otra tarea
+ * puede dar valores de distintos instantes, suficiente para diagnóstico.
+ *
+ * @param count Número de trabajos devueltos
+ * @return Array de trabajos, o nullptr si la tarea no ha arrancado
+ */
+const ScheduledJob* battery_controller_get_jobs(uint8_t* count);
+
+/**
+ * @brief Pide iniciar o detener el balanceo desde otra tarea
+ *
+ * La orden se aplica en la tarea de batería en su próxima iteración.
+ *
+ * @param start true para iniciar, false para detener
+ * @return true si la orden se pudo entregar
+ */
+bool battery_controller_request_balancing(bool start);
+
 #endif // BATTERY_CONTROLLER_H
\ No newline at end of file
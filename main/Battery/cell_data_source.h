@@ -0,0 +1,43 @@
+#ifndef CELL_DATA_SOURCE_H
+#define CELL_DATA_SOURCE_H
+
+#include <cstdint>
+
+/**
+ * @brief Origen de las medidas de celdas y corriente del pack
+ *
+ * Pack lee un marco completo por muestra a través de esta interfaz, así que la
+ * adquisición (simulador, ADC continuo, AFE externo) se cambia sin tocar el
+ * resto del controlador. Todas las llamadas se hacen desde la tarea de batería.
+ */
+class CellDataSource {
+public:
+    virtual ~CellDataSource() = default;
+
+    /**
+     * @brief Prepara la adquisición para un número de celdas
+     *
+     * Se llama al iniciar el pack y en cada reconfiguración; las celdas que ya
+     * existían deben conservar su estado.
+     *
+     * @param cellCount Número de celdas (1..MAX_CELL_COUNT)
+     * @return true si el origen puede medir ese número de celdas
+     */
+    virtual bool begin(uint16_t cellCount) = 0;
+
+    /**
+     * @brief Obtiene el marco más reciente
+     * @param voltage Destino de la tensión de cada celda en V (cellCount valores)
+     * @param temperature Destino de la temperatura de cada celda en °C
+     * @param current Destino de la corriente del pack en A (positivo = carga)
+     * @return true si hay un marco completo; si no, los destinos no se tocan
+     */
+    virtual bool read(float* voltage, float* temperature, float* current) = 0;
+
+    /**
+     * @brief Nombre corto del origen para logs
+     */
+    virtual const char* name() const = 0;
+};
+
+#endif // CELL_DATA_SOURCE_H
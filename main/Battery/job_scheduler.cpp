@@ -0,0 +1,75 @@
+// job_scheduler.cpp
+#include "job_scheduler.h"
+#include "esp_timer.h"
+#include <algorithm>
+#include <cstring>
+
+JobScheduler::JobScheduler() : m_count(0) {
+    memset(m_jobs, 0, sizeof(m_jobs));
+}
+
+int JobScheduler::add(const char* name, job_fn_t fn, uint32_t periodMs, void* context) {
+    if (m_count >= MAX_JOBS || !fn) {
+        return -1;
+    }
+    
+    ScheduledJob& job = m_jobs[m_count];
+    job.name = name;
+    job.fn = fn;
+    job.context = context;
+    job.periodMs = std::max<uint32_t>(1, periodMs);
+    job.nextDueUs = esp_timer_get_time();
+    return m_count++;
+}
+
+void JobScheduler::setPeriod(int id, uint32_t periodMs) {
+    if (id < 0 || id >= m_count) {
+        return;
+    }
+    
+    ScheduledJob& job = m_jobs[id];
+    periodMs = std::max<uint32_t>(1, periodMs);
+    if (periodMs == job.periodMs) {
+        return;
+    }
+    
+    // Mantener como referencia la última ejecución; si el nuevo plazo ya ha
+    // pasado se ejecuta en el siguiente runDue() sin contarlo como retraso
+    job.nextDueUs += (static_cast<int64_t>(periodMs) - job.periodMs) * 1000;
+    job.nextDueUs = std::max(job.nextDueUs, esp_timer_get_time());
+    job.periodMs = periodMs;
+}
+
+uint32_t JobScheduler::runDue() {
+    for (uint8_t i = 0; i < m_count; ++i) {
+        ScheduledJob& job = m_jobs[i];
+        const int64_t now = esp_timer_get_time();
+        if (now < job.nextDueUs) {
+            continue;
+        }
+        
+        const int64_t periodUs = static_cast<int64_t>(job.periodMs) * 1000;
+        const int64_t lateness = now - job.nextDueUs;
+        job.maxLatenessUs = std::max<uint32_t>(job.maxLatenessUs, static_cast<uint32_t>(std::min<int64_t>(lateness, UINT32_MAX)));
+        
+        // Saltar los periodos perdidos en vez de ejecutarlos en ráfaga
+        const int64_t missed = lateness / periodUs;
+        job.overruns += static_cast<uint32_t>(missed);
+        job.nextDueUs += (missed + 1) * periodUs;
+        
+        job.runs++;
+        job.fn(job.context);
+    }
+    
+    // Tiempo hasta el trabajo más próximo
+    const int64_t now = esp_timer_get_time();
+    int64_t wait = INT64_MAX;
+    for (uint8_t i = 0; i < m_count; ++i) {
+        wait = std::min(wait, m_jobs[i].nextDueUs - now);
+    }
+    if (wait <= 0) {
+        return 0;
+    }
+    // Redondear hacia arriba para no despertar justo antes del plazo
+    return wait == INT64_MAX ? UINT32_MAX : static_cast<uint32_t>((wait + 999) / 1000);
+}
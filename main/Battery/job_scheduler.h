@@ -0,0 +1,77 @@
+#ifndef JOB_SCHEDULER_H
+#define JOB_SCHEDULER_H
+
+#include <cstdint>
+
+/**
+ * @brief Función de un trabajo periódico
+ * @param context Puntero registrado junto al trabajo
+ */
+typedef void (*job_fn_t)(void* context);
+
+/**
+ * @brief Trabajo periódico y sus estadísticas
+ */
+struct ScheduledJob {
+    const char* name;        // Nombre corto, usado en logs y diagnósticos
+    job_fn_t fn;
+    void* context;
+    uint32_t periodMs;
+    int64_t nextDueUs;       // Instante de la próxima ejecución (esp_timer_get_time)
+    uint32_t runs;           // Ejecuciones desde el arranque
+    uint32_t overruns;       // Periodos completos perdidos por llegar tarde
+    uint32_t maxLatenessUs;  // Mayor retraso observado sobre nextDueUs
+};
+
+/**
+ * @brief Planificador por plazos de trabajos periódicos de una misma tarea
+ *
+ * No crea tareas ni temporizadores: la tarea dueña llama a runDue() y espera
+ * el tiempo que devuelve. Los trabajos mantienen su rejilla de tiempos; si uno
+ * llega tarde más de un periodo no se ejecuta varias veces seguidas, sino que
+ * se cuentan los periodos perdidos en overruns.
+ */
+class JobScheduler {
+public:
+    static constexpr uint8_t MAX_JOBS = 8;
+
+    JobScheduler();
+
+    /**
+     * @brief Registra un trabajo; la primera ejecución es inmediata
+     * @param name Nombre del trabajo (no se copia)
+     * @param fn Función a ejecutar
+     * @param periodMs Periodo en ms (mínimo 1)
+     * @param context Puntero que se pasa a fn
+     * @return Identificador del trabajo, o -1 si no caben más
+     */
+    int add(const char* name, job_fn_t fn, uint32_t periodMs, void* context = nullptr);
+
+    /**
+     * @brief Cambia el periodo de un trabajo
+     *
+     * La próxima ejecución pasa a ser la última más el nuevo periodo, así que
+     * acortar un periodo largo surte efecto sin esperar al plazo anterior. Si
+     * ese instante ya ha pasado, el trabajo se ejecuta de inmediato sin
+     * contar periodos perdidos.
+     *
+     * @param id Identificador devuelto por add()
+     * @param periodMs Nuevo periodo en ms (mínimo 1)
+     */
+    void setPeriod(int id, uint32_t periodMs);
+
+    /**
+     * @brief Ejecuta los trabajos vencidos, en orden de registro
+     * @return ms hasta el próximo plazo (0 si ya hay otro vencido)
+     */
+    uint32_t runDue();
+
+    uint8_t getJobCount() const { return m_count; }
+    const ScheduledJob* getJobs() const { return m_jobs; }
+
+private:
+    ScheduledJob m_jobs[MAX_JOBS];
+    uint8_t m_count;
+};
+
+#endif // JOB_SCHEDULER_H
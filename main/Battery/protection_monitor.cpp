@@ -0,0 +1,88 @@
+// protection_monitor.cpp
+#include "protection_monitor.h"
+#include "battery_controller.h"
+#include <cmath>
+#include <cstring>
+#include "../custom_config.h"
+
+ProtectionMonitor::ProtectionMonitor()
+    : m_action(nullptr), m_active(0), m_raised(0), m_tripCount(0) {
+    memset(m_counters, 0, sizeof(m_counters));
+}
+
+void HOT_PATH_ATTR ProtectionMonitor::debounce(uint8_t index, bool beyond, bool within) {
+    const uint32_t bit = 1u << index;
+    const bool active = (m_active & bit) != 0;
+    
+    // Contar muestras seguidas en el sentido contrario al estado actual
+    const bool toward = active ? within : beyond;
+    if (!toward) {
+        m_counters[index] = 0;
+        return;
+    }
+    
+    const uint8_t required = active ? PROTECTION_CLEAR_SAMPLES : PROTECTION_TRIP_SAMPLES;
+    if (++m_counters[index] >= required) {
+        m_counters[index] = 0;
+        m_active ^= bit;
+    }
+}
+
+void HOT_PATH_ATTR ProtectionMonitor::evaluate(const Pack& pack, const DeviceParams& params) {
+    const uint16_t cellCount = pack.getCellCount();
+    if (cellCount == 0) {
+        return;
+    }
+    
+    const PackStats& stats = pack.getStats();
+    const float current = fabsf(pack.getCurrent());
+    const float packVoltage = pack.getTotalVoltage();
+    const float shutdownVoltage = params.shutdownVoltage * cellCount;
+    const uint32_t previous = m_active;
+    
+    debounce(0, stats.maxVoltage > params.alertHighVoltage,
+             stats.maxVoltage < params.alertHighVoltage - PROTECTION_VOLTAGE_HYSTERESIS);
+    debounce(1, stats.minVoltage < params.alertLowVoltage,
+             stats.minVoltage > params.alertLowVoltage + PROTECTION_VOLTAGE_HYSTERESIS);
+    debounce(2, stats.maxTemperature > params.alertHighTemp,
+             stats.maxTemperature < params.alertHighTemp - PROTECTION_TEMPERATURE_HYSTERESIS);
+    debounce(3, stats.minTemperature < params.alertLowTemp,
+             stats.minTemperature > params.alertLowTemp + PROTECTION_TEMPERATURE_HYSTERESIS);
+    debounce(4, current > params.maxCurrent,
+             current < params.maxCurrent - PROTECTION_CURRENT_HYSTERESIS);
+    debounce(5, packVoltage < shutdownVoltage,
+             packVoltage > shutdownVoltage + PROTECTION_VOLTAGE_HYSTERESIS * cellCount);
+    
+    const uint32_t raised = m_active & ~previous;
+    const uint32_t cleared = previous & ~m_active;
+    if (raised == 0 && cleared == 0) {
+        return;
+    }
+    
+    if (raised) {
+        m_raised |= raised;
+        m_tripCount += __builtin_popcount(raised);
+    }
+    
+    if (m_action) {
+        m_action(raised, cleared, m_active);
+    }
+}
+
+uint32_t ProtectionMonitor::takeRaised() {
+    const uint32_t raised = m_raised;
+    m_raised = 0;
+    return raised;
+}
+
+const char* ProtectionMonitor::faultToString(protection_fault_t fault) {
+    switch (fault) {
+        case PROTECTION_FAULT_CELL_OVER_VOLTAGE:  return "cellOverVoltage";
+        case PROTECTION_FAULT_CELL_UNDER_VOLTAGE: return "cellUnderVoltage";
+        case PROTECTION_FAULT_OVER_TEMPERATURE:   return "overTemperature";
+        case PROTECTION_FAULT_UNDER_TEMPERATURE:  return "underTemperature";
+        case PROTECTION_FAULT_OVER_CURRENT:       return "overCurrent";
+        case PROTECTION_FAULT_PACK_UNDER_VOLTAGE: return "packUnderVoltage";
+        default:                                  return "none";
+    }
+}
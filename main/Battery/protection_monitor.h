@@ -0,0 +1,109 @@
+#ifndef PROTECTION_MONITOR_H
+#define PROTECTION_MONITOR_H
+
+#include <cstdint>
+#include "bi_params.hpp"
+
+class Pack;
+
+/**
+ * @brief Fallos de protección, como bits de una máscara
+ */
+typedef enum {
+    PROTECTION_FAULT_NONE               = 0,
+    PROTECTION_FAULT_CELL_OVER_VOLTAGE  = 1 << 0,
+    PROTECTION_FAULT_CELL_UNDER_VOLTAGE = 1 << 1,
+    PROTECTION_FAULT_OVER_TEMPERATURE   = 1 << 2,
+    PROTECTION_FAULT_UNDER_TEMPERATURE  = 1 << 3,
+    PROTECTION_FAULT_OVER_CURRENT       = 1 << 4,
+    PROTECTION_FAULT_PACK_UNDER_VOLTAGE = 1 << 5,
+} protection_fault_t;
+
+static constexpr uint8_t PROTECTION_FAULT_COUNT = 6;
+
+/**
+ * @brief Acción a ejecutar cuando cambian los fallos activos
+ *
+ * Se llama desde la tarea de batería, en el mismo ciclo de muestreo en el que
+ * se confirma el cambio, así que no debe bloquear.
+ *
+ * @param raised Fallos que se acaban de activar
+ * @param cleared Fallos que se acaban de desactivar
+ * @param active Fallos activos tras el cambio
+ */
+typedef void (*protection_action_t)(uint32_t raised, uint32_t cleared, uint32_t active);
+
+/**
+ * @brief Protección del pack evaluada en cada muestra
+ *
+ * Un fallo se activa tras PROTECTION_TRIP_SAMPLES muestras seguidas fuera de
+ * límite y se desactiva tras PROTECTION_CLEAR_SAMPLES muestras seguidas dentro
+ * del límite menos la histéresis. Solo usa las estadísticas ya calculadas por
+ * Pack::update(), por lo que su coste no depende del número de celdas.
+ *
+ * No escribe logs ni toca NVS: de informar se encarga la etapa de alertas,
+ * que va limitada en frecuencia.
+ */
+class ProtectionMonitor {
+public:
+    ProtectionMonitor();
+
+    /**
+     * @brief Registra la acción a ejecutar en cada cambio de fallos
+     * @param action Función de acción, o nullptr para ninguna
+     */
+    void setAction(protection_action_t action) { m_action = action; }
+
+    /**
+     * @brief Evalúa los límites sobre la última muestra del pack
+     * @param pack Pack ya actualizado
+     * @param params Límites configurados
+     */
+    void evaluate(const Pack& pack, const DeviceParams& params);
+
+    /**
+     * @brief Fallos activos actualmente
+     */
+    uint32_t getActive() const { return m_active; }
+
+    /**
+     * @brief Devuelve y borra los fallos activados desde la última llamada
+     *
+     * Permite que la etapa de informes no pierda fallos que se activaron y
+     * desactivaron entre dos informes.
+     */
+    uint32_t takeRaised();
+
+    /**
+     * @brief Fallos activados pendientes de informar, sin borrarlos
+     */
+    uint32_t getRaised() const { return m_raised; }
+
+    /**
+     * @brief Número total de activaciones de fallos desde el arranque
+     */
+    uint32_t getTripCount() const { return m_tripCount; }
+
+    /**
+     * @brief Nombre corto del fallo para logs y Firebase
+     * @param fault Un único bit de protection_fault_t
+     */
+    static const char* faultToString(protection_fault_t fault);
+
+private:
+    /**
+     * @brief Aplica el filtro de muestras consecutivas a un fallo
+     * @param index Índice del fallo (bit en la máscara)
+     * @param beyond true si la muestra está fuera de límite
+     * @param within true si la muestra está dentro del límite con histéresis
+     */
+    void debounce(uint8_t index, bool beyond, bool within);
+
+    protection_action_t m_action;
+    uint32_t m_active;
+    uint32_t m_raised;      // Pendientes de informar (todo en la tarea de batería)
+    uint32_t m_tripCount;
+    uint8_t m_counters[PROTECTION_FAULT_COUNT];
+};
+
+#endif // PROTECTION_MONITOR_H
@@ -0,0 +1,102 @@
+// report_policy.cpp
+#include "report_policy.h"
+#include "battery_controller.h"
+#include <algorithm>
+#include <cmath>
+#include "../custom_config.h"
+
+/**
+ * @brief Urgencia lineal: 0 con el margen completo, 1 en el umbral o más allá
+ * @param margin Distancia al umbral (negativa si ya se ha superado)
+ * @param band Distancia a partir de la cual empieza a subir la urgencia
+ */
+static float margin_urgency(float margin, float band) {
+    if (!std::isfinite(margin) || band <= 0.0f) {
+        return 0.0f;
+    }
+    return std::min(1.0f, std::max(0.0f, 1.0f - margin / band));
+}
+
+ReportPolicy::ReportPolicy()
+    : m_adaptive(false), m_basePeriodMs(LIVE_MIN_INTERVAL_MS), m_minPeriodMs(LIVE_MIN_INTERVAL_MS),
+      m_maxPeriodMs(LIVE_MIN_INTERVAL_MS), m_periodMs(LIVE_MIN_INTERVAL_MS), m_urgency(0.0f),
+      m_lastCurrent(0.0f), m_lastUs(0), m_peakDidt(0.0f) {
+}
+
+void ReportPolicy::configure(bool adaptive, uint32_t basePeriodMs, uint32_t minPeriodMs, uint32_t maxPeriodMs) {
+    m_adaptive = adaptive;
+    m_minPeriodMs = std::max<uint32_t>(minPeriodMs, LIVE_MIN_INTERVAL_MS);
+    m_maxPeriodMs = std::max(maxPeriodMs, m_minPeriodMs);
+    m_basePeriodMs = std::min(std::max(basePeriodMs, m_minPeriodMs), m_maxPeriodMs);
+
+    // Sin política el periodo es el configurado, con el mínimo de siempre
+    if (!m_adaptive) {
+        m_periodMs = std::max<uint32_t>(basePeriodMs, LIVE_MIN_INTERVAL_MS);
+    } else {
+        m_periodMs = std::min(std::max(m_periodMs, m_minPeriodMs), m_maxPeriodMs);
+    }
+}
+
+void ReportPolicy::reset() {
+    m_lastUs = 0;
+    m_peakDidt = 0.0f;
+}
+
+float ReportPolicy::limitUrgency(const Pack& pack, const DeviceParams& params) {
+    const PackStats& stats = pack.getStats();
+    float urgency = 0.0f;
+
+    urgency = std::max(urgency, margin_urgency(params.alertHighVoltage - stats.maxVoltage, REPORT_VOLTAGE_MARGIN));
+    urgency = std::max(urgency, margin_urgency(stats.minVoltage - params.alertLowVoltage, REPORT_VOLTAGE_MARGIN));
+    urgency = std::max(urgency, margin_urgency(params.alertHighTemp - stats.maxTemperature, REPORT_TEMPERATURE_MARGIN));
+    urgency = std::max(urgency, margin_urgency(stats.minTemperature - params.alertLowTemp, REPORT_TEMPERATURE_MARGIN));
+
+    if (params.maxCurrent > 0.0f) {
+        const float band = params.maxCurrent * REPORT_CURRENT_MARGIN_PERCENT / 100.0f;
+        urgency = std::max(urgency, margin_urgency(params.maxCurrent - std::fabs(pack.getCurrent()), band));
+    }
+
+    return urgency;
+}
+
+uint32_t ReportPolicy::update(const Pack& pack, const DeviceParams& params, uint32_t faults, bool balancing, int64_t nowUs) {
+    // Pico de |dI/dt| desde la última subida, con el intervalo real entre muestras
+    const float current = pack.getCurrent();
+    if (m_lastUs != 0 && nowUs > m_lastUs && std::isfinite(current)) {
+        const float didt = std::fabs(current - m_lastCurrent) * 1e6f / static_cast<float>(nowUs - m_lastUs);
+        m_peakDidt = std::max(m_peakDidt, didt);
+    }
+    m_lastCurrent = std::isfinite(current) ? current : m_lastCurrent;
+    m_lastUs = nowUs;
+
+    if (!m_adaptive) {
+        m_urgency = 0.0f;
+        return m_periodMs;
+    }
+
+    // Periodo de partida según el estado del pack
+    uint32_t startMs = m_maxPeriodMs;
+    switch (pack.getStatus()) {
+        case PackStatus::IDLE:
+            startMs = balancing ? m_basePeriodMs : m_maxPeriodMs;
+            break;
+        case PackStatus::CHARGING:
+        case PackStatus::DISCHARGING:
+        case PackStatus::BALANCING:
+            startMs = m_basePeriodMs;
+            break;
+        case PackStatus::ERROR:
+            startMs = m_minPeriodMs;
+            break;
+    }
+
+    float urgency = faults ? 1.0f : limitUrgency(pack, params);
+    urgency = std::max(urgency, (m_peakDidt - REPORT_DIDT_DEADBAND) / (REPORT_DIDT_FULL_SCALE - REPORT_DIDT_DEADBAND));
+    urgency = std::min(1.0f, std::max(0.0f, urgency));
+    m_urgency = urgency;
+
+    const float span = static_cast<float>(startMs - m_minPeriodMs);
+    m_periodMs = startMs - static_cast<uint32_t>(span * urgency);
+    m_periodMs = std::min(std::max(m_periodMs, m_minPeriodMs), m_maxPeriodMs);
+    return m_periodMs;
+}
@@ -0,0 +1,81 @@
+#ifndef REPORT_POLICY_H
+#define REPORT_POLICY_H
+
+#include <cstdint>
+#include "bi_params.hpp"
+
+class Pack;
+
+/**
+ * @brief Periodo de subida en tiempo real según la actividad del pack
+ *
+ * El periodo de partida depende del estado: en reposo el máximo configurado,
+ * cargando, descargando o balanceando el intervalo de /config (sampleInterval)
+ * y en error el mínimo. Sobre él se aplica una urgencia entre 0 y 1, la mayor
+ * de:
+ *  - la cercanía de la celda más extrema a los umbrales de alerta de tensión
+ *    y temperatura, y de la corriente a maxCurrent,
+ *  - el mayor |dI/dt| visto desde la última subida, por encima de una banda
+ *    muerta para no reaccionar al ruido,
+ *  - cualquier fallo de protección activo (urgencia 1),
+ * que acerca el periodo al mínimo de forma lineal. El resultado siempre queda
+ * entre el mínimo y el máximo configurados.
+ *
+ * Se evalúa en cada muestra; de aplicar el periodo al planificador se encarga
+ * la tarea de batería.
+ */
+class ReportPolicy {
+public:
+    ReportPolicy();
+
+    /**
+     * @brief Fija los límites del periodo
+     * @param adaptive false para usar siempre basePeriodMs, como sin política
+     * @param basePeriodMs Periodo con el pack en actividad (sampleInterval)
+     * @param minPeriodMs Periodo más corto permitido
+     * @param maxPeriodMs Periodo más largo permitido (pack en reposo)
+     */
+    void configure(bool adaptive, uint32_t basePeriodMs, uint32_t minPeriodMs, uint32_t maxPeriodMs);
+
+    /**
+     * @brief Olvida la corriente anterior, p. ej. tras reconfigurar las celdas
+     */
+    void reset();
+
+    /**
+     * @brief Recalcula el periodo con la última muestra del pack
+     * @param pack Pack ya actualizado
+     * @param params Umbrales de alerta configurados
+     * @param faults Fallos de protección activos
+     * @param balancing true si el balanceo está activo (el pack cuenta como en actividad)
+     * @param nowUs Instante de la muestra (esp_timer_get_time)
+     * @return Periodo recomendado en ms
+     */
+    uint32_t update(const Pack& pack, const DeviceParams& params, uint32_t faults, bool balancing, int64_t nowUs);
+
+    /**
+     * @brief Indica que se ha hecho una subida: empieza un nuevo pico de dI/dt
+     */
+    void onReport() { m_peakDidt = 0.0f; }
+
+    uint32_t getPeriodMs() const { return m_periodMs; }
+    float getUrgency() const { return m_urgency; }
+
+private:
+    /**
+     * @brief Urgencia por cercanía a los umbrales de alerta
+     */
+    static float limitUrgency(const Pack& pack, const DeviceParams& params);
+
+    bool m_adaptive;
+    uint32_t m_basePeriodMs;
+    uint32_t m_minPeriodMs;
+    uint32_t m_maxPeriodMs;
+    uint32_t m_periodMs;     // Último periodo calculado
+    float m_urgency;         // Última urgencia calculada (0-1)
+    float m_lastCurrent;     // A
+    int64_t m_lastUs;        // 0 = sin muestra anterior
+    float m_peakDidt;        // Mayor |dI/dt| desde la última subida, en A/s
+};
+
+#endif // REPORT_POLICY_H
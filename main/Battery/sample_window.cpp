@@ -0,0 +1,116 @@
+// sample_window.cpp
+#include "battery_controller.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+SampleAccumulator::SampleAccumulator()
+    : m_cellCount(0), m_windowSamples(0), m_windowStartUs(-1), m_lastUs(0) {
+}
+
+void SampleAccumulator::reset(uint16_t cellCount) {
+    m_cellCount = std::min<uint16_t>(cellCount, MAX_CELL_COUNT);
+    m_windowSamples = 0;
+    m_windowStartUs = -1;
+}
+
+void HOT_PATH_ATTR SampleAccumulator::push(const float* voltages, float current, int64_t timestampUs) {
+    if (!std::isfinite(current)) {
+        current = 0.0f;
+    }
+    const bool first = (m_windowSamples == 0);
+    const bool counted = (m_windowSamples < UINT16_MAX);
+    
+    for (uint16_t i = 0; i < m_cellCount; ++i) {
+        const long rounded = std::isfinite(voltages[i]) ? std::lround(voltages[i] * 1000.0f) : 0;
+        const uint16_t mv = static_cast<uint16_t>(std::max(0L, std::min(rounded, static_cast<long>(UINT16_MAX))));
+        if (first) {
+            m_minMv[i] = m_maxMv[i] = mv;
+            m_sumMv[i] = 0;
+        } else {
+            m_minMv[i] = std::min(m_minMv[i], mv);
+            m_maxMv[i] = std::max(m_maxMv[i], mv);
+        }
+        // UINT16_MAX muestras de UINT16_MAX mV caben justas en 32 bits
+        if (counted) {
+            m_sumMv[i] += mv;
+        }
+    }
+    
+    if (first) {
+        m_minCurrent = m_maxCurrent = current;
+        m_sumCurrent = 0.0f;
+    } else {
+        m_minCurrent = std::min(m_minCurrent, current);
+        m_maxCurrent = std::max(m_maxCurrent, current);
+    }
+    if (counted) {
+        m_sumCurrent += current;
+        m_windowSamples++;
+    }
+    m_lastCurrent = current;
+    
+    if (m_windowStartUs < 0) {
+        m_windowStartUs = timestampUs;
+    }
+    m_lastUs = timestampUs;
+}
+
+void sample_window_merge(SampleWindow* window, const SampleWindow* older, uint16_t cellCount) {
+    if (older->samples == 0) {
+        return;
+    }
+    if (window->samples == 0) {
+        *window = *older;
+        return;
+    }
+    
+    const uint32_t newer = window->samples;
+    const uint32_t total = newer + older->samples;
+    cellCount = std::min<uint16_t>(cellCount, MAX_CELL_COUNT);
+    for (uint16_t i = 0; i < cellCount; ++i) {
+        window->minVoltageMv[i] = std::min(window->minVoltageMv[i], older->minVoltageMv[i]);
+        window->maxVoltageMv[i] = std::max(window->maxVoltageMv[i], older->maxVoltageMv[i]);
+        const uint32_t sum = window->meanVoltageMv[i] * newer + older->meanVoltageMv[i] * older->samples;
+        window->meanVoltageMv[i] = static_cast<uint16_t>((sum + total / 2) / total);
+    }
+    window->current.min = std::min(window->current.min, older->current.min);
+    window->current.max = std::max(window->current.max, older->current.max);
+    window->current.mean = (window->current.mean * newer + older->current.mean * older->samples) / total;
+    
+    window->samples = static_cast<uint16_t>(std::min<uint32_t>(total, UINT16_MAX));
+    window->durationMs += older->durationMs;
+}
+
+void SampleAccumulator::closeWindow(SampleWindow* window) {
+    const uint16_t samples = m_windowSamples;
+    m_windowSamples = 0;
+    
+    // La ventana siguiente empieza donde acaba esta: así cada una cubre el
+    // intervalo completo entre cierres y no el de la primera a la última muestra
+    const int64_t startUs = m_windowStartUs;
+    if (samples > 0) {
+        m_windowStartUs = m_lastUs;
+    }
+    
+    if (!window) {
+        return;
+    }
+    
+    memset(window, 0, sizeof(*window));
+    if (samples == 0) {
+        return;
+    }
+    
+    window->samples = samples;
+    window->durationMs = static_cast<uint32_t>((m_lastUs - startUs) / 1000);
+    for (uint16_t i = 0; i < m_cellCount; ++i) {
+        window->minVoltageMv[i] = m_minMv[i];
+        window->maxVoltageMv[i] = m_maxMv[i];
+        window->meanVoltageMv[i] = static_cast<uint16_t>((m_sumMv[i] + samples / 2) / samples);
+    }
+    window->current.min = m_minCurrent;
+    window->current.max = m_maxCurrent;
+    window->current.mean = m_sumCurrent / samples;
+    window->current.last = m_lastCurrent;
+}
@@ -0,0 +1,101 @@
+#ifndef SAMPLE_WINDOW_H
+#define SAMPLE_WINDOW_H
+
+#include <cstdint>
+#include "../custom_config.h"
+
+// Usa MAX_CELL_COUNT: se incluye desde battery_controller.h tras definirlo
+
+/**
+ * @brief Mínimo, máximo, media y último valor de una magnitud en una ventana
+ */
+struct ChannelWindow {
+    float min;
+    float max;
+    float mean;
+    float last;
+};
+
+/**
+ * @brief Agregados de las muestras tomadas entre dos subidas
+ *
+ * La tensión de celda va en mV para no duplicar el tamaño de la muestra que
+ * viaja por la cola de subida; la resolución es la misma que se publica.
+ */
+struct SampleWindow {
+    uint16_t samples;                         // Muestras agregadas (0 = ventana vacía)
+    uint32_t durationMs;                      // Tiempo cubierto desde el cierre de la ventana anterior
+    uint16_t minVoltageMv[MAX_CELL_COUNT];
+    uint16_t maxVoltageMv[MAX_CELL_COUNT];
+    uint16_t meanVoltageMv[MAX_CELL_COUNT];
+    ChannelWindow current;                    // Corriente del pack en A
+};
+
+/**
+ * @brief Acumula en una ventana otra anterior que no se llegó a publicar
+ *
+ * El resultado equivale a haber agregado las muestras de ambas: mínimo y
+ * máximo conjuntos, media ponderada por muestras y duración sumada. El último
+ * valor es el de window. Las dos deben tener el mismo número de celdas.
+ *
+ * @param window Ventana más reciente, que recibe el resultado
+ * @param older Ventana anterior
+ * @param cellCount Celdas de ambas ventanas
+ */
+void sample_window_merge(SampleWindow* window, const SampleWindow* older, uint16_t cellCount);
+
+/**
+ * @brief Agregados en curso de la tensión de celda y la corriente entre dos subidas
+ *
+ * Lo alimenta el trabajo de muestreo y lo cierra la subida en tiempo real, así
+ * que los transitorios entre dos subidas quedan reflejados en el mínimo y el
+ * máximo en lugar de perderse. Cada muestra se acumula al llegar (mínimo,
+ * máximo y suma), de modo que la ventana cubre todas las muestras sea cual sea
+ * su duración y sin guardar las muestras crudas. Todo el acceso es desde la
+ * tarea de batería.
+ */
+class SampleAccumulator {
+public:
+    SampleAccumulator();
+
+    /**
+     * @brief Vacía la ventana y fija el número de celdas de cada muestra
+     * @param cellCount Número de celdas (1..MAX_CELL_COUNT)
+     */
+    void reset(uint16_t cellCount);
+
+    /**
+     * @brief Añade una muestra a la ventana actual
+     *
+     * Pasadas UINT16_MAX muestras en una ventana se siguen actualizando el
+     * mínimo, el máximo y el último valor, pero la media queda con las primeras.
+     *
+     * @param voltages Tensión de cada celda en V
+     * @param current Corriente del pack en A
+     * @param timestampUs Instante de la muestra (esp_timer_get_time)
+     */
+    void push(const float* voltages, float current, int64_t timestampUs);
+
+    /**
+     * @brief Calcula los agregados de la ventana actual y empieza una nueva
+     * @param window Destino de los agregados, o nullptr para descartar la ventana
+     */
+    void closeWindow(SampleWindow* window);
+
+    uint16_t getWindowSamples() const { return m_windowSamples; }
+
+private:
+    uint16_t m_cellCount;
+    uint16_t m_windowSamples;    // Muestras desde el último closeWindow()
+    uint16_t m_minMv[MAX_CELL_COUNT];
+    uint16_t m_maxMv[MAX_CELL_COUNT];
+    uint32_t m_sumMv[MAX_CELL_COUNT];
+    float m_minCurrent;
+    float m_maxCurrent;
+    float m_sumCurrent;
+    float m_lastCurrent;
+    int64_t m_windowStartUs;     // Cierre de la ventana anterior, o primera muestra; -1 sin muestras
+    int64_t m_lastUs;
+};
+
+#endif // SAMPLE_WINDOW_H
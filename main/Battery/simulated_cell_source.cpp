@@ -0,0 +1,92 @@
+// simulated_cell_source.cpp
+#include "simulated_cell_source.h"
+#include "esp_random.h"
+#include <algorithm>
+
+// Constantes de simulación
+constexpr float MIN_CELL_VOLTAGE = 3.0f;
+constexpr float MAX_CELL_VOLTAGE = 4.2f;
+constexpr float NOMINAL_CELL_VOLTAGE = 3.7f;
+constexpr float MIN_TEMPERATURE = 10.0f;
+constexpr float MAX_TEMPERATURE = 45.0f;
+constexpr float MIN_CURRENT = -10.0f;  // Descarga máxima
+constexpr float MAX_CURRENT = 5.0f;    // Carga máxima
+
+SimulatedCellSource::SimulatedCellSource(uint32_t seed)
+    : m_state(1), m_cellCount(0), m_mode(PackStatus::IDLE) {
+    this->seed(seed);
+}
+
+void SimulatedCellSource::seed(uint32_t seed) {
+    if (seed == 0) {
+        seed = esp_random();
+    }
+    m_state = seed ? seed : 1;
+    m_cellCount = 0;
+    m_mode = PackStatus::IDLE;
+}
+
+// Genera un número aleatorio entre min y max
+float SimulatedCellSource::random(float min, float max) {
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 17;
+    m_state ^= m_state << 5;
+    return min + (max - min) * static_cast<float>(m_state >> 8) * (1.0f / 16777216.0f);
+}
+
+void SimulatedCellSource::initCell(uint16_t index) {
+    // Inicializar con valores aleatorios pero coherentes
+    m_voltage[index] = random(NOMINAL_CELL_VOLTAGE - 0.2f, NOMINAL_CELL_VOLTAGE + 0.2f);
+    m_temperature[index] = random(20.0f, 30.0f);
+}
+
+bool SimulatedCellSource::begin(uint16_t cellCount) {
+    if (cellCount == 0 || cellCount > MAX_CELL_COUNT) {
+        return false;
+    }
+    
+    // Inicializar las celdas nuevas; las sobrantes simplemente dejan de contarse
+    for (uint16_t i = m_cellCount; i < cellCount; ++i) {
+        initCell(i);
+    }
+    m_cellCount = cellCount;
+    return true;
+}
+
+bool SimulatedCellSource::read(float* voltage, float* temperature, float* current) {
+    for (uint16_t i = 0; i < m_cellCount; ++i) {
+        // Simular ligeras variaciones en voltaje (±0.05V) dentro de límites
+        m_voltage[i] = std::max(MIN_CELL_VOLTAGE, std::min(MAX_CELL_VOLTAGE, m_voltage[i] + random(-0.05f, 0.05f)));
+        
+        // Simular variaciones en temperatura (±0.5°C) dentro de límites
+        m_temperature[i] = std::max(MIN_TEMPERATURE, std::min(MAX_TEMPERATURE, m_temperature[i] + random(-0.5f, 0.5f)));
+        
+        voltage[i] = m_voltage[i];
+        temperature[i] = m_temperature[i];
+    }
+    
+    // 5% de probabilidad de cambiar de régimen
+    if (random(0.0f, 1.0f) < 0.05f) {
+        m_mode = static_cast<PackStatus>(static_cast<int>(random(0.0f, 5.0f)));
+    }
+    
+    // Simular corriente según el régimen
+    switch (m_mode) {
+        case PackStatus::IDLE:
+            *current = random(-0.1f, 0.1f);
+            break;
+        case PackStatus::CHARGING:
+            *current = random(1.0f, MAX_CURRENT);
+            break;
+        case PackStatus::DISCHARGING:
+            *current = random(MIN_CURRENT, -1.0f);
+            break;
+        case PackStatus::ERROR:
+            *current = 0.0f;
+            break;
+        case PackStatus::BALANCING:
+            *current = random(-0.5f, 0.5f);
+            break;
+    }
+    return true;
+}
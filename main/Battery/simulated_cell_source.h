@@ -0,0 +1,42 @@
+#ifndef SIMULATED_CELL_SOURCE_H
+#define SIMULATED_CELL_SOURCE_H
+
+#include "battery_controller.h"
+#include "cell_data_source.h"
+
+/**
+ * @brief Simulador de celdas y corriente (el origen de datos original)
+ *
+ * Usa su propio generador xorshift32 en lugar de rand(): con la misma semilla
+ * y la misma secuencia de llamadas produce siempre los mismos marcos.
+ */
+class SimulatedCellSource : public CellDataSource {
+public:
+    /**
+     * @brief Constructor del simulador
+     * @param seed Semilla del generador; 0 toma una aleatoria de esp_random()
+     */
+    explicit SimulatedCellSource(uint32_t seed = 0);
+
+    /**
+     * @brief Reinicia el generador; las celdas se regeneran en el próximo begin()
+     * @param seed Semilla; 0 toma una aleatoria de esp_random()
+     */
+    void seed(uint32_t seed);
+
+    bool begin(uint16_t cellCount) override;
+    bool read(float* voltage, float* temperature, float* current) override;
+    const char* name() const override { return "simulated"; }
+
+private:
+    float random(float min, float max);
+    void initCell(uint16_t index);
+
+    uint32_t m_state;                        // Estado de xorshift32, nunca 0
+    uint16_t m_cellCount;
+    PackStatus m_mode;                       // Régimen simulado que decide la corriente
+    float m_voltage[MAX_CELL_COUNT];
+    float m_temperature[MAX_CELL_COUNT];
+};
+
+#endif // SIMULATED_CELL_SOURCE_H
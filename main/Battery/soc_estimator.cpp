@@ -0,0 +1,131 @@
+// soc_estimator.cpp
+#include "battery_controller.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// 1 mAh = 3,6 C = 3,6e9 nC
+static constexpr int64_t NC_PER_MAH = 3600000000LL;
+
+// SOC(‰) = (carga * m_socScale) >> SOC_SCALE_SHIFT; con carga <= capacidad el
+// producto no supera 1000 << 48, dentro de 64 bits
+static constexpr uint8_t SOC_SCALE_SHIFT = 48;
+
+static_assert(ocv_to_soc_permille(3000) == 0 && ocv_to_soc_permille(4200) == 1000,
+              "OCV table must span 0-1000 permille");
+static_assert(ocv_to_soc_permille(3710) == 450, "OCV interpolation");
+
+SocEstimator::SocEstimator() {
+    reset(PACK_NOMINAL_CAPACITY_MAH);
+}
+
+void SocEstimator::reset(uint32_t nominalCapacityMah) {
+    m_nominalNc = static_cast<int64_t>(std::max<uint32_t>(nominalCapacityMah, 1)) * NC_PER_MAH;
+    m_throughputNc = 0;
+    m_hasRestPoint = false;
+    m_cellCount = 0;
+    m_packSocPermille = 0;
+    m_lastUs = 0;
+    m_restStartUs = 0;
+    m_rested = false;
+}
+
+void SocEstimator::setCapacity(uint16_t index, int64_t capacityNc) {
+    const int64_t minNc = m_nominalNc * SOC_MIN_CAPACITY_PERCENT / 100;
+    const int64_t maxNc = m_nominalNc * SOC_MAX_CAPACITY_PERCENT / 100;
+    capacityNc = std::max(minNc, std::min(capacityNc, maxNc));
+    
+    m_capacityNc[index] = capacityNc;
+    m_socScale[index] = static_cast<uint32_t>((static_cast<uint64_t>(1000) << SOC_SCALE_SHIFT) / capacityNc);
+    m_soh[index] = static_cast<uint8_t>(std::min<int64_t>(capacityNc * 100 / m_nominalNc, 100));
+    m_chargeNc[index] = std::min(m_chargeNc[index], capacityNc);
+}
+
+void SocEstimator::initCellFromOcv(uint16_t index, float voltage) {
+    const long mv = std::isfinite(voltage) ? std::lround(voltage * 1000.0f) : 0;
+    const uint16_t socPermille = ocv_to_soc_permille(static_cast<uint16_t>(std::max(0L, std::min(mv, 65535L))));
+    
+    m_chargeNc[index] = 0;
+    setCapacity(index, m_nominalNc);
+    m_chargeNc[index] = m_capacityNc[index] * socPermille / 1000;
+    m_restSocPermille[index] = socPermille;
+}
+
+void SocEstimator::correctAtRest(const float* voltage) {
+    uint16_t socPermille[MAX_CELL_COUNT];
+    bool fadeUpdated = false;
+    
+    for (uint16_t i = 0; i < m_cellCount; ++i) {
+        const long mv = std::isfinite(voltage[i]) ? std::lround(voltage[i] * 1000.0f) : 0;
+        socPermille[i] = ocv_to_soc_permille(static_cast<uint16_t>(std::max(0L, std::min(mv, 65535L))));
+        
+        // Capacidad = carga contada / variación de SOC entre dos puntos de reposo.
+        // Solo vale si la carga y el SOC se movieron en el mismo sentido.
+        const int32_t swing = static_cast<int32_t>(socPermille[i]) - m_restSocPermille[i];
+        if (m_hasRestPoint && std::abs(swing) >= SOC_FADE_MIN_SWING_PERMILLE &&
+            (swing > 0) == (m_throughputNc > 0)) {
+            const int64_t measured = std::abs(m_throughputNc) * 1000 / std::abs(swing);
+            setCapacity(i, m_capacityNc[i] + (measured - m_capacityNc[i]) / SOC_FADE_FILTER_DIVIDER);
+            fadeUpdated = true;
+        }
+        
+        // Corregir la deriva de la integración con el SOC en reposo
+        m_chargeNc[i] = m_capacityNc[i] * socPermille[i] / 1000;
+    }
+    
+    // El punto de reposo solo avanza tras medir capacidad, para que las
+    // variaciones pequeñas entre reposos se acumulen hasta ser significativas
+    if (!m_hasRestPoint || fadeUpdated) {
+        memcpy(m_restSocPermille, socPermille, m_cellCount * sizeof(socPermille[0]));
+        m_throughputNc = 0;
+        m_hasRestPoint = true;
+    }
+}
+
+void HOT_PATH_ATTR SocEstimator::update(const float* voltage, float current, int64_t timestampUs, uint16_t cellCount,
+                          uint8_t* soc, uint8_t* soh) {
+    cellCount = std::min<uint16_t>(cellCount, MAX_CELL_COUNT);
+    
+    // Celdas nuevas: SOC inicial por OCV (sin saber si están en reposo)
+    if (cellCount > m_cellCount) {
+        for (uint16_t i = m_cellCount; i < cellCount; ++i) {
+            initCellFromOcv(i, voltage[i]);
+        }
+        // Los puntos de reposo anteriores no cubren las celdas nuevas
+        m_hasRestPoint = false;
+    }
+    m_cellCount = cellCount;
+    
+    // Carga de la muestra: mA * µs = nC
+    const int32_t currentMa = std::isfinite(current) ? static_cast<int32_t>(lroundf(current * 1000.0f)) : 0;
+    const int64_t elapsedUs = m_lastUs ? timestampUs - m_lastUs : 0;
+    const int64_t deltaNc = static_cast<int64_t>(currentMa) * elapsedUs;
+    m_lastUs = timestampUs;
+    m_throughputNc += deltaNc;
+    
+    // Detección de reposo: tras SOC_REST_TIME_MS se corrige una vez por OCV
+    if (std::abs(currentMa) < SOC_REST_CURRENT_MA) {
+        if (m_restStartUs == 0) {
+            m_restStartUs = timestampUs;
+        }
+        if (!m_rested && timestampUs - m_restStartUs >= static_cast<int64_t>(SOC_REST_TIME_MS) * 1000) {
+            correctAtRest(voltage);
+            m_rested = true;
+        }
+    } else {
+        m_restStartUs = 0;
+        m_rested = false;
+    }
+    
+    uint16_t packSoc = 1000;
+    for (uint16_t i = 0; i < cellCount; ++i) {
+        const int64_t charge = std::max<int64_t>(0, std::min(m_chargeNc[i] + deltaNc, m_capacityNc[i]));
+        m_chargeNc[i] = charge;
+        
+        const uint16_t permille = static_cast<uint16_t>((static_cast<uint64_t>(charge) * m_socScale[i]) >> SOC_SCALE_SHIFT);
+        packSoc = std::min(packSoc, permille);
+        soc[i] = static_cast<uint8_t>((std::min<uint16_t>(permille, 1000) + 5) / 10);
+        soh[i] = m_soh[i];
+    }
+    m_packSocPermille = cellCount ? std::min<uint16_t>(packSoc, 1000) : 0;
+}
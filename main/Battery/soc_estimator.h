@@ -0,0 +1,117 @@
+#ifndef SOC_ESTIMATOR_H
+#define SOC_ESTIMATOR_H
+
+#include <cstdint>
+#include "../custom_config.h"
+
+// Usa MAX_CELL_COUNT: se incluye desde battery_controller.h tras definirlo
+
+/**
+ * @brief Punto de la curva de tensión en circuito abierto (OCV) frente a SOC
+ */
+struct OcvPoint {
+    uint16_t mv;         // Tensión de celda en reposo
+    uint16_t permille;   // SOC en tanto por mil
+};
+
+/**
+ * @brief Curva OCV-SOC típica de una celda NMC, en tensiones crecientes
+ */
+static constexpr OcvPoint OCV_TABLE[] = {
+    {3000,    0}, {3300,   50}, {3450,  100}, {3550,  200},
+    {3620,  300}, {3680,  400}, {3740,  500}, {3820,  600},
+    {3920,  700}, {4000,  800}, {4080,  900}, {4200, 1000},
+};
+static constexpr uint8_t OCV_TABLE_SIZE = sizeof(OCV_TABLE) / sizeof(OCV_TABLE[0]);
+
+/**
+ * @brief SOC en reposo a partir de la tensión, interpolando en OCV_TABLE
+ * @param mv Tensión de celda en mV
+ * @return SOC en tanto por mil (0-1000)
+ */
+constexpr uint16_t ocv_to_soc_permille(uint16_t mv) {
+    if (mv <= OCV_TABLE[0].mv) {
+        return OCV_TABLE[0].permille;
+    }
+    for (uint8_t i = 1; i < OCV_TABLE_SIZE; ++i) {
+        if (mv <= OCV_TABLE[i].mv) {
+            const OcvPoint& a = OCV_TABLE[i - 1];
+            const OcvPoint& b = OCV_TABLE[i];
+            return static_cast<uint16_t>(a.permille + static_cast<uint32_t>(mv - a.mv) * (b.permille - a.permille) / (b.mv - a.mv));
+        }
+    }
+    return OCV_TABLE[OCV_TABLE_SIZE - 1].permille;
+}
+
+/**
+ * @brief Estimación de SOC y SOH por celda con aritmética entera
+ *
+ * En cada muestra integra la corriente del pack (compartida por todas las
+ * celdas en serie) sobre el intervalo real medido con esp_timer: una suma y un
+ * producto de 64 bits por celda, sin divisiones ni coma flotante salvo la
+ * conversión de la corriente a mA. La carga se guarda en nC (mA·µs) y el SOC
+ * se obtiene multiplicando por el inverso precalculado de la capacidad.
+ *
+ * Tras SOC_REST_TIME_MS con |I| < SOC_REST_CURRENT_MA la tensión de cada
+ * celda se toma como OCV y su carga se corrige con OCV_TABLE. Entre dos
+ * puntos de reposo suficientemente separados en SOC, la carga contada frente
+ * a la variación de SOC por OCV da la capacidad real de cada celda, que se
+ * filtra y define el SOH (capacidad / capacidad nominal).
+ */
+class SocEstimator {
+public:
+    SocEstimator();
+
+    /**
+     * @brief Reinicia el estimador con una capacidad nominal
+     *
+     * El SOC de todas las celdas se inicializa por OCV con la próxima muestra.
+     *
+     * @param nominalCapacityMah Capacidad nominal de cada celda en mAh
+     */
+    void reset(uint32_t nominalCapacityMah);
+
+    /**
+     * @brief Integra una muestra y actualiza SOC y SOH de las celdas
+     * @param voltage Tensión de cada celda en V
+     * @param current Corriente del pack en A (positivo = carga)
+     * @param timestampUs Instante de la muestra (esp_timer_get_time)
+     * @param cellCount Número de celdas; las nuevas se inicializan por OCV
+     * @param soc Destino del SOC de cada celda en %
+     * @param soh Destino del SOH de cada celda en %
+     */
+    void update(const float* voltage, float current, int64_t timestampUs, uint16_t cellCount,
+                uint8_t* soc, uint8_t* soh);
+
+    /**
+     * @brief SOC del pack: el de la celda más descargada
+     * @return SOC en tanto por mil
+     */
+    uint16_t getPackSocPermille() const { return m_packSocPermille; }
+
+    /**
+     * @brief Indica si el pack lleva SOC_REST_TIME_MS en reposo
+     */
+    bool isResting() const { return m_rested; }
+
+private:
+    void initCellFromOcv(uint16_t index, float voltage);
+    void setCapacity(uint16_t index, int64_t capacityNc);
+    void correctAtRest(const float* voltage);
+
+    int64_t m_nominalNc;                      // Capacidad nominal en nC
+    int64_t m_chargeNc[MAX_CELL_COUNT];       // Carga contenida en cada celda
+    int64_t m_capacityNc[MAX_CELL_COUNT];     // Capacidad estimada de cada celda
+    uint32_t m_socScale[MAX_CELL_COUNT];      // (1000 << SOC_SCALE_SHIFT) / capacidad
+    uint8_t m_soh[MAX_CELL_COUNT];            // Capacidad estimada / nominal en %
+    int64_t m_throughputNc;                   // Carga neta desde el último punto de reposo
+    uint16_t m_restSocPermille[MAX_CELL_COUNT]; // SOC por OCV en el último punto de reposo
+    bool m_hasRestPoint;
+    uint16_t m_cellCount;                     // Celdas con SOC inicializado
+    uint16_t m_packSocPermille;
+    int64_t m_lastUs;                         // 0 = sin muestra anterior
+    int64_t m_restStartUs;                    // 0 = no en reposo
+    bool m_rested;                            // Ya corregido en este periodo de reposo
+};
+
+#endif // SOC_ESTIMATOR_H
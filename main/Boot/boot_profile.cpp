@@ -0,0 +1,53 @@
+// boot_profile.cpp
+#include "boot_profile.h"
+#include "../app_log.h"
+#include "esp_timer.h"
+#include "../custom_config.h"
+
+// Logger del arranque
+static LoggerPtr g_BootLogger;
+
+// Instante de cada hito en µs desde el arranque (0 = no alcanzado)
+static volatile int64_t s_phaseUs[BOOT_PHASE_COUNT] = {};
+static volatile bool s_reported = false;
+
+static const char* const PHASE_NAMES[BOOT_PHASE_COUNT] = {
+    "paramsMs",
+    "firstSampleMs",
+    "wifiMs",
+    "authMs",
+    "firstUploadMs",
+};
+
+void boot_profile_init(void) {
+    g_BootLogger = createLogger("BOOT", INFO, DEBUG_MAIN);
+}
+
+void boot_profile_mark(boot_phase_t phase) {
+    if (phase >= BOOT_PHASE_COUNT || s_phaseUs[phase] != 0) {
+        return;
+    }
+    // Cada hito lo marca una sola tarea; una carrera como mucho repite el valor
+    s_phaseUs[phase] = esp_timer_get_time();
+    BI_DEBUG_INFO(g_BootLogger, "Boot phase %s: %lu ms", PHASE_NAMES[phase], boot_profile_get_ms(phase));
+}
+
+uint32_t boot_profile_get_ms(boot_phase_t phase) {
+    if (phase >= BOOT_PHASE_COUNT) {
+        return 0;
+    }
+    // Redondeo hacia arriba: un hito alcanzado nunca se confunde con 0
+    return static_cast<uint32_t>((s_phaseUs[phase] + 999) / 1000);
+}
+
+const char* boot_profile_phase_name(boot_phase_t phase) {
+    return phase < BOOT_PHASE_COUNT ? PHASE_NAMES[phase] : "unknown";
+}
+
+bool boot_profile_pending_report(void) {
+    return !s_reported && s_phaseUs[BOOT_PHASE_FIRST_UPLOAD] != 0;
+}
+
+void boot_profile_set_reported(void) {
+    s_reported = true;
+}
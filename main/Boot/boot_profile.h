@@ -0,0 +1,53 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include <cstdint>
+
+/**
+ * @brief Hitos del arranque, en el orden en que se esperan
+ */
+typedef enum {
+    BOOT_PHASE_PARAMS = 0,      // Parámetros cargados de NVS
+    BOOT_PHASE_FIRST_SAMPLE,    // Primera lectura de celdas
+    BOOT_PHASE_WIFI,            // WiFi conectado con IP
+    BOOT_PHASE_AUTH,            // Sesión con Firebase abierta
+    BOOT_PHASE_FIRST_UPLOAD,    // Primera escritura confirmada
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+/**
+ * @brief Crea el logger del arranque; lo primero en app_main
+ */
+void boot_profile_init(void);
+
+/**
+ * @brief Registra el instante de un hito; solo cuenta la primera vez
+ *
+ * Barato y seguro desde cualquier tarea: las llamadas repetidas no hacen nada.
+ * Los tiempos se miden desde el arranque de la aplicación (esp_timer).
+ */
+void boot_profile_mark(boot_phase_t phase);
+
+/**
+ * @brief ms desde el arranque hasta el hito, 0 si aún no se ha alcanzado
+ */
+uint32_t boot_profile_get_ms(boot_phase_t phase);
+
+/**
+ * @brief Nombre del hito para logs y diagnostics/boot
+ */
+const char* boot_profile_phase_name(boot_phase_t phase);
+
+/**
+ * @brief Indica si el perfil está completo y aún no se ha publicado
+ *
+ * Se publica una vez por arranque; boot_profile_set_reported() lo cierra.
+ */
+bool boot_profile_pending_report(void);
+
+/**
+ * @brief Marca el perfil de este arranque como publicado
+ */
+void boot_profile_set_reported(void);
+
+#endif // BOOT_PROFILE_H
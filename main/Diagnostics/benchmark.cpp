@@ -0,0 +1,189 @@
+// benchmark.cpp
+#include "benchmark.h"
+#include "../app_log.h"
+#include "bi_params.hpp"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "../custom_config.h"
+#include "../app_config.h"
+#include "../Battery/battery_controller.h"
+#include "../Battery/protection_monitor.h"
+#include "../Battery/simulated_cell_source.h"
+#include "../Firebase/firebase_controller.h"
+#include "../Firebase/json_writer.h"
+#include <algorithm>
+#include <cstdio>
+
+extern BIParams biParams;
+
+// Logger del benchmark
+static LoggerPtr g_BenchmarkLogger;
+
+// Solo una ejecución a la vez; la tarea lo borra al terminar
+static volatile bool s_running = false;
+
+// Tamaños medidos: de una celda al máximo
+static constexpr uint8_t BENCHMARK_CELL_COUNTS[] = {1, 4, 8, 12, 16, MAX_CELL_COUNT};
+static constexpr uint8_t BENCHMARK_SIZES = sizeof(BENCHMARK_CELL_COUNTS) / sizeof(BENCHMARK_CELL_COUNTS[0]);
+static_assert(BENCHMARK_ITERATIONS % BENCHMARK_HEAP_ROUNDS == 0, "Every heap round runs the same iterations");
+
+// Todo estático: ni la pila de la tarea ni el heap (que es lo que se mide)
+static SimulatedCellSource s_source(BENCHMARK_SEED);
+static Pack s_pack;
+static ProtectionMonitor s_protection;
+static battery_snapshot_t s_snapshot;
+static char s_buffer[BENCHMARK_BUFFER_SIZE];
+
+static benchmark_result_t s_results[BENCHMARK_SIZES];
+
+static uint32_t average_ns(int64_t totalUs) {
+    return static_cast<uint32_t>(totalUs * 1000 / BENCHMARK_ITERATIONS);
+}
+
+// Misma muestra que enqueue_snapshot() arma para la subida, sin balanceo
+static void fill_snapshot(const Pack& pack, const ProtectionMonitor& protection) {
+    const CellsView cells = pack.getCells();
+    s_snapshot.cell_count = static_cast<uint8_t>(cells.size());
+    s_snapshot.cells = cells.data();
+    s_snapshot.voltage = pack.getTotalVoltage();
+    s_snapshot.current = pack.getCurrent();
+    s_snapshot.power = pack.getPower();
+    s_snapshot.status = pack.getStatus();
+    s_snapshot.stats = pack.getStats();
+    s_snapshot.soc_permille = pack.getSocPermille();
+    s_snapshot.faults = protection.getActive();
+    s_snapshot.uptime = pack.getUptime();
+}
+
+static bool measure(uint8_t cells, const DeviceParams& params, benchmark_result_t* result) {
+    const bool ok = s_pack.getCellCount() == 0 ? s_pack.init(cells) : s_pack.reconfigure(cells);
+    if (!ok) {
+        return false;
+    }
+
+    int64_t packUs = 0;
+    int64_t alertsUs = 0;
+    int64_t serializeUs = 0;
+    size_t bytes = 0;
+    int32_t heapDelta = INT32_MAX;
+
+    // El heap es global: otras tareas reservan y liberan mientras se mide. Una
+    // reserva del camino medido aparece en todas las rondas, el ruido no, así
+    // que se queda la menor pérdida
+    for (uint32_t round = 0; round < BENCHMARK_HEAP_ROUNDS; ++round) {
+        const uint32_t heapBefore = esp_get_free_heap_size();
+        for (uint32_t i = 0; i < BENCHMARK_ITERATIONS / BENCHMARK_HEAP_ROUNDS; ++i) {
+            int64_t start = esp_timer_get_time();
+            s_pack.update();
+            packUs += esp_timer_get_time() - start;
+
+            start = esp_timer_get_time();
+            s_protection.evaluate(s_pack, params);
+            alertsUs += esp_timer_get_time() - start;
+
+            fill_snapshot(s_pack, s_protection);
+            start = esp_timer_get_time();
+            bytes = firebase_serialize_snapshot(&s_snapshot, s_buffer, sizeof(s_buffer));
+            serializeUs += esp_timer_get_time() - start;
+        }
+        heapDelta = std::min(heapDelta, static_cast<int32_t>(heapBefore) -
+                                        static_cast<int32_t>(esp_get_free_heap_size()));
+    }
+
+    result->cells = cells;
+    result->packUpdateNs = average_ns(packUs);
+    result->alertsNs = average_ns(alertsUs);
+    result->serializeNs = average_ns(serializeUs);
+    result->payloadBytes = static_cast<uint32_t>(bytes);
+    result->heapDelta = heapDelta;
+    return true;
+}
+
+/**
+ * @brief Publica los resultados en diagnostics/benchmark con su propio PATCH
+ *
+ * Reutiliza s_buffer, libre una vez terminadas las medidas.
+ */
+static bool publish_results(void) {
+    JsonWriter writer(s_buffer, sizeof(s_buffer));
+    writer.beginObject();
+    writer.addServerTimestamp("runAt");
+    writer.addInt("iterations", BENCHMARK_ITERATIONS);
+    char key[12];
+    for (uint8_t i = 0; i < BENCHMARK_SIZES; ++i) {
+        const benchmark_result_t& result = s_results[i];
+        snprintf(key, sizeof(key), "cells%u", result.cells);
+        writer.beginObject(key);
+        writer.addInt("packUpdateNs", result.packUpdateNs);
+        writer.addInt("alertsNs", result.alertsNs);
+        writer.addInt("serializeNs", result.serializeNs);
+        writer.addInt("payloadBytes", result.payloadBytes);
+        writer.addInt("heapDelta", result.heapDelta);
+        writer.endObject();
+    }
+    writer.endObject();
+
+    return writer.ok() && update_device_json("diagnostics/benchmark", s_buffer, "resultados del benchmark");
+}
+
+void benchmark_init(void) {
+    g_BenchmarkLogger = createLogger("BENCHMARK", INFO, DEBUG_MAIN);
+}
+
+bool benchmark_run(void) {
+    if (!biParams.isInitialized()) {
+        return false;
+    }
+
+    const DeviceParams& params = biParams.getParams();
+    s_pack.setSource(&s_source);
+    s_pack.setNominalCapacity(appConfig.cellCapacityMah);
+    s_source.seed(BENCHMARK_SEED);
+
+    for (uint8_t i = 0; i < BENCHMARK_SIZES; ++i) {
+        benchmark_result_t& result = s_results[i];
+        if (!measure(BENCHMARK_CELL_COUNTS[i], params, &result)) {
+            BI_DEBUG_ERROR(g_BenchmarkLogger, "Benchmark pack init failed with %d cells", BENCHMARK_CELL_COUNTS[i]);
+            return false;
+        }
+        BI_DEBUG_INFO(g_BenchmarkLogger, "%2d cells: update %lu ns, alerts %lu ns, serialize %lu ns (%lu bytes), heap %ld",
+                     result.cells, result.packUpdateNs, result.alertsNs, result.serializeNs,
+                     result.payloadBytes, result.heapDelta);
+    }
+
+    if (!publish_results()) {
+        BI_DEBUG_ERROR(g_BenchmarkLogger, "Benchmark results not published");
+        return false;
+    }
+    return true;
+}
+
+static void benchmark_task(void* pvParameters) {
+    benchmark_run();
+    s_running = false;
+    vTaskDelete(NULL);
+}
+
+bool benchmark_start(char* result, size_t size) {
+    if (s_running) {
+        snprintf(result, size, "Benchmark already running");
+        return false;
+    }
+    if (!biParams.isInitialized()) {
+        snprintf(result, size, "Benchmark failed: params not ready");
+        return false;
+    }
+
+    // Tarea de vida corta: command_task sigue atendiendo órdenes y acks mientras mide
+    s_running = true;
+    if (xTaskCreate(benchmark_task, "benchmark_task", BENCHMARK_TASK_STACK_SIZE, NULL,
+                    BENCHMARK_TASK_PRIORITY, NULL) != pdPASS) {
+        s_running = false;
+        snprintf(result, size, "Failed to start benchmark task");
+        return false;
+    }
+    snprintf(result, size, "Benchmark started, results in diagnostics/benchmark");
+    return true;
+}
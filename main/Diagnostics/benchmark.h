@@ -0,0 +1,45 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Coste medio por iteración para un tamaño de pack
+ */
+typedef struct {
+    uint8_t cells;
+    uint32_t packUpdateNs;      // Pack::update con celdas simuladas
+    uint32_t alertsNs;          // ProtectionMonitor::evaluate
+    uint32_t serializeNs;       // JSON completo de la muestra (celdas + pack)
+    uint32_t payloadBytes;      // Tamaño de ese JSON
+    int32_t heapDelta;          // Menor pérdida de heap de las BENCHMARK_HEAP_ROUNDS rondas (0 = sin reservas)
+} benchmark_result_t;
+
+/**
+ * @brief Crea el logger del benchmark
+ */
+void benchmark_init(void);
+
+/**
+ * @brief Mide el camino de muestreo y serialización con 1 a MAX_CELL_COUNT celdas
+ *
+ * Usa un pack propio con SimulatedCellSource de semilla fija, así que no toca
+ * el pack real ni su sombra en Firebase. Son medidas de reloj: incluyen las
+ * expropiaciones de tareas de mayor prioridad, por eso se promedia sobre
+ * BENCHMARK_ITERATIONS. Los resultados se publican al terminar en
+ * diagnostics/benchmark, en su propia petición. Bloquea hasta entonces.
+ *
+ * @return false si no se pudo medir o publicar
+ */
+bool benchmark_run(void);
+
+/**
+ * @brief Lanza benchmark_run() en su propia tarea, para la orden "benchmark"
+ * @param result Destino del texto de resultado
+ * @param size Tamaño de result
+ * @return true si el benchmark se ha iniciado
+ */
+bool benchmark_start(char* result, size_t size);
+
+#endif // BENCHMARK_H
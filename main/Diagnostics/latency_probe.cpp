@@ -0,0 +1,102 @@
+// latency_probe.cpp
+#include "latency_probe.h"
+
+#if LATENCY_PROBES
+
+#include "freertos/FreeRTOS.h"
+#include "../app_config.h"
+#include <algorithm>
+#include <cstring>
+
+// Límites superiores de los cubos en µs; el último cubo recoge el resto
+static constexpr uint32_t LATENCY_BUCKET_LIMITS_US[] = {
+    50, 100, 200, 500,
+    1000, 2000, 5000, 10000, 20000, 50000,
+    100000, 200000, 500000, 1000000, 2000000, 5000000,
+};
+static constexpr uint8_t LATENCY_BUCKET_COUNT = sizeof(LATENCY_BUCKET_LIMITS_US) / sizeof(LATENCY_BUCKET_LIMITS_US[0]) + 1;
+
+typedef struct {
+    uint32_t buckets[LATENCY_BUCKET_COUNT];
+    uint32_t count;
+    uint32_t maxUs;
+} latency_histogram_t;
+
+static latency_histogram_t s_histograms[LATENCY_STAGE_COUNT];
+static portMUX_TYPE s_histogramLock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char* const STAGE_NAMES[LATENCY_STAGE_COUNT] = {
+    "packUpdate",
+    "alerts",
+    "serialize",
+    "firebaseUpdate",
+    "firebasePush",
+    "tlsConnect",
+    "nvsCommit",
+    "listener",
+};
+
+static uint8_t bucket_for(uint32_t us) {
+    uint8_t bucket = 0;
+    while (bucket < LATENCY_BUCKET_COUNT - 1 && us > LATENCY_BUCKET_LIMITS_US[bucket]) {
+        bucket++;
+    }
+    return bucket;
+}
+
+// Límite superior del cubo con el percentil pedido; el último cubo usa el máximo
+static uint32_t percentile(const latency_histogram_t& histogram, uint32_t percent) {
+    const uint32_t rank = (histogram.count * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (uint8_t i = 0; i < LATENCY_BUCKET_COUNT - 1; ++i) {
+        seen += histogram.buckets[i];
+        if (seen >= rank) {
+            return std::min(LATENCY_BUCKET_LIMITS_US[i], histogram.maxUs);
+        }
+    }
+    return histogram.maxUs;
+}
+
+void latency_probe_record(latency_stage_t stage, int64_t durationUs) {
+    if (!appConfig.latencyProbes || stage >= LATENCY_STAGE_COUNT) {
+        return;
+    }
+    const uint32_t us = durationUs < 0 ? 0 : durationUs > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(durationUs);
+    const uint8_t bucket = bucket_for(us);
+
+    portENTER_CRITICAL(&s_histogramLock);
+    latency_histogram_t& histogram = s_histograms[stage];
+    histogram.buckets[bucket]++;
+    histogram.count++;
+    if (us > histogram.maxUs) {
+        histogram.maxUs = us;
+    }
+    portEXIT_CRITICAL(&s_histogramLock);
+}
+
+bool latency_probe_collect(latency_stats_t* stats) {
+    // Copia y vaciado en la sección crítica; los percentiles se calculan fuera.
+    // Estática para no ocupar la pila: solo la llama la tarea de subida.
+    static latency_histogram_t copy[LATENCY_STAGE_COUNT];
+    portENTER_CRITICAL(&s_histogramLock);
+    memcpy(copy, s_histograms, sizeof(copy));
+    memset(s_histograms, 0, sizeof(s_histograms));
+    portEXIT_CRITICAL(&s_histogramLock);
+
+    bool any = false;
+    for (uint8_t stage = 0; stage < LATENCY_STAGE_COUNT; ++stage) {
+        const latency_histogram_t& histogram = copy[stage];
+        stats[stage].count = histogram.count;
+        stats[stage].p50Us = histogram.count ? percentile(histogram, 50) : 0;
+        stats[stage].p95Us = histogram.count ? percentile(histogram, 95) : 0;
+        stats[stage].maxUs = histogram.maxUs;
+        any = any || histogram.count > 0;
+    }
+    return any;
+}
+
+const char* latency_probe_stage_name(latency_stage_t stage) {
+    return stage < LATENCY_STAGE_COUNT ? STAGE_NAMES[stage] : "unknown";
+}
+
+#endif // LATENCY_PROBES
@@ -0,0 +1,95 @@
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <cstdint>
+#include "esp_timer.h"
+#include "../custom_config.h"
+
+/**
+ * @brief Etapas medidas del camino caliente
+ */
+typedef enum {
+    LATENCY_STAGE_PACK_UPDATE = 0,  // Pack::update (lectura y estadísticas de celdas)
+    LATENCY_STAGE_ALERTS,           // Evaluación de protecciones por muestra
+    LATENCY_STAGE_SERIALIZE,        // Construcción del JSON de la muestra
+    LATENCY_STAGE_FIREBASE_UPDATE,  // firebase_update / firebase_set
+    LATENCY_STAGE_FIREBASE_PUSH,    // firebase_push
+    LATENCY_STAGE_TLS_CONNECT,      // Conexión nueva (TCP + handshake TLS)
+    LATENCY_STAGE_NVS_COMMIT,       // Guardados en NVS
+    LATENCY_STAGE_LISTENER,         // Callbacks de los listeners de Firebase
+    LATENCY_STAGE_COUNT
+} latency_stage_t;
+
+/**
+ * @brief Resumen del histograma de una etapa
+ *
+ * Los percentiles son el límite superior del cubo en el que caen, así que
+ * su resolución es la de LATENCY_BUCKET_LIMITS_US.
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t p50Us;
+    uint32_t p95Us;
+    uint32_t maxUs;
+} latency_stats_t;
+
+#if LATENCY_PROBES
+
+/**
+ * @brief Añade una medida al histograma de su etapa
+ *
+ * No hace nada si las sondas están desactivadas desde /config
+ * (appConfig.latencyProbes). Seguro desde cualquier tarea.
+ */
+void latency_probe_record(latency_stage_t stage, int64_t durationUs);
+
+/**
+ * @brief Resume los histogramas y los vacía
+ * @param stats Destino, LATENCY_STAGE_COUNT elementos
+ * @return true si alguna etapa tiene medidas
+ */
+bool latency_probe_collect(latency_stats_t* stats);
+
+/**
+ * @brief Nombre de la etapa en diagnostics/latency
+ */
+const char* latency_probe_stage_name(latency_stage_t stage);
+
+/**
+ * @brief Mide el tiempo de vida del objeto en la etapa dada
+ */
+class LatencyScope {
+public:
+    explicit LatencyScope(latency_stage_t stage) : m_stage(stage), m_startUs(esp_timer_get_time()) {}
+    ~LatencyScope() { latency_probe_record(m_stage, esp_timer_get_time() - m_startUs); }
+
+    LatencyScope(const LatencyScope&) = delete;
+    LatencyScope& operator=(const LatencyScope&) = delete;
+
+private:
+    latency_stage_t m_stage;
+    int64_t m_startUs;
+};
+
+#define LATENCY_CONCAT_INNER(a, b) a##b
+#define LATENCY_CONCAT(a, b) LATENCY_CONCAT_INNER(a, b)
+
+// Mide desde aquí hasta el final del bloque
+#define LATENCY_PROBE(stage) LatencyScope LATENCY_CONCAT(latencyScope_, __LINE__)(stage)
+// Añade una duración ya medida
+#define LATENCY_RECORD(stage, durationUs) latency_probe_record((stage), (durationUs))
+// Mide un tramo que no coincide con un bloque: LATENCY_BEGIN(inicio) ... LATENCY_END(etapa, inicio)
+#define LATENCY_BEGIN(startVar) const int64_t startVar = esp_timer_get_time()
+#define LATENCY_END(stage, startVar) latency_probe_record((stage), esp_timer_get_time() - (startVar))
+
+#else
+
+// Sin sondas compiladas no queda ni la lectura del reloj
+#define LATENCY_PROBE(stage) do {} while (0)
+#define LATENCY_RECORD(stage, durationUs) do {} while (0)
+#define LATENCY_BEGIN(startVar) do {} while (0)
+#define LATENCY_END(stage, startVar) do {} while (0)
+
+#endif // LATENCY_PROBES
+
+#endif // LATENCY_PROBE_H
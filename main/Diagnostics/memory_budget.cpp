@@ -0,0 +1,84 @@
+// memory_budget.cpp
+#include "memory_budget.h"
+#include "../app_log.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "../custom_config.h"
+
+// Logger del informe de memoria
+static LoggerPtr g_MemoryLogger;
+
+typedef struct {
+    TaskHandle_t handle;
+    uint32_t stackSize;
+} budget_task_t;
+
+// Las tareas se registran al arrancar y no se eliminan
+static budget_task_t s_tasks[MEMORY_BUDGET_MAX_TASKS];
+static volatile uint8_t s_taskCount = 0;
+static portMUX_TYPE s_taskLock = portMUX_INITIALIZER_UNLOCKED;
+
+static int64_t s_nextReportUs = 0;
+
+void memory_budget_init(void) {
+    g_MemoryLogger = createLogger("MEMORY", INFO, DEBUG_MAIN);
+
+    // La tarea principal también tiene su pila fija
+    memory_budget_register_task(xTaskGetCurrentTaskHandle(), CONFIG_ESP_MAIN_TASK_STACK_SIZE);
+}
+
+void memory_budget_register_task(TaskHandle_t handle, uint32_t stackSize) {
+    if (!handle) {
+        return;
+    }
+    portENTER_CRITICAL(&s_taskLock);
+    if (s_taskCount < MEMORY_BUDGET_MAX_TASKS) {
+        s_tasks[s_taskCount] = {handle, stackSize};
+        s_taskCount = s_taskCount + 1;
+    }
+    portEXIT_CRITICAL(&s_taskLock);
+}
+
+uint8_t memory_budget_get_tasks(memory_task_stats_t* stats, uint8_t max) {
+    const uint8_t count = s_taskCount < max ? s_taskCount : max;
+    for (uint8_t i = 0; i < count; ++i) {
+        stats[i].name = pcTaskGetName(s_tasks[i].handle);
+        stats[i].stackSize = s_tasks[i].stackSize;
+        stats[i].stackFreeMin = uxTaskGetStackHighWaterMark(s_tasks[i].handle);
+    }
+    return count;
+}
+
+memory_heap_stats_t memory_budget_get_heap(void) {
+    memory_heap_stats_t heap;
+    heap.freeHeap = esp_get_free_heap_size();
+    heap.minFreeHeap = esp_get_minimum_free_heap_size();
+    heap.largestFreeBlock = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    return heap;
+}
+
+void memory_budget_step(void) {
+    const int64_t now = esp_timer_get_time();
+    if (now < s_nextReportUs) {
+        return;
+    }
+    s_nextReportUs = now + MEMORY_REPORT_PERIOD_MS * 1000LL;
+
+    const memory_heap_stats_t heap = memory_budget_get_heap();
+    BI_DEBUG_INFO(g_MemoryLogger, "Heap: %lu free, %lu min, %lu largest block",
+                 heap.freeHeap, heap.minFreeHeap, heap.largestFreeBlock);
+
+    memory_task_stats_t tasks[MEMORY_BUDGET_MAX_TASKS];
+    const uint8_t count = memory_budget_get_tasks(tasks, MEMORY_BUDGET_MAX_TASKS);
+    for (uint8_t i = 0; i < count; ++i) {
+        if (tasks[i].stackFreeMin < MEMORY_STACK_WARN_BYTES) {
+            BI_DEBUG_WARNING(g_MemoryLogger, "Stack %s: %lu of %lu bytes free at worst",
+                           tasks[i].name, tasks[i].stackFreeMin, tasks[i].stackSize);
+        } else {
+            BI_DEBUG_INFO(g_MemoryLogger, "Stack %s: %lu of %lu bytes free at worst",
+                         tasks[i].name, tasks[i].stackFreeMin, tasks[i].stackSize);
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <cstdint>
+#include <cstddef>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/**
+ * @brief Uso de la pila de una tarea registrada
+ */
+typedef struct {
+    const char* name;
+    uint32_t stackSize;         // Bytes reservados
+    uint32_t stackFreeMin;      // Mínimo libre desde el arranque (high-water mark)
+} memory_task_stats_t;
+
+/**
+ * @brief Estado del heap
+ */
+typedef struct {
+    uint32_t freeHeap;
+    uint32_t minFreeHeap;       // Mínimo desde el arranque
+    uint32_t largestFreeBlock;  // Mayor reserva posible ahora (fragmentación)
+} memory_heap_stats_t;
+
+/**
+ * @brief Crea el logger y registra la tarea principal; se llama desde app_main
+ */
+void memory_budget_init(void);
+
+/**
+ * @brief Registra una tarea para el informe de pilas
+ * @param handle Tarea
+ * @param stackSize Bytes de pila reservados
+ */
+void memory_budget_register_task(TaskHandle_t handle, uint32_t stackSize);
+
+/**
+ * @brief Copia el uso de pila de las tareas registradas
+ * @param stats Destino
+ * @param max Capacidad de stats
+ * @return Número de tareas copiadas
+ */
+uint8_t memory_budget_get_tasks(memory_task_stats_t* stats, uint8_t max);
+
+/**
+ * @brief Estado actual del heap
+ */
+memory_heap_stats_t memory_budget_get_heap(void);
+
+/**
+ * @brief Escribe el informe de memoria en el log cada MEMORY_REPORT_PERIOD_MS
+ *
+ * Se llama desde el bucle de app_main; avisa de las pilas con menos de
+ * MEMORY_STACK_WARN_BYTES libres.
+ */
+void memory_budget_step(void);
+
+/**
+ * @brief Tarea con pila y TCB reservados estáticamente
+ *
+ * La memoria queda en .bss, así que una tarea no puede fallar al crearse por
+ * falta de heap y el heap que queda es el que necesitan TLS y el WiFi. Se
+ * declara como variable estática del módulo que la crea.
+ *
+ * @tparam StackSize Bytes de pila
+ */
+template <uint32_t StackSize>
+class StaticTask {
+public:
+    /**
+     * @brief Crea la tarea y la registra para el informe de pilas
+     * @return Manejador de la tarea
+     */
+    TaskHandle_t start(TaskFunction_t function, const char* name, void* param, UBaseType_t priority) {
+        // En ESP-IDF la profundidad de pila se da en bytes
+        m_handle = xTaskCreateStatic(function, name, sizeof(m_stack), param, priority, m_stack, &m_tcb);
+        memory_budget_register_task(m_handle, sizeof(m_stack));
+        return m_handle;
+    }
+
+    TaskHandle_t getHandle() const { return m_handle; }
+
+private:
+    StackType_t m_stack[StackSize / sizeof(StackType_t)];
+    StaticTask_t m_tcb;
+    TaskHandle_t m_handle = nullptr;
+};
+
+#endif // MEMORY_BUDGET_H
@@ -0,0 +1,384 @@
+// command_queue.cpp
+#include "command_queue.h"
+#include "firebase_controller.h"
+#include "json_writer.h"
+#include "../app_log.h"
+#include "cJSON.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "../custom_config.h"
+#include "../Battery/battery_controller.h"
+#include "../Diagnostics/memory_budget.h"
+#include "../Diagnostics/benchmark.h"
+#include "../Ota/ota_controller.h"
+#include "../Storage/history_log.h"
+#include <cstdio>
+#include <cstring>
+
+// Logger para las órdenes remotas
+static LoggerPtr g_CommandLogger;
+
+/**
+ * @brief Orden pendiente tal y como viaja por la cola
+ */
+typedef struct {
+    char id[COMMAND_ID_SIZE];          // Clave de la orden en /commands
+    char type[COMMAND_VALUE_SIZE];     // Tipo, para el mensaje de orden desconocida
+    char value[COMMAND_VALUE_SIZE];    // Valor si era una cadena, vacío en otro caso
+    int8_t handler;                    // Índice en COMMAND_ENTRIES, -1 si es desconocida
+    int64_t receivedAtMs;              // Epoch al recibirla el listener, 0 sin hora válida
+} command_t;
+
+/**
+ * @brief Orden ya ejecutada cuyo ack aún no ha llegado a Firebase
+ */
+typedef struct {
+    char id[COMMAND_ID_SIZE];
+    char result[COMMAND_RESULT_SIZE];
+    bool ok;
+    int64_t receivedAtMs;
+    int64_t completedAtMs;             // Epoch al terminar, 0 sin hora válida
+} command_ack_t;
+
+/**
+ * @brief Ejecuta una orden; no debe bloquear más allá de avisar a otra tarea
+ * @param value Valor de la orden
+ * @param result Destino del texto de resultado
+ * @param size Tamaño de result
+ * @return true si la orden se completó
+ */
+typedef bool (*command_handler_t)(const char* value, char* result, size_t size);
+
+typedef struct {
+    const char* type;
+    command_handler_t handler;
+} command_entry_t;
+
+// Reinicio pedido por una orden: se hace después de enviar los acks
+static bool s_restartPending = false;
+
+static bool handle_power(const char* value, char* result, size_t size) {
+    if (strcmp(value, "on") == 0) {
+        // Código para encender
+        BI_DEBUG_INFO(g_CommandLogger, "Command: Power ON");
+        snprintf(result, size, "System powered on successfully");
+        return true;
+    }
+    if (strcmp(value, "off") == 0) {
+        // Código para apagar
+        BI_DEBUG_INFO(g_CommandLogger, "Command: Power OFF");
+        snprintf(result, size, "System powered off successfully");
+        return true;
+    }
+    if (strcmp(value, "restart") == 0) {
+        BI_DEBUG_INFO(g_CommandLogger, "Command: Reboot system");
+        s_restartPending = true;
+        snprintf(result, size, "System rebooting...");
+        return true;
+    }
+    snprintf(result, size, "Invalid power value");
+    return false;
+}
+
+static bool handle_balancing(const char* value, char* result, size_t size) {
+    const bool start = strcmp(value, "start") == 0;
+    if (!start && strcmp(value, "stop") != 0) {
+        snprintf(result, size, "Invalid balancing value");
+        return false;
+    }
+
+    // Lo aplica la tarea de batería
+    BI_DEBUG_INFO(g_CommandLogger, "Command: %s balancing", start ? "Start" : "Stop");
+    if (!battery_controller_request_balancing(start)) {
+        snprintf(result, size, "Battery controller not running");
+        return false;
+    }
+    snprintf(result, size, start ? "Balancing started successfully" : "Balancing stopped successfully");
+    return true;
+}
+
+static bool handle_benchmark(const char* value, char* result, size_t size) {
+    if (strcmp(value, "run") != 0) {
+        snprintf(result, size, "Invalid benchmark value");
+        return false;
+    }
+
+    // Mide y publica en su propia tarea; el ack sale antes de los resultados
+    BI_DEBUG_INFO(g_CommandLogger, "Command: Run benchmark");
+    return benchmark_start(result, size);
+}
+
+static bool handle_ota(const char* value, char* result, size_t size) {
+    // La descarga va en su propia tarea; el ack sale antes del reinicio
+    BI_DEBUG_INFO(g_CommandLogger, "Command: OTA to %s", value);
+    return ota_controller_start(value, result, size);
+}
+
+// Todas las órdenes conocidas
+static const command_entry_t COMMAND_ENTRIES[] = {
+    {"power", handle_power},
+    {"balancing", handle_balancing},
+    {"benchmark", handle_benchmark},
+    {"ota", handle_ota},
+};
+static constexpr uint8_t COMMAND_ENTRY_COUNT = sizeof(COMMAND_ENTRIES) / sizeof(COMMAND_ENTRIES[0]);
+
+// Tabla hash de direccionamiento abierto: tipo -> índice en COMMAND_ENTRIES
+static constexpr uint8_t COMMAND_TABLE_SIZE = 8;   // Potencia de 2, al menos el doble de entradas
+static_assert(COMMAND_TABLE_SIZE >= 2 * COMMAND_ENTRY_COUNT, "Command table too small");
+static int8_t s_commandTable[COMMAND_TABLE_SIZE];
+
+static uint32_t fnv1a(const char* text) {
+    uint32_t hash = 2166136261u;
+    while (*text) {
+        hash ^= static_cast<uint8_t>(*text++);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void build_command_table() {
+    memset(s_commandTable, -1, sizeof(s_commandTable));
+    for (uint8_t i = 0; i < COMMAND_ENTRY_COUNT; ++i) {
+        uint32_t slot = fnv1a(COMMAND_ENTRIES[i].type) & (COMMAND_TABLE_SIZE - 1);
+        while (s_commandTable[slot] >= 0) {
+            slot = (slot + 1) & (COMMAND_TABLE_SIZE - 1);
+        }
+        s_commandTable[slot] = static_cast<int8_t>(i);
+    }
+}
+
+static int8_t find_command(const char* type) {
+    uint32_t slot = fnv1a(type) & (COMMAND_TABLE_SIZE - 1);
+    while (s_commandTable[slot] >= 0) {
+        if (strcmp(COMMAND_ENTRIES[s_commandTable[slot]].type, type) == 0) {
+            return s_commandTable[slot];
+        }
+        slot = (slot + 1) & (COMMAND_TABLE_SIZE - 1);
+    }
+    return -1;
+}
+
+// Cola de órdenes pendientes de ejecutar, con almacenamiento estático
+static QueueHandle_t s_commandQueue = NULL;
+static StaticQueue_t s_commandQueueBuffer;
+static uint8_t s_commandQueueStorage[COMMAND_QUEUE_LENGTH * sizeof(command_t)];
+static StaticTask<COMMAND_TASK_STACK_SIZE> s_commandTask;
+
+// Últimas órdenes encoladas, para no repetirlas mientras su ack no llega (la
+// tarea lo reintenta sin volver a ejecutarlas). Solo las toca el listener.
+static char s_recentIds[COMMAND_RECENT_IDS][COMMAND_ID_SIZE];
+static uint8_t s_recentNext = 0;
+
+static bool recently_queued(const char* id) {
+    for (uint8_t i = 0; i < COMMAND_RECENT_IDS; ++i) {
+        if (strcmp(s_recentIds[i], id) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Encola una orden si está pendiente; true si se encoló
+static bool enqueue_command(const char* id, const cJSON* command) {
+    if (!id || !cJSON_IsObject(command)) {
+        return false;
+    }
+
+    const cJSON* type = cJSON_GetObjectItem(command, "type");
+    const cJSON* value = cJSON_GetObjectItem(command, "value");
+    const cJSON* status = cJSON_GetObjectItem(command, "status");
+
+    // Solo procesar comandos pendientes
+    if (!cJSON_IsString(type) || !value || !cJSON_IsString(status) ||
+        strcmp(status->valuestring, "pending") != 0 || recently_queued(id)) {
+        return false;
+    }
+    if (strlen(id) >= COMMAND_ID_SIZE) {
+        BI_DEBUG_WARNING(g_CommandLogger, "Command ID too long, ignored: %s", id);
+        return false;
+    }
+
+    command_t entry = {};
+    strcpy(entry.id, id);
+    strncpy(entry.type, type->valuestring, sizeof(entry.type) - 1);
+    if (cJSON_IsString(value)) {
+        strncpy(entry.value, value->valuestring, sizeof(entry.value) - 1);
+    }
+    entry.handler = find_command(type->valuestring);
+    entry.receivedAtMs = history_epoch_ms();
+
+    if (xQueueSend(s_commandQueue, &entry, 0) != pdTRUE) {
+        // Sigue en "pending": se recogerá en el próximo evento completo
+        BI_DEBUG_WARNING(g_CommandLogger, "Command queue full, %s left pending", id);
+        return false;
+    }
+
+    strcpy(s_recentIds[s_recentNext], id);
+    s_recentNext = (s_recentNext + 1) % COMMAND_RECENT_IDS;
+    BI_DEBUG_INFO(g_CommandLogger, "Command %s queued: %s", id, entry.type);
+    return true;
+}
+
+int command_queue_handle_event(const char* json) {
+    if (!json || !s_commandQueue) {
+        return 0;
+    }
+
+    cJSON* root = cJSON_Parse(json);
+    if (!root) {
+        BI_DEBUG_ERROR(g_CommandLogger, "Error parsing commands JSON");
+        return 0;
+    }
+
+    // Evento de streaming {"path": ..., "data": ...}; cualquier otra cosa es /commands completo
+    const cJSON* data = root;
+    const char* path = "";
+    const cJSON* path_item = cJSON_GetObjectItem(root, "path");
+    const cJSON* data_item = cJSON_GetObjectItem(root, "data");
+    if (cJSON_IsString(path_item) && data_item && cJSON_GetArraySize(root) == 2) {
+        path = path_item->valuestring;
+        data = data_item;
+    }
+    while (*path == '/') {
+        path++;
+    }
+
+    int queued = 0;
+    if (*path == '\0') {
+        // Objeto de órdenes por ID
+        const cJSON* command = NULL;
+        cJSON_ArrayForEach(command, data) {
+            queued += enqueue_command(command->string, command) ? 1 : 0;
+        }
+    } else if (!strchr(path, '/')) {
+        // Una orden nueva o reemplazada: /<id>
+        queued += enqueue_command(path, data) ? 1 : 0;
+    }
+    // Cambios de un campo (/<id>/status, incluidos nuestros acks): nada que hacer
+
+    cJSON_Delete(root);
+    return queued;
+}
+
+// Fecha de un ack: la del dispositivo si la tiene, si no la del servidor al recibirlo
+static void add_ack_time(JsonWriter& writer, const char* key, int64_t epoch_ms) {
+    if (epoch_ms > 0) {
+        writer.addInt(key, epoch_ms);
+    } else {
+        writer.addServerTimestamp(key);
+    }
+}
+
+/**
+ * @brief Escribe los acks pendientes en un único PATCH multi-ruta
+ *
+ * Cada orden recibe status, receivedAt, completedAt y result con rutas
+ * "<id>/<campo>" para no sobrescribir type y value. Las fechas son las del
+ * dispositivo al recibir y al terminar la orden, así que no cambian aunque el
+ * ack se reintente.
+ */
+static bool send_acks(const command_ack_t* acks, size_t count) {
+    static char buffer[COMMAND_ACK_BUFFER_SIZE];
+    JsonWriter writer(buffer, sizeof(buffer));
+    char key[COMMAND_ID_SIZE + 16];
+
+    writer.beginObject();
+    for (size_t i = 0; i < count; ++i) {
+        snprintf(key, sizeof(key), "%s/status", acks[i].id);
+        writer.addString(key, acks[i].ok ? "completed" : "failed");
+        snprintf(key, sizeof(key), "%s/receivedAt", acks[i].id);
+        add_ack_time(writer, key, acks[i].receivedAtMs);
+        snprintf(key, sizeof(key), "%s/completedAt", acks[i].id);
+        add_ack_time(writer, key, acks[i].completedAtMs);
+        snprintf(key, sizeof(key), "%s/result", acks[i].id);
+        writer.addString(key, acks[i].result);
+    }
+    writer.endObject();
+
+    if (!writer.ok()) {
+        BI_DEBUG_ERROR(g_CommandLogger, "Acks for %d commands do not fit in the buffer", (int)count);
+        return false;
+    }
+    return update_device_json("commands", buffer, "ack de órdenes");
+}
+
+// Ejecuta las órdenes por lotes: todas las que haya en cola, un PATCH de acks
+// por lote. Si el ack falla las órdenes no se repiten: se reintenta solo el ack.
+static void command_task(void* pvParameters) {
+    static command_t batch[COMMAND_BATCH_MAX];
+    static command_ack_t acks[COMMAND_BATCH_MAX];
+    size_t ackCount = 0;    // Acks pendientes en acks[0..ackCount)
+
+    while (true) {
+        // Con acks pendientes se reintenta cada COMMAND_ACK_RETRY_MS, y no se
+        // aceptan más órdenes de las que caben en el próximo PATCH
+        const TickType_t wait = (ackCount > 0) ? pdMS_TO_TICKS(COMMAND_ACK_RETRY_MS) : portMAX_DELAY;
+        size_t count = 0;
+        if (ackCount < COMMAND_BATCH_MAX && xQueueReceive(s_commandQueue, &batch[0], wait) == pdTRUE) {
+            count = 1;
+            while (ackCount + count < COMMAND_BATCH_MAX && xQueueReceive(s_commandQueue, &batch[count], 0) == pdTRUE) {
+                count++;
+            }
+        } else if (ackCount >= COMMAND_BATCH_MAX) {
+            vTaskDelay(wait);
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            const command_t& command = batch[i];
+            command_ack_t& ack = acks[ackCount++];
+            strcpy(ack.id, command.id);
+            if (command.handler < 0) {
+                snprintf(ack.result, sizeof(ack.result), "Unknown command: %s", command.type);
+                ack.ok = false;
+            } else {
+                ack.ok = COMMAND_ENTRIES[command.handler].handler(command.value, ack.result, sizeof(ack.result));
+            }
+            ack.receivedAtMs = command.receivedAtMs;
+            ack.completedAtMs = history_epoch_ms();
+            BI_DEBUG_INFO(g_CommandLogger, "Command %s %s: %s", command.id, ack.ok ? "completed" : "failed", ack.result);
+        }
+
+        if (ackCount == 0) {
+            continue;
+        }
+        const bool acked = send_acks(acks, ackCount);
+        if (acked) {
+            BI_DEBUG_INFO(g_CommandLogger, "Acks sent for %d commands", (int)ackCount);
+            ackCount = 0;
+        } else {
+            BI_DEBUG_WARNING(g_CommandLogger, "Acks for %d commands not delivered, retrying in %dms",
+                           (int)ackCount, COMMAND_ACK_RETRY_MS);
+        }
+
+        if (s_restartPending && acked) {
+            // Sin ack la orden seguiría en "pending" y se repetiría tras reiniciar:
+            // el reinicio espera a que el ack llegue en un reintento
+            s_restartPending = false;
+            // Dar tiempo a que salgan los logs antes del reinicio
+            vTaskDelay(pdMS_TO_TICKS(1000));
+            esp_restart();
+        } else if (s_restartPending) {
+            BI_DEBUG_ERROR(g_CommandLogger, "Restart postponed: command ack not delivered");
+        }
+    }
+}
+
+void command_queue_init(void) {
+    g_CommandLogger = createLogger("COMMANDS", INFO, DEBUG_FIREBASE);
+
+    build_command_table();
+    benchmark_init();
+    memset(s_recentIds, 0, sizeof(s_recentIds));
+
+    s_commandQueue = xQueueCreateStatic(COMMAND_QUEUE_LENGTH, sizeof(command_t), s_commandQueueStorage,
+                                        &s_commandQueueBuffer);
+    if (!s_commandQueue) {
+        BI_DEBUG_ERROR(g_CommandLogger, "Failed to create command queue");
+        return;
+    }
+
+    s_commandTask.start(command_task, "command_task", NULL, COMMAND_TASK_PRIORITY);
+}
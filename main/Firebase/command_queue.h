@@ -0,0 +1,25 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+/**
+ * @brief Crea la cola de órdenes y la tarea que las ejecuta
+ *
+ * Debe llamarse antes de registrar el listener de /commands.
+ */
+void command_queue_init(void);
+
+/**
+ * @brief Encola las órdenes pendientes de un evento del listener de /commands
+ *
+ * Acepta el sobre de los eventos de streaming ({"path": "/<id>", "data": {...}})
+ * o el objeto /commands completo. Solo interpreta el JSON y encola: no hace
+ * peticiones, así que no bloquea el listener. Las órdenes ya encoladas
+ * recientemente se ignoran aunque sigan en "pending" hasta recibir su ack:
+ * si el ack falla, la tarea lo reintenta sin volver a ejecutar la orden.
+ *
+ * @param json Evento recibido, terminado en '\0'
+ * @return Número de órdenes encoladas
+ */
+int command_queue_handle_event(const char* json);
+
+#endif // COMMAND_QUEUE_H
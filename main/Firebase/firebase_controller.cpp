@@ -5,213 +5,249 @@
 
 #include "bi_firebase.h"
 #include "bi_params.hpp"
-#include "bi_debug.h"
+#include "../app_log.h"
 #include "secrets.h"
 #include "firebase_controller.h"
+#include "json_writer.h"
+#include "remote_config.h"
+#include "command_queue.h"
+#include "../Params/params_cache.h"
+#include "../WiFi/wifi_power.h"
+#include "../WiFi/backoff.h"
+#include "../Boot/boot_profile.h"
+#include "../Diagnostics/memory_budget.h"
+#include "../Diagnostics/latency_probe.h"
 #include "../custom_config.h"
+#include "../app_config.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "mbedtls/base64.h"
 #include "math.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
 extern BIParams biParams;
-static std::string device_path = "/batteries/";
+
+// Rutas del dispositivo, construidas una vez tras autenticarse
+static char s_devicePath[FIREBASE_PATH_SIZE] = "/batteries/";
+static char s_historyPath[FIREBASE_PATH_SIZE] = "";
+static char s_lastUpdatePath[FIREBASE_PATH_SIZE] = "";
+static char s_configPath[FIREBASE_PATH_SIZE] = "";
+static char s_commandsPath[FIREBASE_PATH_SIZE] = "";
 
 LoggerPtr g_FirebaseLogger;
 
 // Manejador para Firebase
 firebase_handle_t *firebase_handle = NULL;
 
-static void procesarComando(const char* tipo, cJSON* valor, const char* comando_id);
-static bool update_command_status(const char* comando_id, const char* status, const char* result = nullptr);
-static cJSON* create_firebase_server_timestamp();
+
+// Precisión fija de la telemetría (decimales)
+static constexpr uint8_t CELL_VOLTAGE_DECIMALS = 3;
+static constexpr uint8_t TEMPERATURE_DECIMALS  = 1;
+static constexpr uint8_t PACK_VOLTAGE_DECIMALS = 3;
+static constexpr uint8_t CURRENT_DECIMALS      = 3;
+static constexpr uint8_t POWER_DECIMALS        = 2;
+
+// Buffer único para los documentos de telemetría. Solo se usa desde la tarea
+// de subida, así que no necesita protección y el heap no interviene.
+static char s_telemetryBuffer[HISTORY_BATCH_BUFFER_SIZE];
+
+/**
+ * @brief Últimos valores de una celda confirmados por Firebase, ya cuantizados
+ */
+typedef struct {
+    int32_t voltage_mv;
+    int32_t temperature_dc;     // Décimas de °C
+    uint8_t soc;
+    uint8_t soh;
+} cell_shadow_t;
+
+/**
+ * @brief Sombra de las celdas de un pack y estado de su resincronización
+ */
+typedef struct {
+    cell_shadow_t cells[MAX_CELL_COUNT];     // Lo que hay en /cells según el dispositivo
+    cell_shadow_t pending[MAX_CELL_COUNT];   // Lo que se está enviando en la petición actual
+    uint8_t count;                           // Celdas válidas en la sombra (0 = sin sombra)
+    bool multiPack;                          // La sombra es de /packs/<n>/cells y no de /cells
+    uint32_t samplesSinceResync;             // Envíos parciales desde el último completo
+    uint32_t session;                        // s_shadowSession en que se hizo el último envío completo
+    balance_state_t lastBalanceState;        // Último estado de balanceo enviado
+} pack_shadow_t;
+
+static pack_shadow_t s_packShadows[PACK_MAX_COUNT];
+
+// Se incrementa al reconectar: las sombras de una sesión anterior fuerzan un envío completo
+static volatile uint32_t s_shadowSession = 1;
+
+// Estadísticas de conexión con la base de datos
+static firebase_connection_stats_t s_connStats = {};
+static int64_t s_requestStartUs = 0;   // Inicio de la petición en curso (0 = ninguna)
+
+// Serializa el uso del manejador: piden datos la subida, las órdenes y la OTA,
+// y firebase_task lo reabre y lo libera. Recursivo porque las peticiones
+// comprueban la conectividad, que puede renovar el token.
+static StaticSemaphore_t s_handleMutexBuffer;
+static SemaphoreHandle_t s_handleMutex = NULL;
+
+static inline void handle_lock() {
+    xSemaphoreTakeRecursive(s_handleMutex, portMAX_DELAY);
+}
+
+static inline void handle_unlock() {
+    xSemaphoreGiveRecursive(s_handleMutex);
+}
+
+// Máquina de estados de la sesión; el estado solo lo cambia firebase_task
+static TaskHandle_t s_firebaseTaskHandle = NULL;
+static StaticTask<FIREBASE_TASK_STACK_SIZE> s_firebaseTask;
+static firebase_link_stats_t s_linkStats = {};
+static Backoff s_sessionBackoff(FIREBASE_BACKOFF_BASE_MS, FIREBASE_BACKOFF_MAX_MS);
+static volatile int64_t s_linkUpUs = 0;          // Instante en que volvió el WiFi
+static volatile bool s_awaitFirstUpload = false;
+
+// Sesión conservada entre caídas del enlace para no repetir la autenticación
+// con contraseña (solo en RAM: tras reiniciar se autentica de nuevo)
+static char s_refreshToken[FIREBASE_REFRESH_TOKEN_SIZE] = "";
+static char s_uid[FIREBASE_UID_SIZE] = "";
+
+// Bits de notificación de firebase_task
+enum {
+    FIREBASE_EVENT_LINK_UP   = 1 << 0,
+    FIREBASE_EVENT_LINK_DOWN = 1 << 1,
+};
+
+/**
+ * @brief Manejador de eventos HTTP para contar conexiones nuevas
+ *
+ * HTTP_EVENT_ON_CONNECTED solo se genera cuando el cliente abre una conexión
+ * (TCP + handshake TLS); las peticiones que reutilizan una conexión viva no lo
+ * disparan. El tiempo hasta el evento desde el inicio de la petición es el
+ * coste del establecimiento de la conexión.
+ */
+static esp_err_t firebase_http_event_handler(esp_http_client_event_t *evt) {
+    if (evt->event_id == HTTP_EVENT_ON_CONNECTED) {
+        s_connStats.connections++;
+        const int64_t start = s_requestStartUs;
+        if (start != 0) {
+            const int64_t connectUs = esp_timer_get_time() - start;
+            LATENCY_RECORD(LATENCY_STAGE_TLS_CONNECT, connectUs);
+            s_connStats.lastConnectMs = (uint32_t)(connectUs / 1000);
+            s_connStats.connectMsTotal += s_connStats.lastConnectMs;
+            s_connStats.timedConnections++;
+        }
+    }
+    return ESP_OK;
+}
+
+static inline void request_begin() {
+    s_requestStartUs = esp_timer_get_time();
+}
+
+static inline void request_end(bool ok) {
+    const int64_t now = esp_timer_get_time();
+    s_connStats.requests++;
+    s_connStats.requestMsTotal += (uint32_t)((now - s_requestStartUs) / 1000);
+    s_requestStartUs = 0;
+    
+    if (ok) {
+        boot_profile_mark(BOOT_PHASE_FIRST_UPLOAD);
+    }
+    
+    // Primera escritura tras volver el enlace
+    if (ok && s_awaitFirstUpload) {
+        s_awaitFirstUpload = false;
+        s_linkStats.lastFirstUploadMs = (uint32_t)((now - s_linkUpUs) / 1000);
+        BI_DEBUG_INFO(g_FirebaseLogger, "First upload %lums after link up", s_linkStats.lastFirstUploadMs);
+    }
+}
+
+// Envoltorios de las peticiones para medir su duración y las conexiones que abren.
+// Toman el manejador durante la petición: así el inicio de la petición y las
+// estadísticas solo los toca una tarea a la vez.
+static bool timed_update(const char* path, firebase_data_value_t* value) {
+    LATENCY_PROBE(LATENCY_STAGE_FIREBASE_UPDATE);
+    handle_lock();
+    bool result = false;
+    if (firebase_handle) {
+        request_begin();
+        result = firebase_update(firebase_handle, path, value);
+        request_end(result);
+    }
+    handle_unlock();
+    return result;
+}
+
+static bool timed_set(const char* path, firebase_data_value_t* value) {
+    LATENCY_PROBE(LATENCY_STAGE_FIREBASE_UPDATE);
+    handle_lock();
+    bool result = false;
+    if (firebase_handle) {
+        request_begin();
+        result = firebase_set(firebase_handle, path, value);
+        request_end(result);
+    }
+    handle_unlock();
+    return result;
+}
+
+static bool timed_push(const char* path, firebase_data_value_t* value, char* key, size_t key_size) {
+    LATENCY_PROBE(LATENCY_STAGE_FIREBASE_PUSH);
+    handle_lock();
+    bool result = false;
+    if (firebase_handle) {
+        request_begin();
+        result = firebase_push(firebase_handle, path, value, key, key_size);
+        request_end(result);
+    }
+    handle_unlock();
+    return result;
+}
+
+const firebase_connection_stats_t* firebase_get_connection_stats(void) {
+    return &s_connStats;
+}
+
+const firebase_link_stats_t* firebase_get_link_stats(void) {
+    return &s_linkStats;
+}
+
+static const char* link_state_to_string(link_state_t state) {
+    switch (state) {
+        case LINK_STATE_OFFLINE:    return "offline";
+        case LINK_STATE_CONNECTING: return "connecting";
+        case LINK_STATE_BACKOFF:    return "backoff";
+        case LINK_STATE_ONLINE:     return "online";
+        default:                    return "unknown";
+    }
+}
 
 void firebase_listen_callback(void *data, int event_id, firebase_data_value_t *value) {
-    BI_DEBUG_INFO(g_FirebaseLogger, "Firebase listener event received: %d, data: %i", event_id, (uint32_t)(data));
+    LATENCY_PROBE(LATENCY_STAGE_LISTENER);
+    BI_DEBUG_INFO(g_FirebaseLogger, "Firebase listener event received: %d, data: %i", event_id, static_cast<int>(reinterpret_cast<uintptr_t>(data)));
     
-    DeviceParams& params = biParams.getParams();
     DeviceState& state = biParams.getState();
-    bool config_changed = false;
 
     // Actualizar configuración del dispositivo desde Firebase
-    switch (uint32_t(data)) {
+    switch (static_cast<uint32_t>(reinterpret_cast<uintptr_t>(data))) {
         case RTDB_CONFIG_CHANGED: 
         {
+            // Solo se aplican los campos presentes en el evento (ver remote_config.h)
             if (value && value->type == FIREBASE_DATA_TYPE_JSON && value->data.string_val) {
-                cJSON *json = cJSON_Parse(value->data.string_val);
-                if (json) {
-                    // Actualizar nombre del dispositivo
-                    cJSON *name = cJSON_GetObjectItem(json, "name");
-                    if (name && cJSON_IsString(name)) {
-                        strncpy(params.deviceName, name->valuestring, sizeof(params.deviceName) - 1);
-                        params.deviceName[sizeof(params.deviceName) - 1] = '\0';
-                        config_changed = true;
-                        BI_DEBUG_INFO(g_FirebaseLogger, "Device name updated: %s", params.deviceName);
-                    }
-                    
-                    // Actualizar modelo del dispositivo
-                    cJSON *model = cJSON_GetObjectItem(json, "model");
-                    if (model && cJSON_IsString(model)) {
-                        strncpy(params.deviceModel, model->valuestring, sizeof(params.deviceModel) - 1);
-                        params.deviceModel[sizeof(params.deviceModel) - 1] = '\0';
-                        config_changed = true;
-                        BI_DEBUG_INFO(g_FirebaseLogger, "Device model updated: %s", params.deviceModel);
-                    }
-                    
-                    // Actualizar número de celdas desde configuración
-                    cJSON *cellCount = cJSON_GetObjectItem(json, "cellCount");
-                    if (cellCount && cJSON_IsNumber(cellCount)) {
-                        uint8_t newCellCount = (uint8_t)cellCount->valueint;
-                        if (biParams.setCellCount(newCellCount)) {
-                            config_changed = true;
-                            BI_DEBUG_INFO(g_FirebaseLogger, "Cell count configuration updated: %d", newCellCount);
-                        } else {
-                            BI_DEBUG_WARNING(g_FirebaseLogger, "Invalid cell count in configuration: %d (valid range: %d-%d)", 
-                                           newCellCount, MIN_CELL_COUNT, MAX_CELL_COUNT);
-                        }
-                    }
-                    
-                    // Actualizar intervalo de muestreo (reporting.interval)
-                    cJSON *reporting = cJSON_GetObjectItem(json, "reporting");
-                    if (reporting && cJSON_IsObject(reporting)) {
-                        cJSON *interval = cJSON_GetObjectItem(reporting, "interval");
-                        if (interval && cJSON_IsNumber(interval)) {
-                            // Convertir de ms a segundos
-                            params.sampleInterval = interval->valueint / 1000;
-                            if (params.sampleInterval < 1) params.sampleInterval = 1; // Mínimo 1 segundo
-                            config_changed = true;
-                            BI_DEBUG_INFO(g_FirebaseLogger, "Sample interval updated: %d seconds", params.sampleInterval);
-                        }
-                    }
-                    
-                    // Actualizar configuración de power
-                    cJSON *power = cJSON_GetObjectItem(json, "power");
-                    if (power && cJSON_IsObject(power)) {
-                        cJSON *autoShutdown = cJSON_GetObjectItem(power, "autoShutdown");
-                        if (autoShutdown && cJSON_IsBool(autoShutdown)) {
-                            params.deepSleepEnabled = cJSON_IsTrue(autoShutdown);
-                            config_changed = true;
-                            BI_DEBUG_INFO(g_FirebaseLogger, "Auto shutdown %s", params.deepSleepEnabled ? "enabled" : "disabled");
-                        }
-                        
-                        cJSON *shutdownVoltage = cJSON_GetObjectItem(power, "shutdownVoltage");
-                        if (shutdownVoltage && cJSON_IsNumber(shutdownVoltage)) {
-                            params.shutdownVoltage = (float)shutdownVoltage->valuedouble;
-                            config_changed = true;
-                            BI_DEBUG_INFO(g_FirebaseLogger, "Shutdown voltage updated: %.2fV", params.shutdownVoltage);
-                        }
-                        
-                        cJSON *maxCurrent = cJSON_GetObjectItem(power, "maxCurrent");
-                        if (maxCurrent && cJSON_IsNumber(maxCurrent)) {
-                            params.maxCurrent = (float)maxCurrent->valuedouble;
-                            config_changed = true;
-                            BI_DEBUG_INFO(g_FirebaseLogger, "Max current updated: %.2fA", params.maxCurrent);
-                        }
-                    }
-                    
-                    // Actualizar configuración de alertas
-                    cJSON *alerts = cJSON_GetObjectItem(json, "alerts");
-                    if (alerts && cJSON_IsObject(alerts)) {
-                        cJSON *highTemp = cJSON_GetObjectItem(alerts, "highTemp");
-                        if (highTemp && cJSON_IsNumber(highTemp)) {
-                            params.alertHighTemp = (float)highTemp->valuedouble;
-                            config_changed = true;
-                            BI_DEBUG_INFO(g_FirebaseLogger, "High temp alert: %.1f°C", params.alertHighTemp);
-                        }
-                        
-                        cJSON *lowTemp = cJSON_GetObjectItem(alerts, "lowTemp");
-                        if (lowTemp && cJSON_IsNumber(lowTemp)) {
-                            params.alertLowTemp = (float)lowTemp->valuedouble;
-                            config_changed = true;
-                            BI_DEBUG_INFO(g_FirebaseLogger, "Low temp alert: %.1f°C", params.alertLowTemp);
-                        }
-                        
-                        cJSON *highVoltage = cJSON_GetObjectItem(alerts, "highVoltage");
-                        if (highVoltage && cJSON_IsNumber(highVoltage)) {
-                            params.alertHighVoltage = (float)highVoltage->valuedouble;
-                            config_changed = true;
-                            BI_DEBUG_INFO(g_FirebaseLogger, "High voltage alert: %.2fV", params.alertHighVoltage);
-                        }
-                        
-                        cJSON *lowVoltage = cJSON_GetObjectItem(alerts, "lowVoltage");
-                        if (lowVoltage && cJSON_IsNumber(lowVoltage)) {
-                            params.alertLowVoltage = (float)lowVoltage->valuedouble;
-                            config_changed = true;
-                            BI_DEBUG_INFO(g_FirebaseLogger, "Low voltage alert: %.2fV", params.alertLowVoltage);
-                        }
-                    }
-                    
-                    // Actualizar configuración de balanceo
-                    cJSON *balancing = cJSON_GetObjectItem(json, "balancing");
-                    if (balancing && cJSON_IsObject(balancing)) {
-                        cJSON *enabled = cJSON_GetObjectItem(balancing, "enabled");
-                        if (enabled && cJSON_IsBool(enabled)) {
-                            params.balancingEnabled = cJSON_IsTrue(enabled);
-                            config_changed = true;
-                            BI_DEBUG_INFO(g_FirebaseLogger, "Balancing %s", params.balancingEnabled ? "enabled" : "disabled");
-                        }
-                        
-                        cJSON *threshold = cJSON_GetObjectItem(balancing, "threshold");
-                        if (threshold && cJSON_IsNumber(threshold)) {
-                            params.balancingThreshold = (float)threshold->valuedouble;
-                            config_changed = true;
-                            BI_DEBUG_INFO(g_FirebaseLogger, "Balancing threshold: %.3fV", params.balancingThreshold);
-                        }
-                    }
-                    
-                    // Guardar cambios si hubo alguno
-                    if (config_changed) {
-                        biParams.saveParams();
-                        BI_DEBUG_INFO(g_FirebaseLogger, "Configuration saved to NVS");
-                        
-                        // Log especial si cambió el número de celdas
-                        cJSON *cellCountCheck = cJSON_GetObjectItem(json, "cellCount");
-                        if (cellCountCheck && cJSON_IsNumber(cellCountCheck)) {
-                            BI_DEBUG_INFO(g_FirebaseLogger, "Battery pack will be reconfigured to %d cells on next cycle", 
-                                         params.cellCount);
-                        }
-                    }
-                    
-                    cJSON_Delete(json);
-                } else {
-                    BI_DEBUG_ERROR(g_FirebaseLogger, "Error parsing configuration JSON");
-                }
+                remote_config_handle_event(value->data.string_val);
             }
             break;
         }
         case RTDB_COMMAND_CHANGED:
         {
+            // Solo se encolan: las ejecuta command_task, con un ack por lote
             if (value && value->type == FIREBASE_DATA_TYPE_JSON && value->data.string_val) {
-                cJSON *json = cJSON_Parse(value->data.string_val);
-                if (json) {
-                    // Iterar sobre todos los comandos en el objeto
-                    cJSON *comando = NULL;
-                    cJSON_ArrayForEach(comando, json) {
-                        if (cJSON_IsObject(comando)) {
-                            cJSON *type = cJSON_GetObjectItem(comando, "type");
-                            cJSON *cmd_value = cJSON_GetObjectItem(comando, "value");
-                            cJSON *status = cJSON_GetObjectItem(comando, "status");
-                            
-                            // Solo procesar comandos pendientes
-                            if (type && cmd_value && status && 
-                                cJSON_IsString(type) && 
-                                cJSON_IsString(status) && 
-                                strcmp(status->valuestring, "pending") == 0) {
-                                
-                                // Obtener el ID del comando (clave del objeto)
-                                const char* comando_id = comando->string;
-                                if (comando_id) {
-                                    BI_DEBUG_INFO(g_FirebaseLogger, "Processing command ID: %s", comando_id);
-                                    
-                                    // Marcar como recibido inmediatamente
-                                    update_command_status(comando_id, "received");
-                                    
-                                    // Procesar el comando
-                                    procesarComando(type->valuestring, cmd_value, comando_id);
-                                }
-                            }
-                        }
-                    }
-                    
-                    cJSON_Delete(json);
-                }
+                command_queue_handle_event(value->data.string_val);
             }
             break;
         }
@@ -220,147 +256,49 @@ void firebase_listen_callback(void *data, int event_id, firebase_data_value_t *v
     }
 }
 
-// Función auxiliar para procesar comandos - ACTUALIZADA
-static void procesarComando(const char* tipo, cJSON* valor, const char* comando_id) {
-    if (!tipo || !valor || !comando_id) return;
-    
-    BI_DEBUG_INFO(g_FirebaseLogger, "Processing command: %s (ID: %s)", tipo, comando_id);
-    
-    bool comando_exitoso = false;
-    char resultado[128] = {0};
-    
-    if (strcmp(tipo, "power") == 0 && cJSON_IsString(valor)) {
-        if (strcmp(valor->valuestring, "on") == 0) {
-            // Código para encender
-            BI_DEBUG_INFO(g_FirebaseLogger, "Command: Power ON");
-            comando_exitoso = true;
-            strcpy(resultado, "System powered on successfully");
-        } else if (strcmp(valor->valuestring, "off") == 0) {
-            // Código para apagar
-            BI_DEBUG_INFO(g_FirebaseLogger, "Command: Power OFF");
-            comando_exitoso = true;
-            strcpy(resultado, "System powered off successfully");
-        } else if (strcmp(valor->valuestring, "restart") == 0) {
-            BI_DEBUG_INFO(g_FirebaseLogger, "Command: Reboot system");
-            update_command_status(comando_id, "completed", "System rebooting...");
-            
-            // Esperar un poco para que se envíe la respuesta antes del reinicio
-            vTaskDelay(pdMS_TO_TICKS(1000));
-            esp_restart(); 
-        } else {
-            strcpy(resultado, "Invalid power value");
-        }
-    } 
-    else if (strcmp(tipo, "balancing") == 0 && cJSON_IsString(valor)) {
-        if (strcmp(valor->valuestring, "start") == 0) {
-            // Iniciar balanceo
-            BI_DEBUG_INFO(g_FirebaseLogger, "Command: Start balancing");
-            comando_exitoso = true;
-            strcpy(resultado, "Balancing started successfully");
-        } else if (strcmp(valor->valuestring, "stop") == 0) {
-            // Detener balanceo
-            BI_DEBUG_INFO(g_FirebaseLogger, "Command: Stop balancing");
-            comando_exitoso = true;
-            strcpy(resultado, "Balancing stopped successfully");
-        } else {
-            strcpy(resultado, "Invalid balancing value");
-        }
-    }
-    else {
-        snprintf(resultado, sizeof(resultado), "Unknown command: %s", tipo);
-    }
-    
-    // Actualizar estado del comando
-    const char* estado_final = comando_exitoso ? "completed" : "failed";
-    update_command_status(comando_id, estado_final, resultado);
+/**
+ * @brief Prepara un valor Firebase JSON que apunta a un buffer propio
+ *
+ * A diferencia de firebase_set_json() no duplica la cadena en el heap: el valor
+ * solo toma prestado el buffer, que debe seguir vivo durante la petición, y no
+ * debe pasarse a firebase_free_value().
+ *
+ * @param value Valor a preparar
+ * @param json Documento JSON terminado en '\0'
+ */
+static void wrap_json_value(firebase_data_value_t* value, char* json) {
+    memset(value, 0, sizeof(*value));
+    value->type = FIREBASE_DATA_TYPE_JSON;
+    value->data.string_val = json;
 }
 
-// Función para actualizar el estado de un comando en Firebase
-static bool update_command_status(const char* comando_id, const char* status, const char* result) {
-    if (!comando_id || !status) {
+// Copia una cadena del manejador a un buffer propio; false si no cabe
+template <size_t N>
+static bool save_session_string(char (&dest)[N], const char* src) {
+    if (!src || strlen(src) >= N) {
+        dest[0] = '\0';
         return false;
     }
-    
-    // Verificar conectividad
-    if (!check_firebase_connectivity()) {
-        return false;
-    }
-    
-    // Crear objeto JSON para la actualización
-    cJSON *update_json = cJSON_CreateObject();
-    if (!update_json) {
-        return false;
-    }
-    
-    cJSON_AddStringToObject(update_json, "status", status);
-    
-    // Usar Firebase Server Timestamp
-    if (strcmp(status, "received") == 0) {
-        cJSON *timestamp = create_firebase_server_timestamp();
-        if (timestamp) {
-            cJSON_AddItemToObject(update_json, "receivedAt", timestamp);
-        }
-    } else if (strcmp(status, "completed") == 0 || strcmp(status, "failed") == 0) {
-        cJSON *timestamp = create_firebase_server_timestamp();
-        if (timestamp) {
-            cJSON_AddItemToObject(update_json, "completedAt", timestamp);
-        }
-        if (result) {
-            cJSON_AddStringToObject(update_json, "result", result);
-        }
-    }
-    
-    // Convertir a string
-    char *json_string = cJSON_PrintUnformatted(update_json);
-    cJSON_Delete(update_json);
-    
-    if (!json_string) {
-        return false;
-    }
-    
-    // Crear valor Firebase
-    firebase_data_value_t value;
-    bool success = false;
-    
-    if (firebase_set_json(&value, json_string)) {
-        // Construir la ruta del comando específico
-        std::string command_path = device_path + "/commands/" + comando_id;
-        
-        // Actualizar en Firebase
-        if (firebase_update(firebase_handle, command_path.c_str(), &value)) {
-            BI_DEBUG_INFO(g_FirebaseLogger, "Estado del comando %s actualizado a: %s", comando_id, status);
-            success = true;
-        } else {
-            BI_DEBUG_ERROR(g_FirebaseLogger, "Error al actualizar estado del comando %s", comando_id);
-        }
-        
-        firebase_free_value(&value);
-    }
-    
-    free(json_string);
-    return success;
+    strcpy(dest, src);
+    return true;
 }
 
-// Función para crear timestamp de servidor Firebase
-static cJSON* create_firebase_server_timestamp() {
-    cJSON *timestamp_obj = cJSON_CreateObject();
-    if (timestamp_obj) {
-        cJSON *sv = cJSON_CreateString("timestamp");
-        if (sv) {
-            cJSON_AddItemToObject(timestamp_obj, ".sv", sv);
-        } else {
-            cJSON_Delete(timestamp_obj);
-            timestamp_obj = NULL;
-        }
+// Construye las rutas fijas del dispositivo a partir del UID; false si no caben
+static bool build_device_paths(const char* uid) {
+    // La subruta más larga es la de los históricos de un pack
+    if (!uid || strlen("/batteries/") + strlen(uid) + strlen("/packs/00/history") >= FIREBASE_PATH_SIZE) {
+        return false;
     }
-    return timestamp_obj;
+    snprintf(s_devicePath, sizeof(s_devicePath), "/batteries/%s", uid);
+    snprintf(s_historyPath, sizeof(s_historyPath), "/batteries/%s/history", uid);
+    snprintf(s_lastUpdatePath, sizeof(s_lastUpdatePath), "/batteries/%s/lastUpdate", uid);
+    snprintf(s_configPath, sizeof(s_configPath), "/batteries/%s/config", uid);
+    snprintf(s_commandsPath, sizeof(s_commandsPath), "/batteries/%s/commands", uid);
+    return true;
 }
 
-// Inicializar Firebase y autenticarse
+// Inicializar Firebase y autenticarse, reanudando la sesión anterior si la hay
 bool init_firebase(void) {
-    // Inicializar el logger
-    g_FirebaseLogger = createLogger("FIREBASE_CONTROLLER", INFO, true);
-
     // Configurar Firebase
     firebase_config_t config = {.database_url      = FIREBASE_DATABASE_URL,
                                 .auth              = {.auth_type     = FIREBASE_AUTH_API_KEY,
@@ -382,29 +320,85 @@ bool init_firebase(void) {
     config.http_config.timeout_ms     = 30000;
     config.http_config.transport_type = HTTP_TRANSPORT_OVER_TCP;
     config.http_config.buffer_size     = 4096;
+    
+    // Mantener viva la conexión entre peticiones para no repetir el handshake TLS
+    config.http_config.keep_alive_enable   = true;
+    config.http_config.keep_alive_idle     = FIREBASE_KEEP_ALIVE_IDLE_S;
+    config.http_config.keep_alive_interval = FIREBASE_KEEP_ALIVE_INTERVAL_S;
+    config.http_config.keep_alive_count    = FIREBASE_KEEP_ALIVE_COUNT;
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    // Si hay que reconectar, reanudar la sesión TLS con el ticket guardado
+    config.http_config.save_client_session = true;
+#endif
+    config.http_config.event_handler  = firebase_http_event_handler;
 
-    // Inicializar Firebase
+    // Inicializar Firebase (incluye el primer handshake con el servidor de autenticación)
+    const int64_t init_start = esp_timer_get_time();
     firebase_handle = firebase_init(&config);
     if (!firebase_handle) {
         BI_DEBUG_ERROR(g_FirebaseLogger, "Error al inicializar Firebase");
         return false;
     }
 
-    // Autenticarse con Firebase
-    if (!firebase_auth_with_password(firebase_handle, FIREBASE_EMAIL, FIREBASE_PASSWORD)) {
-        BI_DEBUG_ERROR(g_FirebaseLogger, "Error al autenticarse con Firebase");
-        return false;
+    // Reanudar con el refresh token de la sesión anterior: una petición al
+    // servicio de tokens en lugar del inicio de sesión con contraseña
+    bool resumed = false;
+    if (s_refreshToken[0] != '\0' && s_uid[0] != '\0') {
+        // bi_firebase no tiene una función para restaurar credenciales: se
+        // escriben en el manejador, que es dueño de estas cadenas (las reserva
+        // con malloc, las sustituye al renovar y las libera en firebase_deinit()).
+        // Por eso se liberan las que pudiera tener y se le dan copias en el heap.
+        free(firebase_handle->auth.refresh_token);
+        free(firebase_handle->auth.uid);
+        firebase_handle->auth.refresh_token = strdup(s_refreshToken);
+        firebase_handle->auth.uid = strdup(s_uid);
+        resumed = firebase_handle->auth.refresh_token && firebase_handle->auth.uid &&
+                  firebase_refresh_token(firebase_handle);
+        if (!resumed) {
+            BI_DEBUG_WARNING(g_FirebaseLogger, "No se pudo reanudar la sesión, autenticando con contraseña");
+        }
     }
 
-    // Si lo conseguimos, actualizar el UID de la bateria
-    DeviceParams& params = biParams.getParams();
-    strncpy(params.deviceKey, firebase_handle->auth.uid, strlen(firebase_handle->auth.uid));
-    biParams.saveParams();
+    if (resumed) {
+        s_linkStats.resumedSessions++;
+    } else {
+        // Autenticarse con Firebase
+        if (!firebase_auth_with_password(firebase_handle, FIREBASE_EMAIL, FIREBASE_PASSWORD)) {
+            BI_DEBUG_ERROR(g_FirebaseLogger, "Error al autenticarse con Firebase");
+            return false;
+        }
+
+        // Si lo conseguimos, actualizar el UID de la bateria; con el mismo UID
+        // de siempre no hace falta escribir en NVS
+        DeviceParams& params = biParams.getParams();
+        const char* uid = firebase_handle->auth.uid;
+        if (uid && strncmp(params.deviceKey, uid, sizeof(params.deviceKey)) != 0) {
+            strncpy(params.deviceKey, uid, sizeof(params.deviceKey) - 1);
+            params.deviceKey[sizeof(params.deviceKey) - 1] = '\0';
+            biParams.saveParams();
+            BI_DEBUG_INFO(g_FirebaseLogger, "UID del dispositivo actualizado: %s", params.deviceKey);
+        }
+        s_connStats.sessions++;
+    }
+    
+    // Guardar la sesión para la próxima reconexión
+    if (!save_session_string(s_refreshToken, firebase_handle->auth.refresh_token) ||
+        !save_session_string(s_uid, firebase_handle->auth.uid)) {
+        BI_DEBUG_WARNING(g_FirebaseLogger, "Sesión no guardada: la próxima reconexión usará contraseña");
+    }
 
     // Actualizar las rutas del sistema apuntando al uid
-    device_path = "/batteries/" + std::string(firebase_handle->auth.uid);
+    if (!build_device_paths(firebase_handle->auth.uid)) {
+        BI_DEBUG_ERROR(g_FirebaseLogger, "UID demasiado largo para las rutas del dispositivo");
+        return false;
+    }
+    
+    // Tras reconectar no se sabe qué hay en /cells: el próximo envío de cada pack será completo
+    s_shadowSession = s_shadowSession + 1;
 
-    BI_DEBUG_INFO(g_FirebaseLogger, "Firebase inicializado y autenticado correctamente");
+    BI_DEBUG_INFO(g_FirebaseLogger, "Firebase inicializado y autenticado correctamente (%s, %lu ms, %lu conexiones)",
+                 resumed ? "sesión reanudada" : "contraseña",
+                 (uint32_t)((esp_timer_get_time() - init_start) / 1000), s_connStats.connections);
     return true;
 }
 
@@ -419,22 +413,389 @@ bool check_firebase_connectivity() {
         return false;
     }
     
-    if (!state.firebaseConnected || !firebase_handle) {
+    if (!state.firebaseConnected || !s_handleMutex) {
         return false;
     }
     
     // Verificar que la autenticación sigue activa
-    if (!firebase_is_authenticated(firebase_handle)) {
+    handle_lock();
+    bool connected = firebase_handle != NULL;
+    if (connected && !firebase_is_authenticated(firebase_handle)) {
         
         // Intentar refrescar el token
         if (!firebase_refresh_token(firebase_handle)) {
             state.firebaseConnected = false;
-            biParams.saveState();
+            params_cache_mark_state_dirty();
+            connected = false;
+        }
+    }
+    handle_unlock();
+    
+    return connected;
+}
+
+/**
+ * @brief Envía un PATCH con hasta 3 intentos separados 1 segundo
+ * @param path Ruta de destino
+ * @param value Valor a enviar
+ * @param description Descripción para los logs
+ * @return true si la actualización fue exitosa
+ */
+static bool update_with_retries(const char* path, firebase_data_value_t* value, const char* description) {
+    int retry_count = 0;
+    const int max_retries = 3;
+    
+    while (retry_count < max_retries) {
+        // Verificar conectividad antes de cada intento
+        if (!check_firebase_connectivity()) {
             return false;
         }
+        
+        if (timed_update(path, value)) {
+            return true;
+        }
+        
+        retry_count++;
+        if (retry_count < max_retries) {
+            BI_DEBUG_WARNING(g_FirebaseLogger, "Reintentando %s (%d/%d)", description, retry_count, max_retries);
+            vTaskDelay(pdMS_TO_TICKS(1000)); // Esperar 1 segundo antes de reintentar
+        } else {
+            BI_DEBUG_ERROR(g_FirebaseLogger, "Error en %s después de %d intentos", description, max_retries);
+        }
     }
     
-    return true;
+    return false;
+}
+
+bool update_device_json(const char* path, char* json, const char* description) {
+    if (!firebase_handle || !path || !json) {
+        return false;
+    }
+    
+    firebase_data_value_t value;
+    wrap_json_value(&value, json);
+    
+    char full_path[FIREBASE_PATH_SIZE];
+    if (snprintf(full_path, sizeof(full_path), "%s/%s", s_devicePath, path) >= (int)sizeof(full_path)) {
+        BI_DEBUG_ERROR(g_FirebaseLogger, "Ruta demasiado larga para %s: %s", description, path);
+        return false;
+    }
+    return update_with_retries(full_path, &value, description);
+}
+
+/**
+ * @brief Escribe el array de celdas usado en las actualizaciones en tiempo real
+ * @param writer Serializador de destino
+ * @param cell_data Arreglo con los datos de las celdas
+ * @param cell_count Número de celdas
+ */
+static void write_cells_json(JsonWriter& writer, const CellArrays& cell_data, uint8_t cell_count) {
+    writer.beginArray("cells");
+    for (uint8_t i = 0; i < cell_count; i++) {
+        // addFloat escribe NaN, inf o valores fuera de rango como 0
+        writer.beginObject();
+        writer.addInt("id", i + 1);
+        writer.addFloat("voltage", cell_data.voltage[i], CELL_VOLTAGE_DECIMALS);
+        writer.addFloat("temperature", cell_data.temperature[i], TEMPERATURE_DECIMALS);
+        writer.addInt("soc", cell_data.soc[i]);
+        writer.addInt("soh", cell_data.soh[i]);
+        writer.endObject();
+    }
+    writer.endArray();
+}
+
+static inline int32_t quantize(float value, float scale) {
+    // Igual que JsonWriter::addFloat: NaN, inf o fuera de rango se envían como 0
+    constexpr float LIMIT = 2147483520.0f;  // Mayor float por debajo de 2^31
+    const float scaled = value * scale;
+    return (isfinite(scaled) && scaled > -LIMIT && scaled < LIMIT) ? static_cast<int32_t>(lroundf(scaled)) : 0;
+}
+
+static inline bool exceeds_deadband(int32_t value, int32_t last, uint32_t deadband) {
+    const int64_t diff = static_cast<int64_t>(value) - last;
+    return diff != 0 && static_cast<uint64_t>(diff < 0 ? -diff : diff) >= deadband;
+}
+
+/**
+ * @brief Indica si el próximo envío de un pack debe llevar el array completo de celdas
+ *
+ * Es así si no hay sombra válida (nueva sesión, otra estructura de rutas), si
+ * cambió el número de celdas o cada appConfig.telemetryFullResyncSamples muestras.
+ */
+static bool needs_full_resync(const pack_shadow_t& shadow, bool multi_pack, uint8_t cell_count) {
+    return shadow.session != s_shadowSession || shadow.multiPack != multi_pack || shadow.count != cell_count ||
+           shadow.samplesSinceResync + 1 >= appConfig.telemetryFullResyncSamples;
+}
+
+/**
+ * @brief Escribe las celdas completas o solo los campos que superan su banda muerta
+ *
+ * Compara cada campo con la sombra de lo último confirmado y escribe rutas
+ * "cells/<i>/<campo>" para los que cambiaron, o el array completo según
+ * needs_full_resync(). La sombra no se modifica hasta llamar a
+ * commit_cells_shadow() tras una petición correcta.
+ *
+ * @param writer Serializador de destino, dentro del objeto principal
+ * @param shadow Sombra del pack
+ * @param multi_pack true si las rutas van bajo /packs/<n>
+ * @param cell_data Arreglo con los datos de las celdas
+ * @param cell_count Número de celdas
+ * @param full Devuelve true si se escribió el array completo
+ * @return Número de campos de celda escritos
+ */
+static uint16_t write_cells_update(JsonWriter& writer, pack_shadow_t& shadow, bool multi_pack,
+                                   const CellArrays& cell_data, uint8_t cell_count, bool* full) {
+    for (uint8_t i = 0; i < cell_count; i++) {
+        shadow.pending[i].voltage_mv = quantize(cell_data.voltage[i], 1000.0f);
+        shadow.pending[i].temperature_dc = quantize(cell_data.temperature[i], 10.0f);
+        shadow.pending[i].soc = cell_data.soc[i];
+        shadow.pending[i].soh = cell_data.soh[i];
+    }
+    
+    *full = needs_full_resync(shadow, multi_pack, cell_count);
+    if (*full) {
+        write_cells_json(writer, cell_data, cell_count);
+        return cell_count * 4;
+    }
+    
+    uint16_t fields = 0;
+    char path[24];
+    for (uint8_t i = 0; i < cell_count; i++) {
+        cell_shadow_t& pending = shadow.pending[i];
+        const cell_shadow_t& last = shadow.cells[i];
+        
+        // Los campos que no se envían conservan el valor confirmado
+        if (exceeds_deadband(pending.voltage_mv, last.voltage_mv, appConfig.voltageDeadbandMv)) {
+            snprintf(path, sizeof(path), "cells/%u/voltage", i);
+            writer.addFloat(path, pending.voltage_mv / 1000.0f, CELL_VOLTAGE_DECIMALS);
+            fields++;
+        } else {
+            pending.voltage_mv = last.voltage_mv;
+        }
+        
+        if (exceeds_deadband(pending.temperature_dc, last.temperature_dc, appConfig.temperatureDeadbandDc)) {
+            snprintf(path, sizeof(path), "cells/%u/temperature", i);
+            writer.addFloat(path, pending.temperature_dc / 10.0f, TEMPERATURE_DECIMALS);
+            fields++;
+        } else {
+            pending.temperature_dc = last.temperature_dc;
+        }
+        
+        if (exceeds_deadband(pending.soc, last.soc, appConfig.socStep)) {
+            snprintf(path, sizeof(path), "cells/%u/soc", i);
+            writer.addInt(path, pending.soc);
+            fields++;
+        } else {
+            pending.soc = last.soc;
+        }
+        
+        if (exceeds_deadband(pending.soh, last.soh, appConfig.sohStep)) {
+            snprintf(path, sizeof(path), "cells/%u/soh", i);
+            writer.addInt(path, pending.soh);
+            fields++;
+        } else {
+            pending.soh = last.soh;
+        }
+    }
+    
+    return fields;
+}
+
+/**
+ * @brief Da por confirmados en Firebase los valores escritos por write_cells_update()
+ * @param shadow Sombra del pack
+ * @param multi_pack true si las rutas iban bajo /packs/<n>
+ * @param cell_count Número de celdas enviadas
+ * @param full true si se envió el array completo
+ */
+static void commit_cells_shadow(pack_shadow_t& shadow, bool multi_pack, uint8_t cell_count, bool full) {
+    memcpy(shadow.cells, shadow.pending, cell_count * sizeof(cell_shadow_t));
+    shadow.count = cell_count;
+    shadow.multiPack = multi_pack;
+    if (full) {
+        shadow.session = s_shadowSession;
+        shadow.samplesSinceResync = 0;
+    } else {
+        shadow.samplesSinceResync++;
+    }
+}
+
+/**
+ * @brief Escribe el objeto con los datos en tiempo real del pack
+ *
+ * Si se pasa la muestra completa se añaden el SOC del pack, el mínimo, el
+ * máximo y la dispersión de celdas (índices en base 1), que antes se
+ * calculaban en el servidor, y la máscara de fallos de protección activos.
+ */
+static void write_pack_json(JsonWriter& writer, float voltage, float current, float power,
+                            const char* status, uint32_t uptime, const battery_snapshot_t* snapshot) {
+    writer.beginObject("pack");
+    writer.addFloat("totalVoltage", voltage, PACK_VOLTAGE_DECIMALS);
+    writer.addFloat("current", current, CURRENT_DECIMALS);
+    writer.addFloat("power", power, POWER_DECIMALS);
+    writer.addString("status", status);
+    writer.addInt("uptime", uptime);
+    if (snapshot) {
+        const PackStats& stats = snapshot->stats;
+        writer.addFloat("soc", snapshot->soc_permille / 10.0f, 1);
+        writer.addFloat("minCellVoltage", stats.minVoltage, CELL_VOLTAGE_DECIMALS);
+        writer.addFloat("maxCellVoltage", stats.maxVoltage, CELL_VOLTAGE_DECIMALS);
+        writer.addFloat("cellDelta", stats.voltageSpread, CELL_VOLTAGE_DECIMALS);
+        writer.addInt("minCell", stats.minVoltageCell + 1);
+        writer.addInt("maxCell", stats.maxVoltageCell + 1);
+        writer.addFloat("minTemp", stats.minTemperature, TEMPERATURE_DECIMALS);
+        writer.addFloat("maxTemp", stats.maxTemperature, TEMPERATURE_DECIMALS);
+        writer.addInt("faults", snapshot->faults);
+        writer.addInt("reportPeriodMs", snapshot->report_period_ms);
+    }
+    writer.endObject();
+}
+
+size_t firebase_serialize_snapshot(const battery_snapshot_t* snapshot, char* buffer, size_t size) {
+    JsonWriter writer(buffer, size);
+    writer.beginObject();
+    write_cells_json(writer, snapshot->cells, snapshot->cell_count);
+    write_pack_json(writer, snapshot->voltage, snapshot->current, snapshot->power,
+                    Pack::statusToString(snapshot->status), snapshot->uptime, snapshot);
+    writer.endObject();
+    return writer.ok() ? writer.length() : 0;
+}
+
+/**
+ * @brief Escribe el estado del balanceo y el tiempo acumulado por celda
+ */
+static void write_balancing_json(JsonWriter& writer, const battery_snapshot_t* snapshot) {
+    writer.beginObject("balancing");
+    writer.addString("state", BalancingController::stateToString(snapshot->balance_state));
+    writer.addInt("mask", snapshot->balance_mask);
+    writer.beginArray("cellSeconds");
+    for (uint8_t i = 0; i < snapshot->cell_count; i++) {
+        writer.addInt(nullptr, snapshot->balance_seconds[i]);
+    }
+    writer.endArray();
+    writer.endObject();
+}
+
+/**
+ * @brief Escribe los agregados de las muestras tomadas desde la subida anterior
+ *
+ * Arrays por celda (en el orden de cells) con el mínimo, el máximo y la media
+ * de tensión, y el mínimo/máximo/media/último de la corriente del pack. Los
+ * valores de "cells" y "pack" siguen siendo los de la última muestra.
+ */
+static void write_window_json(JsonWriter& writer, const SampleWindow& window, uint8_t cell_count) {
+    writer.beginObject("window");
+    writer.addInt("samples", window.samples);
+    writer.addInt("durationMs", window.durationMs);
+    
+    writer.beginArray("cellVoltageMin");
+    for (uint8_t i = 0; i < cell_count; i++) {
+        writer.addFloat(nullptr, window.minVoltageMv[i] / 1000.0f, CELL_VOLTAGE_DECIMALS);
+    }
+    writer.endArray();
+    writer.beginArray("cellVoltageMax");
+    for (uint8_t i = 0; i < cell_count; i++) {
+        writer.addFloat(nullptr, window.maxVoltageMv[i] / 1000.0f, CELL_VOLTAGE_DECIMALS);
+    }
+    writer.endArray();
+    writer.beginArray("cellVoltageMean");
+    for (uint8_t i = 0; i < cell_count; i++) {
+        writer.addFloat(nullptr, window.meanVoltageMv[i] / 1000.0f, CELL_VOLTAGE_DECIMALS);
+    }
+    writer.endArray();
+    
+    writer.beginObject("current");
+    writer.addFloat("min", window.current.min, CURRENT_DECIMALS);
+    writer.addFloat("max", window.current.max, CURRENT_DECIMALS);
+    writer.addFloat("mean", window.current.mean, CURRENT_DECIMALS);
+    writer.addFloat("last", window.current.last, CURRENT_DECIMALS);
+    writer.endObject();
+    writer.endObject();
+}
+
+/**
+ * @brief Escribe las celdas de un registro histórico en formato compacto
+ *
+ * Añade "schema", "cellCount" y "cellsPacked". cellsPacked es el base64 de
+ * tres columnas consecutivas en little-endian: cellCount uint16 con la tensión
+ * en mV, cellCount int16 con la temperatura en décimas de °C y cellCount uint8
+ * con el SOC. Son 5 bytes por celda frente a unos 60 en JSON.
+ *
+ * @param writer Serializador de destino, dentro del objeto del registro
+ * @param cells Celdas del registro
+ * @param cell_count Número de celdas
+ */
+static void write_packed_cells(JsonWriter& writer, const history_cell_t* cells, uint8_t cell_count) {
+    static constexpr size_t PACKED_CELL_BYTES = sizeof(uint16_t) + sizeof(int16_t) + sizeof(uint8_t);
+    uint8_t columns[MAX_CELL_COUNT * PACKED_CELL_BYTES];
+    char encoded[((sizeof(columns) + 2) / 3) * 4 + 1];
+    
+    uint8_t* voltages = columns;
+    uint8_t* temperatures = voltages + cell_count * sizeof(uint16_t);
+    uint8_t* socs = temperatures + cell_count * sizeof(int16_t);
+    
+    for (uint8_t i = 0; i < cell_count; i++) {
+        const uint16_t mv = cells[i].voltage_mv;
+        const uint16_t dc = static_cast<uint16_t>(cells[i].temperature_dc);
+        voltages[2 * i] = mv & 0xFF;
+        voltages[2 * i + 1] = mv >> 8;
+        temperatures[2 * i] = dc & 0xFF;
+        temperatures[2 * i + 1] = dc >> 8;
+        socs[i] = cells[i].soc;
+    }
+    
+    size_t encoded_length = 0;
+    if (mbedtls_base64_encode(reinterpret_cast<unsigned char*>(encoded), sizeof(encoded), &encoded_length,
+                              columns, cell_count * PACKED_CELL_BYTES) != 0) {
+        encoded_length = 0;
+    }
+    encoded[encoded_length] = '\0';
+    
+    writer.addInt("schema", HISTORY_PACKED_SCHEMA_VERSION);
+    writer.addInt("cellCount", cell_count);
+    writer.addString("cellsPacked", encoded);
+}
+
+/**
+ * @brief Escribe un registro histórico leído del log en flash
+ * @param writer Serializador de destino
+ * @param key Clave del objeto, o nullptr si es el documento raíz
+ * @param record Registro a escribir
+ */
+static void write_history_record_json(JsonWriter& writer, const char* key, const history_record_t* record) {
+    writer.beginObject(key);
+    
+    // Hora del dispositivo si estaba sincronizada; si no, la del servidor al subirlo
+    if (record->timestamp_ms > 0) {
+        writer.addInt("timestamp", record->timestamp_ms);
+    } else {
+        writer.addServerTimestamp("timestamp");
+    }
+    writer.addInt("uptime", record->uptime);
+    
+    if (appConfig.historyEncoding == HISTORY_ENCODING_PACKED) {
+        write_packed_cells(writer, record->cells, record->cell_count);
+    } else {
+        writer.beginArray("cells");
+        for (uint8_t i = 0; i < record->cell_count; i++) {
+            writer.beginObject();
+            writer.addInt("id", i + 1);
+            writer.addFloat("voltage", record->cells[i].voltage_mv / 1000.0f, CELL_VOLTAGE_DECIMALS);
+            writer.addFloat("temperature", record->cells[i].temperature_dc / 10.0f, TEMPERATURE_DECIMALS);
+            writer.addInt("soc", record->cells[i].soc);
+            writer.endObject();
+        }
+        writer.endArray();
+    }
+    
+    writer.beginObject("pack");
+    writer.addFloat("totalVoltage", record->voltage, PACK_VOLTAGE_DECIMALS);
+    writer.addFloat("current", record->current, CURRENT_DECIMALS);
+    writer.addFloat("power", record->power, POWER_DECIMALS);
+    writer.addString("status", Pack::statusToString(static_cast<PackStatus>(record->status)));
+    writer.endObject();
+    
+    writer.endObject();
 }
 
 /**
@@ -445,7 +806,7 @@ bool check_firebase_connectivity() {
  * @return bool true si la actualización fue exitosa
  */
 bool update_battery_cells(const battery_cell_t* cell_data, uint8_t cell_count) {
-    if (!firebase_handle || !cell_data || cell_count == 0)
+    if (!firebase_handle || !cell_data || cell_count == 0 || cell_count > MAX_CELL_COUNT)
         return false;
 
     // Verificar conectividad
@@ -453,93 +814,94 @@ bool update_battery_cells(const battery_cell_t* cell_data, uint8_t cell_count) {
         return false;
     }
     
-    bool result = false;
-    firebase_data_value_t value;
-    memset(&value, 0, sizeof(value)); // Inicializar a cero
+    // Pasar al formato SoA que usan los serializadores
+    static CellArrays cells;
+    for (uint8_t i = 0; i < cell_count; i++) {
+        cells.voltage[i] = cell_data[i].voltage;
+        cells.temperature[i] = cell_data[i].temperature;
+        cells.soc[i] = cell_data[i].soc;
+        cells.soh[i] = cell_data[i].soh;
+    }
     
-    // Crear array JSON para las celdas
-    cJSON *cells_array = cJSON_CreateArray();
-    if (!cells_array) {
-        BI_DEBUG_ERROR(g_FirebaseLogger, "Error al crear array JSON");
+    bool full = false;
+    JsonWriter writer(s_telemetryBuffer, sizeof(s_telemetryBuffer));
+    writer.beginObject();
+    uint16_t fields = write_cells_update(writer, s_packShadows[0], false, cells, cell_count, &full);
+    writer.endObject();
+    
+    if (!writer.ok()) {
+        BI_DEBUG_ERROR(g_FirebaseLogger, "Error al serializar JSON de celdas");
         return false;
     }
     
-    // Añadir cada celda al array
-    bool cell_create_error = false;
-    for (uint8_t i = 0; i < cell_count && !cell_create_error; i++) {
-        cJSON *cell = cJSON_CreateObject();
-        if (!cell) {
-            cell_create_error = true;
-        } else {
-            // Añadir valores con validación
-            cJSON_AddNumberToObject(cell, "id", i + 1);
-            
-            // Validar valores antes de añadirlos (prevenir NaN o inf)
-            float voltage = cell_data[i].voltage;
-            float temp = cell_data[i].temperature;
-            if (isfinite(voltage)) {
-                cJSON_AddNumberToObject(cell, "voltage", voltage);
-            } else {
-                cJSON_AddNumberToObject(cell, "voltage", 0.0);
-            }
-            
-            if (isfinite(temp)) {
-                cJSON_AddNumberToObject(cell, "temperature", temp);
-            } else {
-                cJSON_AddNumberToObject(cell, "temperature", 0.0);
-            }
-            
-            cJSON_AddNumberToObject(cell, "soc", cell_data[i].soc);
-            cJSON_AddNumberToObject(cell, "soh", cell_data[i].soh);
-            
-            cJSON_AddItemToArray(cells_array, cell);
-        }
+    // Ninguna celda salió de su banda muerta: no hay nada que enviar
+    if (fields == 0) {
+        commit_cells_shadow(s_packShadows[0], false, cell_count, false);
+        return true;
     }
     
-    if (cell_create_error) {
-        cJSON_Delete(cells_array);
-        BI_DEBUG_ERROR(g_FirebaseLogger, "Error al crear objetos de celda JSON");
-        return false;
-    }
+    firebase_data_value_t value;
+    wrap_json_value(&value, s_telemetryBuffer);
     
-    // Crear objeto JSON principal
-    cJSON *json = cJSON_CreateObject();
-    if (!json) {
-        cJSON_Delete(cells_array);
-        BI_DEBUG_ERROR(g_FirebaseLogger, "Error al crear objeto JSON");
+    // Actualizar datos en Firebase
+    if (!timed_update(s_devicePath, &value)) {
+        BI_DEBUG_ERROR(g_FirebaseLogger, "Error al actualizar datos de celdas");
         return false;
     }
     
-    // Añadir array de celdas al objeto principal
-    cJSON_AddItemToObject(json, "cells", cells_array);
+    commit_cells_shadow(s_packShadows[0], false, cell_count, full);
+    BI_DEBUG_INFO(g_FirebaseLogger, "Datos de celdas actualizados correctamente (%s, %d campos)",
+                 full ? "completo" : "parcial", fields);
+    return true;
+}
+
+/**
+ * @brief Añade un registro ya serializado a /history y actualiza /lastUpdate
+ * @param json_string Registro histórico en JSON
+ * @param history_path Ruta de /history del dispositivo o de un pack
+ * @return true si el almacenamiento fue exitoso, false en caso contrario
+ */
+static bool push_history_json(char* json_string, const char* history_path) {
+    static char server_timestamp[] = "{\".sv\":\"timestamp\"}";
     
-    // Convertir a string
-    char *json_string = cJSON_PrintUnformatted(json);
-    cJSON_Delete(json); // Libera json y cells_array
+    firebase_data_value_t value;
+    wrap_json_value(&value, json_string);
     
-    if (!json_string) {
-        BI_DEBUG_ERROR(g_FirebaseLogger, "Error al serializar JSON");
-        return false;
-    }
+    // Establecer un timeout para la operación
+    int retry_count = 0;
+    const int max_retries = 3;
+    char key[64] = {0};
     
-    // Crear valor Firebase de tipo JSON con comprobación de errores
-    if (firebase_set_json(&value, json_string)) {
-        // Actualizar datos en Firebase
-        if (firebase_update(firebase_handle, (device_path).c_str(), &value)) {
-            BI_DEBUG_INFO(g_FirebaseLogger, "Datos de celdas actualizados correctamente");
-            result = true;
+    while (retry_count < max_retries) {
+        // Verificar conectividad antes de cada intento
+        if (!check_firebase_connectivity()) {
+            return false;
+        }
+        
+        // Enviar datos a Firebase en la ruta /batteries/{uid}/history o /batteries/{uid}/packs/{n}/history
+        if (timed_push(history_path, &value, key, sizeof(key))) {
+            BI_DEBUG_INFO(g_FirebaseLogger, "Registro histórico almacenado con clave: %s", key);
+            
+            // También actualizar el último timestamp en los metadatos
+            firebase_data_value_t timestamp_value;
+            wrap_json_value(&timestamp_value, server_timestamp);
+            timed_set(s_lastUpdatePath, &timestamp_value);
+            
+            return true;
+        }
+        
+        retry_count++;
+        if (retry_count < max_retries) {
+            BI_DEBUG_WARNING(g_FirebaseLogger, "Reintentando almacenamiento histórico (%d/%d)", 
+                         retry_count, max_retries);
+            vTaskDelay(pdMS_TO_TICKS(1000)); // Esperar 1 segundo antes de reintentar
         } else {
-            BI_DEBUG_ERROR(g_FirebaseLogger, "Error al actualizar datos de celdas");
+            BI_DEBUG_ERROR(g_FirebaseLogger, "Error al almacenar registro histórico después de %d intentos", 
+                          max_retries);
         }
-    } else {
-        BI_DEBUG_ERROR(g_FirebaseLogger, "Error al crear valor JSON para Firebase");
     }
     
-    // Liberar recursos siempre
-    firebase_free_value(&value);
-    free(json_string);
-    
-    return result;
+    return false;
 }
 
 /**
@@ -565,145 +927,212 @@ bool store_battery_history(const battery_cell_t* cells_data, uint8_t num_cells,
         return false;
     }
     
-    // Crear objeto JSON principal
-    cJSON *json = cJSON_CreateObject();
-    if (!json) {
-        BI_DEBUG_ERROR(g_FirebaseLogger, "Error creando objeto JSON principal");
+    JsonWriter writer(s_telemetryBuffer, sizeof(s_telemetryBuffer));
+    writer.beginObject();
+    
+    // Timestamp de Firebase (usando Server Timestamp para sincronización)
+    writer.addServerTimestamp("timestamp");
+    
+    if (appConfig.historyEncoding == HISTORY_ENCODING_PACKED) {
+        // Misma cuantización que los registros del log en flash
+        history_cell_t packed_cells[MAX_CELL_COUNT];
+        num_cells = std::min<uint8_t>(num_cells, MAX_CELL_COUNT);
+        for (uint8_t i = 0; i < num_cells; i++) {
+            packed_cells[i].voltage_mv = static_cast<uint16_t>(std::clamp<int32_t>(quantize(cells_data[i].voltage, 1000.0f), 0, UINT16_MAX));
+            packed_cells[i].temperature_dc = static_cast<int16_t>(std::clamp<int32_t>(quantize(cells_data[i].temperature, 10.0f), INT16_MIN, INT16_MAX));
+            packed_cells[i].soc = cells_data[i].soc;
+        }
+        write_packed_cells(writer, packed_cells, num_cells);
+    } else {
+        writer.beginArray("cells");
+        for (uint8_t i = 0; i < num_cells; i++) {
+            writer.beginObject();
+            writer.addInt("id", i + 1);
+            writer.addFloat("voltage", cells_data[i].voltage, CELL_VOLTAGE_DECIMALS);
+            writer.addFloat("temperature", cells_data[i].temperature, TEMPERATURE_DECIMALS);
+            writer.addInt("soc", cells_data[i].soc);
+            writer.endObject();
+        }
+        writer.endArray();
+    }
+    
+    writer.beginObject("pack");
+    writer.addFloat("totalVoltage", voltage, PACK_VOLTAGE_DECIMALS);
+    writer.addFloat("current", current, CURRENT_DECIMALS);
+    writer.addFloat("power", power, POWER_DECIMALS);
+    writer.addString("status", status);
+    writer.endObject();
+    
+    writer.endObject();
+    
+    if (!writer.ok()) {
+        BI_DEBUG_ERROR(g_FirebaseLogger, "Error creando string JSON");
         return false;
     }
     
-    // Obtener timestamp de Firebase (usando Server Timestamp para sincronización)
-    cJSON *timestamp_obj = create_firebase_server_timestamp();
-    if (timestamp_obj) {
-        cJSON_AddItemToObject(json, "timestamp", timestamp_obj);
-    } else {
-        // Fallback al timestamp local si falla crear el server timestamp
-        int64_t local_timestamp = esp_timer_get_time() / 1000;
-        cJSON_AddNumberToObject(json, "timestamp", local_timestamp);
+    return push_history_json(s_telemetryBuffer, s_historyPath);
+}
+
+/**
+ * @brief Sube a /history un registro leído del log en flash
+ * @param record Registro histórico a subir
+ * @return true si el almacenamiento fue exitoso, false en caso contrario
+ */
+bool store_history_record(const history_record_t* record) {
+    if (!record || record->cell_count == 0 || record->cell_count > MAX_CELL_COUNT) {
+        BI_DEBUG_ERROR(g_FirebaseLogger, "Parámetros inválidos para store_history_record");
+        return false;
     }
     
-    // Crear array JSON para las celdas
-    cJSON *cells_array = cJSON_CreateArray();
-    if (!cells_array) {
-        cJSON_Delete(json);
-        BI_DEBUG_ERROR(g_FirebaseLogger, "Error creando array JSON para celdas");
+    // Verificar conectividad
+    if (!check_firebase_connectivity()) {
         return false;
     }
     
-    // Añadir datos de cada celda al array
-    for (uint8_t i = 0; i < num_cells; i++) {
-        cJSON *cell = cJSON_CreateObject();
-        if (!cell) {
-            cJSON_Delete(json);
-            BI_DEBUG_ERROR(g_FirebaseLogger, "Error creando objeto celda JSON");
+    // Con varios packs cada uno tiene su /history
+    char pack_history_path[FIREBASE_PATH_SIZE];
+    const char* history_path = s_historyPath;
+    if (record->pack != HISTORY_SINGLE_PACK) {
+        if (snprintf(pack_history_path, sizeof(pack_history_path), "%s/packs/%u/history",
+                     s_devicePath, record->pack) >= (int)sizeof(pack_history_path)) {
+            BI_DEBUG_ERROR(g_FirebaseLogger, "Ruta de históricos demasiado larga para el pack %u", record->pack);
             return false;
         }
-        
-        cJSON_AddNumberToObject(cell, "id", i + 1);
-        cJSON_AddNumberToObject(cell, "voltage", cells_data[i].voltage);
-        cJSON_AddNumberToObject(cell, "temperature", cells_data[i].temperature);
-        cJSON_AddNumberToObject(cell, "soc", cells_data[i].soc);
-        
-        cJSON_AddItemToArray(cells_array, cell);
+        history_path = pack_history_path;
     }
     
-    // Añadir array de celdas al objeto principal
-    cJSON_AddItemToObject(json, "cells", cells_array);
+    JsonWriter writer(s_telemetryBuffer, sizeof(s_telemetryBuffer));
+    write_history_record_json(writer, nullptr, record);
     
-    // Crear objeto JSON para los datos del pack
-    cJSON *pack_json = cJSON_CreateObject();
-    if (!pack_json) {
-        cJSON_Delete(json);
-        BI_DEBUG_ERROR(g_FirebaseLogger, "Error creando objeto JSON para pack");
+    if (!writer.ok()) {
+        BI_DEBUG_ERROR(g_FirebaseLogger, "Error creando JSON del registro histórico");
         return false;
     }
     
-    // Añadir datos del pack
-    cJSON_AddNumberToObject(pack_json, "totalVoltage", voltage);
-    cJSON_AddNumberToObject(pack_json, "current", current);
-    cJSON_AddNumberToObject(pack_json, "power", power);
-    cJSON_AddStringToObject(pack_json, "status", status);
+    return push_history_json(s_telemetryBuffer, history_path);
+}
+
+/**
+ * @brief Genera una clave con el mismo formato y orden que los push-id de Firebase
+ *
+ * 8 caracteres codifican el timestamp en ms y 12 son aleatorios; si dos claves
+ * comparten milisegundo se incrementa la parte aleatoria para mantener el orden.
+ *
+ * @param timestamp_ms Epoch en ms del registro
+ * @param key Buffer de salida de 21 bytes como mínimo
+ */
+static void generate_push_id(int64_t timestamp_ms, char* key) {
+    static const char PUSH_CHARS[] = "-0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ_abcdefghijklmnopqrstuvwxyz";
+    static int64_t last_timestamp = 0;
+    static uint8_t last_random[12];
     
-    // Añadir objeto pack al objeto principal
-    cJSON_AddItemToObject(json, "pack", pack_json);
+    // Nunca retroceder: los registros sin hora propia se fechan al subirlos
+    if (timestamp_ms < last_timestamp) {
+        timestamp_ms = last_timestamp;
+    }
     
-    // Convertir a string
-    char *json_string = cJSON_PrintUnformatted(json);
-    cJSON_Delete(json);
+    const bool duplicated = (timestamp_ms == last_timestamp);
+    last_timestamp = timestamp_ms;
     
-    if (!json_string) {
-        BI_DEBUG_ERROR(g_FirebaseLogger, "Error creando string JSON");
-        return false;
+    for (int i = 7; i >= 0; i--) {
+        key[i] = PUSH_CHARS[timestamp_ms % 64];
+        timestamp_ms /= 64;
     }
     
-    // Crear valor Firebase de tipo JSON
-    firebase_data_value_t value;
-    bool result = false;
+    if (!duplicated) {
+        for (int i = 0; i < 12; i++) {
+            last_random[i] = esp_random() % 64;
+        }
+    } else {
+        int i = 11;
+        while (i >= 0 && last_random[i] == 63) {
+            last_random[i] = 0;
+            i--;
+        }
+        if (i >= 0) {
+            last_random[i]++;
+        }
+    }
+    
+    for (int i = 0; i < 12; i++) {
+        key[8 + i] = PUSH_CHARS[last_random[i]];
+    }
+    key[20] = '\0';
+}
+
+/**
+ * @brief Sube varios registros a /history en un único PATCH multi-ruta
+ * @param records Registros a subir, del más antiguo al más reciente
+ * @param count Número de registros disponibles
+ * @return Número de registros (prefijo de records) almacenados
+ */
+size_t store_history_batch(const history_record_t* records, size_t count) {
+    if (!records || count == 0) {
+        return 0;
+    }
     
-    if (firebase_set_json(&value, json_string)) {
-        // Establecer un timeout para la operación
-        int retry_count = 0;
-        const int max_retries = 3;
-        char key[64] = {0};
-        std::string history_path = device_path + "/history";
+    // Sin hora válida no se pueden generar claves ordenadas en el dispositivo
+    const int64_t now_ms = history_epoch_ms();
+    if (now_ms == 0) {
+        return 0;
+    }
+    
+    // Verificar conectividad
+    if (!check_firebase_connectivity()) {
+        return 0;
+    }
+    
+    // Sitio que hay que dejar siempre para lastUpdate y el cierre
+    static constexpr size_t LAST_UPDATE_RESERVE = sizeof(",\"lastUpdate\":{\".sv\":\"timestamp\"}}");
+    const size_t max_bytes = std::min(static_cast<size_t>(appConfig.historyBatchMaxBytes), sizeof(s_telemetryBuffer));
+    
+    // Cuerpo: {"history/<clave>":{...},...,"lastUpdate":{".sv":"timestamp"}}; con
+    // varios packs las claves de cada registro son packs/<n>/history/<clave>
+    JsonWriter writer(s_telemetryBuffer, sizeof(s_telemetryBuffer));
+    writer.beginObject();
+    
+    size_t batched = 0;
+    for (size_t i = 0; i < count; i++) {
+        char key[48];
+        const int prefix_length = (records[i].pack == HISTORY_SINGLE_PACK) ?
+                                  snprintf(key, sizeof(key), "history/") :
+                                  snprintf(key, sizeof(key), "packs/%u/history/", records[i].pack);
+        generate_push_id(records[i].timestamp_ms > 0 ? records[i].timestamp_ms : now_ms, key + prefix_length);
         
-        while (retry_count < max_retries) {
-            // Verificar conectividad antes de cada intento
-            if (!check_firebase_connectivity()) {
-                firebase_free_value(&value);
-                free(json_string);
-                return false;
-            }
-            
-            // Enviar datos a Firebase en la ruta /batteries/{uid}/history
-            if (firebase_push(firebase_handle, history_path.c_str(), &value, key, sizeof(key))) {
-                BI_DEBUG_INFO(g_FirebaseLogger, "Registro histórico almacenado con clave: %s", key);
-                
-                // También actualizar el último timestamp en los metadatos
-                firebase_data_value_t timestamp_value;
-                cJSON *server_timestamp = create_firebase_server_timestamp();
-                if (server_timestamp) {
-                    char *timestamp_str = cJSON_PrintUnformatted(server_timestamp);
-                    if (timestamp_str) {
-                        if (firebase_set_json(&timestamp_value, timestamp_str)) {
-                            std::string last_update_path = device_path + "/lastUpdate";
-                            firebase_set(firebase_handle, last_update_path.c_str(), &timestamp_value);
-                            firebase_free_value(&timestamp_value);
-                        }
-                        free(timestamp_str);
-                    }
-                    cJSON_Delete(server_timestamp);
-                } else {
-                    // Fallback al timestamp local
-                    int64_t local_timestamp = esp_timer_get_time() / 1000;
-                    if (firebase_set_int(&timestamp_value, local_timestamp)) {
-                        std::string last_update_path = device_path + "/lastUpdate";
-                        firebase_set(firebase_handle, last_update_path.c_str(), &timestamp_value);
-                        firebase_free_value(&timestamp_value);
-                    }
-                }
-                
-                result = true;
-                break;
-            } else {
-                retry_count++;
-                if (retry_count < max_retries) {
-                    BI_DEBUG_WARNING(g_FirebaseLogger, "Reintentando almacenamiento histórico (%d/%d)", 
-                                 retry_count, max_retries);
-                    vTaskDelay(pdMS_TO_TICKS(1000)); // Esperar 1 segundo antes de reintentar
-                } else {
-                    BI_DEBUG_ERROR(g_FirebaseLogger, "Error al almacenar registro histórico después de %d intentos", 
-                                  max_retries);
-                }
-            }
+        // Los registros se escriben directamente en el cuerpo; el que no cabe se deshace
+        const JsonWriter::Checkpoint checkpoint = writer.checkpoint();
+        write_history_record_json(writer, key, &records[i]);
+        if (!writer.ok() || writer.length() + LAST_UPDATE_RESERVE > max_bytes) {
+            writer.restore(checkpoint);
+            break;
         }
-        
-        // Liberar recursos
-        firebase_free_value(&value);
+        batched++;
     }
     
-    free(json_string);
-    return result;
+    if (batched == 0) {
+        BI_DEBUG_ERROR(g_FirebaseLogger, "Registro histórico no cabe en un lote de %d bytes", (int)max_bytes);
+        return 0;
+    }
+    
+    writer.addServerTimestamp("lastUpdate");
+    writer.endObject();
+    
+    if (!writer.ok()) {
+        BI_DEBUG_ERROR(g_FirebaseLogger, "Error creando JSON del lote de históricos");
+        return 0;
+    }
+    
+    firebase_data_value_t value;
+    wrap_json_value(&value, s_telemetryBuffer);
+    
+    // Un único PATCH en /batteries/{uid} con todos los registros del lote
+    if (!update_with_retries(s_devicePath, &value, "lote de históricos")) {
+        return 0;
+    }
+    
+    BI_DEBUG_INFO(g_FirebaseLogger, "Lote de %d registros históricos almacenado (%d bytes)",
+                 (int)batched, (int)writer.length());
+    return batched;
 }
 
 /**
@@ -727,127 +1156,476 @@ bool update_battery_pack(float voltage, float current, float power, const char*
         return false;
     }
     
-    // Crear objeto JSON para los datos del pack
-    cJSON *pack_json = cJSON_CreateObject();
-    if (!pack_json) {
-        BI_DEBUG_ERROR(g_FirebaseLogger, "Error creando objeto JSON para pack");
+    JsonWriter writer(s_telemetryBuffer, sizeof(s_telemetryBuffer));
+    writer.beginObject();
+    write_pack_json(writer, voltage, current, power, status, uptime, nullptr);
+    writer.endObject();
+    
+    if (!writer.ok()) {
+        BI_DEBUG_ERROR(g_FirebaseLogger, "Error creando JSON del pack");
         return false;
     }
     
-    // Añadir datos del pack
-    cJSON_AddNumberToObject(pack_json, "totalVoltage", voltage);
-    cJSON_AddNumberToObject(pack_json, "current", current);
-    cJSON_AddNumberToObject(pack_json, "power", power);
-    cJSON_AddStringToObject(pack_json, "status", status);
-    cJSON_AddNumberToObject(pack_json, "uptime", uptime);
+    firebase_data_value_t value;
+    wrap_json_value(&value, s_telemetryBuffer);
     
-    // Crear objeto JSON principal para actualizar
-    cJSON *json = cJSON_CreateObject();
-    if (!json) {
-        cJSON_Delete(pack_json);
-        BI_DEBUG_ERROR(g_FirebaseLogger, "Error creando objeto JSON principal");
+    // Enviar datos a Firebase en la ruta /batteries/{uid}/
+    if (!update_with_retries(s_devicePath, &value, "actualización del pack")) {
         return false;
     }
     
-    // Añadir datos del pack al objeto principal
-    cJSON_AddItemToObject(json, "pack", pack_json);
+    BI_DEBUG_INFO(g_FirebaseLogger, "Datos del pack de batería actualizados correctamente");
+    return true;
+}
+
+/**
+ * @brief Escribe los diagnósticos del dispositivo que viajan con cada resincronización completa
+ */
+static void write_diagnostics_json(JsonWriter& writer) {
+    writer.beginObject("diagnostics/http");
+    writer.addInt("sessions", s_connStats.sessions);
+    writer.addInt("connections", s_connStats.connections);
+    writer.addInt("connectMsTotal", s_connStats.connectMsTotal);
+    writer.addInt("connectMsLast", s_connStats.lastConnectMs);
+    writer.addInt("requests", s_connStats.requests);
+    writer.addInt("requestMsTotal", s_connStats.requestMsTotal);
+    writer.endObject();
+    
+    // Sesión con Firebase
+    writer.beginObject("diagnostics/link");
+    writer.addString("state", link_state_to_string(s_linkStats.state));
+    writer.addInt("linkUps", s_linkStats.linkUps);
+    writer.addInt("failedAttempts", s_linkStats.failedAttempts);
+    writer.addInt("resumedSessions", s_linkStats.resumedSessions);
+    writer.addInt("onlineMsLast", s_linkStats.lastOnlineMs);
+    writer.addInt("firstUploadMsLast", s_linkStats.lastFirstUploadMs);
+    writer.endObject();
     
-    // Convertir a string
-    char *json_string = cJSON_PrintUnformatted(json);
-    cJSON_Delete(json);
+    // Uso de la radio
+    const wifi_power_stats_t wifiStats = wifi_power_get_stats();
+    writer.beginObject("diagnostics/wifi");
+    writer.addInt("bursts", wifiStats.bursts);
+    writer.addInt("fastConnects", wifiStats.fastConnects);
+    writer.addInt("fastConnectFails", wifiStats.fastConnectFails);
+    writer.addInt("lastConnectMs", wifiStats.lastConnectMs);
+    writer.addInt("radioOnS", static_cast<uint32_t>(wifiStats.radioOnMs / 1000));
+    writer.endObject();
     
-    if (!json_string) {
-        BI_DEBUG_ERROR(g_FirebaseLogger, "Error creando string JSON");
+    // Pilas de las tareas y heap
+    const memory_heap_stats_t heap = memory_budget_get_heap();
+    writer.beginObject("diagnostics/memory");
+    writer.addInt("freeHeap", heap.freeHeap);
+    writer.addInt("minFreeHeap", heap.minFreeHeap);
+    writer.addInt("largestFreeBlock", heap.largestFreeBlock);
+    memory_task_stats_t tasks[MEMORY_BUDGET_MAX_TASKS];
+    const uint8_t taskCount = memory_budget_get_tasks(tasks, MEMORY_BUDGET_MAX_TASKS);
+    writer.beginObject("stackFreeMin");
+    for (uint8_t i = 0; i < taskCount; ++i) {
+        writer.addInt(tasks[i].name, tasks[i].stackFreeMin);
+    }
+    writer.endObject();
+    writer.endObject();
+    
+#if LATENCY_PROBES
+    // Histogramas desde la resincronización anterior, solo las etapas con medidas
+    latency_stats_t latency[LATENCY_STAGE_COUNT];
+    if (appConfig.latencyProbes && latency_probe_collect(latency)) {
+        writer.beginObject("diagnostics/latency");
+        for (uint8_t stage = 0; stage < LATENCY_STAGE_COUNT; ++stage) {
+            if (latency[stage].count == 0) {
+                continue;
+            }
+            writer.beginObject(latency_probe_stage_name(static_cast<latency_stage_t>(stage)));
+            writer.addInt("count", latency[stage].count);
+            writer.addInt("p50Us", latency[stage].p50Us);
+            writer.addInt("p95Us", latency[stage].p95Us);
+            writer.addInt("maxUs", latency[stage].maxUs);
+            writer.endObject();
+        }
+        writer.endObject();
+    }
+#endif
+    
+    // Trabajos de la tarea de batería
+    uint8_t jobCount = 0;
+    const ScheduledJob* jobs = battery_controller_get_jobs(&jobCount);
+    writer.beginObject("diagnostics/scheduler");
+    for (uint8_t i = 0; i < jobCount; ++i) {
+        writer.beginObject(jobs[i].name);
+        writer.addInt("periodMs", jobs[i].periodMs);
+        writer.addInt("runs", jobs[i].runs);
+        writer.addInt("overruns", jobs[i].overruns);
+        writer.addInt("maxLatenessMs", jobs[i].maxLatenessUs / 1000);
+        writer.endObject();
+    }
+    writer.endObject();
+}
+
+/**
+ * @brief Escribe los datos del dispositivo que acompañan a las muestras
+ * @param writer Serializador de destino, dentro del objeto multi-ruta
+ * @param diagnostics Incluir las estadísticas del dispositivo (resincronización completa)
+ * @param boot_report Incluir el perfil del arranque
+ */
+static void write_device_extras_json(JsonWriter& writer, bool diagnostics, bool boot_report) {
+    if (boot_report) {
+        writer.beginObject("diagnostics/boot");
+        writer.addInt("resetReason", static_cast<int>(esp_reset_reason()));
+        for (int phase = 0; phase < BOOT_PHASE_COUNT; ++phase) {
+            writer.addInt(boot_profile_phase_name(static_cast<boot_phase_t>(phase)),
+                          boot_profile_get_ms(static_cast<boot_phase_t>(phase)));
+        }
+        writer.endObject();
+    }
+    if (diagnostics) {
+        write_diagnostics_json(writer);
+    }
+}
+
+/**
+ * @brief Envía en su propio PATCH los datos del dispositivo que no cupieron con las muestras
+ *
+ * Un fallo no invalida las muestras, ya confirmadas: el perfil del arranque
+ * sigue pendiente y las estadísticas vuelven con la siguiente resincronización.
+ *
+ * @return true si se enviaron
+ */
+static bool send_device_extras(bool diagnostics, bool boot_report) {
+    JsonWriter writer(s_telemetryBuffer, sizeof(s_telemetryBuffer));
+    writer.beginObject();
+    write_device_extras_json(writer, diagnostics, boot_report);
+    writer.endObject();
+    if (!writer.ok()) {
+        BI_DEBUG_WARNING(g_FirebaseLogger, "Diagnósticos del dispositivo demasiado grandes, se descartan");
         return false;
     }
     
-    // Crear valor Firebase de tipo JSON
     firebase_data_value_t value;
-    bool result = false;
+    wrap_json_value(&value, s_telemetryBuffer);
+    if (!update_with_retries(s_devicePath, &value, "diagnósticos del dispositivo")) {
+        return false;
+    }
+    if (boot_report) {
+        boot_profile_set_reported();
+    }
+    return true;
+}
+
+/**
+ * @brief Escribe las rutas de la muestra de un pack: celdas, pack, ventana y balanceo
+ * @param writer Serializador de destino, dentro del objeto principal
+ * @param shadow Sombra del pack, cuyas celdas pendientes quedan preparadas
+ * @param snapshot Muestra del pack
+ * @param full Devuelve true si se escribió el array completo de celdas
+ * @return Número de campos de celda escritos
+ */
+static uint16_t write_snapshot_json(JsonWriter& writer, pack_shadow_t& shadow, const battery_snapshot_t* snapshot,
+                                    bool* full) {
+    uint16_t fields = write_cells_update(writer, shadow, snapshot->pack_count > 1, snapshot->cells,
+                                         snapshot->cell_count, full);
+    write_pack_json(writer, snapshot->voltage, snapshot->current, snapshot->power,
+                    Pack::statusToString(snapshot->status), snapshot->uptime, snapshot);
+    
+    // Con una sola muestra los agregados coinciden con los valores de cells y pack
+    if (snapshot->window.samples > 1) {
+        write_window_json(writer, snapshot->window, snapshot->cell_count);
+    }
+    
+    // El balanceo solo cambia mientras está activo; parado basta con la resincronización
+    const bool balanceChanged = snapshot->balance_state != shadow.lastBalanceState;
+    if (*full || balanceChanged || snapshot->balance_state == BALANCE_STATE_ACTIVE) {
+        write_balancing_json(writer, snapshot);
+    }
+    return fields;
+}
+
+/**
+ * @brief Actualiza celdas, pack y uptime en Firebase con un único PATCH multi-ruta
+ * @param snapshot Muestra a enviar
+ * @param include_last_update Si es true, añade /lastUpdate con el timestamp del servidor
+ * @return true si la actualización fue exitosa, false en caso contrario
+ */
+bool update_battery_snapshot(const battery_snapshot_t* snapshot, bool include_last_update) {
+    return update_battery_snapshots(&snapshot, 1, include_last_update);
+}
+
+/**
+ * @brief Actualiza en Firebase las muestras de varios packs del mismo intervalo
+ * @param snapshots Muestras a enviar, una por pack
+ * @param count Número de muestras
+ * @param include_last_update Si es true, añade /lastUpdate con el timestamp del servidor
+ * @return true si se enviaron todas las muestras
+ */
+bool update_battery_snapshots(const battery_snapshot_t* const* snapshots, uint8_t count, bool include_last_update) {
+    // Validar parámetros de entrada
+    bool valid = firebase_handle && snapshots && count > 0;
+    for (uint8_t i = 0; valid && i < count; i++) {
+        valid = snapshots[i] && snapshots[i]->cell_count > 0 && snapshots[i]->pack < PACK_MAX_COUNT;
+    }
+    if (!valid) {
+        BI_DEBUG_ERROR(g_FirebaseLogger, "Parámetros inválidos para update_battery_snapshots");
+        return false;
+    }
+    
+    // Verificar conectividad
+    if (!check_firebase_connectivity()) {
+        return false;
+    }
     
-    if (firebase_set_json(&value, json_string)) {
-        // Establecer un timeout para la operación
-        int retry_count = 0;
-        const int max_retries = 3;
+    // Datos del dispositivo: las estadísticas con cada resincronización
+    // completa del primer pack y el perfil del arranque una vez por arranque.
+    // Van detrás de los packs y solo si caben, para no impedir nunca una
+    // resincronización; si no, en su propia petición.
+    const battery_snapshot_t* lead = snapshots[0];
+    const bool diagnostics = needs_full_resync(s_packShadows[lead->pack], lead->pack_count > 1, lead->cell_count);
+    const bool bootReport = boot_profile_pending_report();
+    bool extrasPending = diagnostics || bootReport;
+    
+    // Tantas peticiones como hagan falta para que quepan todos los packs
+    uint8_t next = 0;
+    while (next < count) {
+        // Objeto principal: cada clave es una ruta bajo /batteries/{uid}
+        LATENCY_BEGIN(serializeStartUs);
+        JsonWriter writer(s_telemetryBuffer, sizeof(s_telemetryBuffer));
+        writer.beginObject();
         
-        while (retry_count < max_retries) {
-            // Verificar conectividad antes de cada intento
-            if (!check_firebase_connectivity()) {
-                firebase_free_value(&value);
-                free(json_string);
-                return false;
+        if (next == 0 && include_last_update) {
+            writer.addServerTimestamp("lastUpdate");
+        }
+        
+        // Packs en orden mientras quepan; el que no cabe se deshace y va en la siguiente petición
+        uint8_t batched = 0;
+        uint16_t fields = 0;
+        bool full[PACK_MAX_COUNT] = {};
+        char prefix[16];
+        while (next + batched < count) {
+            const battery_snapshot_t* snapshot = snapshots[next + batched];
+            const JsonWriter::Checkpoint checkpoint = writer.checkpoint();
+            
+            // Con varios packs cada muestra va en su subárbol /packs/<n>
+            if (snapshot->pack_count > 1) {
+                snprintf(prefix, sizeof(prefix), "packs/%u/", snapshot->pack);
+                writer.setKeyPrefix(prefix);
             }
+            const uint16_t packFields = write_snapshot_json(writer, s_packShadows[snapshot->pack], snapshot,
+                                                            &full[batched]);
+            writer.setKeyPrefix(nullptr);
             
-            // Enviar datos a Firebase en la ruta /batteries/{uid}/
-            if (firebase_update(firebase_handle, device_path.c_str(), &value)) {
-                BI_DEBUG_INFO(g_FirebaseLogger, "Datos del pack de batería actualizados correctamente");
-                result = true;
+            // Dejar sitio para el cierre del objeto
+            if (!writer.ok() || writer.length() + 1 >= sizeof(s_telemetryBuffer)) {
+                writer.restore(checkpoint);
                 break;
+            }
+            fields += packFields;
+            batched++;
+        }
+        
+        // Los datos del dispositivo, en la última petición si queda sitio
+        bool extrasBatched = false;
+        if (extrasPending && batched > 0 && next + batched == count) {
+            const JsonWriter::Checkpoint checkpoint = writer.checkpoint();
+            write_device_extras_json(writer, diagnostics, bootReport);
+            if (!writer.ok() || writer.length() + 1 >= sizeof(s_telemetryBuffer)) {
+                writer.restore(checkpoint);
             } else {
-                retry_count++;
-                if (retry_count < max_retries) {
-                    BI_DEBUG_WARNING(g_FirebaseLogger, "Reintentando actualización del pack (%d/%d)", 
-                                 retry_count, max_retries);
-                    vTaskDelay(pdMS_TO_TICKS(1000)); // Esperar 1 segundo antes de reintentar
-                } else {
-                    BI_DEBUG_ERROR(g_FirebaseLogger, "Error al actualizar datos del pack después de %d intentos", 
-                                  max_retries);
-                }
+                extrasBatched = true;
             }
         }
         
-        // Liberar recursos
-        firebase_free_value(&value);
+        writer.endObject();
+        LATENCY_END(LATENCY_STAGE_SERIALIZE, serializeStartUs);
+        
+        if (batched == 0 || !writer.ok()) {
+            BI_DEBUG_ERROR(g_FirebaseLogger, "Error creando JSON de la muestra del pack %u",
+                          snapshots[next]->pack);
+            return false;
+        }
+        
+        firebase_data_value_t value;
+        wrap_json_value(&value, s_telemetryBuffer);
+        
+        // Enviar celdas y pack en la misma petición a /batteries/{uid}/
+        if (!update_with_retries(s_devicePath, &value, "actualización de la muestra")) {
+            return false;
+        }
+        
+        for (uint8_t i = 0; i < batched; i++) {
+            const battery_snapshot_t* snapshot = snapshots[next + i];
+            pack_shadow_t& shadow = s_packShadows[snapshot->pack];
+            commit_cells_shadow(shadow, snapshot->pack_count > 1, snapshot->cell_count, full[i]);
+            shadow.lastBalanceState = snapshot->balance_state;
+        }
+        if (extrasBatched) {
+            extrasPending = false;
+            if (bootReport) {
+                boot_profile_set_reported();
+            }
+        }
+        
+        if (batched == 1) {
+            BI_DEBUG_INFO(g_FirebaseLogger, "Muestra de batería actualizada correctamente (%d celdas, %s, %d campos, %d bytes)",
+                         snapshots[next]->cell_count, full[0] ? "completo" : "parcial", fields, (int)writer.length());
+        } else {
+            BI_DEBUG_INFO(g_FirebaseLogger, "Muestras de %d packs actualizadas correctamente (%d campos, %d bytes)",
+                         batched, fields, (int)writer.length());
+        }
+        next += batched;
     }
     
-    free(json_string);
-    return result;
+    if (extrasPending) {
+        send_device_extras(diagnostics, bootReport);
+    }
+    return true;
 }
 
-// Tarea para simular la lectura de sensores
-void firebase_task(void *pvParameters) {
-    TickType_t last_wake_time = xTaskGetTickCount();
-    DeviceParams& params = biParams.getParams();
-    DeviceCounters& counters = biParams.getCounters();
+// Cierra la sesión actual conservando el refresh token y el UID
+static void close_session() {
     DeviceState& state = biParams.getState();
+    state.firebaseConnected = false;
+    params_cache_mark_state_dirty();
+    handle_lock();
+    if (firebase_handle) {
+        firebase_deinit(firebase_handle);
+        firebase_handle = NULL;
+    }
+    handle_unlock();
+}
 
-    while (1) {
-        if(!state.firebaseConnected)
-        {
-            if(state.wifiConnected){
-                state.firebaseConnected = init_firebase();
-                biParams.saveState();
+// Abre la sesión y registra los listeners; los anteriores terminan con su manejador
+static bool open_session() {
+    handle_lock();
+    if (firebase_handle) {
+        firebase_deinit(firebase_handle);
+        firebase_handle = NULL;
+    }
+    const bool opened = init_firebase();
+    if (opened) {
+        // Registrar listener para configuracion y commandos
+        firebase_listen(firebase_handle, s_configPath, firebase_listen_callback, (void*)RTDB_CONFIG_CHANGED);
+        firebase_listen(firebase_handle, s_commandsPath, firebase_listen_callback, (void*)RTDB_COMMAND_CHANGED);
+    }
+    handle_unlock();
+    return opened;
+}
 
-                // Registrar listener para configuracion y commandos
-                firebase_listen(firebase_handle, (device_path + "/config").c_str(), firebase_listen_callback, (void*)RTDB_CONFIG_CHANGED);
-                firebase_listen(firebase_handle, (device_path + "/commands").c_str(), firebase_listen_callback, (void*)RTDB_COMMAND_CHANGED);
-            }
-        }
+void firebase_controller_notify_link(bool up) {
+    if (up) {
+        s_linkUpUs = esp_timer_get_time();
+        s_awaitFirstUpload = true;
+        s_linkStats.linkUps++;
+    }
+    if (s_firebaseTaskHandle) {
+        xTaskNotify(s_firebaseTaskHandle, up ? FIREBASE_EVENT_LINK_UP : FIREBASE_EVENT_LINK_DOWN, eSetBits);
+    }
+}
 
-        else{
-            if(!state.wifiConnected  && state.firebaseConnected) {
-                // Desconectar de firebase
-                firebase_deinit(firebase_handle);
-                state.firebaseConnected = false;
-                biParams.saveState();
+/**
+ * @brief Máquina de estados de la sesión con Firebase
+ *
+ * OFFLINE -> CONNECTING al volver el WiFi; CONNECTING -> ONLINE si se abre la
+ * sesión o -> BACKOFF con espera exponencial y jitter si falla; ONLINE ->
+ * OFFLINE si cae el WiFi y -> CONNECTING si se pierde la autenticación. Los
+ * avisos del WiFi despiertan la tarea, así que una reconexión no espera a la
+ * siguiente comprobación periódica.
+ */
+void firebase_task(void *pvParameters) {
+    DeviceState& state = biParams.getState();
+    int64_t nextAttemptUs = 0;
+    int64_t nextMaintainUs = 0;
+    link_state_t lastState = LINK_STATE_OFFLINE;
+
+    while (1) {
+        const int64_t now = esp_timer_get_time();
+        
+        switch (s_linkStats.state) {
+            case LINK_STATE_OFFLINE:
+                if (state.wifiConnected) {
+                    s_linkStats.state = LINK_STATE_CONNECTING;
+                }
+                break;
                 
-            }
-            else{
-                // Verificar autenticación
-                if (!firebase_maintain_auth(firebase_handle)) {
-                    BI_DEBUG_ERROR(g_FirebaseLogger, "Error en el mantenimiento de la autenticación");
+            case LINK_STATE_CONNECTING:
+                if (!state.wifiConnected) {
+                    s_linkStats.state = LINK_STATE_OFFLINE;
+                } else if (open_session()) {
+                    state.firebaseConnected = true;
+                    params_cache_mark_state_dirty();
+                    s_sessionBackoff.reset();
+                    s_linkStats.lastOnlineMs = (uint32_t)((esp_timer_get_time() - s_linkUpUs) / 1000);
+                    nextMaintainUs = esp_timer_get_time() + FIREBASE_MAINTAIN_PERIOD_MS * 1000LL;
+                    s_linkStats.state = LINK_STATE_ONLINE;
+                    boot_profile_mark(BOOT_PHASE_AUTH);
+                    BI_DEBUG_INFO(g_FirebaseLogger, "Sesión abierta %lums tras volver el enlace", s_linkStats.lastOnlineMs);
+                } else {
+                    const uint32_t delayMs = s_sessionBackoff.next();
+                    nextAttemptUs = esp_timer_get_time() + delayMs * 1000LL;
+                    s_linkStats.failedAttempts++;
+                    s_linkStats.state = LINK_STATE_BACKOFF;
+                    BI_DEBUG_WARNING(g_FirebaseLogger, "Error abriendo la sesión, reintento en %lums (intento %lu)",
+                                   delayMs, s_sessionBackoff.getAttempts());
                 }
-            }
+                break;
+                
+            case LINK_STATE_BACKOFF:
+                if (!state.wifiConnected) {
+                    s_linkStats.state = LINK_STATE_OFFLINE;
+                } else if (now >= nextAttemptUs) {
+                    s_linkStats.state = LINK_STATE_CONNECTING;
+                }
+                break;
+                
+            case LINK_STATE_ONLINE:
+                if (!state.wifiConnected) {
+                    // Desconectar de firebase, sin perder la sesión
+                    close_session();
+                    s_linkStats.state = LINK_STATE_OFFLINE;
+                } else if (!state.firebaseConnected) {
+                    // check_firebase_connectivity() no pudo refrescar el token
+                    s_linkStats.state = LINK_STATE_CONNECTING;
+                } else if (now >= nextMaintainUs) {
+                    // Verificar autenticación
+                    handle_lock();
+                    const bool maintained = firebase_handle && firebase_maintain_auth(firebase_handle);
+                    handle_unlock();
+                    if (!maintained) {
+                        BI_DEBUG_ERROR(g_FirebaseLogger, "Error en el mantenimiento de la autenticación");
+                    }
+                    nextMaintainUs = now + FIREBASE_MAINTAIN_PERIOD_MS * 1000LL;
+                }
+                break;
         }
-    
-        // Dormir hasta el próximo ciclo usando el intervalo de muestreo configurado
-        vTaskDelayUntil(&last_wake_time, pdMS_TO_TICKS(params.sampleInterval * 1000));
+        
+        if (s_linkStats.state != lastState) {
+            BI_DEBUG_INFO(g_FirebaseLogger, "Enlace: %s -> %s", link_state_to_string(lastState),
+                         link_state_to_string(s_linkStats.state));
+            lastState = s_linkStats.state;
+            continue;
+        }
+        
+        // Esperar al próximo plazo del estado actual o a un aviso del WiFi
+        TickType_t wait = portMAX_DELAY;
+        const int64_t deadline = (s_linkStats.state == LINK_STATE_BACKOFF) ? nextAttemptUs :
+                                 (s_linkStats.state == LINK_STATE_ONLINE) ? nextMaintainUs : 0;
+        if (deadline != 0) {
+            const int64_t remainingMs = std::max<int64_t>(0, (deadline - esp_timer_get_time() + 999) / 1000);
+            wait = (remainingMs + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+        }
+        uint32_t events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events, wait);
     }
 }
 
 
 void firebase_controller_init(void) {
+    // Inicializar el logger
+    g_FirebaseLogger = createLogger("FIREBASE_CONTROLLER", INFO, true);
+
+    s_handleMutex = xSemaphoreCreateRecursiveMutexStatic(&s_handleMutexBuffer);
+
+    // Aplicación de /config y cola de órdenes (antes de registrar los listeners)
+    remote_config_init();
+    command_queue_init();
 
     // Crear tareas de firebase
-    xTaskCreate(firebase_task, "firebase_task", 8192, NULL, 5, NULL);
+    s_firebaseTaskHandle = s_firebaseTask.start(firebase_task, "firebase_task", NULL, FIREBASE_TASK_PRIORITY);
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define FIREBASE_CONTROLLER_H
 
 #include "../Battery/battery_controller.h"
+#include "../Storage/history_log.h"
 
 /**
  * @brief Tipo de campo cambiado en rtdb
@@ -49,8 +50,66 @@ bool update_battery_cells(const battery_cell_t* cell_data, uint8_t cell_count);
  */
 bool update_battery_pack(float voltage, float current, float power, const char* status, uint32_t uptime);
 
+/**
+ * @brief Muestra completa de la batería (celdas + pack) para enviar en una sola petición
+ */
+typedef struct {
+    CellArrays cells;                     // Datos de las celdas (SoA, como en Pack)
+    uint8_t cell_count;                   // Número de celdas válidas en cells
+    float voltage;                        // Voltaje total del pack en V
+    float current;                        // Corriente del pack en A
+    float power;                          // Potencia del pack en W
+    PackStatus status;                    // Estado del pack
+    PackStats stats;                      // Estadísticas de celdas del mismo ciclo
+    uint16_t soc_permille;                // SOC del pack en tanto por mil
+    uint32_t report_period_ms;            // Periodo de subida vigente: la siguiente muestra llega como mucho tras él
+    balance_state_t balance_state;        // Estado del balanceo
+    uint32_t balance_mask;                // Celdas descargándose (bit i = celda i)
+    uint32_t balance_seconds[MAX_CELL_COUNT]; // Tiempo total de balanceo de cada celda en s
+    uint32_t faults;                      // Fallos de protección activos (protection_fault_t)
+    SampleWindow window;                  // Agregados desde la subida anterior (solo con UPLINK_FLAG_LIVE)
+    uint32_t uptime;                      // Tiempo de funcionamiento en segundos
+    int64_t timestamp_ms;                 // Epoch en ms al tomar la muestra, 0 si no hay hora válida
+    uint8_t pack;                         // Índice del pack (0..PACK_MAX_COUNT-1)
+    uint8_t pack_count;                   // Packs configurados: con más de uno se usa /packs/<pack>
+} battery_snapshot_t;
+
+/**
+ * @brief Actualiza celdas, pack y uptime en Firebase con un único PATCH multi-ruta
+ *
+ * Sustituye a la secuencia update_battery_cells() + update_battery_pack(), que
+ * requería dos peticiones HTTPS por muestra sobre la misma ruta del dispositivo.
+ *
+ * @param snapshot Muestra a enviar
+ * @param include_last_update Si es true, añade /lastUpdate con el timestamp del servidor
+ * @return true si la actualización fue exitosa, false en caso contrario
+ */
+bool update_battery_snapshot(const battery_snapshot_t* snapshot, bool include_last_update);
+
+/**
+ * @brief Actualiza en Firebase las muestras de varios packs del mismo intervalo
+ *
+ * Con pack_count == 1 la muestra va a la raíz del dispositivo como siempre;
+ * con más packs cada una va a /packs/<pack>, con su propia sombra de celdas.
+ * Todas viajan en un único PATCH multi-ruta mientras quepan en el buffer de
+ * telemetría; las que no caben (p. ej. varias resincronizaciones completas a
+ * la vez) van en peticiones adicionales. Los diagnósticos del dispositivo y
+ * el perfil del arranque van detrás de los packs en la última petición si
+ * caben, y si no en una propia: nunca impiden subir una resincronización.
+ *
+ * @param snapshots Muestras a enviar, una por pack
+ * @param count Número de muestras
+ * @param include_last_update Si es true, añade /lastUpdate con el timestamp del servidor
+ * @return true si se enviaron todas las muestras
+ */
+bool update_battery_snapshots(const battery_snapshot_t* const* snapshots, uint8_t count, bool include_last_update);
+
 /**
  * @brief Almacena un registro histórico de la batería en Firebase
+ *
+ * Con appConfig.historyEncoding == HISTORY_ENCODING_PACKED las celdas se envían
+ * como columnas en base64 (cellsPacked) en lugar del array "cells".
+ *
  * @param cells_data Arreglo con los datos de las celdas de la batería
  * @param num_cells Número de celdas en el arreglo
  * @param voltage Voltaje total del pack en V
@@ -62,6 +121,113 @@ bool update_battery_pack(float voltage, float current, float power, const char*
 bool store_battery_history(const battery_cell_t* cells_data, uint8_t num_cells, 
     float voltage, float current, float power, const char* status);
 
+/**
+ * @brief Sube a /history un registro leído del log en flash
+ *
+ * Usa el timestamp del registro si el reloj estaba sincronizado al tomarlo;
+ * en caso contrario recurre al timestamp del servidor.
+ *
+ * @param record Registro histórico a subir
+ * @return true si el almacenamiento fue exitoso, false en caso contrario
+ */
+bool store_history_record(const history_record_t* record);
+
+/**
+ * @brief Sube varios registros a /history en un único PATCH multi-ruta
+ *
+ * Cada registro se escribe bajo una clave tipo push-id generada en el
+ * dispositivo a partir de su timestamp, y /lastUpdate se actualiza una vez
+ * por lote. Se añaden registros en orden mientras el cuerpo no supere
+ * appConfig.historyBatchMaxBytes. Requiere hora válida para generar claves
+ * ordenadas; sin ella devuelve 0 y el llamador debe usar store_history_record().
+ *
+ * @param records Registros a subir, del más antiguo al más reciente
+ * @param count Número de registros disponibles
+ * @return Número de registros (prefijo de records) almacenados
+ */
+size_t store_history_batch(const history_record_t* records, size_t count);
+
+/**
+ * @brief Estadísticas de las conexiones HTTPS con la base de datos
+ */
+typedef struct {
+    uint32_t sessions;          // Inicializaciones de Firebase (autenticación completa)
+    uint32_t connections;       // Conexiones TCP/TLS abiertas (handshakes)
+    uint32_t timedConnections;  // Conexiones abiertas dentro de una petición medida
+    uint32_t connectMsTotal;    // Tiempo acumulado hasta conectar en esas peticiones
+    uint32_t lastConnectMs;     // Tiempo de la última conexión medida
+    uint32_t requests;          // Peticiones de escritura realizadas
+    uint32_t requestMsTotal;    // Tiempo acumulado de esas peticiones
+} firebase_connection_stats_t;
+
+/**
+ * @brief Devuelve las estadísticas de conexión acumuladas desde el arranque
+ */
+const firebase_connection_stats_t* firebase_get_connection_stats(void);
+
+/**
+ * @brief Serializa una muestra completa (array de celdas y pack)
+ *
+ * Mismo formato que la resincronización completa de update_battery_snapshot(),
+ * pero sin consultar ni actualizar la sombra de /cells. Lo usa el benchmark.
+ *
+ * @param snapshot Muestra a serializar
+ * @param buffer Destino
+ * @param size Tamaño de buffer
+ * @return Longitud del JSON, 0 si no cabe
+ */
+size_t firebase_serialize_snapshot(const battery_snapshot_t* snapshot, char* buffer, size_t size);
+
+/**
+ * @brief PATCH multi-ruta de un documento JSON bajo /batteries/{uid}/<path>
+ *
+ * No copia el documento: el buffer debe seguir vivo durante la petición.
+ * Hasta 3 intentos, como el resto de actualizaciones.
+ *
+ * @param path Ruta relativa al dispositivo, sin '/' inicial
+ * @param json Documento JSON con las rutas a actualizar
+ * @param description Descripción para los logs
+ * @return true si la actualización fue exitosa
+ */
+bool update_device_json(const char* path, char* json, const char* description);
+
+/**
+ * @brief Estado de la sesión con Firebase
+ */
+typedef enum {
+    LINK_STATE_OFFLINE = 0,      // Sin WiFi
+    LINK_STATE_CONNECTING,       // Abriendo sesión y registrando listeners
+    LINK_STATE_BACKOFF,          // Esperando para reintentar tras un fallo
+    LINK_STATE_ONLINE,           // Sesión abierta y listeners activos
+} link_state_t;
+
+/**
+ * @brief Estadísticas de la máquina de estados de conexión
+ */
+typedef struct {
+    link_state_t state;
+    uint32_t linkUps;            // Veces que ha vuelto el WiFi
+    uint32_t failedAttempts;     // Intentos de sesión fallidos
+    uint32_t resumedSessions;    // Sesiones abiertas con el refresh token guardado, sin contraseña
+    uint32_t lastOnlineMs;       // Desde que vuelve el WiFi hasta tener sesión
+    uint32_t lastFirstUploadMs;  // Desde que vuelve el WiFi hasta la primera escritura correcta
+} firebase_link_stats_t;
+
+/**
+ * @brief Avisa a la tarea de Firebase de un cambio del enlace WiFi
+ *
+ * Lo llama el callback de WiFi; la tarea abre o cierra la sesión sin esperar
+ * a su próxima comprobación.
+ *
+ * @param up true si el WiFi acaba de conectar
+ */
+void firebase_controller_notify_link(bool up);
+
+/**
+ * @brief Devuelve las estadísticas de conexión de la sesión
+ */
+const firebase_link_stats_t* firebase_get_link_stats(void);
+
 /**
  * @brief Verifica si hay conectividad adecuada para operaciones con Firebase
  * @return true si hay conectividad completa, false en caso contrario
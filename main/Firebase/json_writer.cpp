@@ -0,0 +1,214 @@
+// json_writer.cpp
+#include "json_writer.h"
+#include <cmath>
+
+static constexpr uint32_t POW10[JsonWriter::MAX_DECIMALS + 1] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+JsonWriter::JsonWriter(char* buffer, size_t size)
+    : m_buffer(buffer), m_size(size) {
+    reset();
+}
+
+void JsonWriter::reset() {
+    m_length = 0;
+    m_depth = 0;
+    m_commaMask = 0;
+    m_keyPrefix = nullptr;
+    m_overflow = (m_buffer == nullptr || m_size == 0);
+    if (!m_overflow) {
+        m_buffer[0] = '\0';
+    }
+}
+
+void JsonWriter::put(char c) {
+    if (m_overflow) {
+        return;
+    }
+    // Reservar siempre el último byte para el '\0'
+    if (m_length + 1 >= m_size) {
+        m_overflow = true;
+        return;
+    }
+    m_buffer[m_length++] = c;
+    m_buffer[m_length] = '\0';
+}
+
+void JsonWriter::put(const char* text) {
+    while (*text) {
+        put(*text++);
+    }
+}
+
+void JsonWriter::putEscaped(const char* text, const char* prefix) {
+    static const char HEX[] = "0123456789abcdef";
+    put('"');
+    if (prefix) {
+        put(prefix);
+    }
+    for (; *text; ++text) {
+        const char c = *text;
+        if (c == '"' || c == '\\') {
+            put('\\');
+            put(c);
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            put("\\u00");
+            put(HEX[(c >> 4) & 0x0F]);
+            put(HEX[c & 0x0F]);
+        } else {
+            put(c);
+        }
+    }
+    put('"');
+}
+
+void JsonWriter::putUnsigned(uint64_t value, uint8_t minDigits) {
+    char digits[20];
+    uint8_t count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0 && count < sizeof(digits));
+
+    while (count < minDigits && count < sizeof(digits)) {
+        digits[count++] = '0';
+    }
+    while (count > 0) {
+        put(digits[--count]);
+    }
+}
+
+void JsonWriter::separator() {
+    const uint8_t bit = static_cast<uint8_t>(1u << m_depth);
+    if (m_commaMask & bit) {
+        put(',');
+    }
+    m_commaMask |= bit;
+}
+
+void JsonWriter::putKey(const char* key) {
+    separator();
+    if (key) {
+        putEscaped(key, m_depth == 1 ? m_keyPrefix : nullptr);
+        put(':');
+    }
+}
+
+JsonWriter& JsonWriter::beginObject(const char* key) {
+    putKey(key);
+    put('{');
+    if (m_depth + 1 < MAX_DEPTH) {
+        m_depth++;
+        m_commaMask &= static_cast<uint8_t>(~(1u << m_depth));
+    } else {
+        m_overflow = true;
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    if (m_depth > 0) {
+        m_depth--;
+    }
+    put('}');
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray(const char* key) {
+    putKey(key);
+    put('[');
+    if (m_depth + 1 < MAX_DEPTH) {
+        m_depth++;
+        m_commaMask &= static_cast<uint8_t>(~(1u << m_depth));
+    } else {
+        m_overflow = true;
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    if (m_depth > 0) {
+        m_depth--;
+    }
+    put(']');
+    return *this;
+}
+
+JsonWriter& JsonWriter::addFloat(const char* key, float value, uint8_t decimals) {
+    if (decimals > MAX_DECIMALS) {
+        decimals = MAX_DECIMALS;
+    }
+
+    putKey(key);
+
+    // NaN/inf no son JSON válido y un valor fuera del rango de uint64_t una
+    // vez escalado no se puede convertir: en ambos casos se escribe 0. No
+    // null, que en un PATCH multi-ruta borraría la clave
+    constexpr float SCALED_LIMIT = 18446744073709551616.0f;  // 2^64, exacto en float
+    const uint32_t scale = POW10[decimals];
+    const bool negative = value < 0.0f;
+    const float magnitude = (negative ? -value : value) * static_cast<float>(scale) + 0.5f;
+    if (!std::isfinite(value) || !(magnitude < SCALED_LIMIT)) {
+        put('0');
+        if (decimals > 0) {
+            put('.');
+            putUnsigned(0, decimals);
+        }
+        return *this;
+    }
+
+    // Redondear a entero escalado y escribir parte entera y decimal por separado
+    const uint64_t scaled = static_cast<uint64_t>(magnitude);
+
+    if (negative && scaled != 0) {
+        put('-');
+    }
+    putUnsigned(scaled / scale);
+    if (decimals > 0) {
+        put('.');
+        putUnsigned(scaled % scale, decimals);
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::addInt(const char* key, int64_t value) {
+    putKey(key);
+    if (value < 0) {
+        put('-');
+        putUnsigned(static_cast<uint64_t>(-(value + 1)) + 1);
+    } else {
+        putUnsigned(static_cast<uint64_t>(value));
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::addBool(const char* key, bool value) {
+    putKey(key);
+    put(value ? "true" : "false");
+    return *this;
+}
+
+JsonWriter& JsonWriter::addString(const char* key, const char* value) {
+    putKey(key);
+    putEscaped(value ? value : "");
+    return *this;
+}
+
+JsonWriter& JsonWriter::addServerTimestamp(const char* key) {
+    putKey(key);
+    put("{\".sv\":\"timestamp\"}");
+    return *this;
+}
+
+JsonWriter::Checkpoint JsonWriter::checkpoint() const {
+    return {m_length, m_depth, m_commaMask, m_overflow};
+}
+
+void JsonWriter::restore(const Checkpoint& checkpoint) {
+    m_length = checkpoint.length;
+    m_depth = checkpoint.depth;
+    m_commaMask = checkpoint.commaMask;
+    m_overflow = checkpoint.overflow;
+    if (m_buffer && m_length < m_size) {
+        m_buffer[m_length] = '\0';
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Serializador JSON en streaming sobre un buffer preasignado
+ *
+ * No reserva memoria dinámica ni usa printf: los números se formatean como
+ * enteros escalados con un número fijo de decimales, lo que además evita la
+ * aritmética de coma flotante pesada en el C3 (sin FPU). Si el contenido no
+ * cabe, ok() pasa a false y el buffer deja de crecer, pero siempre queda
+ * terminado en '\0'.
+ */
+class JsonWriter {
+public:
+    static constexpr uint8_t MAX_DEPTH = 8;
+    static constexpr uint8_t MAX_DECIMALS = 6;
+
+    /**
+     * @brief Estado guardado para poder deshacer lo escrito después
+     */
+    struct Checkpoint {
+        size_t length;
+        uint8_t depth;
+        uint8_t commaMask;
+        bool overflow;
+    };
+
+    /**
+     * @brief Constructor del serializador
+     * @param buffer Buffer de destino (no se copia)
+     * @param size Tamaño del buffer incluyendo el '\0' final
+     */
+    JsonWriter(char* buffer, size_t size);
+
+    /**
+     * @brief Vacía el buffer para empezar un documento nuevo
+     */
+    void reset();
+
+    JsonWriter& beginObject(const char* key = nullptr);
+    JsonWriter& endObject();
+    JsonWriter& beginArray(const char* key = nullptr);
+    JsonWriter& endArray();
+
+    /**
+     * @brief Añade un número con decimales fijos
+     *
+     * NaN, inf y los valores que escalados no caben en 64 bits se escriben
+     * como 0, igual que la validación anterior. No se usa null porque en un
+     * PATCH multi-ruta borra el nodo: una lectura NaN eliminaría p. ej.
+     * cells/<i>/voltage del árbol del dispositivo.
+     *
+     * @param key Clave, o nullptr dentro de un array
+     * @param value Valor a escribir
+     * @param decimals Número de decimales (0-6)
+     */
+    JsonWriter& addFloat(const char* key, float value, uint8_t decimals);
+    JsonWriter& addInt(const char* key, int64_t value);
+    JsonWriter& addBool(const char* key, bool value);
+    JsonWriter& addString(const char* key, const char* value);
+
+    /**
+     * @brief Añade el marcador de timestamp del servidor {".sv":"timestamp"}
+     */
+    JsonWriter& addServerTimestamp(const char* key);
+
+    /**
+     * @brief Antepone un prefijo a las claves del objeto raíz
+     *
+     * Permite escribir con las mismas funciones el subárbol de un pack en un
+     * PATCH multi-ruta ("packs/2/" + "cells"). El prefijo no se escapa y no se
+     * copia: debe seguir vivo mientras esté activo.
+     *
+     * @param prefix Prefijo, o nullptr para quitarlo
+     */
+    void setKeyPrefix(const char* prefix) { m_keyPrefix = prefix; }
+
+    /**
+     * @brief Guarda la posición actual para poder descartar lo que venga después
+     */
+    Checkpoint checkpoint() const;
+
+    /**
+     * @brief Descarta todo lo escrito desde el checkpoint
+     */
+    void restore(const Checkpoint& checkpoint);
+
+    /**
+     * @brief Indica si todo lo escrito cupo en el buffer
+     */
+    bool ok() const { return !m_overflow; }
+
+    const char* c_str() const { return m_buffer; }
+    size_t length() const { return m_length; }
+
+private:
+    void separator();
+    void putKey(const char* key);
+    void put(char c);
+    void put(const char* text);
+    void putEscaped(const char* text, const char* prefix = nullptr);
+    void putUnsigned(uint64_t value, uint8_t minDigits = 1);
+
+    char* m_buffer;
+    size_t m_size;
+    size_t m_length;
+    uint8_t m_depth;
+    uint8_t m_commaMask;    // Bit n: ya hay un elemento en el nivel n
+    bool m_overflow;
+    const char* m_keyPrefix; // Prefijo de las claves del nivel 1 (ver setKeyPrefix)
+};
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,476 @@
+// remote_config.cpp
+#include "remote_config.h"
+#include "../app_log.h"
+#include "bi_params.hpp"
+#include "cJSON.h"
+#include "esp_timer.h"
+#include "../custom_config.h"
+#include "../app_config.h"
+#include "../Battery/battery_controller.h"
+#include "../Diagnostics/latency_probe.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+extern BIParams biParams;
+
+// Logger para la configuración remota
+static LoggerPtr g_ConfigLogger;
+
+// Temporizador que agrupa los guardados en NVS de una ráfaga de cambios
+static esp_timer_handle_t s_saveTimer = NULL;
+
+/**
+ * @brief Opciones de una entrada de configuración
+ */
+enum {
+    CONFIG_RAM     = 0,        // Solo en AppConfig: se recibe de nuevo en cada conexión
+    CONFIG_PERSIST = 1 << 0,   // Campo de DeviceParams, se guarda en NVS
+};
+
+/**
+ * @brief Entrada de la tabla de configuración
+ *
+ * apply() valida el valor JSON, lo escribe solo si es distinto del actual y
+ * devuelve true si lo cambió.
+ */
+typedef struct {
+    const char* path;                     // Ruta relativa a /config, sin '/' inicial
+    bool (*apply)(const cJSON* item);
+    uint8_t flags;                        // Combinación de CONFIG_RAM / CONFIG_PERSIST
+    uint32_t batteryEvents;               // battery_config_event_t a notificar si cambia
+} config_entry_t;
+
+static inline DeviceParams& params() {
+    return biParams.getParams();
+}
+
+template <typename T, typename V>
+static bool assign(T& field, V value) {
+    const T converted = static_cast<T>(value);
+    if (field == converted) {
+        return false;
+    }
+    field = converted;
+    return true;
+}
+
+template <size_t N>
+static bool assign_string(char (&field)[N], const cJSON* item) {
+    if (!cJSON_IsString(item) || strncmp(field, item->valuestring, N - 1) == 0) {
+        return false;
+    }
+    strncpy(field, item->valuestring, N - 1);
+    field[N - 1] = '\0';
+    return true;
+}
+
+static bool apply_cell_count(const cJSON* item) {
+    if (!cJSON_IsNumber(item) || item->valueint == biParams.getCellCount()) {
+        return false;
+    }
+    if (!biParams.setCellCount(static_cast<uint8_t>(item->valueint))) {
+        BI_DEBUG_WARNING(g_ConfigLogger, "Invalid cell count in configuration: %d (valid range: %d-%d)",
+                       item->valueint, MIN_CELL_COUNT, MAX_CELL_COUNT);
+        return false;
+    }
+    return true;
+}
+
+static bool apply_pack_count(const cJSON* item) {
+    if (!cJSON_IsNumber(item)) {
+        return false;
+    }
+    if (item->valueint < 1 || item->valueint > PACK_MAX_COUNT) {
+        BI_DEBUG_WARNING(g_ConfigLogger, "Invalid pack count in configuration: %d (valid range: 1-%d)",
+                       item->valueint, PACK_MAX_COUNT);
+        return false;
+    }
+    return assign(appConfig.packCount, item->valueint);
+}
+
+// Celdas de un pack de packs/cellCounts; 0 (o null, o inválido) usa cellCount
+static uint8_t parse_pack_cell_count(int index, const cJSON* item) {
+    if (cJSON_IsNumber(item) && item->valueint >= MIN_CELL_COUNT && item->valueint <= MAX_CELL_COUNT) {
+        return static_cast<uint8_t>(item->valueint);
+    }
+    if (!cJSON_IsNull(item) && !(cJSON_IsNumber(item) && item->valueint == 0)) {
+        BI_DEBUG_WARNING(g_ConfigLogger, "Invalid cell count for pack %d, using cellCount", index);
+    }
+    return 0;
+}
+
+// Índice de una clave "<n>" de un array de RTDB; -1 si no es un índice menor que size
+static int parse_index(const char* key, uint8_t size) {
+    char* end = nullptr;
+    const unsigned long index = (key && *key >= '0' && *key <= '9') ? strtoul(key, &end, 10) : ULONG_MAX;
+    return (end && *end == '\0' && index < size) ? static_cast<int>(index) : -1;
+}
+
+static bool apply_pack_cell_counts(const cJSON* item) {
+    // Las celdas de todos los packs; las posiciones que faltan o son 0 usan
+    // cellCount. RTDB entrega como objeto {"3": 12} un array con huecos y
+    // como null un nodo borrado
+    uint8_t counts[PACK_MAX_COUNT] = {};
+    const cJSON* child = nullptr;
+    if (cJSON_IsArray(item)) {
+        int index = 0;
+        cJSON_ArrayForEach(child, item) {
+            if (index >= PACK_MAX_COUNT) {
+                break;
+            }
+            counts[index] = parse_pack_cell_count(index, child);
+            index++;
+        }
+    } else if (cJSON_IsObject(item)) {
+        cJSON_ArrayForEach(child, item) {
+            const int index = parse_index(child->string, PACK_MAX_COUNT);
+            if (index >= 0) {
+                counts[index] = parse_pack_cell_count(index, child);
+            }
+        }
+    } else if (!cJSON_IsNull(item)) {
+        return false;
+    }
+    if (memcmp(counts, appConfig.packCellCounts, sizeof(counts)) == 0) {
+        return false;
+    }
+    memcpy(appConfig.packCellCounts, counts, sizeof(counts));
+    return true;
+}
+
+static bool apply_pack_cell_count(uint8_t index, const cJSON* item) {
+    // Un solo pack, p. ej. tras editar packs/cellCounts/3 en la consola
+    return assign(appConfig.packCellCounts[index], parse_pack_cell_count(index, item));
+}
+
+static bool apply_sample_interval(const cJSON* item) {
+    // reporting.interval llega en ms; el parámetro se guarda en segundos (mínimo 1)
+    return cJSON_IsNumber(item) && assign(params().sampleInterval, std::max(1, item->valueint / 1000));
+}
+
+static bool apply_history_interval(const cJSON* item) {
+    return cJSON_IsNumber(item) &&
+           assign(appConfig.historyIntervalMs, std::max<double>(item->valuedouble, HISTORY_MIN_INTERVAL_MS));
+}
+
+static bool apply_history_batch_max_bytes(const cJSON* item) {
+    return cJSON_IsNumber(item) &&
+           assign(appConfig.historyBatchMaxBytes,
+                  std::min<double>(std::max<double>(item->valuedouble, HISTORY_BATCH_MIN_BYTES), HISTORY_BATCH_BUFFER_SIZE));
+}
+
+static bool apply_history_encoding(const cJSON* item) {
+    // "json" (por defecto) o "packed"
+    return cJSON_IsString(item) &&
+           assign(appConfig.historyEncoding, strcmp(item->valuestring, "packed") == 0 ?
+                                             HISTORY_ENCODING_PACKED : HISTORY_ENCODING_JSON);
+}
+
+// Todas las claves conocidas de /config
+static const config_entry_t CONFIG_ENTRIES[] = {
+    {"name", [](const cJSON* item) { return assign_string(params().deviceName, item); }, CONFIG_PERSIST, BATTERY_CONFIG_NONE},
+    {"model", [](const cJSON* item) { return assign_string(params().deviceModel, item); }, CONFIG_PERSIST, BATTERY_CONFIG_NONE},
+    {"cellCount", apply_cell_count, CONFIG_PERSIST, BATTERY_CONFIG_CELL_COUNT},
+    {"capacity", [](const cJSON* item) {
+        // Capacidad nominal de cada celda en mAh
+        return cJSON_IsNumber(item) && item->valuedouble >= 1 && assign(appConfig.cellCapacityMah, item->valuedouble);
+    }, CONFIG_RAM, BATTERY_CONFIG_CAPACITY},
+    {"packs/count", apply_pack_count, CONFIG_RAM, BATTERY_CONFIG_PACKS},
+    {"packs/cellCounts", apply_pack_cell_counts, CONFIG_RAM, BATTERY_CONFIG_PACKS},
+    {"reporting/interval", apply_sample_interval, CONFIG_PERSIST, BATTERY_CONFIG_INTERVALS},
+    {"reporting/samplePeriod", [](const cJSON* item) {
+        // En ms; puede bajar de 1 s sin acelerar la subida en tiempo real
+        return cJSON_IsNumber(item) &&
+               assign(appConfig.samplePeriodMs, std::max<double>(item->valuedouble, BATTERY_MIN_SAMPLE_PERIOD_MS));
+    }, CONFIG_RAM, BATTERY_CONFIG_INTERVALS},
+    {"reporting/adaptive", [](const cJSON* item) {
+        return cJSON_IsBool(item) && assign(appConfig.reportAdaptive, cJSON_IsTrue(item) != 0);
+    }, CONFIG_RAM, BATTERY_CONFIG_INTERVALS},
+    {"reporting/minPeriod", [](const cJSON* item) {
+        // En ms; el periodo adaptativo nunca baja de aquí
+        return cJSON_IsNumber(item) &&
+               assign(appConfig.reportMinPeriodMs, std::max<double>(item->valuedouble, LIVE_MIN_INTERVAL_MS));
+    }, CONFIG_RAM, BATTERY_CONFIG_INTERVALS},
+    {"reporting/maxPeriod", [](const cJSON* item) {
+        // En ms; periodo con el pack en reposo
+        return cJSON_IsNumber(item) &&
+               assign(appConfig.reportMaxPeriodMs, std::max<double>(item->valuedouble, LIVE_MIN_INTERVAL_MS));
+    }, CONFIG_RAM, BATTERY_CONFIG_INTERVALS},
+
+    // Bandas muertas de la telemetría en tiempo real
+    {"telemetry/voltageDeadband", [](const cJSON* item) {
+        // En mV
+        return cJSON_IsNumber(item) && item->valuedouble >= 0 && assign(appConfig.voltageDeadbandMv, item->valuedouble);
+    }, CONFIG_RAM, BATTERY_CONFIG_NONE},
+    {"telemetry/temperatureDeadband", [](const cJSON* item) {
+        // En °C, se guarda en décimas
+        return cJSON_IsNumber(item) && item->valuedouble >= 0 &&
+               assign(appConfig.temperatureDeadbandDc, lround(item->valuedouble * 10.0));
+    }, CONFIG_RAM, BATTERY_CONFIG_NONE},
+    {"telemetry/socStep", [](const cJSON* item) {
+        return cJSON_IsNumber(item) && item->valueint >= 0 && assign(appConfig.socStep, item->valueint);
+    }, CONFIG_RAM, BATTERY_CONFIG_NONE},
+    {"telemetry/sohStep", [](const cJSON* item) {
+        return cJSON_IsNumber(item) && item->valueint >= 0 && assign(appConfig.sohStep, item->valueint);
+    }, CONFIG_RAM, BATTERY_CONFIG_NONE},
+    {"telemetry/fullResyncSamples", [](const cJSON* item) {
+        return cJSON_IsNumber(item) && assign(appConfig.telemetryFullResyncSamples, std::max(1, item->valueint));
+    }, CONFIG_RAM, BATTERY_CONFIG_NONE},
+
+    // Históricos
+    {"history/interval", apply_history_interval, CONFIG_RAM, BATTERY_CONFIG_INTERVALS},
+    {"history/batchMaxBytes", apply_history_batch_max_bytes, CONFIG_RAM, BATTERY_CONFIG_NONE},
+    {"history/encoding", apply_history_encoding, CONFIG_RAM, BATTERY_CONFIG_NONE},
+
+    // Alimentación
+    {"power/autoShutdown", [](const cJSON* item) {
+        return cJSON_IsBool(item) && assign(params().deepSleepEnabled, cJSON_IsTrue(item) != 0);
+    }, CONFIG_PERSIST, BATTERY_CONFIG_NONE},
+    {"power/wifiMode", [](const cJSON* item) {
+        // "on", "modem" (por defecto) o "duty"
+        if (!cJSON_IsString(item)) {
+            return false;
+        }
+        wifi_power_mode_t mode = WIFI_POWER_MODEM_SLEEP;
+        if (strcmp(item->valuestring, "on") == 0) {
+            mode = WIFI_POWER_ALWAYS_ON;
+        } else if (strcmp(item->valuestring, "duty") == 0) {
+            mode = WIFI_POWER_DUTY_CYCLE;
+        }
+        return assign(appConfig.wifiPowerMode, mode);
+    }, CONFIG_RAM, BATTERY_CONFIG_NONE},
+    {"power/listenInterval", [](const cJSON* item) {
+        return cJSON_IsNumber(item) && assign(appConfig.wifiListenInterval, std::min(std::max(1, item->valueint), 100));
+    }, CONFIG_RAM, BATTERY_CONFIG_NONE},
+    {"power/wifiBurstPeriod", [](const cJSON* item) {
+        // En ms, entre la duración mínima de una ráfaga y WIFI_BURST_PERIOD_MAX_MS
+        return cJSON_IsNumber(item) && assign(appConfig.wifiBurstPeriodMs,
+                                              std::clamp<double>(item->valuedouble, WIFI_BURST_MIN_MS, WIFI_BURST_PERIOD_MAX_MS));
+    }, CONFIG_RAM, BATTERY_CONFIG_NONE},
+    // Actualizaciones: la orden "ota" descarga <baseUrl>/<versión>.bin
+    {"ota/baseUrl", [](const cJSON* item) {
+        return cJSON_IsString(item) && strncmp(item->valuestring, "https://", 8) == 0 &&
+               assign_string(appConfig.otaBaseUrl, item);
+    }, CONFIG_RAM, BATTERY_CONFIG_NONE},
+
+#if LATENCY_PROBES
+    // Diagnóstico
+    {"diagnostics/latency", [](const cJSON* item) {
+        return cJSON_IsBool(item) && assign(appConfig.latencyProbes, cJSON_IsTrue(item) != 0);
+    }, CONFIG_RAM, BATTERY_CONFIG_NONE},
+#endif
+    {"power/shutdownVoltage", [](const cJSON* item) {
+        return cJSON_IsNumber(item) && assign(params().shutdownVoltage, item->valuedouble);
+    }, CONFIG_PERSIST, BATTERY_CONFIG_NONE},
+    {"power/maxCurrent", [](const cJSON* item) {
+        return cJSON_IsNumber(item) && assign(params().maxCurrent, item->valuedouble);
+    }, CONFIG_PERSIST, BATTERY_CONFIG_NONE},
+
+    // Alertas
+    {"alerts/highTemp", [](const cJSON* item) {
+        return cJSON_IsNumber(item) && assign(params().alertHighTemp, item->valuedouble);
+    }, CONFIG_PERSIST, BATTERY_CONFIG_NONE},
+    {"alerts/lowTemp", [](const cJSON* item) {
+        return cJSON_IsNumber(item) && assign(params().alertLowTemp, item->valuedouble);
+    }, CONFIG_PERSIST, BATTERY_CONFIG_NONE},
+    {"alerts/highVoltage", [](const cJSON* item) {
+        return cJSON_IsNumber(item) && assign(params().alertHighVoltage, item->valuedouble);
+    }, CONFIG_PERSIST, BATTERY_CONFIG_NONE},
+    {"alerts/lowVoltage", [](const cJSON* item) {
+        return cJSON_IsNumber(item) && assign(params().alertLowVoltage, item->valuedouble);
+    }, CONFIG_PERSIST, BATTERY_CONFIG_NONE},
+
+    // Balanceo
+    {"balancing/enabled", [](const cJSON* item) {
+        return cJSON_IsBool(item) && assign(params().balancingEnabled, cJSON_IsTrue(item) != 0);
+    }, CONFIG_PERSIST, BATTERY_CONFIG_NONE},
+    {"balancing/threshold", [](const cJSON* item) {
+        return cJSON_IsNumber(item) && assign(params().balancingThreshold, item->valuedouble);
+    }, CONFIG_PERSIST, BATTERY_CONFIG_NONE},
+};
+
+/**
+ * @brief Entrada de la tabla de configuración con un valor por índice
+ *
+ * Además de la ruta completa (que sigue en CONFIG_ENTRIES), los eventos de
+ * streaming pueden llegar a un único elemento, "<path>/<n>".
+ */
+typedef struct {
+    const char* path;                     // Ruta del array, relativa a /config
+    uint8_t size;                         // Índices válidos: 0..size-1
+    bool (*apply)(uint8_t index, const cJSON* item);
+    uint8_t flags;                        // Combinación de CONFIG_RAM / CONFIG_PERSIST
+    uint32_t batteryEvents;               // battery_config_event_t a notificar si cambia
+} config_indexed_entry_t;
+
+static const config_indexed_entry_t CONFIG_INDEXED_ENTRIES[] = {
+    {"packs/cellCounts", PACK_MAX_COUNT, apply_pack_cell_count, CONFIG_RAM, BATTERY_CONFIG_PACKS},
+};
+
+/**
+ * @brief Resultado acumulado de aplicar un evento
+ */
+typedef struct {
+    uint8_t flags;              // CONFIG_PERSIST si cambió algún parámetro persistente
+    uint32_t batteryEvents;     // Eventos para la tarea de batería
+    uint16_t changed;           // Campos modificados
+} config_result_t;
+
+static const config_entry_t* find_entry(const char* path) {
+    for (const config_entry_t& entry : CONFIG_ENTRIES) {
+        if (strcmp(entry.path, path) == 0) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+// Entrada indexada de la que path es un elemento ("<ruta>/<n>")
+static const config_indexed_entry_t* find_indexed_entry(const char* path, uint8_t* index) {
+    for (const config_indexed_entry_t& entry : CONFIG_INDEXED_ENTRIES) {
+        const size_t length = strlen(entry.path);
+        if (strncmp(entry.path, path, length) != 0 || path[length] != '/') {
+            continue;
+        }
+        const int value = parse_index(path + length + 1, entry.size);
+        if (value < 0) {
+            BI_DEBUG_WARNING(g_ConfigLogger, "Config '%s' ignored: index out of range (0-%d)", path, entry.size - 1);
+            return nullptr;
+        }
+        *index = static_cast<uint8_t>(value);
+        return &entry;
+    }
+    return nullptr;
+}
+
+static void note_change(config_result_t* result, uint8_t flags, uint32_t batteryEvents, const char* path) {
+    result->flags |= flags;
+    result->batteryEvents |= batteryEvents;
+    result->changed++;
+    BI_DEBUG_INFO(g_ConfigLogger, "Config '%s' updated", path);
+}
+
+// Recorre solo los nodos recibidos, componiendo su ruta en path
+static void apply_node(char* path, size_t length, size_t size, const cJSON* node, config_result_t* result) {
+    const config_entry_t* entry = find_entry(path);
+    if (entry) {
+        if (entry->apply(node)) {
+            note_change(result, entry->flags, entry->batteryEvents, path);
+        }
+        return;
+    }
+
+    uint8_t index = 0;
+    const config_indexed_entry_t* indexed = find_indexed_entry(path, &index);
+    if (indexed) {
+        if (indexed->apply(index, node)) {
+            note_change(result, indexed->flags, indexed->batteryEvents, path);
+        }
+        return;
+    }
+
+    if (!cJSON_IsObject(node)) {
+        BI_DEBUG_VERBOSE(g_ConfigLogger, "Config '%s' ignored", path);
+        return;
+    }
+
+    const cJSON* child = nullptr;
+    cJSON_ArrayForEach(child, node) {
+        if (!child->string) {
+            continue;
+        }
+        int written = snprintf(path + length, size - length, length > 0 ? "/%s" : "%s", child->string);
+        if (written > 0 && length + written < size) {
+            apply_node(path, length + written, size, child, result);
+        }
+        path[length] = '\0';
+    }
+}
+
+static void save_timer_callback(void* arg) {
+    LATENCY_PROBE(LATENCY_STAGE_NVS_COMMIT);
+    biParams.saveParams();
+    BI_DEBUG_INFO(g_ConfigLogger, "Configuration saved to NVS");
+}
+
+void remote_config_init(void) {
+    g_ConfigLogger = createLogger("REMOTE_CONFIG", INFO, DEBUG_FIREBASE);
+
+    // esp_timer en lugar de un temporizador FreeRTOS: su tarea tiene pila
+    // suficiente para el commit de NVS
+    const esp_timer_create_args_t timer_args = {
+        .callback = save_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "config_save",
+        .skip_unhandled_events = true,
+    };
+    if (esp_timer_create(&timer_args, &s_saveTimer) != ESP_OK) {
+        BI_DEBUG_ERROR(g_ConfigLogger, "Failed to create config save timer, saving immediately");
+        s_saveTimer = NULL;
+    }
+}
+
+bool remote_config_handle_event(const char* json) {
+    if (!json) {
+        return false;
+    }
+
+    cJSON* root = cJSON_Parse(json);
+    if (!root) {
+        BI_DEBUG_ERROR(g_ConfigLogger, "Error parsing configuration JSON");
+        return false;
+    }
+
+    // Evento de streaming {"path": ..., "data": ...}; cualquier otra cosa es la raíz
+    const cJSON* data = root;
+    const char* event_path = "";
+    const cJSON* path_item = cJSON_GetObjectItem(root, "path");
+    const cJSON* data_item = cJSON_GetObjectItem(root, "data");
+    if (path_item && data_item && cJSON_IsString(path_item) && cJSON_GetArraySize(root) == 2) {
+        event_path = path_item->valuestring;
+        data = data_item;
+    }
+
+    // Normalizar la ruta: sin '/' inicial ni final
+    char path[64];
+    while (*event_path == '/') {
+        event_path++;
+    }
+    size_t length = strlen(event_path);
+    if (length >= sizeof(path)) {
+        BI_DEBUG_WARNING(g_ConfigLogger, "Config path too long: %s", event_path);
+        cJSON_Delete(root);
+        return false;
+    }
+    memcpy(path, event_path, length + 1);
+    while (length > 0 && path[length - 1] == '/') {
+        path[--length] = '\0';
+    }
+
+    config_result_t result = {};
+    apply_node(path, length, sizeof(path), data, &result);
+    cJSON_Delete(root);
+
+    if (result.changed == 0) {
+        BI_DEBUG_VERBOSE(g_ConfigLogger, "Config event without changes");
+        return true;
+    }
+
+    // Un único guardado en NVS por ráfaga de ediciones
+    if (result.flags & CONFIG_PERSIST) {
+        if (s_saveTimer) {
+            esp_timer_stop(s_saveTimer);
+            esp_timer_start_once(s_saveTimer, REMOTE_CONFIG_SAVE_DEBOUNCE_MS * 1000ULL);
+        } else {
+            biParams.saveParams();
+        }
+    }
+
+    // Avisar a la tarea de batería una vez escritos todos los valores
+    battery_controller_notify_config(result.batteryEvents);
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef REMOTE_CONFIG_H
+#define REMOTE_CONFIG_H
+
+/**
+ * @brief Inicializa la aplicación de la configuración recibida por /config
+ *
+ * Crea el temporizador que agrupa los guardados en NVS. Debe llamarse antes de
+ * registrar el listener de /config.
+ */
+void remote_config_init(void);
+
+/**
+ * @brief Aplica un evento del listener de /config
+ *
+ * Acepta tanto el sobre de los eventos de streaming de RTDB
+ * ({"path": "/alerts/highTemp", "data": 55}) como un documento sin sobre, que
+ * se interpreta como la raíz de /config. Solo se tocan los campos presentes en
+ * "data" y solo se escriben los que cambian de valor. Los parámetros
+ * persistentes se guardan en NVS una única vez tras REMOTE_CONFIG_SAVE_DEBOUNCE_MS
+ * sin nuevos cambios.
+ *
+ * @param json Evento recibido, terminado en '\0'
+ * @return true si el evento se pudo interpretar
+ */
+bool remote_config_handle_event(const char* json);
+
+#endif // REMOTE_CONFIG_H
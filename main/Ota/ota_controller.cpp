@@ -0,0 +1,176 @@
+// ota_controller.cpp
+#include "ota_controller.h"
+#include "../app_log.h"
+#include "esp_https_ota.h"
+#include "esp_ota_ops.h"
+#include "esp_app_desc.h"
+#include "esp_crt_bundle.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "../custom_config.h"
+#include "../app_config.h"
+#include "../Firebase/firebase_controller.h"
+#include "../Firebase/json_writer.h"
+#include <cstdio>
+#include <cstring>
+
+// Logger de las actualizaciones
+static LoggerPtr g_OtaLogger;
+
+// Solo una actualización a la vez; la tarea la borra al terminar con error
+static volatile bool s_running = false;
+static volatile bool s_pendingVerify = false;
+
+static char s_url[OTA_URL_SIZE];
+static char s_version[COMMAND_VALUE_SIZE];
+
+/**
+ * @brief Escribe el estado de la actualización en diagnostics/ota
+ */
+static void report_status(const char* state, int progress, const char* error) {
+    char buffer[OTA_STATUS_BUFFER_SIZE];
+    JsonWriter writer(buffer, sizeof(buffer));
+    writer.beginObject();
+    writer.addString("state", state);
+    writer.addString("version", s_version);
+    writer.addInt("progress", progress);
+    writer.addString("running", esp_app_get_description()->version);
+    if (error) {
+        writer.addString("error", error);
+    }
+    writer.addServerTimestamp("updatedAt");
+    writer.endObject();
+
+    if (writer.ok()) {
+        update_device_json("diagnostics/ota", buffer, "estado de la actualización");
+    }
+}
+
+static void ota_task(void* pvParameters) {
+    esp_http_client_config_t http_config = {};
+    http_config.url = s_url;
+    http_config.timeout_ms = OTA_HTTP_TIMEOUT_MS;
+    http_config.crt_bundle_attach = esp_crt_bundle_attach;
+    http_config.keep_alive_enable = true;
+
+    // Descarga por rangos: peticiones cortas que aguantan mejor un enlace débil
+    esp_https_ota_config_t ota_config = {};
+    ota_config.http_config = &http_config;
+    ota_config.partial_http_download = true;
+    ota_config.max_http_request_size = OTA_HTTP_REQUEST_SIZE;
+
+    const char* error = nullptr;
+    esp_https_ota_handle_t handle = nullptr;
+    esp_err_t err = esp_https_ota_begin(&ota_config, &handle);
+    if (err != ESP_OK) {
+        error = esp_err_to_name(err);
+    }
+
+    // La cabecera llega con el primer bloque: descartar la versión que ya corre
+    esp_app_desc_t image = {};
+    if (!error && esp_https_ota_get_img_desc(handle, &image) == ESP_OK &&
+        strncmp(image.version, esp_app_get_description()->version, sizeof(image.version)) == 0) {
+        error = "Version already running";
+    }
+
+    if (!error) {
+        BI_DEBUG_INFO(g_OtaLogger, "Downloading %s (%d bytes)", image.version, esp_https_ota_get_image_size(handle));
+        report_status("downloading", 0, nullptr);
+
+        int lastDecile = 0;
+        while ((err = esp_https_ota_perform(handle)) == ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
+            const int total = esp_https_ota_get_image_size(handle);
+            const int progress = total > 0 ? (int)(100LL * esp_https_ota_get_image_len_read(handle) / total) : 0;
+            if (progress / 10 > lastDecile) {
+                lastDecile = progress / 10;
+                BI_DEBUG_INFO(g_OtaLogger, "Download %d%%", progress);
+            }
+        }
+        if (err != ESP_OK) {
+            error = esp_err_to_name(err);
+        } else if (!esp_https_ota_is_complete_data_received(handle)) {
+            error = "Incomplete image";
+        }
+    }
+
+    if (error) {
+        if (handle) {
+            esp_https_ota_abort(handle);
+        }
+        BI_DEBUG_ERROR(g_OtaLogger, "OTA %s failed: %s", s_version, error);
+        report_status("failed", 0, error);
+        s_running = false;
+        vTaskDelete(NULL);
+        return;
+    }
+
+    // Comprueba la imagen completa (SHA-256) y la deja como siguiente arranque
+    err = esp_https_ota_finish(handle);
+    if (err != ESP_OK) {
+        BI_DEBUG_ERROR(g_OtaLogger, "OTA %s validation failed: %s", s_version, esp_err_to_name(err));
+        report_status("failed", 100, esp_err_to_name(err));
+        s_running = false;
+        vTaskDelete(NULL);
+        return;
+    }
+
+    BI_DEBUG_INFO(g_OtaLogger, "OTA %s installed, restarting", s_version);
+    report_status("installed", 100, nullptr);
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    esp_restart();
+}
+
+void ota_controller_init(void) {
+    g_OtaLogger = createLogger("OTA", INFO, DEBUG_MAIN);
+
+    esp_ota_img_states_t state;
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    if (running && esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY) {
+        s_pendingVerify = true;
+        BI_DEBUG_WARNING(g_OtaLogger, "Image %s pending verification, rollback if sampling does not start",
+                       esp_app_get_description()->version);
+    }
+}
+
+bool ota_controller_start(const char* version, char* result, size_t size) {
+    if (s_running) {
+        snprintf(result, size, "OTA already in progress");
+        return false;
+    }
+    if (appConfig.otaBaseUrl[0] == '\0') {
+        snprintf(result, size, "OTA base URL not configured");
+        return false;
+    }
+    if (!version || version[0] == '\0' || strchr(version, '/')) {
+        snprintf(result, size, "Invalid OTA version");
+        return false;
+    }
+    if (snprintf(s_url, sizeof(s_url), "%s/%s.bin", appConfig.otaBaseUrl, version) >= (int)sizeof(s_url)) {
+        snprintf(result, size, "OTA URL too long");
+        return false;
+    }
+
+    strncpy(s_version, version, sizeof(s_version) - 1);
+    s_version[sizeof(s_version) - 1] = '\0';
+
+    // Tarea de vida corta: su pila vuelve al heap si la actualización falla
+    s_running = true;
+    if (xTaskCreate(ota_task, "ota_task", OTA_TASK_STACK_SIZE, NULL, OTA_TASK_PRIORITY, NULL) != pdPASS) {
+        s_running = false;
+        snprintf(result, size, "Failed to start OTA task");
+        return false;
+    }
+    snprintf(result, size, "OTA to %s started", version);
+    return true;
+}
+
+void ota_controller_confirm_image(void) {
+    if (!s_pendingVerify) {
+        return;
+    }
+    s_pendingVerify = false;
+    if (esp_ota_mark_app_valid_cancel_rollback() == ESP_OK) {
+        BI_DEBUG_INFO(g_OtaLogger, "Image %s confirmed", esp_app_get_description()->version);
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef OTA_CONTROLLER_H
+#define OTA_CONTROLLER_H
+
+#include <cstddef>
+
+/**
+ * @brief Comprueba el estado de la imagen en ejecución
+ *
+ * Tras una actualización la imagen arranca pendiente de verificar: si no se
+ * confirma con ota_controller_confirm_image() antes del siguiente reinicio, el
+ * bootloader vuelve a la anterior.
+ */
+void ota_controller_init(void);
+
+/**
+ * @brief Inicia la descarga de una imagen en su propia tarea
+ *
+ * La URL es appConfig.otaBaseUrl + "/" + version + ".bin". La imagen se
+ * escribe en la partición OTA libre según llega, en peticiones de
+ * OTA_HTTP_REQUEST_SIZE bytes, sin guardarla en RAM. Al terminar reinicia
+ * con la nueva imagen. El progreso y el resultado se escriben en
+ * diagnostics/ota.
+ *
+ * @param version Versión a instalar
+ * @param result Destino del texto de resultado
+ * @param size Tamaño de result
+ * @return true si la descarga se ha iniciado
+ */
+bool ota_controller_start(const char* version, char* result, size_t size);
+
+/**
+ * @brief Confirma la imagen en ejecución si estaba pendiente de verificar
+ *
+ * La llama la tarea de batería tras OTA_HEALTHY_SAMPLES muestras seguidas
+ * del pack 0 leídas bien: la imagen arranca, planifica el muestreo y lee las
+ * celdas, así que no hay que volver a la anterior. No depende de la red, de
+ * modo que una imagen buena que reinicia sin WiFi no se revierte. Solo la
+ * primera llamada tras una actualización escribe en flash (otadata).
+ */
+void ota_controller_confirm_image(void);
+
+#endif // OTA_CONTROLLER_H
@@ -0,0 +1,153 @@
+// params_cache.cpp
+#include "params_cache.h"
+#include "../app_log.h"
+#include "bi_params.hpp"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "../custom_config.h"
+#include "../Diagnostics/latency_probe.h"
+
+extern BIParams biParams;
+
+// Logger para la escritura diferida de parámetros
+static LoggerPtr g_ParamsCacheLogger;
+
+// Nombres en BIParams, en el orden de params_counter_t
+static const char* const COUNTER_NAMES[PARAMS_COUNTER_MAX] = {
+    "dataPoints",
+    "errorCount",
+    "wifiConnectCount",
+    "wifiFailCount",
+};
+
+// Incrementos acumulados desde el último volcado
+static uint32_t s_pendingCounters[PARAMS_COUNTER_MAX] = {};
+static bool s_stateDirty = false;
+
+// Serializa el volcado: lo pueden pedir el temporizador, el apagado y las tareas
+static SemaphoreHandle_t s_flushMutex = NULL;
+static esp_timer_handle_t s_flushTimer = NULL;
+
+// Volcado a petición (params_cache_flush_async) y su continuación
+static esp_timer_handle_t s_asyncFlushTimer = NULL;
+static volatile params_flush_done_t s_asyncFlushDone = nullptr;
+
+void params_cache_increment(params_counter_t counter, uint32_t delta) {
+    if (counter < PARAMS_COUNTER_MAX) {
+        __atomic_fetch_add(&s_pendingCounters[counter], delta, __ATOMIC_RELAXED);
+    }
+}
+
+void params_cache_set_state(const char* name, const void* value, size_t size) {
+    biParams.updateStateValue(name, value, size, false);
+    params_cache_mark_state_dirty();
+}
+
+void params_cache_mark_state_dirty(void) {
+    __atomic_store_n(&s_stateDirty, true, __ATOMIC_RELEASE);
+}
+
+void params_cache_flush(void) {
+    if (s_flushMutex && xSemaphoreTake(s_flushMutex, pdMS_TO_TICKS(1000)) != pdTRUE) {
+        BI_DEBUG_WARNING(g_ParamsCacheLogger, "Flush already in progress, skipped");
+        return;
+    }
+
+    // Aplicar los incrementos en RAM y guardar una sola vez con el último
+    int last = -1;
+    uint32_t deltas[PARAMS_COUNTER_MAX];
+    for (int i = 0; i < PARAMS_COUNTER_MAX; ++i) {
+        deltas[i] = __atomic_exchange_n(&s_pendingCounters[i], 0, __ATOMIC_RELAXED);
+        if (deltas[i] > 0) {
+            last = i;
+        }
+    }
+    for (int i = 0; i <= last; ++i) {
+        if (i == last) {
+            // Solo el último incremento guarda en NVS
+            LATENCY_PROBE(LATENCY_STAGE_NVS_COMMIT);
+            biParams.incrementCounter(COUNTER_NAMES[i], deltas[i], true);
+        } else if (deltas[i] > 0) {
+            biParams.incrementCounter(COUNTER_NAMES[i], deltas[i], false);
+        }
+    }
+
+    if (__atomic_exchange_n(&s_stateDirty, false, __ATOMIC_ACQ_REL)) {
+        LATENCY_PROBE(LATENCY_STAGE_NVS_COMMIT);
+        biParams.saveState();
+    }
+
+    if (last >= 0) {
+        BI_DEBUG_VERBOSE(g_ParamsCacheLogger, "Counters flushed to NVS");
+    }
+
+    if (s_flushMutex) {
+        xSemaphoreGive(s_flushMutex);
+    }
+}
+
+static void flush_timer_callback(void* arg) {
+    params_cache_flush();
+}
+
+static void async_flush_callback(void* arg) {
+    params_cache_flush();
+    const params_flush_done_t done = s_asyncFlushDone;
+    s_asyncFlushDone = nullptr;
+    if (done) {
+        done();
+    }
+}
+
+void params_cache_flush_async(params_flush_done_t done) {
+    s_asyncFlushDone = done;
+    if (s_asyncFlushTimer && esp_timer_start_once(s_asyncFlushTimer, 0) == ESP_OK) {
+        return;
+    }
+
+    // Sin temporizador (o con un volcado diferido aún pendiente) se vuelca aquí
+    s_asyncFlushDone = nullptr;
+    params_cache_flush();
+    if (done) {
+        done();
+    }
+}
+
+void params_cache_init(void) {
+    g_ParamsCacheLogger = createLogger("PARAMS_CACHE", INFO, DEBUG_PARAMS);
+
+    s_flushMutex = xSemaphoreCreateMutex();
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = flush_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "params_flush",
+        .skip_unhandled_events = true,
+    };
+    if (esp_timer_create(&timer_args, &s_flushTimer) != ESP_OK ||
+        esp_timer_start_periodic(s_flushTimer, PARAMS_FLUSH_PERIOD_MS * 1000ULL) != ESP_OK) {
+        BI_DEBUG_ERROR(g_ParamsCacheLogger, "Failed to start params flush timer");
+    }
+
+    const esp_timer_create_args_t async_args = {
+        .callback = async_flush_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "params_flush_async",
+        .skip_unhandled_events = false,
+    };
+    if (esp_timer_create(&async_args, &s_asyncFlushTimer) != ESP_OK) {
+        BI_DEBUG_ERROR(g_ParamsCacheLogger, "Failed to create async params flush timer");
+        s_asyncFlushTimer = NULL;
+    }
+
+    // Los reinicios con esp_restart() vuelcan antes; los pánicos y el brownout no
+    if (esp_register_shutdown_handler(params_cache_flush) != ESP_OK) {
+        BI_DEBUG_ERROR(g_ParamsCacheLogger, "Failed to register shutdown handler");
+    }
+
+    BI_DEBUG_INFO(g_ParamsCacheLogger, "Write-behind params enabled (flush every %d ms)", PARAMS_FLUSH_PERIOD_MS);
+}
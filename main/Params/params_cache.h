@@ -0,0 +1,70 @@
+#ifndef PARAMS_CACHE_H
+#define PARAMS_CACHE_H
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @brief Contadores de DeviceCounters que se actualizan en caliente
+ */
+typedef enum {
+    PARAMS_COUNTER_DATA_POINTS = 0,     // "dataPoints"
+    PARAMS_COUNTER_ERROR_COUNT,         // "errorCount"
+    PARAMS_COUNTER_WIFI_CONNECT,        // "wifiConnectCount"
+    PARAMS_COUNTER_WIFI_FAIL,           // "wifiFailCount"
+    PARAMS_COUNTER_MAX
+} params_counter_t;
+
+/**
+ * @brief Inicializa la escritura diferida de contadores y estado
+ *
+ * Arranca el volcado periódico a NVS (PARAMS_FLUSH_PERIOD_MS) y registra un
+ * manejador de apagado para volcar antes de esp_restart().
+ */
+void params_cache_init(void);
+
+/**
+ * @brief Incrementa un contador solo en RAM; se guarda en el próximo volcado
+ * @param counter Contador a incrementar
+ * @param delta Incremento
+ */
+void params_cache_increment(params_counter_t counter, uint32_t delta = 1);
+
+/**
+ * @brief Actualiza un valor de DeviceState en RAM y lo marca para guardar
+ * @param name Nombre del campo (como en BIParams::updateStateValue)
+ * @param value Nuevo valor
+ * @param size Tamaño del valor
+ */
+void params_cache_set_state(const char* name, const void* value, size_t size);
+
+/**
+ * @brief Marca DeviceState como modificado tras escribir sus campos directamente
+ */
+void params_cache_mark_state_dirty(void);
+
+/**
+ * @brief Vuelca a NVS los contadores y el estado pendientes
+ *
+ * Llamar antes de entrar en deep sleep; los reinicios ya lo hacen a través del
+ * manejador de apagado.
+ */
+void params_cache_flush(void);
+
+/**
+ * @brief Función a la que se llama cuando termina un volcado diferido
+ */
+typedef void (*params_flush_done_t)(void);
+
+/**
+ * @brief Pide un volcado a la tarea de esp_timer sin bloquear a quien lo pide
+ *
+ * Pensado para rutas de tiempo real, como la protección de la batería, que no
+ * pueden esperar a NVS. Si el temporizador no está disponible se vuelca en el
+ * momento.
+ *
+ * @param done Se llama tras el volcado desde la misma tarea, o nullptr
+ */
+void params_cache_flush_async(params_flush_done_t done);
+
+#endif // PARAMS_CACHE_H
@@ -0,0 +1,322 @@
+// history_log.cpp
+#include "history_log.h"
+#include "../app_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <cstring>
+#include <sys/time.h>
+#include "../custom_config.h"
+
+// Logger para el registro histórico
+static LoggerPtr g_HistoryLogger;
+
+// Estados de una ranura: solo se pasan bits de 1 a 0, sin borrar el sector
+constexpr uint32_t SLOT_STATE_ERASED   = 0xFFFFFFFF;
+constexpr uint32_t SLOT_STATE_WRITTEN  = 0xFFFF5A5A;
+constexpr uint32_t SLOT_STATE_UPLOADED = 0x00005A5A;
+
+constexpr size_t SECTOR_SIZE = HISTORY_LOG_SECTOR_SIZE;
+
+/**
+ * @brief Ranura de flash que contiene un registro
+ *
+ * El estado va al principio pero se escribe el último, de modo que un corte
+ * de alimentación a mitad de escritura deja la ranura como "rota" (estado
+ * borrado con datos) y se ignora en el arranque.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t state;
+    history_record_t record;
+    uint16_t crc;
+    uint8_t reserved[128 - sizeof(uint32_t) - sizeof(history_record_t) - sizeof(uint16_t)];
+} history_slot_t;
+
+static_assert(sizeof(history_slot_t) == 128, "history_slot_t must be 128 bytes");
+static_assert(SECTOR_SIZE % sizeof(history_slot_t) == 0, "slots must not straddle sectors");
+
+constexpr size_t SLOTS_PER_SECTOR = SECTOR_SIZE / sizeof(history_slot_t);
+
+static const esp_partition_t* s_partition = NULL;
+static size_t s_slotCount = 0;      // Ranuras totales en la partición
+static size_t s_head = 0;           // Próxima ranura a escribir
+static size_t s_tail = 0;           // Ranura pendiente más antigua
+static uint32_t s_pending = 0;      // Registros escritos y no subidos
+static uint32_t s_nextSeq = 0;      // Secuencia del próximo registro
+static uint32_t s_overwritten = 0;  // Registros perdidos al reciclar sectores
+
+// Lo usa la tarea de subida y, con la cola llena, también la productora
+static SemaphoreHandle_t s_logMutex = NULL;
+
+static inline size_t slot_offset(size_t slot) {
+    return slot * sizeof(history_slot_t);
+}
+
+static inline size_t next_slot(size_t slot) {
+    return (slot + 1) % s_slotCount;
+}
+
+static uint16_t record_crc(const history_record_t* record) {
+    return esp_rom_crc16_le(0, reinterpret_cast<const uint8_t*>(record), sizeof(history_record_t));
+}
+
+static bool read_slot_header(size_t slot, uint32_t* state, uint32_t* seq) {
+    uint32_t header[2];
+    if (esp_partition_read(s_partition, slot_offset(slot), header, sizeof(header)) != ESP_OK) {
+        return false;
+    }
+    *state = header[0];
+    *seq = header[1];
+    return true;
+}
+
+static bool set_slot_state(size_t slot, uint32_t state) {
+    return esp_partition_write(s_partition, slot_offset(slot), &state, sizeof(state)) == ESP_OK;
+}
+
+// Busca la siguiente ranura pendiente a partir de "slot" (sin pasar de la cabeza)
+static bool find_pending(size_t slot, size_t* found) {
+    while (slot != s_head) {
+        uint32_t state, seq;
+        if (read_slot_header(slot, &state, &seq) && state == SLOT_STATE_WRITTEN) {
+            *found = slot;
+            return true;
+        }
+        slot = next_slot(slot);
+    }
+    return false;
+}
+
+bool history_log_init(void) {
+    g_HistoryLogger = createLogger("HISTORY_LOG", INFO, DEBUG_HISTORY);
+
+    s_logMutex = xSemaphoreCreateMutex();
+    if (!s_logMutex) {
+        BI_DEBUG_ERROR(g_HistoryLogger, "Failed to create history log mutex");
+        return false;
+    }
+
+    s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                           static_cast<esp_partition_subtype_t>(HISTORY_LOG_PARTITION_SUBTYPE),
+                                           HISTORY_LOG_PARTITION_LABEL);
+    if (!s_partition) {
+        BI_DEBUG_ERROR(g_HistoryLogger, "History partition '%s' not found", HISTORY_LOG_PARTITION_LABEL);
+        return false;
+    }
+
+    s_slotCount = (s_partition->size / SECTOR_SIZE) * SLOTS_PER_SECTOR;
+    if (s_slotCount < 2 * SLOTS_PER_SECTOR) {
+        BI_DEBUG_ERROR(g_HistoryLogger, "History partition too small (%lu bytes)", s_partition->size);
+        s_partition = NULL;
+        return false;
+    }
+
+    // Localizar cabeza (secuencia más alta usada) y cola (pendiente más antiguo)
+    bool anyUsed = false;
+    bool anyPending = false;
+    uint32_t maxSeq = 0;
+    uint32_t minPendingSeq = 0;
+    size_t maxSlot = 0;
+
+    for (size_t slot = 0; slot < s_slotCount; ++slot) {
+        uint32_t state, seq;
+        if (!read_slot_header(slot, &state, &seq)) {
+            BI_DEBUG_ERROR(g_HistoryLogger, "Error reading history slot %d", (int)slot);
+            s_partition = NULL;
+            return false;
+        }
+
+        if (state == SLOT_STATE_ERASED && seq == 0xFFFFFFFF) {
+            continue;   // Ranura libre
+        }
+
+        // Ranura usada (también las rotas, para no reescribir sobre ellas)
+        if (!anyUsed || seq > maxSeq) {
+            maxSeq = seq;
+            maxSlot = slot;
+            anyUsed = true;
+        }
+
+        if (state == SLOT_STATE_WRITTEN) {
+            if (!anyPending || seq < minPendingSeq) {
+                minPendingSeq = seq;
+                s_tail = slot;
+                anyPending = true;
+            }
+            s_pending++;
+        }
+    }
+
+    s_head = anyUsed ? next_slot(maxSlot) : 0;
+    s_nextSeq = anyUsed ? maxSeq + 1 : 0;
+    if (!anyPending) {
+        s_tail = s_head;
+    }
+
+    BI_DEBUG_INFO(g_HistoryLogger, "History log ready: %d slots, %lu pending, next seq %lu",
+                 (int)s_slotCount, s_pending, s_nextSeq);
+    return true;
+}
+
+static bool append_locked(const history_record_t* record) {
+
+    // Al entrar en un sector nuevo, reciclarlo si contiene datos
+    if (s_head % SLOTS_PER_SECTOR == 0) {
+        uint32_t state, seq;
+        if (!read_slot_header(s_head, &state, &seq)) {
+            return false;
+        }
+
+        if (state != SLOT_STATE_ERASED || seq != 0xFFFFFFFF) {
+            // Contar los pendientes que se van a perder
+            uint32_t lost = 0;
+            for (size_t i = 0; i < SLOTS_PER_SECTOR; ++i) {
+                if (read_slot_header(s_head + i, &state, &seq) && state == SLOT_STATE_WRITTEN) {
+                    lost++;
+                }
+            }
+
+            if (esp_partition_erase_range(s_partition, slot_offset(s_head), SECTOR_SIZE) != ESP_OK) {
+                BI_DEBUG_ERROR(g_HistoryLogger, "Error erasing history sector at slot %d", (int)s_head);
+                return false;
+            }
+
+            if (lost > 0) {
+                s_pending -= lost;
+                s_overwritten += lost;
+                BI_DEBUG_WARNING(g_HistoryLogger, "History log full, %lu unsent records overwritten", lost);
+            }
+
+            // Si la cola estaba en el sector borrado, pasa al siguiente
+            if (s_tail / SLOTS_PER_SECTOR == s_head / SLOTS_PER_SECTOR) {
+                s_tail = (s_head + SLOTS_PER_SECTOR) % s_slotCount;
+            }
+        }
+    }
+
+    static history_slot_t slot;
+    memset(&slot, 0xFF, sizeof(slot));
+    slot.record = *record;
+    slot.record.seq = s_nextSeq;
+    slot.crc = record_crc(&slot.record);
+
+    // Primero los datos, después el estado (ver history_slot_t)
+    const size_t dataOffset = slot_offset(s_head) + sizeof(uint32_t);
+    if (esp_partition_write(s_partition, dataOffset, &slot.record, sizeof(slot) - sizeof(uint32_t)) != ESP_OK ||
+        !set_slot_state(s_head, SLOT_STATE_WRITTEN)) {
+        BI_DEBUG_ERROR(g_HistoryLogger, "Error writing history slot %d", (int)s_head);
+        // La ranura queda rota; se salta para no escribir dos veces sobre ella
+        s_head = next_slot(s_head);
+        s_nextSeq++;
+        return false;
+    }
+
+    if (s_pending == 0) {
+        s_tail = s_head;
+    }
+    s_pending++;
+    s_head = next_slot(s_head);
+    s_nextSeq++;
+
+    BI_DEBUG_VERBOSE(g_HistoryLogger, "History record %lu appended (%lu pending)", slot.record.seq, s_pending);
+    return true;
+}
+
+bool history_log_append(const history_record_t* record) {
+    if (!s_partition || !record) {
+        return false;
+    }
+
+    xSemaphoreTake(s_logMutex, portMAX_DELAY);
+    const bool ok = append_locked(record);
+    xSemaphoreGive(s_logMutex);
+    return ok;
+}
+
+static size_t peek_locked(history_record_t* records, size_t max_records) {
+
+    static history_slot_t slot;
+    size_t count = 0;
+    size_t current = s_tail;
+
+    while (count < max_records && find_pending(current, &current)) {
+        if (esp_partition_read(s_partition, slot_offset(current), &slot, sizeof(slot)) != ESP_OK) {
+            break;
+        }
+
+        if (slot.crc == record_crc(&slot.record)) {
+            records[count++] = slot.record;
+        } else {
+            // Registro corrupto: se descarta para no bloquear la subida
+            BI_DEBUG_WARNING(g_HistoryLogger, "Corrupted history slot %d discarded", (int)current);
+            set_slot_state(current, SLOT_STATE_UPLOADED);
+            s_pending--;
+        }
+        current = next_slot(current);
+    }
+
+    return count;
+}
+
+size_t history_log_peek(history_record_t* records, size_t max_records) {
+    if (!s_partition || !records || s_pending == 0) {
+        return 0;
+    }
+
+    xSemaphoreTake(s_logMutex, portMAX_DELAY);
+    const size_t count = peek_locked(records, max_records);
+    xSemaphoreGive(s_logMutex);
+    return count;
+}
+
+static bool consume_locked(size_t count, uint32_t last_seq) {
+    size_t current = s_tail;
+    while (count > 0 && s_pending > 0 && find_pending(current, &current)) {
+        // Si el sector leído se recicló mientras se subía, lo que sigue es más nuevo
+        uint32_t state, seq;
+        if (!read_slot_header(current, &state, &seq) || seq > last_seq) {
+            break;
+        }
+        if (!set_slot_state(current, SLOT_STATE_UPLOADED)) {
+            BI_DEBUG_ERROR(g_HistoryLogger, "Error marking history slot %d as uploaded", (int)current);
+            s_tail = current;
+            return false;
+        }
+        s_pending--;
+        count--;
+        current = next_slot(current);
+    }
+
+    s_tail = (s_pending > 0) ? current : s_head;
+    return count == 0;
+}
+
+bool history_log_consume(size_t count, uint32_t last_seq) {
+    if (!s_partition) {
+        return false;
+    }
+
+    xSemaphoreTake(s_logMutex, portMAX_DELAY);
+    const bool ok = consume_locked(count, last_seq);
+    xSemaphoreGive(s_logMutex);
+    return ok;
+}
+
+uint32_t history_log_pending(void) {
+    return s_pending;
+}
+
+uint32_t history_log_overwritten(void) {
+    return s_overwritten;
+}
+
+int64_t history_epoch_ms(void) {
+    constexpr time_t MIN_VALID_EPOCH = 1700000000;  // Noviembre de 2023
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (tv.tv_sec < MIN_VALID_EPOCH) {
+        return 0;
+    }
+    return static_cast<int64_t>(tv.tv_sec) * 1000 + tv.tv_usec / 1000;
+}
@@ -0,0 +1,97 @@
+#ifndef HISTORY_LOG_H
+#define HISTORY_LOG_H
+
+#include <cstdint>
+#include <cstddef>
+#include "../Battery/battery_controller.h"
+
+/**
+ * @brief Datos compactos de una celda en un registro histórico
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t voltage_mv;        // Voltaje en mV
+    int16_t temperature_dc;     // Temperatura en décimas de °C
+    uint8_t soc;                // Estado de carga (0-100%)
+} history_cell_t;
+
+/**
+ * @brief Registro histórico de tamaño fijo tal y como se guarda en flash
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t seq;               // Número de secuencia (lo asigna history_log_append)
+    int64_t timestamp_ms;       // Epoch en ms, 0 si el reloj no estaba sincronizado
+    uint32_t uptime;            // Tiempo de funcionamiento del pack en segundos
+    float voltage;              // Voltaje total del pack en V
+    float current;              // Corriente del pack en A
+    float power;                // Potencia del pack en W
+    uint8_t status;             // PackStatus
+    uint8_t cell_count;         // Celdas válidas en cells
+    history_cell_t cells[MAX_CELL_COUNT];
+    uint8_t pack;               // Pack de origen, o HISTORY_SINGLE_PACK
+} history_record_t;
+
+// Registro de un dispositivo con un solo pack: se sube a /history, no a /packs/<n>/history
+#define HISTORY_SINGLE_PACK     (0xFF)
+
+/**
+ * @brief Inicializa el registro en la partición "history" y recupera su estado
+ *
+ * Recorre la partición para localizar el registro más reciente (cabeza) y el
+ * más antiguo pendiente de subir (cola), de modo que los registros tomados
+ * antes de un reinicio se siguen subiendo.
+ *
+ * @return true si la partición existe y se pudo leer
+ */
+bool history_log_init(void);
+
+/**
+ * @brief Añade un registro al final del log
+ *
+ * Al entrar en un sector que ya contiene datos se borra completo; si quedaban
+ * registros sin subir en él se pierden y se contabilizan como sobrescritos.
+ * Se puede llamar desde varias tareas.
+ *
+ * @param record Registro a guardar (el campo seq se ignora)
+ * @return true si el registro se escribió en flash
+ */
+bool history_log_append(const history_record_t* record);
+
+/**
+ * @brief Lee los registros pendientes más antiguos sin consumirlos
+ * @param records Buffer de salida
+ * @param max_records Capacidad del buffer
+ * @return Número de registros copiados en records
+ */
+size_t history_log_peek(history_record_t* records, size_t max_records);
+
+/**
+ * @brief Marca como subidos los count registros pendientes más antiguos
+ *
+ * Si mientras se subían se recicló su sector (log lleno), los registros que
+ * quedan en cabeza son más nuevos que last_seq y no se marcan.
+ *
+ * @param count Número de registros a consumir (normalmente lo devuelto por peek)
+ * @param last_seq Secuencia del último registro leído con peek
+ * @return true si se pudieron marcar todos
+ */
+bool history_log_consume(size_t count, uint32_t last_seq);
+
+/**
+ * @brief Obtiene el número de registros pendientes de subir
+ * @return Registros pendientes
+ */
+uint32_t history_log_pending(void);
+
+/**
+ * @brief Obtiene el número de registros perdidos por sobrescritura desde el arranque
+ * @return Registros sobrescritos sin haberse subido
+ */
+uint32_t history_log_overwritten(void);
+
+/**
+ * @brief Obtiene la hora real para fechar registros
+ * @return Epoch en ms, o 0 si el reloj aún no se ha sincronizado por SNTP
+ */
+int64_t history_epoch_ms(void);
+
+#endif // HISTORY_LOG_H
@@ -0,0 +1,309 @@
+// uplink_controller.cpp
+#include "uplink_controller.h"
+#include "../app_log.h"
+#include "bi_params.hpp"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "../custom_config.h"
+#include "../Storage/history_log.h"
+#include "../Diagnostics/memory_budget.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+extern BIParams biParams;
+
+// Logger para la tarea de subida
+static LoggerPtr g_UplinkLogger;
+
+// Cola de registros pendientes de subir: el almacenamiento es un pool fijo
+// de UPLINK_QUEUE_LENGTH registros, fuera del heap
+static QueueHandle_t s_uplinkQueue = NULL;
+static StaticQueue_t s_uplinkQueueBuffer;
+static uint8_t s_uplinkQueueStorage[UPLINK_QUEUE_LENGTH * sizeof(uplink_record_t)];
+static StaticTask<UPLINK_TASK_STACK_SIZE> s_uplinkTask;
+
+// Históricos rescatados de la cola llena, ya compactos: los guarda en flash
+// uplink_task, así el productor nunca espera por el log
+static QueueHandle_t s_historyQueue = NULL;
+static StaticQueue_t s_historyQueueBuffer;
+static uint8_t s_historyQueueStorage[UPLINK_HISTORY_QUEUE_LENGTH * sizeof(history_record_t)];
+
+// Registros descartados por cola llena (solo lo escribe el productor)
+static volatile uint32_t s_droppedCount = 0;
+
+// true si el log histórico en flash está disponible
+static bool s_historyLogReady = false;
+
+// Última muestra en tiempo real de cada pack. Se reúnen pack a pack y se suben
+// juntas al final de la pasada; sin enlace se retienen y se suben en cuanto
+// vuelve. Solo las toca uplink_task; los indicadores también se leen desde la
+// gestión de la radio.
+static battery_snapshot_t s_pendingLive[PACK_MAX_COUNT];
+static uint32_t s_pendingMask = 0;          // Bit i: hay muestra del pack i en s_pendingLive
+static uint8_t s_pendingPackCount = 0;      // pack_count de las muestras reunidas
+static volatile bool s_hasPendingLive = false;
+static volatile bool s_pendingUrgent = false;
+
+// Convierte una muestra a registro histórico compacto (mV, décimas de °C)
+static void history_record_from_snapshot(const battery_snapshot_t* snapshot, history_record_t* record) {
+    memset(record, 0, sizeof(*record));
+    record->timestamp_ms = snapshot->timestamp_ms;
+    record->uptime = snapshot->uptime;
+    record->voltage = snapshot->voltage;
+    record->current = snapshot->current;
+    record->power = snapshot->power;
+    record->status = static_cast<uint8_t>(snapshot->status);
+    record->cell_count = snapshot->cell_count;
+    record->pack = snapshot->pack_count > 1 ? snapshot->pack : HISTORY_SINGLE_PACK;
+
+    for (uint8_t i = 0; i < snapshot->cell_count; ++i) {
+        float voltage = snapshot->cells.voltage[i];
+        float temperature = snapshot->cells.temperature[i];
+        long mv = std::isfinite(voltage) ? std::lround(voltage * 1000.0f) : 0;
+        long dc = std::isfinite(temperature) ? std::lround(temperature * 10.0f) : 0;
+        record->cells[i].voltage_mv = static_cast<uint16_t>(std::max(0L, std::min(mv, static_cast<long>(UINT16_MAX))));
+        record->cells[i].temperature_dc = static_cast<int16_t>(std::max(static_cast<long>(INT16_MIN), std::min(dc, static_cast<long>(INT16_MAX))));
+        record->cells[i].soc = snapshot->cells.soc[i];
+    }
+}
+
+bool uplink_enqueue(const uplink_record_t* record) {
+    if (!s_uplinkQueue || !record) {
+        return false;
+    }
+
+    if (xQueueSend(s_uplinkQueue, record, 0) == pdTRUE) {
+        return true;
+    }
+
+    // Cola llena: descartar el registro más antiguo para dejar sitio al nuevo.
+    // Estáticos porque solo hay un productor y no queremos los registros en su pila.
+    static uplink_record_t discarded;
+    static history_record_t discardedHistory;
+    if (xQueueReceive(s_uplinkQueue, &discarded, 0) == pdTRUE) {
+        // Un histórico no se pierde: pasa compacto a su propia cola y uplink_task
+        // lo guarda en flash. Solo se descarta de verdad la parte en tiempo
+        // real, que ya está superada. Sin E/S de flash ni esperas aquí.
+        if (discarded.flags & UPLINK_FLAG_HISTORY) {
+            history_record_from_snapshot(&discarded.snapshot, &discardedHistory);
+            if (xQueueSend(s_historyQueue, &discardedHistory, 0) == pdTRUE) {
+                BI_DEBUG_VERBOSE(g_UplinkLogger, "Uplink queue full, oldest history record set aside");
+            } else {
+                s_droppedCount = s_droppedCount + 1;
+                BI_DEBUG_WARNING(g_UplinkLogger, "Uplink queue full, history record lost (total: %lu)", s_droppedCount);
+            }
+        } else {
+            s_droppedCount = s_droppedCount + 1;
+            BI_DEBUG_WARNING(g_UplinkLogger, "Uplink queue full, oldest record dropped (total: %lu)", s_droppedCount);
+        }
+    }
+
+    return xQueueSend(s_uplinkQueue, record, 0) == pdTRUE;
+}
+
+uint32_t uplink_get_dropped_count(void) {
+    return s_droppedCount;
+}
+
+bool uplink_has_pending(void) {
+    return (s_uplinkQueue && uxQueueMessagesWaiting(s_uplinkQueue) > 0) ||
+           (s_historyQueue && uxQueueMessagesWaiting(s_historyQueue) > 0) || s_hasPendingLive ||
+           (s_historyLogReady && history_log_pending() > 0);
+}
+
+bool uplink_has_urgent(void) {
+    return s_hasPendingLive && s_pendingUrgent;
+}
+
+// Guarda un registro histórico; sin partición de log se sube directamente como antes
+static void store_history(const history_record_t* record) {
+    if (s_historyLogReady && history_log_append(record)) {
+        BI_DEBUG_VERBOSE(g_UplinkLogger, "Historical record buffered (%lu pending)", history_log_pending());
+        return;
+    }
+
+    if (store_history_record(record)) {
+        BI_DEBUG_INFO(g_UplinkLogger, "Historical record stored (%d cells)", record->cell_count);
+    } else {
+        BI_DEBUG_WARNING(g_UplinkLogger, "Failed to store historical record");
+    }
+}
+
+static void handle_history(const battery_snapshot_t* snapshot) {
+    static history_record_t record;
+    history_record_from_snapshot(snapshot, &record);
+    store_history(&record);
+}
+
+// Guarda los históricos que el productor apartó al llenarse la cola; van
+// antes que los de la cola, que son más recientes
+static void store_set_aside_history() {
+    static history_record_t record;
+    while (xQueueReceive(s_historyQueue, &record, 0) == pdTRUE) {
+        store_history(&record);
+    }
+}
+
+// Sube un bloque de registros pendientes del log en flash
+static void drain_history_log() {
+    if (!s_historyLogReady || history_log_pending() == 0 || !check_firebase_connectivity()) {
+        return;
+    }
+
+    static history_record_t chunk[HISTORY_DRAIN_CHUNK];
+    size_t count = history_log_peek(chunk, HISTORY_DRAIN_CHUNK);
+
+    // Un PATCH por lote; sin hora válida no hay claves ordenadas y se sube de uno en uno
+    size_t sent = store_history_batch(chunk, count);
+    if (sent == 0 && history_epoch_ms() == 0) {
+        while (sent < count && store_history_record(&chunk[sent])) {
+            sent++;
+        }
+    }
+
+    if (sent > 0) {
+        history_log_consume(sent, chunk[sent - 1].seq);
+        BI_DEBUG_INFO(g_UplinkLogger, "Uploaded %d buffered history records (%lu pending)",
+                     (int)sent, history_log_pending());
+    }
+}
+
+// Sube en un único PATCH las muestras reunidas de todos los packs; solo se
+// descartan si la petición fue bien, si no se reintentan con la próxima subida
+static bool upload_pending_live() {
+    const battery_snapshot_t* snapshots[PACK_MAX_COUNT];
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < PACK_MAX_COUNT; ++i) {
+        if (s_pendingMask & (1u << i)) {
+            snapshots[count++] = &s_pendingLive[i];
+        }
+    }
+    if (count > 0 && !update_battery_snapshots(snapshots, count, false)) {
+        return false;
+    }
+    s_pendingMask = 0;
+    return true;
+}
+
+/**
+ * @brief Guarda la muestra en tiempo real de un pack sobre la que aún no se subió
+ *
+ * La ventana de la muestra sustituida se acumula en la nueva, de modo que la
+ * que se publique cubra todo el intervalo desde la última subida, aunque haya
+ * pasado sin enlace o con pasadas omitidas por obsoletas.
+ */
+static void hold_live_snapshot(const battery_snapshot_t& snapshot) {
+    battery_snapshot_t& pending = s_pendingLive[snapshot.pack];
+    const bool held = (s_pendingMask & (1u << snapshot.pack)) != 0;
+    
+    if (held && pending.cell_count == snapshot.cell_count) {
+        // La ventana nueva recibe la anterior; el resto de la muestra se sustituye
+        static SampleWindow merged;
+        merged = snapshot.window;
+        sample_window_merge(&merged, &pending.window, snapshot.cell_count);
+        pending = snapshot;
+        pending.window = merged;
+    } else {
+        pending = snapshot;
+    }
+    s_pendingMask |= 1u << snapshot.pack;
+}
+
+// Indica si alguna de las muestras reunidas lleva fallos de protección activos
+static bool pending_has_faults() {
+    for (uint8_t i = 0; i < PACK_MAX_COUNT; ++i) {
+        if ((s_pendingMask & (1u << i)) && s_pendingLive[i].faults != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Tarea que consume la cola y realiza las peticiones a Firebase
+static void uplink_task(void* pvParameters) {
+    static uplink_record_t record;
+
+    while (true) {
+        // Con datos pendientes se despierta periódicamente para subirlos
+        TickType_t wait = (s_hasPendingLive || (s_historyLogReady && history_log_pending() > 0)) ?
+                          pdMS_TO_TICKS(HISTORY_DRAIN_PERIOD_MS) : portMAX_DELAY;
+
+        if (xQueueReceive(s_uplinkQueue, &record, wait) == pdTRUE) {
+            const battery_snapshot_t& snapshot = record.snapshot;
+            store_set_aside_history();
+
+            // Los registros históricos se guardan siempre, aunque haya muestras más nuevas
+            if (record.flags & UPLINK_FLAG_HISTORY) {
+                handle_history(&snapshot);
+            }
+
+            // Las muestras de una pasada se reúnen y se suben juntas con la última
+            if ((record.flags & UPLINK_FLAG_LIVE) && snapshot.pack < PACK_MAX_COUNT) {
+                // Con otro número de packs las reunidas corresponden a la estructura anterior
+                if (snapshot.pack_count != s_pendingPackCount) {
+                    s_pendingMask = 0;
+                    s_pendingPackCount = snapshot.pack_count;
+                }
+                hold_live_snapshot(snapshot);
+            }
+
+            // El estado en tiempo real solo tiene valor si es el más reciente:
+            // si ya hay otra pasada en cola, esta queda obsoleta y se omite
+            // (sus ventanas se acumulan en la siguiente)
+            if ((record.flags & UPLINK_FLAG_LIVE) && (record.flags & UPLINK_FLAG_BATCH_END)) {
+                const DeviceState& state = biParams.getState();
+                if (uxQueueMessagesWaiting(s_uplinkQueue) > 0) {
+                    BI_DEBUG_VERBOSE(g_UplinkLogger, "Snapshot superseded by a newer one, skipping");
+                    // Sigue reunida: si lo que espera es solo historial, la sube la pasada sin cola
+                    s_pendingUrgent = pending_has_faults();
+                    s_hasPendingLive = true;
+                } else if (!state.wifiConnected || !state.firebaseConnected) {
+                    // Sin enlace (p. ej. radio apagada entre ráfagas) se guarda la más reciente
+                    s_pendingUrgent = pending_has_faults();
+                    s_hasPendingLive = true;
+                } else if (upload_pending_live()) {
+                    s_hasPendingLive = false;
+                    BI_DEBUG_VERBOSE(g_UplinkLogger, "Snapshot updated in Firebase (%d pack(s))", snapshot.pack_count);
+                } else {
+                    // Se retiene y se reintenta cuando la cola quede vacía
+                    s_pendingUrgent = pending_has_faults();
+                    s_hasPendingLive = true;
+                }
+            }
+        }
+
+        // La muestra retenida y el log solo se suben cuando no hay muestras esperando
+        if (uxQueueMessagesWaiting(s_uplinkQueue) == 0) {
+            if (s_hasPendingLive && check_firebase_connectivity() && upload_pending_live()) {
+                BI_DEBUG_VERBOSE(g_UplinkLogger, "Held snapshot updated in Firebase");
+                s_hasPendingLive = false;
+            }
+            drain_history_log();
+        }
+    }
+}
+
+void uplink_controller_init(void) {
+    g_UplinkLogger = createLogger("UPLINK", INFO, DEBUG_UPLINK);
+
+    // Log histórico en flash para no perder registros sin conexión
+    s_historyLogReady = history_log_init();
+    if (!s_historyLogReady) {
+        BI_DEBUG_WARNING(g_UplinkLogger, "History log unavailable, history will only be stored while online");
+    }
+
+    s_uplinkQueue = xQueueCreateStatic(UPLINK_QUEUE_LENGTH, sizeof(uplink_record_t), s_uplinkQueueStorage,
+                                       &s_uplinkQueueBuffer);
+    s_historyQueue = xQueueCreateStatic(UPLINK_HISTORY_QUEUE_LENGTH, sizeof(history_record_t), s_historyQueueStorage,
+                                        &s_historyQueueBuffer);
+    if (!s_uplinkQueue || !s_historyQueue) {
+        BI_DEBUG_ERROR(g_UplinkLogger, "Failed to create uplink queue");
+        return;
+    }
+
+    s_uplinkTask.start(uplink_task, "uplink_task", NULL, UPLINK_TASK_PRIORITY);
+    BI_DEBUG_INFO(g_UplinkLogger, "Uplink task created (queue: %d records of %d bytes)",
+                 UPLINK_QUEUE_LENGTH, (int)sizeof(uplink_record_t));
+}
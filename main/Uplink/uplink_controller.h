@@ -0,0 +1,70 @@
+#ifndef UPLINK_CONTROLLER_H
+#define UPLINK_CONTROLLER_H
+
+#include <cstdint>
+#include "../Firebase/firebase_controller.h"
+
+/**
+ * @brief Indicadores de lo que debe hacer la tarea de subida con cada registro
+ */
+typedef enum {
+    UPLINK_FLAG_NONE    = 0,
+    UPLINK_FLAG_LIVE    = (1 << 0),  // Actualizar el estado en tiempo real (celdas + pack)
+    UPLINK_FLAG_HISTORY = (1 << 1),  // Guardar como registro histórico (flash + /history)
+    UPLINK_FLAG_BATCH_END = (1 << 2) // Último pack de la pasada: ya están las muestras de todos
+} uplink_flags_t;
+
+/**
+ * @brief Registro de tamaño fijo que viaja por la cola de subida
+ *
+ * Cada pasada de la tarea de batería produce un registro por pack, en orden;
+ * el último lleva UPLINK_FLAG_BATCH_END.
+ */
+typedef struct {
+    battery_snapshot_t snapshot;     // Muestra de celdas y pack
+    uint32_t flags;                  // Combinación de uplink_flags_t
+} uplink_record_t;
+
+/**
+ * @brief Crea la cola de subida y la tarea que la consume
+ *
+ * También abre el log histórico en flash; los registros pendientes de un
+ * arranque anterior se suben en cuanto hay conectividad.
+ *
+ * Debe llamarse antes de battery_controller_init() para que la primera
+ * muestra ya encuentre la cola creada.
+ */
+void uplink_controller_init(void);
+
+/**
+ * @brief Encola un registro para su envío a Firebase sin bloquear
+ *
+ * Si la cola está llena se descarta el registro más antiguo y se incrementa
+ * el contador de descartes; si era un registro histórico se aparta compacto
+ * en una cola propia (UPLINK_HISTORY_QUEUE_LENGTH) y uplink_task lo guarda en
+ * flash, así que esta llamada nunca espera por el log ni borra sectores. Solo
+ * la tarea de batería produce registros.
+ *
+ * @param record Registro a encolar (se copia)
+ * @return true si el registro quedó encolado
+ */
+bool uplink_enqueue(const uplink_record_t* record);
+
+/**
+ * @brief Obtiene el número de registros descartados por cola llena desde el arranque
+ * @return Número de registros descartados
+ */
+uint32_t uplink_get_dropped_count(void);
+
+/**
+ * @brief Indica si quedan datos por subir: registros en cola, la última
+ *        muestra en tiempo real retenida sin enlace o históricos en flash
+ */
+bool uplink_has_pending(void);
+
+/**
+ * @brief Indica si la muestra retenida sin enlace lleva fallos de protección activos
+ */
+bool uplink_has_urgent(void);
+
+#endif // UPLINK_CONTROLLER_H
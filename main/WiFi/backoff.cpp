@@ -0,0 +1,21 @@
+// backoff.cpp
+#include "backoff.h"
+#include "esp_random.h"
+#include <algorithm>
+
+Backoff::Backoff(uint32_t baseMs, uint32_t maxMs)
+    : m_baseMs(std::max<uint32_t>(1, baseMs)), m_maxMs(std::max(baseMs, maxMs)), m_attempts(0) {
+}
+
+uint32_t Backoff::next() {
+    // Tope: base * 2^intentos, sin desbordar
+    uint32_t cap = m_baseMs;
+    for (uint32_t i = 0; i < m_attempts && cap < m_maxMs; ++i) {
+        cap = (cap > m_maxMs / 2) ? m_maxMs : cap * 2;
+    }
+    cap = std::min(cap, m_maxMs);
+    m_attempts++;
+
+    const uint32_t half = cap / 2;
+    return half + esp_random() % (cap - half + 1);
+}
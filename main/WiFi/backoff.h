@@ -0,0 +1,36 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <cstdint>
+
+/**
+ * @brief Espera exponencial con jitter entre reintentos de conexión
+ *
+ * El tope de cada espera se duplica en cada intento desde baseMs hasta maxMs
+ * y la espera devuelta es aleatoria entre la mitad del tope y el tope, para
+ * que los dispositivos que pierden el enlace a la vez no reintenten a la vez.
+ */
+class Backoff {
+public:
+    Backoff(uint32_t baseMs, uint32_t maxMs);
+
+    /**
+     * @brief Vuelve a la espera inicial, p. ej. tras conectar
+     */
+    void reset() { m_attempts = 0; }
+
+    /**
+     * @brief Espera antes del próximo intento; cada llamada cuenta como un intento fallido
+     * @return Espera en ms
+     */
+    uint32_t next();
+
+    uint32_t getAttempts() const { return m_attempts; }
+
+private:
+    uint32_t m_baseMs;
+    uint32_t m_maxMs;
+    uint32_t m_attempts;     // Intentos fallidos desde el último reset()
+};
+
+#endif // BACKOFF_H
@@ -1,11 +1,16 @@
 #include "wifi_controller.h"
 #include "esp_mac.h"
 #include "esp_wifi.h"
+#include "esp_sntp.h"
 
 #include "bi_wifi.hpp"
 #include "bi_params.hpp"
-#include "bi_debug.h"
+#include "../app_log.h"
 #include "../custom_config.h"
+#include "../Params/params_cache.h"
+#include "wifi_power.h"
+#include "../Boot/boot_profile.h"
+#include "../Firebase/firebase_controller.h"
 
 extern BIParams biParams;
 
@@ -18,8 +23,8 @@ void onWiFiStateChanged(WiFiManager::WiFiState state, void* data) {
         {
             BI_DEBUG_INFO(g_commLogger, "WiFi desconectado");
             bool connected = false;
-            biParams.updateStateValue("wifiConnected", &connected, sizeof(bool), true);
-           
+            params_cache_set_state("wifiConnected", &connected, sizeof(bool));
+            firebase_controller_notify_link(false);
             break;
         }
         case WiFiManager::WiFiState::CONNECTING:
@@ -35,9 +40,19 @@ void onWiFiStateChanged(WiFiManager::WiFiState state, void* data) {
                 BI_DEBUG_INFO(g_commLogger, "Conectado a la red: %s", wifi->getSSID().c_str());
                 BI_DEBUG_INFO(g_commLogger, "Dirección IP: %s", wifi->getIPAddress().c_str());
             }
+            wifi_power_on_connected();
+            boot_profile_mark(BOOT_PHASE_WIFI);
             bool connected = true;
-            biParams.updateStateValue("wifiConnected", &connected, sizeof(bool), true);
-            biParams.incrementCounter("wifiConnectCount", 1, false);
+            params_cache_set_state("wifiConnected", &connected, sizeof(bool));
+            params_cache_increment(PARAMS_COUNTER_WIFI_CONNECT);
+            firebase_controller_notify_link(true);
+
+            // Sincronizar la hora para poder fechar los históricos tomados sin conexión
+            if (!esp_sntp_enabled()) {
+                esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+                esp_sntp_setservername(0, SNTP_SERVER);
+                esp_sntp_init();
+            }
             break;
         }
         case WiFiManager::WiFiState::PROVISIONING:
@@ -45,7 +60,8 @@ void onWiFiStateChanged(WiFiManager::WiFiState state, void* data) {
             break;
         case WiFiManager::WiFiState::ERROR:
             BI_DEBUG_ERROR(g_commLogger, "Error en la conexión WiFi");
-            biParams.incrementCounter("wifiFailCount", 1, true);
+            params_cache_increment(PARAMS_COUNTER_WIFI_FAIL);
+            wifi_power_on_error();
             break;
     }
 }
@@ -77,8 +93,9 @@ bool wifi_controller_init(void) {
     // Configurar callback para cambios de estado
     wifi_manager.setConnectionCallback(onWiFiStateChanged, &wifi_manager);
 
-    // Conectar al wifi
-    wifi_controller_connect(ConnectionType::STORED_CREDENTIALS);
+    // Conectar al wifi: con el punto de acceso guardado si lo hay, si no con
+    // las credenciales almacenadas
+    wifi_power_init();
     
     return true;
 }
@@ -0,0 +1,399 @@
+// wifi_power.cpp
+#include "wifi_power.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "esp_netif_net_stack.h"
+#include "lwip/dhcp.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "bi_wifi.hpp"
+#include "bi_params.hpp"
+#include "../app_log.h"
+#include "../custom_config.h"
+#include "../app_config.h"
+#include "../Uplink/uplink_controller.h"
+#include "backoff.h"
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+extern BIParams biParams;
+extern WiFiManager wifi_manager;
+
+// Logger para la gestión de la radio
+static LoggerPtr g_WifiPowerLogger;
+
+/**
+ * @brief Punto de acceso y concesión DHCP de la última conexión
+ *
+ * En memoria RTC para que sobreviva a deep sleep. magic solo es válido tras
+ * una conexión completa; se borra si la reconexión rápida falla.
+ */
+typedef struct {
+    uint32_t magic;
+    uint8_t bssid[6];
+    uint8_t channel;
+    esp_netif_ip_info_t ipInfo;
+    esp_netif_dns_info_t dns;
+    int64_t leaseTime;           // time() al obtener la concesión
+    uint32_t leaseRenewS;        // T1 concedido por el servidor DHCP, 0 si no se conoce
+} wifi_ap_cache_t;
+
+static constexpr uint32_t AP_CACHE_MAGIC = 0x57494649;  // "WIFI"
+
+RTC_DATA_ATTR static wifi_ap_cache_t s_apCache;
+
+// Estado de la radio: todo lo que sigue se accede con s_powerMutex tomado.
+// Lo usan app_main (wifi_power_step), la subida (estadísticas) y el apagado
+// por protección; los callbacks de WiFi solo publican eventos (ver abajo).
+static SemaphoreHandle_t s_powerMutex = NULL;
+static wifi_power_mode_t s_appliedMode = WIFI_POWER_ALWAYS_ON;
+static uint32_t s_appliedListenInterval = 0;
+static bool s_radioOn = false;
+static bool s_fastPending = false;       // Reconexión rápida en curso
+static bool s_leaseReused = false;       // IP de la concesión guardada, sin DHCP
+static int64_t s_connectStartUs = 0;
+static int64_t s_radioOnSinceUs = 0;
+static int64_t s_burstStartUs = 0;
+static int64_t s_linkedSinceUs = 0;      // 0 = aún sin enlace con Firebase en esta ráfaga
+static int64_t s_radioOffSinceUs = 0;
+static wifi_power_stats_t s_stats = {};
+
+// Reintentos tras un error de conexión del WiFiManager
+static Backoff s_reconnectBackoff(WIFI_BACKOFF_BASE_MS, WIFI_BACKOFF_MAX_MS);
+static int64_t s_reconnectAtUs = 0;      // 0 = sin reintento programado
+
+// Eventos del callback de WiFi pendientes de procesar en wifi_power_step().
+// El callback no toma s_powerMutex: app_main lo tiene mientras llama al
+// WiFiManager, que podría esperar a la propia tarea de eventos.
+static portMUX_TYPE s_eventLock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t s_connectedAtUs = 0;      // 0 = sin evento pendiente
+static int64_t s_errorAtUs = 0;
+
+static esp_netif_t* sta_netif() {
+    return esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+}
+
+static const char* mode_to_string(wifi_power_mode_t mode) {
+    switch (mode) {
+        case WIFI_POWER_ALWAYS_ON:  return "on";
+        case WIFI_POWER_MODEM_SLEEP: return "modem";
+        case WIFI_POWER_DUTY_CYCLE: return "duty";
+        default:                    return "unknown";
+    }
+}
+
+// Modem sleep con el intervalo de escucha configurado; este se aplica en la próxima asociación
+static void apply_power_save(wifi_power_mode_t mode) {
+    esp_wifi_set_ps(mode == WIFI_POWER_ALWAYS_ON ? WIFI_PS_NONE : WIFI_PS_MAX_MODEM);
+
+    wifi_config_t config;
+    if (esp_wifi_get_config(WIFI_IF_STA, &config) == ESP_OK) {
+        config.sta.listen_interval = static_cast<uint16_t>(appConfig.wifiListenInterval);
+        esp_wifi_set_config(WIFI_IF_STA, &config);
+    }
+
+    s_appliedMode = mode;
+    s_appliedListenInterval = appConfig.wifiListenInterval;
+    BI_DEBUG_INFO(g_WifiPowerLogger, "WiFi power mode: %s (listen interval %lu)",
+                 mode_to_string(mode), appConfig.wifiListenInterval);
+}
+
+static bool lease_reusable() {
+    if (!WIFI_REUSE_DHCP_LEASE || s_apCache.ipInfo.ip.addr == 0) {
+        return false;
+    }
+    // Sin DHCP no se renueva: solo hasta T1, cuando el cliente ya debería hacerlo
+    const int64_t maxAge = s_apCache.leaseRenewS > 0 ?
+                           std::min<int64_t>(s_apCache.leaseRenewS, WIFI_LEASE_REUSE_MAX_S) : 0;
+    const int64_t age = static_cast<int64_t>(time(nullptr)) - s_apCache.leaseTime;
+    return age >= 0 && age < maxAge;
+}
+
+// T1 de la concesión recién obtenida por DHCP, 0 si lwIP no lo tiene
+static uint32_t granted_lease_renew_s(esp_netif_t* netif) {
+    struct netif* lwip = static_cast<struct netif*>(esp_netif_get_netif_impl(netif));
+    const struct dhcp* dhcp = lwip ? netif_dhcp_data(lwip) : nullptr;
+    if (!dhcp) {
+        return 0;
+    }
+    // Si el servidor no envía T1, el valor por defecto es la mitad de la concesión
+    return dhcp->offered_t1_renew > 0 ? dhcp->offered_t1_renew : dhcp->offered_t0_lease / 2;
+}
+
+/**
+ * @brief Conecta al punto de acceso guardado sin escanear
+ * @return false si no hay punto de acceso o credenciales guardados
+ */
+static bool fast_connect() {
+    if (s_apCache.magic != AP_CACHE_MAGIC) {
+        return false;
+    }
+
+    wifi_config_t config;
+    if (esp_wifi_get_config(WIFI_IF_STA, &config) != ESP_OK || config.sta.ssid[0] == '\0') {
+        return false;
+    }
+    config.sta.bssid_set = true;
+    memcpy(config.sta.bssid, s_apCache.bssid, sizeof(config.sta.bssid));
+    config.sta.channel = s_apCache.channel;
+    config.sta.scan_method = WIFI_FAST_SCAN;
+    config.sta.listen_interval = static_cast<uint16_t>(appConfig.wifiListenInterval);
+    if (esp_wifi_set_config(WIFI_IF_STA, &config) != ESP_OK) {
+        return false;
+    }
+
+    // Sin DHCP se ahorra el intercambio completo tras cada asociación
+    esp_netif_t* netif = sta_netif();
+    s_leaseReused = netif && lease_reusable() && esp_netif_dhcpc_stop(netif) == ESP_OK;
+    if (s_leaseReused) {
+        esp_netif_set_ip_info(netif, &s_apCache.ipInfo);
+        esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &s_apCache.dns);
+    }
+
+    esp_wifi_start();
+    if (esp_wifi_connect() != ESP_OK) {
+        return false;
+    }
+
+    s_fastPending = true;
+    s_stats.fastConnects++;
+    BI_DEBUG_VERBOSE(g_WifiPowerLogger, "Fast reconnect on channel %d%s", s_apCache.channel,
+                    s_leaseReused ? " with cached lease" : "");
+    return true;
+}
+
+// Conexión normal del WiFiManager: escaneo completo y DHCP
+static void normal_connect() {
+    wifi_config_t config;
+    if (esp_wifi_get_config(WIFI_IF_STA, &config) == ESP_OK && config.sta.bssid_set) {
+        config.sta.bssid_set = false;
+        config.sta.channel = 0;
+        esp_wifi_set_config(WIFI_IF_STA, &config);
+    }
+
+    esp_netif_t* netif = sta_netif();
+    if (netif) {
+        esp_netif_dhcpc_start(netif);
+    }
+    s_leaseReused = false;
+
+    esp_wifi_start();
+    wifi_manager.connect();
+}
+
+static void radio_on() {
+    const int64_t now = esp_timer_get_time();
+    s_radioOn = true;
+    s_radioOnSinceUs = now;
+    s_connectStartUs = now;
+    s_linkedSinceUs = 0;
+    if (!fast_connect()) {
+        normal_connect();
+    }
+}
+
+static void radio_off() {
+    const int64_t now = esp_timer_get_time();
+    wifi_manager.disconnect();
+    esp_wifi_stop();
+    s_stats.radioOnMs += (now - s_radioOnSinceUs) / 1000;
+    s_radioOn = false;
+    s_fastPending = false;
+    s_reconnectAtUs = 0;
+    s_radioOffSinceUs = now;
+}
+
+void wifi_power_init(void) {
+    g_WifiPowerLogger = createLogger("WIFI_POWER", INFO, DEBUG_WIFI);
+
+    s_powerMutex = xSemaphoreCreateMutex();
+    xSemaphoreTake(s_powerMutex, portMAX_DELAY);
+    apply_power_save(appConfig.wifiPowerMode);
+    s_burstStartUs = esp_timer_get_time();
+    radio_on();
+    xSemaphoreGive(s_powerMutex);
+}
+
+// Conexión completada: guarda punto de acceso y concesión (con s_powerMutex)
+static void handle_connected(int64_t connectedAtUs) {
+    s_stats.lastConnectMs = static_cast<uint32_t>((connectedAtUs - s_connectStartUs) / 1000);
+    s_fastPending = false;
+    s_reconnectBackoff.reset();
+    s_reconnectAtUs = 0;
+
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+    memcpy(s_apCache.bssid, ap.bssid, sizeof(s_apCache.bssid));
+    s_apCache.channel = ap.primary;
+
+    // Concesión nueva solo si ha habido DHCP; la reutilizada conserva su antigüedad
+    esp_netif_t* netif = sta_netif();
+    if (netif && !s_leaseReused && esp_netif_get_ip_info(netif, &s_apCache.ipInfo) == ESP_OK) {
+        esp_netif_get_dns_info(netif, ESP_NETIF_DNS_MAIN, &s_apCache.dns);
+        s_apCache.leaseTime = static_cast<int64_t>(time(nullptr));
+        s_apCache.leaseRenewS = granted_lease_renew_s(netif);
+    }
+    s_apCache.magic = AP_CACHE_MAGIC;
+
+    BI_DEBUG_INFO(g_WifiPowerLogger, "Connected in %lums (channel %d, %s)", s_stats.lastConnectMs,
+                 s_apCache.channel, s_leaseReused ? "cached lease" : "DHCP");
+}
+
+// Error del WiFiManager: programa el reintento (con s_powerMutex)
+static void handle_error(int64_t errorAtUs) {
+    const uint32_t delayMs = s_reconnectBackoff.next();
+    s_reconnectAtUs = errorAtUs + delayMs * 1000LL;
+    BI_DEBUG_WARNING(g_WifiPowerLogger, "WiFi connection failed, retrying in %lums (attempt %lu)",
+                   delayMs, s_reconnectBackoff.getAttempts());
+}
+
+void wifi_power_on_connected(void) {
+    const int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_eventLock);
+    s_connectedAtUs = now;
+    portEXIT_CRITICAL(&s_eventLock);
+}
+
+void wifi_power_on_error(void) {
+    const int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_eventLock);
+    s_errorAtUs = now;
+    portEXIT_CRITICAL(&s_eventLock);
+}
+
+// Procesa los eventos publicados por el callback en el orden en que llegaron
+static void process_events() {
+    portENTER_CRITICAL(&s_eventLock);
+    const int64_t connectedAt = s_connectedAtUs;
+    const int64_t errorAt = s_errorAtUs;
+    s_connectedAtUs = 0;
+    s_errorAtUs = 0;
+    portEXIT_CRITICAL(&s_eventLock);
+
+    const bool errorFirst = errorAt != 0 && (connectedAt == 0 || errorAt < connectedAt);
+    if (errorFirst) {
+        handle_error(errorAt);
+    }
+    if (connectedAt != 0) {
+        handle_connected(connectedAt);
+    }
+    if (errorAt != 0 && !errorFirst) {
+        handle_error(errorAt);
+    }
+}
+
+static uint32_t step_locked() {
+    process_events();
+
+    const int64_t now = esp_timer_get_time();
+    const DeviceState& state = biParams.getState();
+    const wifi_power_mode_t mode = appConfig.wifiPowerMode;
+
+    if (mode != s_appliedMode || appConfig.wifiListenInterval != s_appliedListenInterval) {
+        apply_power_save(mode);
+        if (mode == WIFI_POWER_DUTY_CYCLE) {
+            // La asociación actual cuenta como ráfaga: se apaga al vaciar la cola
+            s_burstStartUs = now;
+            s_linkedSinceUs = 0;
+        } else if (!s_radioOn) {
+            radio_on();
+        }
+    }
+
+    // Si el punto de acceso guardado no responde, conexión normal y se olvida
+    if (s_fastPending && !state.wifiConnected && now - s_connectStartUs > WIFI_FAST_CONNECT_TIMEOUT_MS * 1000LL) {
+        BI_DEBUG_WARNING(g_WifiPowerLogger, "Fast reconnect timed out, falling back to a full scan");
+        s_stats.fastConnectFails++;
+        s_fastPending = false;
+        s_apCache.magic = 0;
+        esp_wifi_disconnect();
+        normal_connect();
+    }
+
+    // Reintento tras un error; con la radio apagada lo sustituye la próxima ráfaga
+    if (s_reconnectAtUs != 0 && now >= s_reconnectAtUs) {
+        s_reconnectAtUs = 0;
+        if (s_radioOn && !state.wifiConnected) {
+            s_connectStartUs = now;
+            normal_connect();
+        }
+    }
+    
+    if (mode != WIFI_POWER_DUTY_CYCLE) {
+        return WIFI_POWER_POLL_MS;
+    }
+
+    if (s_radioOn) {
+        // Ráfaga: se apaga cuando no queda nada por subir, tras dar margen al
+        // listener para recibir órdenes y cambios de /config
+        const bool linked = state.wifiConnected && state.firebaseConnected;
+        if (linked && s_linkedSinceUs == 0) {
+            s_linkedSinceUs = now;
+        }
+        const bool drained = linked && !uplink_has_pending() &&
+                             now - s_linkedSinceUs >= WIFI_BURST_MIN_MS * 1000LL;
+        const bool expired = now - s_burstStartUs >= WIFI_BURST_MAX_MS * 1000LL;
+        if (drained || expired) {
+            BI_DEBUG_INFO(g_WifiPowerLogger, "Radio off after %lldms burst%s", (now - s_burstStartUs) / 1000,
+                         drained ? "" : " (limit reached)");
+            radio_off();
+        }
+    } else {
+        // Con fallos de protección pendientes no se espera al periodo de ráfaga
+        const int64_t offMs = (now - s_radioOffSinceUs) / 1000;
+        const bool urgent = uplink_has_urgent() && offMs >= WIFI_BURST_MIN_MS;
+        if (urgent || (uplink_has_pending() && offMs >= appConfig.wifiBurstPeriodMs)) {
+            s_stats.bursts++;
+            s_burstStartUs = now;
+            radio_on();
+        }
+    }
+
+    return WIFI_POWER_POLL_MS;
+}
+
+uint32_t wifi_power_step(void) {
+    // Sin wifi_power_init() (p. ej. si falló el WiFiManager) no hay radio que gestionar
+    if (!s_powerMutex) {
+        return WIFI_POWER_POLL_MS;
+    }
+    xSemaphoreTake(s_powerMutex, portMAX_DELAY);
+    const uint32_t nextMs = step_locked();
+    xSemaphoreGive(s_powerMutex);
+    return nextMs;
+}
+
+bool wifi_power_is_duty_cycled(void) {
+    return appConfig.wifiPowerMode == WIFI_POWER_DUTY_CYCLE;
+}
+
+void wifi_power_prepare_deep_sleep(void) {
+    if (!s_powerMutex) {
+        return;
+    }
+    // El punto de acceso ya está en memoria RTC para reconectar rápido al despertar
+    xSemaphoreTake(s_powerMutex, portMAX_DELAY);
+    if (s_radioOn) {
+        radio_off();
+    }
+    xSemaphoreGive(s_powerMutex);
+}
+
+wifi_power_stats_t wifi_power_get_stats(void) {
+    wifi_power_stats_t stats = {};
+    if (!s_powerMutex) {
+        return stats;
+    }
+    xSemaphoreTake(s_powerMutex, portMAX_DELAY);
+    stats = s_stats;
+    if (s_radioOn) {
+        stats.radioOnMs += (esp_timer_get_time() - s_radioOnSinceUs) / 1000;
+    }
+    xSemaphoreGive(s_powerMutex);
+    return stats;
+}
@@ -0,0 +1,73 @@
+#ifndef WIFI_POWER_H
+#define WIFI_POWER_H
+
+#include <cstdint>
+
+/**
+ * @brief Estadísticas de uso de la radio desde el arranque
+ */
+typedef struct {
+    uint32_t bursts;             // Ráfagas de subida en modo de ciclo de trabajo
+    uint32_t fastConnects;       // Conexiones con BSSID/canal guardados
+    uint32_t fastConnectFails;   // Reconexiones rápidas que acabaron en conexión normal
+    uint32_t lastConnectMs;      // Duración de la última conexión hasta tener IP
+    uint64_t radioOnMs;          // Tiempo total con la radio encendida
+} wifi_power_stats_t;
+
+/**
+ * @brief Prepara la gestión de la radio tras wifi_controller_init()
+ *
+ * Si hay un punto de acceso guardado en memoria RTC (p. ej. al despertar de
+ * deep sleep) intenta primero la conexión rápida.
+ */
+void wifi_power_init(void);
+
+/**
+ * @brief Aplica el modo de /config y, en modo de ciclo de trabajo, enciende
+ *        o apaga la radio según lo pendiente en la cola de subida
+ *
+ * Se llama periódicamente desde app_main. Sin wifi_power_init() no hace nada
+ * y devuelve WIFI_POWER_POLL_MS.
+ *
+ * @return ms hasta la próxima llamada
+ */
+uint32_t wifi_power_step(void);
+
+/**
+ * @brief Guarda el punto de acceso y la concesión DHCP de la conexión actual
+ *
+ * Lo llama el callback de WiFi al conectar; quedan en memoria RTC para las
+ * reconexiones rápidas, también tras deep sleep. Solo anota el evento: se
+ * procesa en el siguiente wifi_power_step().
+ */
+void wifi_power_on_connected(void);
+
+/**
+ * @brief Programa un reintento de conexión con espera exponencial
+ *
+ * Lo llama el callback de WiFi cuando el WiFiManager abandona una conexión.
+ * Como wifi_power_on_connected(), se procesa en el siguiente wifi_power_step().
+ */
+void wifi_power_on_error(void);
+
+/**
+ * @brief Indica si la radio se apaga entre ráfagas
+ *
+ * En ese modo las muestras se encolan aunque no haya enlace: la subida
+ * retiene la última y la envía en la siguiente ráfaga.
+ */
+bool wifi_power_is_duty_cycled(void);
+
+/**
+ * @brief Apaga la radio de forma ordenada antes de entrar en deep sleep
+ *
+ * Se puede llamar desde cualquier tarea salvo los callbacks de WiFi.
+ */
+void wifi_power_prepare_deep_sleep(void);
+
+/**
+ * @brief Estadísticas de uso de la radio
+ */
+wifi_power_stats_t wifi_power_get_stats(void);
+
+#endif // WIFI_POWER_H
@@ -0,0 +1,59 @@
+#ifndef APP_CONFIG_H
+#define APP_CONFIG_H
+
+/************************ INCLUDES **************************/
+#include <cstdint>
+#include "custom_config.h"
+
+/**
+ * @brief Codificación de las celdas en los registros históricos
+ */
+typedef enum {
+    HISTORY_ENCODING_JSON = 0,   // Array de objetos {id, voltage, temperature, soc} (por defecto)
+    HISTORY_ENCODING_PACKED,     // Columnas int16/uint8 en base64 (ver HISTORY_PACKED_SCHEMA_VERSION)
+} history_encoding_t;
+
+/**
+ * @brief Gestión de la radio WiFi entre subidas
+ */
+typedef enum {
+    WIFI_POWER_ALWAYS_ON = 0,    // Asociado sin ahorro de energía: menor latencia
+    WIFI_POWER_MODEM_SLEEP,      // Asociado con modem sleep, despierta cada WIFI_LISTEN_INTERVAL beacons (por defecto)
+    WIFI_POWER_DUTY_CYCLE,       // Radio apagada entre ráfagas de subida cada wifiBurstPeriodMs
+} wifi_power_mode_t;
+
+/**
+ * @brief Configuración de aplicación que no forma parte de DeviceParams
+ *
+ * Solo vive en RAM: el listener de /config recibe la configuración completa
+ * cada vez que se registra, así que no necesita persistencia propia en NVS.
+ * Hasta la primera conexión se usan los valores por defecto de custom_config.h.
+ */
+struct AppConfig {
+    uint32_t samplePeriodMs = BATTERY_SAMPLE_PERIOD_MS;        // Periodo de muestreo de las celdas
+    uint32_t cellCapacityMah = PACK_NOMINAL_CAPACITY_MAH;      // Capacidad nominal de cada celda
+    uint8_t packCount = PACK_DEFAULT_COUNT;                     // Packs gestionados por el dispositivo (1..PACK_MAX_COUNT)
+    uint8_t packCellCounts[PACK_MAX_COUNT] = {};                // Celdas de cada pack; 0 = DeviceParams::cellCount
+    bool reportAdaptive = REPORT_ADAPTIVE_DEFAULT;              // Periodo de subida según la actividad del pack
+    uint32_t reportMinPeriodMs = REPORT_MIN_PERIOD_MS;         // Límites del periodo adaptativo
+    uint32_t reportMaxPeriodMs = REPORT_MAX_PERIOD_MS;
+    wifi_power_mode_t wifiPowerMode = WIFI_POWER_MODEM_SLEEP;  // Uso de la radio entre subidas
+    uint32_t wifiListenInterval = WIFI_LISTEN_INTERVAL;        // Beacons entre escuchas en modem sleep
+    uint32_t wifiBurstPeriodMs = WIFI_BURST_PERIOD_MS;         // Mínimo entre ráfagas con la radio apagada
+    uint32_t historyIntervalMs = HISTORY_DEFAULT_INTERVAL_MS;  // Intervalo entre registros históricos
+    uint32_t historyBatchMaxBytes = HISTORY_BATCH_MAX_BYTES;   // Tamaño máximo del cuerpo de un lote de históricos
+    history_encoding_t historyEncoding = HISTORY_ENCODING_JSON; // Formato de las celdas en /history
+
+    // Bandas muertas de la telemetría en tiempo real (0 = enviar cualquier cambio)
+    uint32_t voltageDeadbandMv = TELEMETRY_VOLTAGE_DEADBAND_MV;
+    uint32_t temperatureDeadbandDc = TELEMETRY_TEMPERATURE_DEADBAND_DC;   // Décimas de °C
+    uint32_t socStep = TELEMETRY_SOC_STEP;
+    uint32_t sohStep = TELEMETRY_SOH_STEP;
+    uint32_t telemetryFullResyncSamples = TELEMETRY_FULL_RESYNC_SAMPLES;  // Cada cuántas muestras se envían todas las celdas
+    char otaBaseUrl[OTA_URL_SIZE] = "";                         // Origen de las imágenes OTA (HTTPS)
+    bool latencyProbes = LATENCY_PROBES_DEFAULT;                // Histogramas de latencia (si están compilados)
+};
+
+extern AppConfig appConfig;
+
+#endif // APP_CONFIG_H
@@ -0,0 +1,36 @@
+#ifndef APP_LOG_H
+#define APP_LOG_H
+
+/************************ INCLUDES **************************/
+#include <cstdio>
+#include "bi_debug.h"
+#include "custom_config.h"
+
+/**
+ * Filtrado de logs en compilación
+ *
+ * Las llamadas BI_DEBUG_* por debajo de LOG_MIN_LEVEL (custom_config.h) se
+ * sustituyen por una expresión sin evaluar: el compilador sigue comprobando el
+ * formato y los argumentos, pero no queda código ni cadena en la imagen. Los
+ * errores no se filtran nunca. Incluir este fichero en lugar de bi_debug.h.
+ */
+#define BI_DEBUG_DISCARD(logger, ...) ((void)sizeof(((void)(logger), snprintf(nullptr, 0, __VA_ARGS__))))
+
+#if LOG_MIN_LEVEL > 0
+    #undef BI_DEBUG_VERBOSE
+    #define BI_DEBUG_VERBOSE(logger, ...) BI_DEBUG_DISCARD(logger, __VA_ARGS__)
+#endif
+#if LOG_MIN_LEVEL > 1
+    #undef BI_DEBUG_DEBUG
+    #define BI_DEBUG_DEBUG(logger, ...) BI_DEBUG_DISCARD(logger, __VA_ARGS__)
+#endif
+#if LOG_MIN_LEVEL > 2
+    #undef BI_DEBUG_INFO
+    #define BI_DEBUG_INFO(logger, ...) BI_DEBUG_DISCARD(logger, __VA_ARGS__)
+#endif
+#if LOG_MIN_LEVEL > 3
+    #undef BI_DEBUG_WARNING
+    #define BI_DEBUG_WARNING(logger, ...) BI_DEBUG_DISCARD(logger, __VA_ARGS__)
+#endif
+
+#endif // APP_LOG_H
@@ -2,9 +2,16 @@
 #define __CUSTOM_CONFIG__H
 
 /************************ INCLUDES **************************/
+#include "sdkconfig.h"
+#include "esp_attr.h"
 
 /******************** CONFIG DEFINITIONS ********************/
 
+// Perfil de compilación: sdkconfig.defaults.release activa el de release
+#if !defined(_RELEASE) && CONFIG_BIHAR_RELEASE_BUILD
+    #define _RELEASE (1)
+#endif
+
 // Develop configuration
 #if !_RELEASE
 
@@ -22,14 +29,223 @@
         #define DEBUG_METERING (0)
         #define DEBUG_MAIN     (1)
         #define DEBUG_BATTERY  (0)
+        #define DEBUG_UPLINK   (1)
+        #define DEBUG_HISTORY  (1)
     #endif
 
+    // Histogramas de latencia por etapa en diagnostics/latency
+    #define LATENCY_PROBES (1)
+
 
 // Release configuration
 #else
     #define FW_VERSION						{__DATE__, "00.001_R", {0,1}}
 
+    // Mismos módulos que en develop; LOG_MIN_LEVEL solo filtra el nivel
+    #define GLOBAL_DEBUG (1)
+    #if GLOBAL_DEBUG
+
+        #define DEBUG_WIFI     (0)
+        #define DEBUG_RTC      (1)
+        #define DEBUG_FIREBASE (1)
+        #define DEBUG_PARAMS   (0)
+        #define DEBUG_METERING (0)
+        #define DEBUG_MAIN     (1)
+        #define DEBUG_BATTERY  (0)
+        #define DEBUG_UPLINK   (1)
+        #define DEBUG_HISTORY  (1)
+    #endif
+
+#endif
+
+// Nivel mínimo de BI_DEBUG_* que genera código (0=VERBOSE ... 4=ERROR, ver app_log.h)
+#ifdef CONFIG_BIHAR_LOG_MIN_LEVEL
+    #define LOG_MIN_LEVEL CONFIG_BIHAR_LOG_MIN_LEVEL
+#else
+    #define LOG_MIN_LEVEL (0)
+#endif
+
+// Camino caliente de muestreo y protección en IRAM
+#if CONFIG_BIHAR_HOT_PATH_IN_IRAM
+    #define HOT_PATH_ATTR IRAM_ATTR
+#else
+    #define HOT_PATH_ATTR
+#endif
+
+// Sin sondas compiladas no cuestan nada (ver Diagnostics/latency_probe.h)
+#ifndef LATENCY_PROBES
+    #define LATENCY_PROBES (0)
 #endif
+#define LATENCY_PROBES_DEFAULT          (true)  // Estado inicial del interruptor de /config
+
+// On-device benchmark configuration (orden "benchmark")
+#define BENCHMARK_ITERATIONS            (100)   // Iteraciones promediadas por tamaño de pack
+#define BENCHMARK_HEAP_ROUNDS           (4)     // Rondas de medida del heap: se publica la menor pérdida
+#define BENCHMARK_SEED                  (0x5EED1234)  // Semilla fija: mismas muestras en cada ejecución
+#define BENCHMARK_BUFFER_SIZE           (3072)  // JSON completo de MAX_CELL_COUNT celdas
+#define BENCHMARK_TASK_STACK_SIZE       (8192)  // El PATCH de resultados (TLS) se hace en esta pila
+#define BENCHMARK_TASK_PRIORITY         (2)     // Por debajo de command_task: órdenes y acks no esperan
+
+// OTA configuration
+#define OTA_URL_SIZE                    (256)   // appConfig.otaBaseUrl + "/<versión>.bin"
+#define OTA_HTTP_REQUEST_SIZE           (16384) // Bytes por petición de rango durante la descarga
+#define OTA_HTTP_TIMEOUT_MS             (30000)
+#define OTA_STATUS_BUFFER_SIZE          (384)   // JSON de diagnostics/ota
+#define OTA_TASK_STACK_SIZE             (8192)  // TLS de la descarga en esta pila
+#define OTA_TASK_PRIORITY               (3)     // Por debajo del muestreo y de la subida
+#define OTA_HEALTHY_SAMPLES             (10)    // Muestras seguidas del pack 0 leídas bien para confirmar una imagen nueva
+
+// Boot configuration
+#define NETWORK_INIT_TASK_STACK_SIZE    (6144)  // Inicialización de WiFi y Firebase, en paralelo con el muestreo
+#define NETWORK_INIT_TASK_PRIORITY      (4)     // Por debajo de battery_task: la primera muestra va antes
+
+// Task and memory budget configuration
+#define BATTERY_TASK_STACK_SIZE         (8192)
+#define BATTERY_TASK_PRIORITY           (5)
+#define FIREBASE_TASK_STACK_SIZE        (8192)  // Autenticación y listeners (TLS) en esta pila
+#define FIREBASE_TASK_PRIORITY          (5)
+#define MEMORY_BUDGET_MAX_TASKS         (8)     // Tareas en el informe de pilas
+#define MEMORY_REPORT_PERIOD_MS         (300000)
+#define MEMORY_STACK_WARN_BYTES         (512)   // Aviso si a una pila le ha llegado a quedar menos
+#define FIREBASE_PATH_SIZE              (192)   // "/batteries/" + UID + subruta
+
+// Uplink configuration
+#define UPLINK_QUEUE_LENGTH             (PACK_MAX_COUNT > 4 ? 2 * PACK_MAX_COUNT : 8) // Dos pasadas de todos los packs, como mínimo 8 registros (drop-oldest al llenarse)
+#define UPLINK_HISTORY_QUEUE_LENGTH     (4)     // Históricos rescatados de la cola llena, pendientes de guardar en flash
+#define UPLINK_TASK_STACK_SIZE          (8192)
+#define UPLINK_TASK_PRIORITY            (4)     // Por debajo de battery_task para no retrasar el muestreo
+
+// Firebase connection configuration
+#define FIREBASE_KEEP_ALIVE_IDLE_S      (30)    // Inactividad antes del primer keep-alive TCP
+#define FIREBASE_KEEP_ALIVE_INTERVAL_S  (10)
+#define FIREBASE_KEEP_ALIVE_COUNT       (3)
+#define FIREBASE_MAINTAIN_PERIOD_MS     (10000) // Comprobación de la autenticación con la sesión abierta
+#define FIREBASE_BACKOFF_BASE_MS        (1000)  // Espera tras el primer intento fallido de sesión
+#define FIREBASE_BACKOFF_MAX_MS         (120000)
+#define FIREBASE_REFRESH_TOKEN_SIZE     (1024)  // Refresh token conservado entre caídas del enlace
+#define FIREBASE_UID_SIZE               (129)   // UID de Firebase Auth (hasta 128 caracteres)
+#define REMOTE_CONFIG_SAVE_DEBOUNCE_MS  (2000)  // Agrupa en un guardado NVS las ediciones seguidas de /config
+
+// Remote commands configuration
+#define COMMAND_QUEUE_LENGTH            (16)    // Órdenes en espera de command_task
+#define COMMAND_BATCH_MAX               (8)     // Órdenes por lote (un PATCH de acks por lote)
+#define COMMAND_ID_SIZE                 (32)    // Clave de la orden (los push-id tienen 20 caracteres)
+#define COMMAND_VALUE_SIZE              (32)
+#define COMMAND_RESULT_SIZE             (64)
+#define COMMAND_RECENT_IDS              (16)    // Órdenes recientes que no se vuelven a encolar
+#define COMMAND_ACK_BUFFER_SIZE         (3072)  // Cuerpo del PATCH de acks de un lote completo
+#define COMMAND_ACK_RETRY_MS            (10000) // Reintento de los acks que no llegaron
+#define COMMAND_TASK_STACK_SIZE         (8192)  // Las peticiones HTTPS (TLS) se hacen en esta pila
+#define COMMAND_TASK_PRIORITY           (3)
+
+// Write-behind params configuration
+#define PARAMS_FLUSH_PERIOD_MS          (60000) // Volcado a NVS de contadores y estado
+
+// History store-and-forward configuration
+#define HISTORY_LOG_PARTITION_LABEL     "history"
+#define HISTORY_LOG_PARTITION_SUBTYPE   (0x40)  // Debe coincidir con partition_table.csv
+#define HISTORY_LOG_SECTOR_SIZE         (4096)
+#define HISTORY_DRAIN_CHUNK             (16)    // Registros leídos de flash por pasada (máximo por lote)
+#define HISTORY_BATCH_BUFFER_SIZE       (4096)  // Buffer del cuerpo del PATCH (= http_config.buffer_size)
+#define HISTORY_BATCH_MAX_BYTES         (3584)  // Límite configurable del cuerpo, con margen sobre el buffer
+#define HISTORY_BATCH_MIN_BYTES         (1536)  // Garantiza que cabe un registro de MAX_CELL_COUNT celdas
+#define HISTORY_DRAIN_PERIOD_MS         (1000)  // Espera entre pasadas mientras quedan pendientes
+#define HISTORY_DEFAULT_INTERVAL_MS     (3600000)
+#define HISTORY_MIN_INTERVAL_MS         (10000)
+#define HISTORY_PACKED_SCHEMA_VERSION   (1)     // Incrementar si cambia el formato de cellsPacked
+#define SNTP_SERVER                     "pool.ntp.org"  // Hora real para los registros guardados offline
+
+// Cell acquisition configuration
+#define CELL_DATA_SOURCE_SIMULATED          (0)
+#define CELL_DATA_SOURCE_ADC                (1)
+#define CELL_DATA_SOURCE                    CELL_DATA_SOURCE_SIMULATED
+#define CELL_SIM_SEED                       (0)     // 0 = semilla aleatoria; fija para ejecuciones reproducibles
+#define ADC_CELL_CHANNELS                   {0, 1, 2, 3}    // Canal ADC1 de cada toma del stack (C3: GPIO0-4)
+#define ADC_CELL_DIVIDER                    (7.5f)  // Relación del divisor de cada toma (la más alta manda, ver abajo)
+#define ADC_CELL_MAX_VOLTAGE                (4.25f) // V por celda con carga completa y margen
+#define ADC_INPUT_MAX_MV                    (2500)  // Entrada útil del ADC del C3 con 12 dB, según la calibración
+#define ADC_CURRENT_CHANNEL                 (4)     // Canal del amplificador de shunt, -1 si no hay
+#define ADC_CURRENT_ZERO_MV                 (1650.0f)
+#define ADC_CURRENT_MV_PER_A                (100.0f)
+#define ADC_SAMPLE_FREQ_HZ                  (20000) // Conversiones por segundo entre todos los canales
+#define ADC_CONV_FRAME_SIZE                 (256)   // Bytes por marco DMA (múltiplo de 4)
+#define ADC_POOL_FRAMES                     (4)     // Marcos en el pool del driver: ~13 ms de conversiones a 20 kHz
+#define PACK_SOURCE_MAX_MISSED_READS        (5)     // Lecturas sin marco antes de marcar el pack en error
+#define PACK_IDLE_CURRENT_A                 (0.2f)  // |I| por debajo: pack en reposo
+
+// Multi-pack configuration
+#ifdef CONFIG_BIHAR_PACK_MAX_COUNT
+    #define PACK_MAX_COUNT                  CONFIG_BIHAR_PACK_MAX_COUNT // Kconfig; ~3 KB de RAM estática por pack
+#else
+    #define PACK_MAX_COUNT                  (1)     // Packs por dispositivo
+#endif
+#define PACK_DEFAULT_COUNT                  (1)     // Hasta recibir /config; con 1 pack se mantiene la estructura de /batteries/<uid>
+#define PACK_SAMPLE_SLOT_MIN_MS             (10)    // Separación mínima entre lecturas de packs distintos (un tick)
+
+// SOC/SOH estimation configuration
+#define PACK_NOMINAL_CAPACITY_MAH           (5000)  // Capacidad nominal por celda (configurable desde /config)
+#define SOC_REST_CURRENT_MA                 (150)   // |I| por debajo: la celda se considera en reposo
+#define SOC_REST_TIME_MS                    (1800000) // Reposo necesario para tomar la tensión como OCV
+#define SOC_FADE_MIN_SWING_PERMILLE         (200)   // Variación de SOC mínima entre reposos para medir capacidad
+#define SOC_FADE_FILTER_DIVIDER             (8)     // Filtro de la capacidad medida (1 = sin filtro)
+#define SOC_MIN_CAPACITY_PERCENT            (50)    // Límites de la capacidad estimada respecto a la nominal
+#define SOC_MAX_CAPACITY_PERCENT            (110)
+
+// Cell balancing configuration
+#define BALANCE_DRIVER_NONE                 (0)     // Sin hardware: el estado se calcula pero no se conmuta nada
+#define BALANCE_DRIVER_GPIO                 (1)     // Una resistencia de descarga por celda conmutada por GPIO
+#define BALANCE_DRIVER                      BALANCE_DRIVER_NONE
+#define BALANCE_GPIOS                       {5, 6, 7, 10} // GPIO de descarga de cada celda, en orden
+#define BALANCE_PERIOD_MS                   (1000)  // Periodo del trabajo de balanceo
+#define BALANCE_ON_MS                       (8000)  // Fase de descarga
+#define BALANCE_OFF_MS                      (2000)  // Fase de medida con las resistencias abiertas
+#define BALANCE_STOP_RATIO_PERCENT          (50)    // Se detiene con spread < umbral * ratio
+#define BALANCE_MAX_TEMPERATURE             (45.0f) // Pausa el balanceo por encima de esta temperatura
+#define BALANCE_TEMPERATURE_HYSTERESIS      (5.0f)
+#define BALANCE_MIN_CELL_VOLTAGE            (3.3f)  // No descargar celdas por debajo de esta tensión
+
+// WiFi power management configuration
+#define WIFI_LISTEN_INTERVAL                (3)     // Beacons entre escuchas con modem sleep (configurable desde /config)
+#define WIFI_BURST_PERIOD_MS                (60000) // Mínimo entre ráfagas en modo de ciclo de trabajo
+#define WIFI_BURST_PERIOD_MAX_MS            (3600000) // Máximo aceptado desde /config para power/wifiBurstPeriod
+#define WIFI_BURST_MIN_MS                   (3000)  // Radio encendida tras vaciar la cola, para recibir órdenes y /config
+#define WIFI_BURST_MAX_MS                   (30000) // Límite de una ráfaga aunque queden datos o no conecte
+#define WIFI_FAST_CONNECT_TIMEOUT_MS        (3000)  // Con BSSID/canal guardados; después conexión normal
+#define WIFI_REUSE_DHCP_LEASE               (1)     // Reutilizar la IP anterior en las reconexiones rápidas
+#define WIFI_LEASE_REUSE_MAX_S              (3600)  // Antigüedad máxima de la concesión reutilizada (y nunca más del T1 concedido)
+#define WIFI_BACKOFF_BASE_MS                (2000)  // Reintento de conexión tras un error del WiFiManager
+#define WIFI_BACKOFF_MAX_MS                 (300000)
+#define WIFI_POWER_POLL_MS                  (1000)  // Periodo de la gestión de la radio en app_main
+
+// Battery task scheduling configuration
+#define BATTERY_SAMPLE_PERIOD_MS            (1000)  // Periodo de muestreo por defecto (configurable desde /config)
+#define BATTERY_MIN_SAMPLE_PERIOD_MS        (50)
+#define LIVE_MIN_INTERVAL_MS                (1000)  // Mínimo entre subidas del estado en tiempo real
+#define REPORT_ADAPTIVE_DEFAULT             (true)  // Periodo de subida según la actividad (configurable desde /config)
+#define REPORT_MIN_PERIOD_MS                (2000)  // Periodo con urgencia máxima (cerca de alertas, transitorios)
+#define REPORT_MAX_PERIOD_MS                (300000) // Periodo con el pack en reposo
+#define REPORT_VOLTAGE_MARGIN               (0.10f) // V hasta el umbral de alerta a partir de los que se acelera
+#define REPORT_TEMPERATURE_MARGIN           (5.0f)  // °C hasta el umbral de alerta
+#define REPORT_CURRENT_MARGIN_PERCENT       (20)    // % de maxCurrent por debajo del límite
+#define REPORT_DIDT_DEADBAND                (0.1f)  // A/s de |dI/dt| que se consideran ruido
+#define REPORT_DIDT_FULL_SCALE              (2.0f)  // A/s de |dI/dt| con los que se usa el periodo mínimo
+#define ALERT_CHECK_PERIOD_MS               (1000)  // Comprobación de alertas pendientes de informar
+
+// Protection configuration
+#define PROTECTION_TRIP_SAMPLES             (3)     // Muestras seguidas fuera de límite para activar un fallo
+#define PROTECTION_CLEAR_SAMPLES            (5)     // Muestras seguidas dentro de límite para desactivarlo
+#define PROTECTION_VOLTAGE_HYSTERESIS       (0.05f) // V por celda
+#define PROTECTION_TEMPERATURE_HYSTERESIS   (2.0f)  // °C
+#define PROTECTION_CURRENT_HYSTERESIS       (0.5f)  // A
+#define PROTECTION_SHUTDOWN_WAKE_S          (900)   // Tras el apagado por tensión crítica, despertar a medir de nuevo
+#define ALERT_REPORT_INTERVAL_MS            (30000) // Informe de alertas (logs, lastError), no afecta a la detección
+
+// Delta telemetry configuration (valores por defecto, configurables desde /config)
+#define TELEMETRY_VOLTAGE_DEADBAND_MV       (2)     // mV
+#define TELEMETRY_TEMPERATURE_DEADBAND_DC   (2)     // Décimas de °C
+#define TELEMETRY_SOC_STEP                  (1)     // %
+#define TELEMETRY_SOH_STEP                  (1)     // %
+#define TELEMETRY_FULL_RESYNC_SAMPLES       (60)    // 1 = enviar siempre todas las celdas
 
 
 #endif
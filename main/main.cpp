@@ -4,40 +4,88 @@
 #include "bi_params.hpp"
 #include "Firebase/firebase_controller.h"
 #include "custom_config.h"
-#include "bi_debug.h"
+#include "app_config.h"
+#include "app_log.h"
 #include "Battery/battery_controller.h"
+#include "Uplink/uplink_controller.h"
+#include "Params/params_cache.h"
+#include "WiFi/wifi_power.h"
+#include "Boot/boot_profile.h"
+#include "Diagnostics/memory_budget.h"
+#include "Ota/ota_controller.h"
+#include "freertos/task.h"
 
 BIParams biParams;
+AppConfig appConfig;
 LoggerPtr g_mainLogger;
 
+// Tarea principal, avisada cuando la red está inicializada
+static TaskHandle_t s_mainTaskHandle = NULL;
+
+/**
+ * @brief Inicializa WiFi y Firebase en paralelo con el arranque del muestreo
+ *
+ * La asociación y la autenticación tardan segundos; mientras tanto la tarea de
+ * batería ya está midiendo. Termina avisando a app_main.
+ */
+static void network_init_task(void* pvParameters) {
+    // Inicializa WiFi
+    wifi_controller_init();
+
+    // Inicializa firebase
+    firebase_controller_init();
+
+    xTaskNotifyGive(s_mainTaskHandle);
+    vTaskDelete(NULL);
+}
+
 extern "C" void app_main(void)
 {
     g_mainLogger = createLogger("MAIN", INFO, DEBUG_MAIN);
+    boot_profile_init();
+    memory_budget_init();
 
     BI_DEBUG_INFO(g_mainLogger, "Sistema de gestión de baterías Bihar iniciando...");
 
     // Inicializa parametros y actualiza contadores arranque
     biParams.init();
     biParams.incrementCounter("bootCount");
-
-    biParams.printState();
     biParams.resetState();
+    boot_profile_mark(BOOT_PHASE_PARAMS);
+
+    // Imagen recién actualizada: se confirma cuando el muestreo funciona
+    ota_controller_init();
+
+    // Contadores y estado de alta frecuencia: en RAM y a NVS periódicamente
+    params_cache_init();
+
+    // Inicializa la cola y la tarea de subida antes de empezar a muestrear
+    uplink_controller_init();
 
     // Inicializa controlador de bateria (usa configuración de celdas automáticamente)
     battery_controller_init();
 
-    // Inicializa WiFi
-    wifi_controller_init();
+    // La red arranca en su propia tarea para no retrasar la primera muestra. Se
+    // crea después de la batería: con más prioridad que app_main, creada antes
+    // se adelantaría a battery_controller_init()
+    s_mainTaskHandle = xTaskGetCurrentTaskHandle();
+    xTaskCreate(network_init_task, "network_init", NETWORK_INIT_TASK_STACK_SIZE, NULL,
+                NETWORK_INIT_TASK_PRIORITY, NULL);
 
-    // Inicializa firebase
-    firebase_controller_init();
+    // El volcado de parámetros por consola ya no retrasa el muestreo
+    biParams.printState();
+
+    // wifi_power_step() necesita el WiFi inicializado
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
     BI_DEBUG_INFO(g_mainLogger, "Sistema Bihar inicializado correctamente");
     BI_DEBUG_INFO(g_mainLogger, "Monitoreo de %d celdas activo", biParams.getCellCount());
 
     while (1) {
-        // Agrega tu código principal aqui
-        vTaskDelay(pdMS_TO_TICKS(10000)); // 10 segundos
-        
+        // Informe periódico de pilas y heap
+        memory_budget_step();
+
+        // Gestión de la radio: modo de ahorro y, en ciclo de trabajo, ráfagas de subida
+        vTaskDelay(pdMS_TO_TICKS(wifi_power_step()));
     }
-}
\ No newline at end of file
+}